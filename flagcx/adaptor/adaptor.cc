@@ -118,11 +118,24 @@ struct flagcxCCLAdaptor *cclAdaptors[NCCLADAPTORS] = {&mpiAdaptor,
                                                       &rcclAdaptor};
 #endif
 struct flagcxDeviceAdaptor *deviceAdaptor = &hipAdaptor;
+#elif USE_HOST_ADAPTOR
+#ifdef USE_BOOTSTRAP_ADAPTOR
+struct flagcxCCLAdaptor *cclAdaptors[NCCLADAPTORS] = {&bootstrapAdaptor,
+                                                      &hostcclAdaptor};
+#elif USE_GLOO_ADAPTOR
+struct flagcxCCLAdaptor *cclAdaptors[NCCLADAPTORS] = {&glooAdaptor,
+                                                      &hostcclAdaptor};
+#elif USE_MPI_ADAPTOR
+struct flagcxCCLAdaptor *cclAdaptors[NCCLADAPTORS] = {&mpiAdaptor,
+                                                      &hostcclAdaptor};
+#endif
+struct flagcxDeviceAdaptor *deviceAdaptor = &hostAdaptor;
 #endif
 
 // External adaptor declarations
 extern struct flagcxNetAdaptor flagcxNetSocket;
 extern struct flagcxNetAdaptor flagcxNetIb;
+extern struct flagcxNetAdaptor flagcxNetShm;
 
 #ifdef USE_IBUC
 extern struct flagcxNetAdaptor flagcxNetIbuc;
@@ -147,6 +160,8 @@ struct flagcxNetAdaptor *getUnifiedNetAdaptor(int netType) {
 #endif
     case SOCKET:
       return &flagcxNetSocket;
+    case SHM:
+      return &flagcxNetShm;
     default:
       return NULL;
   }
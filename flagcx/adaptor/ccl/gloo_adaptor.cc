@@ -3,6 +3,10 @@
 
 #ifdef USE_GLOO_ADAPTOR
 
+// Communicators with deferred ops in the current group
+static std::vector<flagcxInnerComm *> groupComms;
+static int groupDepth = 0;
+
 // TODO: unsupported
 flagcxResult_t glooAdaptorGetVersion(int *version) {
   return flagcxNotSupported;
@@ -59,7 +63,7 @@ flagcxResult_t glooAdaptorCommInitRank(flagcxInnerComm_t *comm, int nranks,
   }
   // }
   if (*comm == NULL) {
-    FLAGCXCHECK(flagcxCalloc(comm, 1));
+    *comm = new flagcxInnerComm();
   }
   // Create gloo context
   (*comm)->base = std::make_shared<flagcxGlooContext>(rank, nranks, bootstrap);
@@ -73,7 +77,11 @@ flagcxResult_t glooAdaptorCommFinalize(flagcxInnerComm_t comm) {
 }
 
 flagcxResult_t glooAdaptorCommDestroy(flagcxInnerComm_t comm) {
+  // buffers belong to the transport context, release them first
+  comm->pendingOps.clear();
+  comm->buffers.clear();
   comm->base.reset();
+  delete comm;
   return flagcxSuccess;
 }
 
@@ -217,12 +225,78 @@ flagcxResult_t glooAdaptorAllReduce(const void *sendbuff, void *recvbuff,
   return flagcxSuccess;
 }
 
-// TODO: unsupported
+// Ring reduce-scatter: at step s every rank adds its own contribution to
+// the partial result of chunk rank-s-1 and passes it on, so after nranks-1
+// steps rank r holds the reduction of chunk r. Each rank sends and receives
+// (nranks-1)/nranks of the data.
 flagcxResult_t
 glooAdaptorReduceScatter(const void *sendbuff, void *recvbuff, size_t recvcount,
                          flagcxDataType_t datatype, flagcxRedOp_t op,
                          flagcxInnerComm_t comm, flagcxStream_t /*stream*/) {
-  return flagcxNotSupported;
+  int rank = comm->base->rank;
+  int nranks = comm->base->size;
+  size_t chunkBytes = recvcount * getFlagcxDataTypeSize(datatype);
+  const char *input = static_cast<const char *>(sendbuff);
+  if (nranks == 1) {
+    if (recvbuff != sendbuff) {
+      memcpy(recvbuff, sendbuff, chunkBytes);
+    }
+    return flagcxSuccess;
+  }
+  flagcxGlooReduceFunc fn = getFunction<flagcxGlooReduceFunc>(datatype, op);
+  if (fn == nullptr) {
+    return flagcxInvalidArgument;
+  }
+  if (chunkBytes == 0) {
+    return flagcxSuccess;
+  }
+
+  int next = (rank + 1) % nranks;
+  int prev = (rank - 1 + nranks) % nranks;
+  uint64_t slot = comm->base->nextSlot();
+  // partial results alternate between two halves, so that one can be sent
+  // while the next one is computed
+  std::vector<char> partial(2 * chunkBytes);
+  std::vector<char> incoming(chunkBytes);
+  try {
+    auto inputBuf = comm->base->createUnboundBuffer(const_cast<char *>(input),
+                                                    nranks * chunkBytes);
+    auto partialBuf =
+        comm->base->createUnboundBuffer(partial.data(), partial.size());
+    auto incomingBuf =
+        comm->base->createUnboundBuffer(incoming.data(), incoming.size());
+    inputBuf->send(next, slot, prev * chunkBytes, chunkBytes);
+    int partialSends = 0;
+    for (int step = 0; step < nranks - 1; step++) {
+      int chunk = (rank - step - 2 + 2 * nranks) % nranks;
+      incomingBuf->recv(prev, slot);
+      incomingBuf->waitRecv(flagcxGlooDefaultTimeout);
+      const char *own = input + chunk * chunkBytes;
+      if (step == nranks - 2) {
+        // chunk == rank. recvbuff may alias any part of sendbuff, including
+        // the chunk the first send may still be reading
+        inputBuf->waitSend(flagcxGlooDefaultTimeout);
+        fn(recvbuff, own, incoming.data(), recvcount);
+        break;
+      }
+      size_t offset = (step % 2) * chunkBytes;
+      if (partialSends == 2) {
+        // sends complete in order, this frees the half sent two steps ago
+        partialBuf->waitSend(flagcxGlooDefaultTimeout);
+        partialSends--;
+      }
+      fn(partial.data() + offset, own, incoming.data(), recvcount);
+      partialBuf->send(next, slot, offset, chunkBytes);
+      partialSends++;
+    }
+    for (; partialSends > 0; partialSends--) {
+      partialBuf->waitSend(flagcxGlooDefaultTimeout);
+    }
+  } catch (const std::exception &e) {
+    WARN("Gloo ReduceScatter failed: %s", e.what());
+    return flagcxRemoteError;
+  }
+  return flagcxSuccess;
 }
 
 flagcxResult_t glooAdaptorAllGather(const void *sendbuff, void *recvbuff,
@@ -257,19 +331,132 @@ flagcxResult_t glooAdaptorAlltoAllv(const void *sendbuff, size_t *sendcounts,
                                     flagcxDataType_t datatype,
                                     flagcxInnerComm_t comm,
                                     flagcxStream_t /*stream*/) {
-  // Note that sdispls and rdispls are not used in Gloo.
-  ::gloo::AlltoallvOptions opts(comm->base);
-  std::vector<int64_t> send_cnt(comm->base->size);
-  std::vector<int64_t> recv_cnt(comm->base->size);
-  for (int i = 0; i < comm->base->size; ++i) {
-    send_cnt[i] = sendcounts[i];
-    recv_cnt[i] = recvcounts[i];
+  // Every block is sent from and received into its place at the given
+  // displacement, one unbound buffer spans each side
+  int rank = comm->base->rank;
+  int nranks = comm->base->size;
+  size_t typeSize = getFlagcxDataTypeSize(datatype);
+  size_t sendBytes = 0, recvBytes = 0;
+  for (int i = 0; i < nranks; ++i) {
+    sendBytes = std::max(sendBytes, (sdispls[i] + sendcounts[i]) * typeSize);
+    recvBytes = std::max(recvBytes, (rdispls[i] + recvcounts[i]) * typeSize);
+  }
+  if (recvcounts[rank] > 0) {
+    memmove((char *)recvbuff + rdispls[rank] * typeSize,
+            (const char *)sendbuff + sdispls[rank] * typeSize,
+            recvcounts[rank] * typeSize);
   }
 
-  GENERATE_GLOO_TYPES(datatype, setInput, opts, const_cast<void *>(sendbuff),
-                      send_cnt);
-  GENERATE_GLOO_TYPES(datatype, setOutput, opts, recvbuff, recv_cnt);
-  ::gloo::alltoallv(opts);
+  uint64_t slot = comm->base->nextSlot();
+  try {
+    buffer_ptr sendBuf, recvBuf;
+    int nSends = 0, nRecvs = 0;
+    if (recvBytes > 0) {
+      recvBuf = comm->base->createUnboundBuffer(recvbuff, recvBytes);
+    }
+    if (sendBytes > 0) {
+      sendBuf = comm->base->createUnboundBuffer(const_cast<void *>(sendbuff),
+                                                sendBytes);
+    }
+    for (int i = 1; i < nranks; ++i) {
+      int peer = (rank - i + nranks) % nranks;
+      if (recvcounts[peer] > 0) {
+        recvBuf->recv(peer, slot, rdispls[peer] * typeSize,
+                      recvcounts[peer] * typeSize);
+        nRecvs++;
+      }
+    }
+    for (int i = 1; i < nranks; ++i) {
+      int peer = (rank + i) % nranks;
+      if (sendcounts[peer] > 0) {
+        sendBuf->send(peer, slot, sdispls[peer] * typeSize,
+                      sendcounts[peer] * typeSize);
+        nSends++;
+      }
+    }
+    for (; nRecvs > 0; nRecvs--) {
+      recvBuf->waitRecv(flagcxGlooDefaultTimeout);
+    }
+    for (; nSends > 0; nSends--) {
+      sendBuf->waitSend(flagcxGlooDefaultTimeout);
+    }
+  } catch (const std::exception &e) {
+    WARN("Gloo AlltoAllv failed: %s", e.what());
+    return flagcxRemoteError;
+  }
+  return flagcxSuccess;
+}
+
+static ::gloo::transport::UnboundBuffer *
+glooGetBuffer(flagcxInnerComm_t comm, void *ptr, size_t size) {
+  auto &entry = comm->buffers[std::make_pair(ptr, size)];
+  if (!entry.buf) {
+    entry.buf = comm->base->createUnboundBuffer(ptr, size);
+  }
+  entry.lastUse = ++comm->bufferClock;
+  return entry.buf.get();
+}
+
+// Drop the least recently used buffers, only once no op is pending
+static void glooTrimBuffers(flagcxInnerComm_t comm) {
+  while (comm->buffers.size() > flagcxGlooBufferCacheSize) {
+    auto oldest = comm->buffers.begin();
+    for (auto it = comm->buffers.begin(); it != comm->buffers.end(); ++it) {
+      if (it->second.lastUse < oldest->second.lastUse) {
+        oldest = it;
+      }
+    }
+    comm->buffers.erase(oldest);
+  }
+}
+
+// Post the deferred ops of comm, receives first so that sends from peers
+// land in place
+static void glooPostOps(flagcxInnerComm_t comm) {
+  for (auto &op : comm->pendingOps) {
+    if (!op.isSend) {
+      op.buf->recv(op.peer, op.peer);
+    }
+  }
+  for (auto &op : comm->pendingOps) {
+    if (op.isSend) {
+      op.buf->send(op.peer, comm->base->rank);
+    }
+  }
+}
+
+static flagcxResult_t glooWaitOps(flagcxInnerComm_t comm) {
+  flagcxResult_t res = flagcxSuccess;
+  try {
+    for (auto &op : comm->pendingOps) {
+      bool done = op.isSend ? op.buf->waitSend(flagcxGlooDefaultTimeout)
+                            : op.buf->waitRecv(flagcxGlooDefaultTimeout);
+      if (!done) {
+        res = flagcxRemoteError;
+      }
+    }
+  } catch (const std::exception &e) {
+    WARN("Gloo send/recv failed: %s", e.what());
+    res = flagcxRemoteError;
+  }
+  comm->pendingOps.clear();
+  glooTrimBuffers(comm);
+  return res;
+}
+
+static flagcxResult_t glooAddOp(flagcxInnerComm_t comm, void *buff,
+                                size_t size, int peer, bool isSend) {
+  if (size == 0) {
+    return flagcxSuccess;
+  }
+  comm->pendingOps.push_back({glooGetBuffer(comm, buff, size), peer, isSend});
+  if (groupDepth == 0) {
+    glooPostOps(comm);
+    return glooWaitOps(comm);
+  }
+  if (comm->pendingOps.size() == 1) {
+    groupComms.push_back(comm);
+  }
   return flagcxSuccess;
 }
 
@@ -278,13 +465,7 @@ flagcxResult_t glooAdaptorSend(const void *sendbuff, size_t count,
                                flagcxInnerComm_t comm,
                                flagcxStream_t /*stream*/) {
   size_t size = count * getFlagcxDataTypeSize(datatype);
-  inputBuffers.push(
-      comm->base->createUnboundBuffer(const_cast<void *>(sendbuff), size));
-  inputBuffers.back()->send(peer, comm->base->rank);
-  if (!groupStarted) {
-    inputBuffers.back()->waitSend(flagcxGlooDefaultTimeout);
-  }
-  return flagcxSuccess;
+  return glooAddOp(comm, const_cast<void *>(sendbuff), size, peer, true);
 }
 
 flagcxResult_t glooAdaptorRecv(void *recvbuff, size_t count,
@@ -292,27 +473,32 @@ flagcxResult_t glooAdaptorRecv(void *recvbuff, size_t count,
                                flagcxInnerComm_t comm,
                                flagcxStream_t /*stream*/) {
   size_t size = count * getFlagcxDataTypeSize(datatype);
-  auto buf =
-      comm->base->createUnboundBuffer(const_cast<void *>(recvbuff), size);
-  buf->recv(peer, peer);
-  buf->waitRecv(flagcxGlooDefaultTimeout);
-  return flagcxSuccess;
+  return glooAddOp(comm, recvbuff, size, peer, false);
 }
 
 flagcxResult_t glooAdaptorGroupStart() {
-  groupStarted = true;
+  groupDepth++;
   return flagcxSuccess;
 }
 
 flagcxResult_t glooAdaptorGroupEnd() {
-  if (groupStarted) {
-    while (!inputBuffers.empty()) {
-      inputBuffers.front()->waitSend(flagcxGlooDefaultTimeout);
-      inputBuffers.pop();
+  if (groupDepth == 0 || --groupDepth > 0) {
+    return flagcxSuccess;
+  }
+  // Post everything before waiting on anything, ops of one communicator may
+  // depend on another one progressing on the peer
+  for (auto comm : groupComms) {
+    glooPostOps(comm);
+  }
+  flagcxResult_t res = flagcxSuccess;
+  for (auto comm : groupComms) {
+    flagcxResult_t ret = glooWaitOps(comm);
+    if (res == flagcxSuccess) {
+      res = ret;
     }
-    groupStarted = false;
   }
-  return flagcxSuccess;
+  groupComms.clear();
+  return res;
 }
 
 struct flagcxCCLAdaptor glooAdaptor = {
@@ -0,0 +1,398 @@
+#include "host_adaptor.h"
+
+#ifdef USE_HOST_ADAPTOR
+
+#include <sched.h>
+#include <vector>
+
+// Device-side CCL for the HOST device adaptor. Device buffers are plain host
+// memory, so collectives run the bootstrap algorithms directly once all work
+// previously queued on the stream has retired.
+//
+// Unlike a device CCL, every operation is synchronous: it synchronizes the
+// stream, then blocks the calling thread in the bootstrap collective until
+// the result is in recvbuff (send/recv inside a group block in GroupEnd).
+// Work queued on the stream afterwards therefore sees the result, as with
+// stream ordering, but the caller cannot overlap host work with the
+// collective, and a collective must be issued from every rank's host
+// thread in the same order across streams.
+
+#define HOSTCCL_SEND_RECV_TAG -6768
+
+struct hostcclP2pOp {
+  void *buff;
+  size_t bytes;
+  int peer;
+  flagcxInnerComm_t comm;
+};
+
+// A deferred send/recv once its bootstrap connection is open
+struct hostcclP2pXfer {
+  hostcclP2pOp op;
+  bool isSend;
+  struct flagcxSocket sock;
+  int size;       // payload size carried ahead of the payload
+  int sizeOffset; // progress of the size, then of the payload
+  int offset;
+};
+
+// Send/recv posted inside a group are deferred to GroupEnd so that
+// symmetric exchanges cannot deadlock on blocking socket writes
+static thread_local int hostcclGroupDepth = 0;
+static thread_local std::vector<hostcclP2pOp> hostcclPendingSends;
+static thread_local std::vector<hostcclP2pOp> hostcclPendingRecvs;
+
+flagcxResult_t hostcclAdaptorGetVersion(int *version) {
+  return flagcxNotSupported;
+}
+
+flagcxResult_t hostcclAdaptorGetUniqueId(flagcxUniqueId_t *uniqueId) {
+  if (*uniqueId == NULL) {
+    flagcxCalloc(uniqueId, 1);
+  }
+  struct flagcxBootstrapHandle handle;
+  FLAGCXCHECK(bootstrapNetInit());
+  FLAGCXCHECK(bootstrapGetUniqueId(&handle));
+  memset((void *)*uniqueId, 0, sizeof(**uniqueId));
+  memcpy((void *)*uniqueId, &handle, sizeof(handle));
+  return flagcxSuccess;
+}
+
+const char *hostcclAdaptorGetErrorString(flagcxResult_t result) {
+  return "Not Implemented";
+}
+
+const char *hostcclAdaptorGetLastError(flagcxInnerComm_t comm) {
+  return "Not Implemented";
+}
+
+flagcxResult_t hostcclAdaptorCommInitRank(flagcxInnerComm_t *comm, int nranks,
+                                          flagcxUniqueId_t commId, int rank,
+                                          bootstrapState *bootstrap) {
+  if (*comm == NULL) {
+    FLAGCXCHECK(flagcxCalloc(comm, 1));
+  }
+  const char *config = flagcxGetEnv("FLAGCX_HOSTCCL_TUNER_CONFIG");
+  if (config != NULL) {
+    INFO(FLAGCX_INIT, "hostccl comm rank %d nranks %d tuner config %s", rank,
+         nranks, config);
+  }
+  if (bootstrap != NULL) {
+    (*comm)->base = bootstrap;
+    (*comm)->ownBootstrap = false;
+    return flagcxSuccess;
+  }
+  struct flagcxBootstrapHandle *handle =
+      (struct flagcxBootstrapHandle *)commId;
+  struct bootstrapState *state = NULL;
+  FLAGCXCHECK(flagcxCalloc(&state, 1));
+  state->rank = rank;
+  state->nranks = nranks;
+  state->magic = handle->magic;
+  FLAGCXCHECK(bootstrapNetInit());
+  FLAGCXCHECK(bootstrapInit(handle, state));
+  (*comm)->base = state;
+  (*comm)->ownBootstrap = true;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorCommFinalize(flagcxInnerComm_t comm) {
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorCommDestroy(flagcxInnerComm_t comm) {
+  if (comm != NULL) {
+    if (comm->ownBootstrap) {
+      FLAGCXCHECK(bootstrapClose(comm->base));
+    }
+    free(comm);
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorCommAbort(flagcxInnerComm_t comm) {
+  if (comm != NULL) {
+    if (comm->ownBootstrap) {
+      FLAGCXCHECK(bootstrapAbort(comm->base));
+    }
+    free(comm);
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorCommResume(flagcxInnerComm_t comm) {
+  return flagcxNotSupported;
+}
+
+flagcxResult_t hostcclAdaptorCommSuspend(flagcxInnerComm_t comm) {
+  return flagcxNotSupported;
+}
+
+flagcxResult_t hostcclAdaptorCommCount(const flagcxInnerComm_t comm,
+                                       int *count) {
+  *count = comm->base->nranks;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorCommCuDevice(const flagcxInnerComm_t comm,
+                                          int *device) {
+  return deviceAdaptor->getDevice(device);
+}
+
+flagcxResult_t hostcclAdaptorCommUserRank(const flagcxInnerComm_t comm,
+                                          int *rank) {
+  *rank = comm->base->rank;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorCommGetAsyncError(flagcxInnerComm_t comm,
+                                               flagcxResult_t *asyncError) {
+  *asyncError = flagcxSuccess;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorMemAlloc(void **ptr, size_t size) {
+  return deviceAdaptor->deviceMalloc(ptr, size, flagcxMemDevice, NULL);
+}
+
+flagcxResult_t hostcclAdaptorMemFree(void *ptr) {
+  return deviceAdaptor->deviceFree(ptr, flagcxMemDevice, NULL);
+}
+
+flagcxResult_t hostcclAdaptorCommRegister(flagcxInnerComm_t comm, void *buff,
+                                          size_t size, void **handle) {
+  *handle = buff;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorCommDeregister(flagcxInnerComm_t comm,
+                                            void *handle) {
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorGather(const void *sendbuff, void *recvbuff,
+                                    size_t count, flagcxDataType_t datatype,
+                                    int root, flagcxInnerComm_t comm,
+                                    flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(
+      GatherBootstrap(comm->base, sendbuff, recvbuff, count, datatype, root));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorScatter(const void *sendbuff, void *recvbuff,
+                                     size_t count, flagcxDataType_t datatype,
+                                     int root, flagcxInnerComm_t comm,
+                                     flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(
+      ScatterBootstrap(comm->base, sendbuff, recvbuff, count, datatype, root));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorBroadcast(const void *sendbuff, void *recvbuff,
+                                       size_t count, flagcxDataType_t datatype,
+                                       int root, flagcxInnerComm_t comm,
+                                       flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(BroadcastBootstrap(comm->base, sendbuff, recvbuff, count,
+                                 datatype, root));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorAllReduce(const void *sendbuff, void *recvbuff,
+                                       size_t count, flagcxDataType_t datatype,
+                                       flagcxRedOp_t op, flagcxInnerComm_t comm,
+                                       flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(
+      AllReduceBootstrap(comm->base, sendbuff, recvbuff, count, datatype, op));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorReduce(const void *sendbuff, void *recvbuff,
+                                    size_t count, flagcxDataType_t datatype,
+                                    flagcxRedOp_t op, int root,
+                                    flagcxInnerComm_t comm,
+                                    flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(ReduceBootstrap(comm->base, sendbuff, recvbuff, count, datatype,
+                              op, root));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorReduceScatter(const void *sendbuff,
+                                           void *recvbuff, size_t recvcount,
+                                           flagcxDataType_t datatype,
+                                           flagcxRedOp_t op,
+                                           flagcxInnerComm_t comm,
+                                           flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(ReduceScatterBootstrap(comm->base, sendbuff, recvbuff, recvcount,
+                                     datatype, op));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorAllGather(const void *sendbuff, void *recvbuff,
+                                       size_t sendcount,
+                                       flagcxDataType_t datatype,
+                                       flagcxInnerComm_t comm,
+                                       flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(
+      AllGatherBootstrap(comm->base, sendbuff, recvbuff, sendcount, datatype));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorAlltoAll(const void *sendbuff, void *recvbuff,
+                                      size_t count, flagcxDataType_t datatype,
+                                      flagcxInnerComm_t comm,
+                                      flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(
+      AlltoAllBootstrap(comm->base, sendbuff, recvbuff, count, datatype));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorAlltoAllv(const void *sendbuff, size_t *sendcounts,
+                                       size_t *sdispls, void *recvbuff,
+                                       size_t *recvcounts, size_t *rdispls,
+                                       flagcxDataType_t datatype,
+                                       flagcxInnerComm_t comm,
+                                       flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  FLAGCXCHECK(AlltoAllvBootstrap(comm->base, sendbuff, sendcounts, sdispls,
+                                 recvbuff, recvcounts, rdispls, datatype));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorSend(const void *sendbuff, size_t count,
+                                  flagcxDataType_t datatype, int peer,
+                                  flagcxInnerComm_t comm,
+                                  flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  hostcclP2pOp op = {(void *)sendbuff, count * getFlagcxDataTypeSize(datatype),
+                     peer, comm};
+  if (hostcclGroupDepth > 0) {
+    hostcclPendingSends.push_back(op);
+    return flagcxSuccess;
+  }
+  FLAGCXCHECK(bootstrapSend(comm->base, peer, HOSTCCL_SEND_RECV_TAG, op.buff,
+                            op.bytes));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorRecv(void *recvbuff, size_t count,
+                                  flagcxDataType_t datatype, int peer,
+                                  flagcxInnerComm_t comm,
+                                  flagcxStream_t stream) {
+  FLAGCXCHECK(deviceAdaptor->streamSynchronize(stream));
+  hostcclP2pOp op = {recvbuff, count * getFlagcxDataTypeSize(datatype), peer,
+                     comm};
+  if (hostcclGroupDepth > 0) {
+    hostcclPendingRecvs.push_back(op);
+    return flagcxSuccess;
+  }
+  FLAGCXCHECK(bootstrapRecv(comm->base, peer, HOSTCCL_SEND_RECV_TAG, op.buff,
+                            op.bytes));
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorGroupStart() {
+  hostcclGroupDepth++;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostcclAdaptorGroupEnd() {
+  if (hostcclGroupDepth == 0) {
+    return flagcxInvalidUsage;
+  }
+  if (--hostcclGroupDepth > 0) {
+    return flagcxSuccess;
+  }
+  std::vector<hostcclP2pOp> sends;
+  std::vector<hostcclP2pOp> recvs;
+  sends.swap(hostcclPendingSends);
+  recvs.swap(hostcclPendingRecvs);
+
+  // Open every connection first: connecting only needs the peer's listen
+  // socket, so by the time we accept, the peers have connected our recvs.
+  // Connections to the same peer are opened and accepted in posting order,
+  // which keeps the messages in that order.
+  std::vector<hostcclP2pXfer> xfers(sends.size() + recvs.size());
+  flagcxResult_t res = flagcxSuccess;
+  size_t opened = 0;
+  for (; opened < xfers.size() && res == flagcxSuccess; opened++) {
+    hostcclP2pXfer &x = xfers[opened];
+    x.isSend = opened < sends.size();
+    x.op = x.isSend ? sends[opened] : recvs[opened - sends.size()];
+    x.size = (int)x.op.bytes;
+    res = x.isSend ? bootstrapConnect(x.op.comm->base, x.op.peer,
+                                      HOSTCCL_SEND_RECV_TAG, &x.sock)
+                   : bootstrapAccept(x.op.comm->base, x.op.peer,
+                                     HOSTCCL_SEND_RECV_TAG, &x.sock);
+  }
+  if (res != flagcxSuccess) {
+    opened--; // the failed one closed its own socket
+  }
+
+  // Then move the size and the payload of all of them without blocking, so
+  // a peer that is slow to drain one connection does not hold the others
+  size_t pending = res == flagcxSuccess ? xfers.size() : 0;
+  while (pending > 0 && res == flagcxSuccess) {
+    pending = 0;
+    for (auto &x : xfers) {
+      int op = x.isSend ? FLAGCX_SOCKET_SEND : FLAGCX_SOCKET_RECV;
+      if (x.sizeOffset < (int)sizeof(int)) {
+        int expected = (int)x.op.bytes;
+        res = flagcxSocketProgress(op, &x.sock, &x.size, sizeof(int),
+                                   &x.sizeOffset);
+        if (res == flagcxSuccess && !x.isSend &&
+            x.sizeOffset == sizeof(int) && x.size > expected) {
+          WARN("Message truncated : received %d bytes instead of %d", x.size,
+               expected);
+          res = flagcxInternalError;
+        }
+      } else if (x.offset < x.size) {
+        res = flagcxSocketProgress(op, &x.sock, x.op.buff, x.size, &x.offset);
+      }
+      if (res != flagcxSuccess) {
+        break;
+      }
+      if (x.sizeOffset < (int)sizeof(int) || x.offset < x.size) {
+        pending++;
+      }
+    }
+    if (pending > 0) {
+      sched_yield();
+    }
+  }
+  for (size_t i = 0; i < opened; i++) {
+    flagcxSocketClose(&xfers[i].sock);
+  }
+  return res;
+}
+
+struct flagcxCCLAdaptor hostcclAdaptor = {
+    "HOSTCCL",
+    // Basic functions
+    hostcclAdaptorGetVersion, hostcclAdaptorGetUniqueId,
+    hostcclAdaptorGetErrorString, hostcclAdaptorGetLastError,
+    // Communicator functions
+    hostcclAdaptorCommInitRank, hostcclAdaptorCommFinalize,
+    hostcclAdaptorCommDestroy, hostcclAdaptorCommAbort,
+    hostcclAdaptorCommResume, hostcclAdaptorCommSuspend,
+    hostcclAdaptorCommCount, hostcclAdaptorCommCuDevice,
+    hostcclAdaptorCommUserRank, hostcclAdaptorCommGetAsyncError,
+    hostcclAdaptorMemAlloc, hostcclAdaptorMemFree, hostcclAdaptorCommRegister,
+    hostcclAdaptorCommDeregister,
+    // Communication functions
+    hostcclAdaptorReduce, hostcclAdaptorGather, hostcclAdaptorScatter,
+    hostcclAdaptorBroadcast, hostcclAdaptorAllReduce,
+    hostcclAdaptorReduceScatter, hostcclAdaptorAllGather,
+    hostcclAdaptorAlltoAll, hostcclAdaptorAlltoAllv, hostcclAdaptorSend,
+    hostcclAdaptorRecv,
+    // Group semantics
+    hostcclAdaptorGroupStart, hostcclAdaptorGroupEnd};
+
+#endif // USE_HOST_ADAPTOR
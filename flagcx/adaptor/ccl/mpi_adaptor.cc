@@ -3,6 +3,10 @@
 
 #ifdef USE_MPI_ADAPTOR
 
+// Communicators with pending requests in the current group
+static std::vector<flagcxInnerComm *> groupComms;
+static int groupDepth = 0;
+
 static flagcxResult_t validateComm(flagcxInnerComm_t comm) {
   if (!comm || !comm->base) {
     return flagcxInvalidArgument;
@@ -75,7 +79,7 @@ flagcxResult_t mpiAdaptorCommInitRank(flagcxInnerComm_t *comm, int nranks,
   }
 
   if (*comm == NULL) {
-    FLAGCXCHECK(flagcxCalloc(comm, 1));
+    *comm = new flagcxInnerComm();
   }
 
   // use actual MPI rank and size to create context
@@ -98,7 +102,9 @@ flagcxResult_t mpiAdaptorCommFinalize(flagcxInnerComm_t comm) {
 }
 
 flagcxResult_t mpiAdaptorCommDestroy(flagcxInnerComm_t comm) {
+  comm->pendingRequests.clear();
   comm->base.reset();
+  delete comm;
   return flagcxSuccess;
 }
 
@@ -245,6 +251,59 @@ flagcxResult_t mpiAdaptorAlltoAll(const void *sendbuff, void *recvbuff,
   return (result == MPI_SUCCESS) ? flagcxSuccess : flagcxInternalError;
 }
 
+// Post a non-blocking send or receive of count elements, split into
+// messages of at most FLAGCX_MPI_MAX_COUNT elements. Messages between two
+// ranks on one communicator and tag do not overtake each other, so the
+// pieces match up in order on the peer.
+static int mpiPostP2p(void *buff, size_t count, flagcxDataType_t datatype,
+                      int peer, bool isSend, flagcxInnerComm_t comm,
+                      std::vector<MPI_Request> &requests) {
+  MPI_Datatype mpi_datatype = getFlagcxToMpiDataType(datatype);
+  size_t typeSize = getFlagcxDataTypeSize(datatype);
+  int tag = 0;
+  size_t off = 0;
+  do {
+    int n = std::min<size_t>(count - off, FLAGCX_MPI_MAX_COUNT);
+    MPI_Request request;
+    int result =
+        isSend ? MPI_Isend(mpiOffset(buff, off * typeSize), n, mpi_datatype,
+                           peer, tag, comm->base->getMpiComm(), &request)
+               : MPI_Irecv(mpiOffset(buff, off * typeSize), n, mpi_datatype,
+                           peer, tag, comm->base->getMpiComm(), &request);
+    if (result != MPI_SUCCESS) {
+      return result;
+    }
+    requests.push_back(request);
+    off += n;
+  } while (off < count);
+  return MPI_SUCCESS;
+}
+
+static flagcxResult_t mpiWaitRequests(flagcxInnerComm_t comm) {
+  int result = MPI_Waitall(comm->pendingRequests.size(),
+                           comm->pendingRequests.data(), MPI_STATUSES_IGNORE);
+  comm->pendingRequests.clear();
+  return (result == MPI_SUCCESS) ? flagcxSuccess : flagcxInternalError;
+}
+
+// Outside a group the operation completes before returning, inside one it
+// is left in flight until mpiAdaptorGroupEnd
+static flagcxResult_t mpiAddP2p(void *buff, size_t count,
+                                flagcxDataType_t datatype, int peer,
+                                bool isSend, flagcxInnerComm_t comm) {
+  bool first = comm->pendingRequests.empty();
+  int result = mpiPostP2p(buff, count, datatype, peer, isSend, comm,
+                          comm->pendingRequests);
+  if (groupDepth == 0) {
+    flagcxResult_t res = mpiWaitRequests(comm);
+    return (result == MPI_SUCCESS) ? res : flagcxInternalError;
+  }
+  if (first && !comm->pendingRequests.empty()) {
+    groupComms.push_back(comm);
+  }
+  return (result == MPI_SUCCESS) ? flagcxSuccess : flagcxInternalError;
+}
+
 flagcxResult_t mpiAdaptorAlltoAllv(const void *sendbuff, size_t *sendcounts,
                                    size_t *sdispls, void *recvbuff,
                                    size_t *recvcounts, size_t *rdispls,
@@ -266,18 +325,43 @@ flagcxResult_t mpiAdaptorAlltoAllv(const void *sendbuff, size_t *sendcounts,
   std::vector<int> mpi_sendcounts(size), mpi_recvcounts(size);
   std::vector<int> mpi_sdispls(size), mpi_rdispls(size);
 
+  bool fits = true;
   for (int i = 0; i < size; i++) {
+    fits = fits && sendcounts[i] <= FLAGCX_MPI_MAX_COUNT &&
+           recvcounts[i] <= FLAGCX_MPI_MAX_COUNT &&
+           sdispls[i] <= FLAGCX_MPI_MAX_COUNT &&
+           rdispls[i] <= FLAGCX_MPI_MAX_COUNT;
     mpi_sendcounts[i] = static_cast<int>(sendcounts[i]);
     mpi_recvcounts[i] = static_cast<int>(recvcounts[i]);
     mpi_sdispls[i] = static_cast<int>(sdispls[i]);
     mpi_rdispls[i] = static_cast<int>(rdispls[i]);
   }
 
-  int result =
-      MPI_Alltoallv(sendbuff, mpi_sendcounts.data(), mpi_sdispls.data(),
-                    mpi_datatype, recvbuff, mpi_recvcounts.data(),
-                    mpi_rdispls.data(), mpi_datatype, comm->base->getMpiComm());
+  if (fits) {
+    int result = MPI_Alltoallv(
+        sendbuff, mpi_sendcounts.data(), mpi_sdispls.data(), mpi_datatype,
+        recvbuff, mpi_recvcounts.data(), mpi_rdispls.data(), mpi_datatype,
+        comm->base->getMpiComm());
+    return (result == MPI_SUCCESS) ? flagcxSuccess : flagcxInternalError;
+  }
 
+  // Counts or displacements beyond int: exchange the blocks point to point
+  size_t typeSize = getFlagcxDataTypeSize(datatype);
+  std::vector<MPI_Request> requests;
+  int result = MPI_SUCCESS;
+  for (int i = 0; i < size && result == MPI_SUCCESS; i++) {
+    result = mpiPostP2p(mpiOffset(recvbuff, rdispls[i] * typeSize),
+                        recvcounts[i], datatype, i, false, comm, requests);
+  }
+  for (int i = 0; i < size && result == MPI_SUCCESS; i++) {
+    void *buff = const_cast<void *>(mpiOffset(sendbuff, sdispls[i] * typeSize));
+    result = mpiPostP2p(buff, sendcounts[i], datatype, i, true, comm, requests);
+  }
+  int waitResult = MPI_Waitall(requests.size(), requests.data(),
+                               MPI_STATUSES_IGNORE);
+  if (result == MPI_SUCCESS) {
+    result = waitResult;
+  }
   return (result == MPI_SUCCESS) ? flagcxSuccess : flagcxInternalError;
 }
 
@@ -294,13 +378,8 @@ flagcxResult_t mpiAdaptorSend(const void *sendbuff, size_t count,
     return flagcxInvalidArgument;
   }
 
-  MPI_Datatype mpi_datatype = getFlagcxToMpiDataType(datatype);
-  int tag = 0;
-
-  int result = MPI_Send(sendbuff, static_cast<int>(count), mpi_datatype, peer,
-                        tag, comm->base->getMpiComm());
-
-  return (result == MPI_SUCCESS) ? flagcxSuccess : flagcxInternalError;
+  return mpiAddP2p(const_cast<void *>(sendbuff), count, datatype, peer, true,
+                   comm);
 }
 
 flagcxResult_t mpiAdaptorRecv(void *recvbuff, size_t count,
@@ -317,19 +396,36 @@ flagcxResult_t mpiAdaptorRecv(void *recvbuff, size_t count,
     return flagcxInvalidArgument;
   }
 
-  MPI_Datatype mpi_datatype = getFlagcxToMpiDataType(datatype);
-  int tag = 0;
-  MPI_Status status;
-
-  int result = MPI_Recv(recvbuff, static_cast<int>(count), mpi_datatype, peer,
-                        tag, comm->base->getMpiComm(), &status);
+  if (peer == MPI_ANY_SOURCE && count > FLAGCX_MPI_MAX_COUNT) {
+    printf("Error: Receives from MPI_ANY_SOURCE are limited to %d elements\n",
+           FLAGCX_MPI_MAX_COUNT);
+    return flagcxInvalidArgument;
+  }
 
-  return (result == MPI_SUCCESS) ? flagcxSuccess : flagcxInternalError;
+  return mpiAddP2p(recvbuff, count, datatype, peer, false, comm);
 }
 
-flagcxResult_t mpiAdaptorGroupStart() { return flagcxSuccess; }
+flagcxResult_t mpiAdaptorGroupStart() {
+  groupDepth++;
+  return flagcxSuccess;
+}
 
-flagcxResult_t mpiAdaptorGroupEnd() { return flagcxSuccess; }
+flagcxResult_t mpiAdaptorGroupEnd() {
+  if (groupDepth == 0 || --groupDepth > 0) {
+    return flagcxSuccess;
+  }
+  // Every request of the group is already posted, so pairs that would
+  // deadlock with blocking calls complete here in any order
+  flagcxResult_t res = flagcxSuccess;
+  for (auto comm : groupComms) {
+    flagcxResult_t ret = mpiWaitRequests(comm);
+    if (res == flagcxSuccess) {
+      res = ret;
+    }
+  }
+  groupComms.clear();
+  return res;
+}
 
 struct flagcxCCLAdaptor mpiAdaptor = {
     "MPI",
@@ -0,0 +1,726 @@
+#include "host_adaptor.h"
+
+#ifdef USE_HOST_ADAPTOR
+
+#include "ipcsocket.h"
+#include "param.h"
+#include <algorithm>
+#include <map>
+#include <sched.h>
+#include <poll.h>
+#include <set>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+FLAGCX_PARAM(HostAdaptorHugePage, "HOST_ADAPTOR_HUGEPAGE", 0);
+FLAGCX_PARAM(HostAdaptorNDevs, "HOST_ADAPTOR_NDEVS", 8);
+
+#define HOST_ADAPTOR_HUGEPAGE_SIZE (2UL << 20)
+#define HOST_ADAPTOR_IPC_HASH 0x686f737469706371UL // "hostipcq"
+
+struct hostAllocation {
+  int fd; // -1 for pinned host memory
+  size_t size;
+};
+
+static std::mutex allocMutex;
+// mapping base -> allocation, ordered to resolve interior pointers
+static std::map<uintptr_t, hostAllocation> allocations;
+// imported mapping base -> size, used by ipcMemHandleClose
+static std::map<uintptr_t, size_t> importedMappings;
+// memfds handed out by ipcMemHandleGet, the only ones the IPC server sends
+static std::map<int, size_t> exportedFds;
+
+static std::mutex streamsMutex;
+static std::set<hostStream *> liveStreams;
+
+static thread_local int currentDevice = 0;
+
+// Number of device allocations and events created, logged at exit with
+// FLAGCX_DEBUG_SUBSYS=ALLOC to check that steady-state paths do not allocate
+static std::atomic<uint64_t> deviceAllocCount(0);
+static std::atomic<uint64_t> eventCreateCount(0);
+static std::once_flag allocReportOnce;
+
+static void hostAdaptorReportAllocs() {
+  INFO(FLAGCX_ALLOC, "host adaptor: %lu device allocations, %lu events created",
+       deviceAllocCount.load(), eventCreateCount.load());
+}
+
+static void hostAdaptorCountAlloc(std::atomic<uint64_t> *counter) {
+  std::call_once(allocReportOnce, [] { atexit(hostAdaptorReportAllocs); });
+  counter->fetch_add(1, std::memory_order_relaxed);
+}
+
+static uint64_t hostAdaptorNowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void hostStreamWorker(hostStream *s) {
+  std::unique_lock<std::mutex> lock(s->mtx);
+  while (true) {
+    s->cond.wait(lock, [s] { return s->stop || !s->tasks.empty(); });
+    if (s->tasks.empty()) {
+      break;
+    }
+    std::function<void()> task = std::move(s->tasks.front());
+    s->tasks.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+    s->completed++;
+    if (s->completed == s->submitted) {
+      s->idle.notify_all();
+    }
+  }
+}
+
+static void hostStreamEnqueue(hostStream *s, std::function<void()> task) {
+  std::lock_guard<std::mutex> lock(s->mtx);
+  s->tasks.push_back(std::move(task));
+  s->submitted++;
+  s->cond.notify_one();
+}
+
+static void hostStreamDrain(hostStream *s) {
+  std::unique_lock<std::mutex> lock(s->mtx);
+  s->idle.wait(lock, [s] { return s->completed == s->submitted; });
+}
+
+static void hostEventWait(flagcxEvent_t event, uint64_t target) {
+  while (event->completed.load(std::memory_order_acquire) < target) {
+    sched_yield();
+  }
+}
+
+static void *hostAdaptorMapShared(size_t size, int *fdOut) {
+  int fd = -1;
+  size_t mapSize = size;
+  if (flagcxParamHostAdaptorHugePage()) {
+    mapSize = (size + HOST_ADAPTOR_HUGEPAGE_SIZE - 1) &
+              ~(HOST_ADAPTOR_HUGEPAGE_SIZE - 1);
+    fd = memfd_create("flagcx-host-dev", MFD_CLOEXEC | MFD_HUGETLB);
+    if (fd >= 0 && ftruncate(fd, mapSize) != 0) {
+      close(fd);
+      fd = -1;
+    }
+    if (fd < 0) {
+      INFO(FLAGCX_ALLOC,
+           "HOST adaptor: huge page memfd unavailable, falling back to 4K "
+           "pages");
+    }
+  }
+  if (fd < 0) {
+    mapSize = size;
+    fd = memfd_create("flagcx-host-dev", MFD_CLOEXEC);
+    if (fd < 0) {
+      WARN("HOST adaptor: memfd_create failed : %s", strerror(errno));
+      return NULL;
+    }
+    if (ftruncate(fd, mapSize) != 0) {
+      WARN("HOST adaptor: ftruncate of %zu bytes failed : %s", mapSize,
+           strerror(errno));
+      close(fd);
+      return NULL;
+    }
+  }
+  void *ptr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED) {
+    WARN("HOST adaptor: mmap of %zu bytes failed : %s", mapSize,
+         strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  *fdOut = fd;
+  std::lock_guard<std::mutex> lock(allocMutex);
+  allocations[(uintptr_t)ptr] = {fd, mapSize};
+  return ptr;
+}
+
+static void *hostAdaptorMapPinned(size_t size) {
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    WARN("HOST adaptor: mmap of %zu bytes failed : %s", size,
+         strerror(errno));
+    return NULL;
+  }
+  // Pinning is best effort, RLIMIT_MEMLOCK is often small in containers
+  if (mlock(ptr, size) != 0) {
+    TRACE(FLAGCX_ALLOC, "HOST adaptor: mlock of %zu bytes failed : %s", size,
+          strerror(errno));
+  }
+  std::lock_guard<std::mutex> lock(allocMutex);
+  allocations[(uintptr_t)ptr] = {-1, size};
+  return ptr;
+}
+
+static flagcxResult_t hostAdaptorUnmap(void *ptr) {
+  hostAllocation alloc;
+  {
+    std::lock_guard<std::mutex> lock(allocMutex);
+    auto it = allocations.find((uintptr_t)ptr);
+    if (it == allocations.end()) {
+      WARN("HOST adaptor: freeing unknown pointer %p", ptr);
+      return flagcxInvalidArgument;
+    }
+    alloc = it->second;
+    allocations.erase(it);
+    exportedFds.erase(alloc.fd);
+  }
+  SYSCHECK(munmap(ptr, alloc.size), "munmap");
+  if (alloc.fd >= 0) {
+    close(alloc.fd);
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorDeviceSynchronize() {
+  std::lock_guard<std::mutex> lock(streamsMutex);
+  for (auto s : liveStreams) {
+    hostStreamDrain(s);
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorDeviceMemcpy(void *dst, void *src, size_t size,
+                                       flagcxMemcpyType_t type,
+                                       flagcxStream_t stream, void *args) {
+  if (stream == NULL) {
+    memcpy(dst, src, size);
+  } else {
+    hostStreamEnqueue(stream->base, [=] { memcpy(dst, src, size); });
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorDeviceMemset(void *ptr, int value, size_t size,
+                                       flagcxMemType_t type,
+                                       flagcxStream_t stream) {
+  if (type == flagcxMemHost || stream == NULL) {
+    memset(ptr, value, size);
+  } else {
+    hostStreamEnqueue(stream->base, [=] { memset(ptr, value, size); });
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorDeviceMalloc(void **ptr, size_t size,
+                                       flagcxMemType_t type,
+                                       flagcxStream_t stream) {
+  if (ptr == NULL) {
+    return flagcxInvalidArgument;
+  }
+  if (size == 0) {
+    *ptr = NULL;
+    return flagcxSuccess;
+  }
+  hostAdaptorCountAlloc(&deviceAllocCount);
+  if (type == flagcxMemHost) {
+    *ptr = hostAdaptorMapPinned(size);
+  } else {
+    // Device and managed memory are memfd backed so they can be exported
+    // to other processes through ipcMemHandleGet
+    int fd;
+    *ptr = hostAdaptorMapShared(size, &fd);
+  }
+  return *ptr == NULL ? flagcxSystemError : flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorDeviceFree(void *ptr, flagcxMemType_t type,
+                                     flagcxStream_t stream) {
+  if (ptr == NULL) {
+    return flagcxSuccess;
+  }
+  if (stream != NULL) {
+    hostStreamDrain(stream->base);
+  }
+  return hostAdaptorUnmap(ptr);
+}
+
+flagcxResult_t hostAdaptorSetDevice(int dev) {
+  if (dev < 0 || dev >= flagcxParamHostAdaptorNDevs()) {
+    return flagcxInvalidArgument;
+  }
+  currentDevice = dev;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorGetDevice(int *dev) {
+  *dev = currentDevice;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorGetDeviceCount(int *count) {
+  *count = (int)flagcxParamHostAdaptorNDevs();
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorGetVendor(char *vendor) {
+  // Overriding the vendor lets several processes on one host pose as
+  // different clusters and exercise the heterogeneous code paths
+  const char *env = flagcxGetEnv("FLAGCX_HOST_ADAPTOR_VENDOR");
+  strncpy(vendor, env ? env : "HOST", MAX_VENDOR_LEN - 1);
+  vendor[MAX_VENDOR_LEN - 1] = '\0';
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorHostGetDevicePointer(void **pDevice, void *pHost) {
+  *pDevice = pHost;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorGdrMemAlloc(void **ptr, size_t size,
+                                      void *memHandle) {
+  return hostAdaptorDeviceMalloc(ptr, size, flagcxMemDevice, NULL);
+}
+
+flagcxResult_t hostAdaptorGdrMemFree(void *ptr, void *memHandle) {
+  return hostAdaptorDeviceFree(ptr, flagcxMemDevice, NULL);
+}
+
+flagcxResult_t hostAdaptorStreamCreate(flagcxStream_t *stream) {
+  (*stream) = NULL;
+  flagcxCalloc(stream, 1);
+  hostStream *s = new hostStream();
+  s->submitted = 0;
+  s->completed = 0;
+  s->stop = false;
+  s->worker = std::thread(hostStreamWorker, s);
+  (*stream)->base = s;
+  std::lock_guard<std::mutex> lock(streamsMutex);
+  liveStreams.insert(s);
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorStreamDestroy(flagcxStream_t stream) {
+  if (stream != NULL) {
+    hostStream *s = stream->base;
+    {
+      std::lock_guard<std::mutex> lock(streamsMutex);
+      liveStreams.erase(s);
+    }
+    {
+      std::lock_guard<std::mutex> lock(s->mtx);
+      s->stop = true;
+      s->cond.notify_one();
+    }
+    // The worker drains the remaining tasks before exiting
+    s->worker.join();
+    delete s;
+    free(stream);
+    stream = NULL;
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorStreamCopy(flagcxStream_t *newStream,
+                                     void *oldStream) {
+  (*newStream) = NULL;
+  flagcxCalloc(newStream, 1);
+  (*newStream)->base = (hostStream *)oldStream;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorStreamFree(flagcxStream_t stream) {
+  if (stream != NULL) {
+    free(stream);
+    stream = NULL;
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorStreamSynchronize(flagcxStream_t stream) {
+  if (stream != NULL) {
+    hostStreamDrain(stream->base);
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorStreamQuery(flagcxStream_t stream) {
+  if (stream != NULL) {
+    hostStream *s = stream->base;
+    std::lock_guard<std::mutex> lock(s->mtx);
+    if (s->completed != s->submitted) {
+      return flagcxInProgress;
+    }
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorStreamWaitEvent(flagcxStream_t stream,
+                                          flagcxEvent_t event) {
+  if (stream != NULL && event != NULL) {
+    uint64_t target = event->recorded.load(std::memory_order_acquire);
+    if (event->completed.load(std::memory_order_acquire) < target) {
+      hostStreamEnqueue(stream->base, [=] { hostEventWait(event, target); });
+    }
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorEventCreate(flagcxEvent_t *event,
+                                      flagcxEventType_t eventType) {
+  hostAdaptorCountAlloc(&eventCreateCount);
+  (*event) = NULL;
+  flagcxCalloc(event, 1);
+  (*event)->recorded.store(0);
+  (*event)->completed.store(0);
+  (*event)->timestamp.store(0);
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorEventDestroy(flagcxEvent_t event) {
+  if (event != NULL) {
+    hostEventWait(event, event->recorded.load(std::memory_order_acquire));
+    free(event);
+    event = NULL;
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorEventRecord(flagcxEvent_t event,
+                                      flagcxStream_t stream) {
+  if (event != NULL) {
+    uint64_t seq = event->recorded.fetch_add(1) + 1;
+    auto complete = [=] {
+      event->timestamp.store(hostAdaptorNowNs(), std::memory_order_relaxed);
+      uint64_t cur = event->completed.load(std::memory_order_relaxed);
+      while (cur < seq && !event->completed.compare_exchange_weak(
+                              cur, seq, std::memory_order_release)) {
+      }
+    };
+    if (stream != NULL) {
+      hostStreamEnqueue(stream->base, complete);
+    } else {
+      complete();
+    }
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorEventSynchronize(flagcxEvent_t event) {
+  if (event != NULL) {
+    hostEventWait(event, event->recorded.load(std::memory_order_acquire));
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorEventQuery(flagcxEvent_t event) {
+  if (event != NULL && event->completed.load(std::memory_order_acquire) <
+                           event->recorded.load(std::memory_order_acquire)) {
+    return flagcxInProgress;
+  }
+  return flagcxSuccess;
+}
+
+// Request sent to the owner of a memfd, the reply carries the fd through
+// SCM_RIGHTS to the socket named (replyPid, replyHash). A reply without a
+// descriptor rejects the request.
+struct hostIpcRequest {
+  int32_t fd;
+  int32_t replyPid;
+  uint64_t replyHash;
+  uint64_t size; // size of the mapping named by the handle
+};
+
+#define HOST_ADAPTOR_IPC_MAX_BACKOFF_US 100000
+// How long an importer waits for the exporter to answer
+#define HOST_ADAPTOR_IPC_TIMEOUT_MS 30000
+
+static std::once_flag ipcServerOnce;
+
+static bool hostIpcExported(const struct hostIpcRequest *req) {
+  std::lock_guard<std::mutex> lock(allocMutex);
+  auto it = exportedFds.find(req->fd);
+  return it != exportedFds.end() && it->second == req->size;
+}
+
+static void *hostIpcServer(void *) {
+  struct flagcxIpcSocket sock = {};
+  if (flagcxIpcSocketInit(&sock, getpid(), HOST_ADAPTOR_IPC_HASH, 1) !=
+      flagcxSuccess) {
+    WARN("HOST adaptor: failed to start the IPC fd server");
+    return NULL;
+  }
+  int backoffUs = 0;
+  while (true) {
+    struct hostIpcRequest req;
+    if (flagcxIpcSocketRecvMsg(&sock, &req, sizeof(req), NULL) !=
+        flagcxSuccess) {
+      // Back off instead of spinning on a socket that keeps failing
+      backoffUs = std::min(std::max(2 * backoffUs, 1000),
+                           HOST_ADAPTOR_IPC_MAX_BACKOFF_US);
+      usleep(backoffUs);
+      continue;
+    }
+    backoffUs = 0;
+    int fd = req.fd;
+    if (!hostIpcExported(&req)) {
+      WARN("HOST adaptor: pid %d asked for fd %d of %lu bytes, which was "
+           "never exported, rejecting",
+           req.replyPid, req.fd, (unsigned long)req.size);
+      fd = -1;
+    }
+    if (flagcxIpcSocketSendFd(&sock, fd, req.replyPid, req.replyHash) !=
+        flagcxSuccess) {
+      WARN("HOST adaptor: failed to send fd %d to pid %d", fd, req.replyPid);
+    }
+  }
+  return NULL;
+}
+
+flagcxResult_t hostAdaptorIpcMemHandleCreate(flagcxIpcMemHandle_t *handle,
+                                             size_t *size) {
+  flagcxCalloc(handle, 1);
+  if (size != NULL) {
+    *size = sizeof(struct flagcxIpcMemHandle);
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorIpcMemHandleGet(flagcxIpcMemHandle_t handle,
+                                          void *devPtr) {
+  if (handle == NULL || devPtr == NULL) {
+    return flagcxInvalidArgument;
+  }
+  {
+    std::lock_guard<std::mutex> lock(allocMutex);
+    auto it = allocations.upper_bound((uintptr_t)devPtr);
+    if (it == allocations.begin()) {
+      return flagcxInvalidArgument;
+    }
+    --it;
+    uintptr_t offset = (uintptr_t)devPtr - it->first;
+    if (it->second.fd < 0 || offset >= it->second.size) {
+      return flagcxInvalidArgument;
+    }
+    handle->pid = getpid();
+    handle->fd = it->second.fd;
+    handle->size = it->second.size;
+    handle->offset = offset;
+    exportedFds[it->second.fd] = it->second.size;
+  }
+  std::call_once(ipcServerOnce, [] {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, hostIpcServer, NULL) == 0) {
+      flagcxSetThreadName(thread, "FlagCX hostIpc");
+      pthread_detach(thread);
+    }
+  });
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorIpcMemHandleOpen(flagcxIpcMemHandle_t handle,
+                                           void **devPtr) {
+  if (handle == NULL || devPtr == NULL || *devPtr != NULL) {
+    return flagcxInvalidArgument;
+  }
+  static std::atomic<uint64_t> replyCounter(0);
+  flagcxResult_t res = flagcxSuccess;
+  struct flagcxIpcSocket sock = {};
+  struct hostIpcRequest req;
+  struct pollfd pfd;
+  int fd = -1;
+  int ready;
+  void *base;
+  req.fd = handle->fd;
+  req.size = handle->size;
+  req.replyPid = getpid();
+  req.replyHash = (HOST_ADAPTOR_IPC_HASH ^ ((uint64_t)handle->pid << 20)) +
+                  replyCounter.fetch_add(1) + 1;
+  FLAGCXCHECK(flagcxIpcSocketInit(&sock, req.replyPid, req.replyHash, 1));
+  FLAGCXCHECKGOTO(flagcxIpcSocketSendMsg(&sock, &req, sizeof(req), -1,
+                                         handle->pid, HOST_ADAPTOR_IPC_HASH),
+                  res, out);
+  // The exporter may be gone, do not wait for its answer forever
+  pfd.fd = sock.fd;
+  pfd.events = POLLIN;
+  while ((ready = poll(&pfd, 1, HOST_ADAPTOR_IPC_TIMEOUT_MS)) < 0 &&
+         errno == EINTR)
+    ;
+  if (ready <= 0) {
+    WARN("HOST adaptor: pid %d did not answer for fd %d within %d ms",
+         handle->pid, handle->fd, HOST_ADAPTOR_IPC_TIMEOUT_MS);
+    res = flagcxRemoteError;
+    goto out;
+  }
+  FLAGCXCHECKGOTO(flagcxIpcSocketRecvFd(&sock, &fd), res, out);
+  base = mmap(NULL, handle->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    WARN("HOST adaptor: mmap of imported fd failed : %s", strerror(errno));
+    res = flagcxSystemError;
+    goto out;
+  }
+  {
+    std::lock_guard<std::mutex> lock(allocMutex);
+    importedMappings[(uintptr_t)base] = handle->size;
+  }
+  *devPtr = (char *)base + handle->offset;
+out:
+  flagcxIpcSocketClose(&sock);
+  return res;
+}
+
+flagcxResult_t hostAdaptorIpcMemHandleClose(void *devPtr) {
+  if (devPtr == NULL) {
+    return flagcxInvalidArgument;
+  }
+  uintptr_t base;
+  size_t size;
+  {
+    std::lock_guard<std::mutex> lock(allocMutex);
+    auto it = importedMappings.upper_bound((uintptr_t)devPtr);
+    if (it == importedMappings.begin()) {
+      return flagcxInvalidArgument;
+    }
+    --it;
+    base = it->first;
+    size = it->second;
+    importedMappings.erase(it);
+  }
+  SYSCHECK(munmap((void *)base, size), "munmap");
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorIpcMemHandleFree(flagcxIpcMemHandle_t handle) {
+  if (handle != NULL) {
+    free(handle);
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorLaunchHostFunc(flagcxStream_t stream,
+                                         void (*fn)(void *), void *args) {
+  if (stream != NULL) {
+    hostStreamEnqueue(stream->base, [=] { fn(args); });
+  }
+  return flagcxSuccess;
+}
+
+// Device funcs are host functions here, run by the stream worker in order
+// with the rest of the stream like a kernel launch
+flagcxResult_t hostAdaptorLaunchDeviceFunc(flagcxStream_t stream,
+                                           flagcxLaunchFunc_t fn, void *args) {
+  if (stream != NULL) {
+    hostStreamEnqueue(stream->base, [=] { fn(stream, args); });
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorGetDeviceProperties(struct flagcxDevProps *props,
+                                              int dev) {
+  if (props == NULL) {
+    return flagcxInvalidArgument;
+  }
+  snprintf(props->name, sizeof(props->name), "HOST emulated device %d", dev);
+  props->pciBusId = dev;
+  props->pciDeviceId = 0;
+  props->pciDomainId = 0xff;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorGetDevicePciBusId(char *pciBusId, int len, int dev) {
+  if (pciBusId == NULL) {
+    return flagcxInvalidArgument;
+  }
+  // Synthetic bus id in a PCI domain that does not exist on real hosts
+  snprintf(pciBusId, len, "%08x:%02x:00.0", 0xff, dev);
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorGetDeviceByPciBusId(int *dev, const char *pciBusId) {
+  if (dev == NULL || pciBusId == NULL) {
+    return flagcxInvalidArgument;
+  }
+  unsigned int domain, bus;
+  if (sscanf(pciBusId, "%x:%x", &domain, &bus) != 2) {
+    return flagcxInvalidArgument;
+  }
+  *dev = (int)bus;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorDmaSupport(bool *dmaBufferSupport) {
+  if (dmaBufferSupport == NULL)
+    return flagcxInvalidArgument;
+  *dmaBufferSupport = false;
+  return flagcxSuccess;
+}
+
+flagcxResult_t hostAdaptorEventElapsedTime(float *ms, flagcxEvent_t start,
+                                           flagcxEvent_t end) {
+  if (ms == NULL || start == NULL || end == NULL) {
+    return flagcxInvalidArgument;
+  }
+  if (hostAdaptorEventQuery(start) != flagcxSuccess ||
+      hostAdaptorEventQuery(end) != flagcxSuccess) {
+    return flagcxInProgress;
+  }
+  *ms = (float)((double)((int64_t)end->timestamp.load() -
+                         (int64_t)start->timestamp.load()) /
+                1e6);
+  return flagcxSuccess;
+}
+
+struct flagcxDeviceAdaptor hostAdaptor {
+  "HOST",
+      // Basic functions
+      hostAdaptorDeviceSynchronize, hostAdaptorDeviceMemcpy,
+      hostAdaptorDeviceMemset, hostAdaptorDeviceMalloc, hostAdaptorDeviceFree,
+      hostAdaptorSetDevice, hostAdaptorGetDevice, hostAdaptorGetDeviceCount,
+      hostAdaptorGetVendor, hostAdaptorHostGetDevicePointer,
+      // GDR functions
+      NULL, // flagcxResult_t (*memHandleInit)(int dev_id, void **memHandle);
+      NULL, // flagcxResult_t (*memHandleDestroy)(int dev, void *memHandle);
+      hostAdaptorGdrMemAlloc, hostAdaptorGdrMemFree,
+      NULL, // flagcxResult_t (*hostShareMemAlloc)(void **ptr, size_t size, void
+            // *memHandle);
+      NULL, // flagcxResult_t (*hostShareMemFree)(void *ptr, void *memHandle);
+      NULL, // flagcxResult_t (*gdrPtrMmap)(void **pcpuptr, void *devptr, size_t
+            // sz);
+      NULL, // flagcxResult_t (*gdrPtrMunmap)(void *cpuptr, size_t sz);
+      // Stream functions
+      hostAdaptorStreamCreate, hostAdaptorStreamDestroy, hostAdaptorStreamCopy,
+      hostAdaptorStreamFree, hostAdaptorStreamSynchronize,
+      hostAdaptorStreamQuery, hostAdaptorStreamWaitEvent,
+      // Event functions
+      hostAdaptorEventCreate, hostAdaptorEventDestroy, hostAdaptorEventRecord,
+      hostAdaptorEventSynchronize, hostAdaptorEventQuery,
+      // IpcMemHandle functions
+      hostAdaptorIpcMemHandleCreate, hostAdaptorIpcMemHandleGet,
+      hostAdaptorIpcMemHandleOpen, hostAdaptorIpcMemHandleClose,
+      hostAdaptorIpcMemHandleFree,
+      // Kernel launch
+      NULL, // flagcxResult_t (*launchKernel)(void *func, unsigned int block_x,
+            // unsigned int block_y, unsigned int block_z, unsigned int grid_x,
+            // unsigned int grid_y, unsigned int grid_z, void **args, size_t
+            // share_mem, void *stream, void *memHandle);
+      NULL, // flagcxResult_t (*copyArgsInit)(void **args);
+      NULL, // flagcxResult_t (*copyArgsFree)(void *args);
+      hostAdaptorLaunchDeviceFunc, // flagcxResult_t
+                                   // (*launchDeviceFunc)(flagcxStream_t stream,
+                                   // void *args);
+      // Others
+      hostAdaptorGetDeviceProperties, // flagcxResult_t
+                                      // (*getDeviceProperties)(struct
+                                      // flagcxDevProps *props, int dev);
+      hostAdaptorGetDevicePciBusId, // flagcxResult_t (*getDevicePciBusId)(char
+                                    // *pciBusId, int len, int dev);
+      hostAdaptorGetDeviceByPciBusId, // flagcxResult_t
+                                      // (*getDeviceByPciBusId)(int
+                                      // *dev, const char *pciBusId);
+      hostAdaptorLaunchHostFunc,
+      // DMA buffer
+      hostAdaptorDmaSupport, // flagcxResult_t (*dmaSupport)(bool
+                             // *dmaBufferSupport);
+      NULL, // flagcxResult_t (*memGetHandleForAddressRange)(void *handleOut,
+            // void *buffer, size_t size, unsigned long long flags);
+      hostAdaptorEventElapsedTime, // flagcxResult_t
+};
+
+#endif // USE_HOST_ADAPTOR
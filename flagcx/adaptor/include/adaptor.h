@@ -34,6 +34,7 @@ extern struct flagcxCCLAdaptor musa_mcclAdaptor;
 extern struct flagcxCCLAdaptor xcclAdaptor;
 extern struct flagcxCCLAdaptor duncclAdaptor;
 extern struct flagcxCCLAdaptor rcclAdaptor;
+extern struct flagcxCCLAdaptor hostcclAdaptor;
 extern struct flagcxCCLAdaptor *cclAdaptors[];
 
 extern struct flagcxDeviceAdaptor cudaAdaptor;
@@ -45,6 +46,7 @@ extern struct flagcxDeviceAdaptor musaAdaptor;
 extern struct flagcxDeviceAdaptor kunlunAdaptor;
 extern struct flagcxDeviceAdaptor ducudaAdaptor;
 extern struct flagcxDeviceAdaptor hipAdaptor;
+extern struct flagcxDeviceAdaptor hostAdaptor;
 extern struct flagcxDeviceAdaptor *deviceAdaptor;
 
 extern struct flagcxNetAdaptor *netAdaptor;
@@ -54,8 +56,9 @@ enum NetType {
   IBRC = 1,   // InfiniBand RC (or UCX when USE_UCX=1)
   SOCKET = 2, // Socket
 #ifdef USE_IBUC
-  IBUC = 3 // InfiniBand UC
+  IBUC = 3, // InfiniBand UC
 #endif
+  SHM = 4 // Shared memory, same-host peers only
 };
 
 // Unified network adaptor function declarations
@@ -276,7 +279,11 @@ struct flagcxNetAdaptor {
                            void **mhandles, void **request);
   flagcxResult_t (*test)(void *request, int *done, int *sizes);
 
-  // One-sided functions
+  // One-sided functions. phandle is the flagcxNetRmaDesc_t of the remote
+  // region and mhandle the local registration of data. write puts data at
+  // the remote address, read gets it from there (issued on the recv comm) and
+  // signal atomically adds the uint64_t at data to the remote word after all
+  // previous writes on the same comm.
   flagcxResult_t (*write)(void *sendComm, void *data, size_t size, int tag,
                           void *mhandle, void *phandle, void **request);
   flagcxResult_t (*read)(void *recvComm, void *data, size_t size, int tag,
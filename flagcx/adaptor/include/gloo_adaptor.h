@@ -31,15 +31,14 @@
 #include <cstring>
 #include <map>
 #include <memory>
-#include <queue>
 #include <string>
 #include <vector>
 
 using buffer_ptr = std::unique_ptr<::gloo::transport::UnboundBuffer>;
-static std::queue<buffer_ptr> inputBuffers;
 static constexpr std::chrono::milliseconds flagcxGlooDefaultTimeout =
     std::chrono::seconds(10000);
-static bool groupStarted = false;
+// Unbound buffers kept per communicator once no op is pending
+static constexpr size_t flagcxGlooBufferCacheSize = 64;
 
 #define GENERATE_GLOO_TYPES(type, func, args...)                               \
   switch (type) {                                                              \
@@ -215,8 +214,24 @@ public:
   bootstrapState *bootstrap_;
 };
 
+struct flagcxGlooCachedBuffer {
+  buffer_ptr buf;
+  uint64_t lastUse;
+};
+
+struct flagcxGlooP2pOp {
+  ::gloo::transport::UnboundBuffer *buf;
+  int peer;
+  bool isSend;
+};
+
 struct flagcxInnerComm {
   std::shared_ptr<flagcxGlooContext> base;
+  // Unbound buffers by address and size, reused across send/recv calls
+  std::map<std::pair<void *, size_t>, flagcxGlooCachedBuffer> buffers;
+  uint64_t bufferClock;
+  // Send/recv deferred to the end of the current group
+  std::vector<flagcxGlooP2pOp> pendingOps;
 };
 
 #endif // USE_GLOO_ADAPTOR
\ No newline at end of file
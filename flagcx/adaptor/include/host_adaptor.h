@@ -0,0 +1,55 @@
+#ifdef USE_HOST_ADAPTOR
+
+#include "adaptor.h"
+#include "alloc.h"
+#include "bootstrap.h"
+#include "check.h"
+#include "comm.h"
+#include "flagcx.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Host-memory emulation of a device runtime. "Device" buffers live in host
+// memory, streams are in-order work queues drained by a worker thread and
+// events are completion counters, so the full FlagCX stack (proxy, p2p,
+// c2c planner, tuner) can run on CPU-only machines.
+
+struct flagcxInnerComm {
+  bootstrapState *base;
+  bool ownBootstrap; // base was created by the adaptor and must be closed
+};
+
+struct hostStream {
+  std::thread worker;
+  std::mutex mtx;
+  std::condition_variable cond;
+  std::condition_variable idle;
+  std::deque<std::function<void()>> tasks;
+  uint64_t submitted;
+  uint64_t completed;
+  bool stop;
+};
+
+struct flagcxStream {
+  hostStream *base;
+};
+
+struct flagcxEvent {
+  std::atomic<uint64_t> recorded;  // number of eventRecord calls
+  std::atomic<uint64_t> completed; // highest record retired by its stream
+  std::atomic<uint64_t> timestamp; // completion time of the last record in ns
+};
+
+// Must fit in flagcxIpcHandleData (FLAGCX_P2P_IPC_HANDLE_SIZE bytes)
+struct flagcxIpcMemHandle {
+  int32_t pid;     // owner process that serves the memfd
+  int32_t fd;      // memfd number inside the owner process
+  uint64_t size;   // size of the whole mapping
+  uint64_t offset; // offset of devPtr inside the mapping
+};
+
+#endif // USE_HOST_ADAPTOR
@@ -7,6 +7,8 @@
 #include "flagcx.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <climits>
 #include <cstring>
 #include <map>
 #include <memory>
@@ -17,31 +19,31 @@
 #define GENERATE_MPI_TYPES(type, func, args...)                                \
   switch (type) {                                                              \
     case flagcxChar:                                                           \
-      func<char, MPI_CHAR>(args);                                              \
+      func<char>(MPI_CHAR, args);                                              \
       break;                                                                   \
     case flagcxUint8:                                                          \
-      func<uint8_t, MPI_UNSIGNED_CHAR>(args);                                  \
+      func<uint8_t>(MPI_UNSIGNED_CHAR, args);                                  \
       break;                                                                   \
     case flagcxInt:                                                            \
-      func<int, MPI_INT>(args);                                                \
+      func<int>(MPI_INT, args);                                                \
       break;                                                                   \
     case flagcxUint32:                                                         \
-      func<uint32_t, MPI_UNSIGNED>(args);                                      \
+      func<uint32_t>(MPI_UNSIGNED, args);                                      \
       break;                                                                   \
     case flagcxInt64:                                                          \
-      func<int64_t, MPI_LONG_LONG>(args);                                      \
+      func<int64_t>(MPI_LONG_LONG, args);                                      \
       break;                                                                   \
     case flagcxUint64:                                                         \
-      func<uint64_t, MPI_UNSIGNED_LONG_LONG>(args);                            \
+      func<uint64_t>(MPI_UNSIGNED_LONG_LONG, args);                            \
       break;                                                                   \
     case flagcxFloat:                                                          \
-      func<float, MPI_FLOAT>(args);                                            \
+      func<float>(MPI_FLOAT, args);                                            \
       break;                                                                   \
     case flagcxDouble:                                                         \
-      func<double, MPI_DOUBLE>(args);                                          \
+      func<double>(MPI_DOUBLE, args);                                          \
       break;                                                                   \
     case flagcxHalf:                                                           \
-      func<uint16_t, MPI_UINT16_T>(args);                                      \
+      func<uint16_t>(MPI_UINT16_T, args);                                      \
       break;                                                                   \
     case flagcxBfloat16:                                                       \
       printf("Invalid data type");                                             \
@@ -54,16 +56,16 @@
 #define GENERATE_MPI_REDUCTION_OPS(op, func, args...)                          \
   switch (op) {                                                                \
     case flagcxSum:                                                            \
-      func<MPI_SUM>(args);                                                     \
+      func(MPI_SUM, args);                                                     \
       break;                                                                   \
     case flagcxProd:                                                           \
-      func<MPI_PROD>(args);                                                    \
+      func(MPI_PROD, args);                                                    \
       break;                                                                   \
     case flagcxMax:                                                            \
-      func<MPI_MAX>(args);                                                     \
+      func(MPI_MAX, args);                                                     \
       break;                                                                   \
     case flagcxMin:                                                            \
-      func<MPI_MIN>(args);                                                     \
+      func(MPI_MIN, args);                                                     \
       break;                                                                   \
     case flagcxAvg:                                                            \
       printf("MPI backend does not support flagcxAvg\n");                      \
@@ -72,15 +74,14 @@
       break;                                                                   \
   }
 
-template <typename T, MPI_Datatype mpi_type>
-void getMpiDataType(MPI_Datatype &result) {
+// Handles are passed as arguments rather than template parameters, they are
+// not constant expressions in every MPI implementation
+template <typename T>
+void getMpiDataType(MPI_Datatype mpi_type, MPI_Datatype &result) {
   result = mpi_type;
 }
 
-template <MPI_Op mpi_op>
-void getMpiOp(MPI_Op &result) {
-  result = mpi_op;
-}
+inline void getMpiOp(MPI_Op mpi_op, MPI_Op &result) { result = mpi_op; }
 
 inline MPI_Datatype getFlagcxToMpiDataType(flagcxDataType_t datatype) {
   MPI_Datatype result = MPI_DATATYPE_NULL;
@@ -94,43 +95,138 @@ inline MPI_Op getFlagcxToMpiOp(flagcxRedOp_t op) {
   return result;
 }
 
-template <typename T, MPI_Datatype mpi_type>
-void callMpiFunction(int func_type, const void *sendbuf, void *recvbuf,
-                     size_t count, MPI_Op op, int root, MPI_Comm comm,
-                     int *result) {
+// Largest element count passed to a single MPI call, counts of the MPI-3
+// interface are int
+#ifndef FLAGCX_MPI_MAX_COUNT
+#define FLAGCX_MPI_MAX_COUNT INT_MAX
+#endif
+
+inline const void *mpiOffset(const void *buf, size_t bytes) {
+  if (buf == MPI_IN_PLACE || buf == nullptr) {
+    return buf;
+  }
+  return static_cast<const char *>(buf) + bytes;
+}
+
+inline void *mpiOffset(void *buf, size_t bytes) {
+  if (buf == MPI_IN_PLACE || buf == nullptr) {
+    return buf;
+  }
+  return static_cast<char *>(buf) + bytes;
+}
+
+// Datatype covering count elements of type, so that a block larger than
+// FLAGCX_MPI_MAX_COUNT travels as one element: a vector of full chunks
+// followed by the remainder. Returns type itself when count fits, otherwise
+// the caller frees the result. Not usable with reductions, the predefined
+// ops only apply to predefined types.
+inline int mpiLargeType(size_t count, MPI_Datatype type,
+                        MPI_Datatype *result) {
+  if (count <= FLAGCX_MPI_MAX_COUNT) {
+    *result = type;
+    return MPI_SUCCESS;
+  }
+  size_t chunks = count / FLAGCX_MPI_MAX_COUNT;
+  int rest = count % FLAGCX_MPI_MAX_COUNT;
+  MPI_Aint lb, extent;
+  MPI_Type_get_extent(type, &lb, &extent);
+  MPI_Datatype chunkType, restType;
+  MPI_Type_vector(chunks, FLAGCX_MPI_MAX_COUNT, FLAGCX_MPI_MAX_COUNT, type,
+                  &chunkType);
+  MPI_Type_contiguous(rest, type, &restType);
+  int lengths[2] = {1, 1};
+  MPI_Aint displs[2] = {0, (MPI_Aint)(chunks * FLAGCX_MPI_MAX_COUNT * extent)};
+  MPI_Datatype types[2] = {chunkType, restType};
+  int ret = MPI_Type_create_struct(2, lengths, displs, types, result);
+  MPI_Type_free(&chunkType);
+  MPI_Type_free(&restType);
+  if (ret == MPI_SUCCESS) {
+    ret = MPI_Type_commit(result);
+  }
+  return ret;
+}
+
+inline void mpiFreeLargeType(MPI_Datatype large, MPI_Datatype type) {
+  if (large != type) {
+    MPI_Type_free(&large);
+  }
+}
+
+template <typename T>
+void callMpiFunction(MPI_Datatype mpi_type, int func_type, const void *sendbuf,
+                     void *recvbuf, size_t count, MPI_Op op, int root,
+                     MPI_Comm comm, int *result) {
+  *result = MPI_SUCCESS;
   switch (func_type) {
+    // Reductions and broadcasts are element-wise, so they are split into
+    // calls of at most FLAGCX_MPI_MAX_COUNT elements
     case 0: // ALLREDUCE
-      *result = MPI_Allreduce(sendbuf, recvbuf, count, mpi_type, op, comm);
+      for (size_t off = 0; off < count && *result == MPI_SUCCESS;
+           off += FLAGCX_MPI_MAX_COUNT) {
+        int n = std::min<size_t>(count - off, FLAGCX_MPI_MAX_COUNT);
+        *result = MPI_Allreduce(mpiOffset(sendbuf, off * sizeof(T)),
+                                mpiOffset(recvbuf, off * sizeof(T)), n,
+                                mpi_type, op, comm);
+      }
       break;
     case 1: // REDUCE
-      *result = MPI_Reduce(sendbuf, recvbuf, count, mpi_type, op, root, comm);
+      for (size_t off = 0; off < count && *result == MPI_SUCCESS;
+           off += FLAGCX_MPI_MAX_COUNT) {
+        int n = std::min<size_t>(count - off, FLAGCX_MPI_MAX_COUNT);
+        *result = MPI_Reduce(mpiOffset(sendbuf, off * sizeof(T)),
+                             mpiOffset(recvbuf, off * sizeof(T)), n, mpi_type,
+                             op, root, comm);
+      }
       break;
     case 2: // BCAST
-      *result = MPI_Bcast(recvbuf, count, mpi_type, root, comm);
+      for (size_t off = 0; off < count && *result == MPI_SUCCESS;
+           off += FLAGCX_MPI_MAX_COUNT) {
+        int n = std::min<size_t>(count - off, FLAGCX_MPI_MAX_COUNT);
+        *result = MPI_Bcast(mpiOffset(recvbuf, off * sizeof(T)), n, mpi_type,
+                            root, comm);
+      }
       break;
+    // Rank blocks of the gather family must stay whole, larger ones are
+    // described by a derived type
     case 3: // GATHER
-      *result = MPI_Gather(sendbuf, count, mpi_type, recvbuf, count, mpi_type,
-                           root, comm);
-      break;
     case 4: // SCATTER
-      *result = MPI_Scatter(sendbuf, count, mpi_type, recvbuf, count, mpi_type,
-                            root, comm);
-      break;
     case 5: // ALLGATHER
-      *result = MPI_Allgather(sendbuf, count, mpi_type, recvbuf, count,
-                              mpi_type, comm);
-      break;
     case 6: // ALLTOALL
-      *result = MPI_Alltoall(sendbuf, count, mpi_type, recvbuf, count, mpi_type,
-                             comm);
-      break;
+    {
+      MPI_Datatype type;
+      *result = mpiLargeType(count, mpi_type, &type);
+      if (*result != MPI_SUCCESS) {
+        break;
+      }
+      int n = type == mpi_type ? count : 1;
+      if (func_type == 3) {
+        *result = MPI_Gather(sendbuf, n, type, recvbuf, n, type, root, comm);
+      } else if (func_type == 4) {
+        *result = MPI_Scatter(sendbuf, n, type, recvbuf, n, type, root, comm);
+      } else if (func_type == 5) {
+        *result = MPI_Allgather(sendbuf, n, type, recvbuf, n, type, comm);
+      } else {
+        *result = MPI_Alltoall(sendbuf, n, type, recvbuf, n, type, comm);
+      }
+      mpiFreeLargeType(type, mpi_type);
+    } break;
     case 7: // REDUCE_SCATTER
     {
-      int size;
+      if (count <= FLAGCX_MPI_MAX_COUNT) {
+        *result = MPI_Reduce_scatter_block(sendbuf, recvbuf, count, mpi_type,
+                                           op, comm);
+        break;
+      }
+      // Too large for one block, reduce every rank's block to its owner
+      int rank, size;
+      MPI_Comm_rank(comm, &rank);
       MPI_Comm_size(comm, &size);
-      std::vector<int> recvcounts(size, count);
-      *result = MPI_Reduce_scatter(sendbuf, recvbuf, recvcounts.data(),
-                                   mpi_type, op, comm);
+      for (int r = 0; r < size && *result == MPI_SUCCESS; r++) {
+        callMpiFunction<T>(mpi_type, 1,
+                           mpiOffset(sendbuf, r * count * sizeof(T)),
+                           r == rank ? recvbuf : nullptr, count, op, r, comm,
+                           result);
+      }
     } break;
   }
 }
@@ -277,6 +373,8 @@ inline bool flagcxMpiContext::validateMpiEnvironment() {
 
 struct flagcxInnerComm {
   std::shared_ptr<flagcxMpiContext> base;
+  // Send/recv requests posted inside a group, completed at group end
+  std::vector<MPI_Request> pendingRequests;
 };
 
 #endif // USE_MPI_ADAPTOR
@@ -36,6 +36,7 @@ struct flagcxUcxCommStage {
 
 // UCX Memory Handle
 typedef struct flagcxUcxMhandle {
+  flagcxNetRmaDesc_t desc; /* packed rkey exposed to one-sided peers */
   ucp_mem_h ucp_memh;
   ucp_rkey_h rkey;
   int mem_type;
@@ -99,6 +100,7 @@ typedef struct flagcxUcxRequest {
   int pending;                   /* How many requests are still pending */
   int count;                     /* How many requests are contained */
   int size[FLAGCX_NET_IB_MAX_RECVS];
+  ucp_rkey_h rkey; /* Remote key of a one-sided request, released in test */
 } flagcxUcxRequest_t;
 
 // UCX GPU Flush Structure
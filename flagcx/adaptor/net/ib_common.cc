@@ -1,5 +1,6 @@
 #include "ib_common.h"
 
+#include "bintrace.h"
 #include "flagcx_common.h"
 #include "ibvwrap.h"
 #include "socket.h"
@@ -89,7 +90,7 @@ flagcxIbCommonTestDataQp(struct flagcxIbRequest *r, int *done, int *sizes,
   *done = 0;
   while (1) {
     if (r->events[0] == 0 && r->events[1] == 0) {
-      TRACE(FLAGCX_NET, "r=%p done", r);
+      TRACE_BIN(FLAGCX_NET, "r=%p done", r);
       *done = 1;
       if (sizes && r->type == FLAGCX_NET_IB_REQ_RECV) {
         for (int i = 0; i < r->nreqs; i++)
@@ -180,15 +181,24 @@ flagcxIbCommonTestDataQp(struct flagcxIbRequest *r, int *done, int *sizes,
           struct flagcxIbRequest *req = r->base->reqs + req_idx;
 
 #ifdef ENABLE_TRACE
-          union flagcxSocketAddress addr;
-          flagcxSocketGetAddr(r->sock, &addr);
-          char line[SOCKET_NAME_MAXLEN + 1];
-          TRACE(FLAGCX_NET,
-                "Got completion from peer %s with status=%d opcode=%d len=%d "
-                "wr_id=%ld r=%p type=%d events={%d,%d}, i=%d",
-                flagcxSocketToString(&addr, line), wc->status, wc->opcode,
-                wc->byte_len, wc->wr_id, req, req->type, req->events[0],
-                req->events[1], i);
+          if (flagcxBintraceOn(FLAGCX_NET)) {
+            // without the peer name, formatting it costs more than the rest
+            TRACE_BIN(FLAGCX_NET,
+                      "Got completion with status=%d opcode=%d len=%d "
+                      "wr_id=%ld r=%p type=%d",
+                      wc->status, wc->opcode, wc->byte_len, wc->wr_id, req,
+                      req->type);
+          } else {
+            union flagcxSocketAddress addr;
+            flagcxSocketGetAddr(r->sock, &addr);
+            char line[SOCKET_NAME_MAXLEN + 1];
+            TRACE(FLAGCX_NET,
+                  "Got completion from peer %s with status=%d opcode=%d "
+                  "len=%d wr_id=%ld r=%p type=%d events={%d,%d}, i=%d",
+                  flagcxSocketToString(&addr, line), wc->status, wc->opcode,
+                  wc->byte_len, wc->wr_id, req, req->type, req->events[0],
+                  req->events[1], i);
+          }
 #endif
 
           if (req->type == FLAGCX_NET_IB_REQ_SEND) {
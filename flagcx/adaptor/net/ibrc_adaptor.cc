@@ -5,6 +5,7 @@
  ************************************************************************/
 
 #include "adaptor.h"
+#include "bintrace.h"
 #include "core.h"
 #include "flagcx_common.h"
 #include "flagcx_net.h"
@@ -2161,15 +2162,15 @@ static flagcxResult_t flagcxIbrcProcessWc(struct flagcxIbRequest *r,
         flagcxResult_t ack_result =
             flagcxIbRetransSendAckViaUd(rComm, &ack_msg, devIndex);
         if (ack_result != flagcxSuccess) {
-          TRACE(FLAGCX_NET, "Failed to send ACK for seq=%u (result=%d)", seq,
-                ack_result);
+          TRACE_BIN(FLAGCX_NET, "Failed to send ACK for seq=%u (result=%d)",
+                    seq, ack_result);
         } else {
-          TRACE(FLAGCX_NET, "Sent ACK for seq=%u, ack_seq=%u", seq,
-                ack_msg.ackSeq);
+          TRACE_BIN(FLAGCX_NET, "Sent ACK for seq=%u, ack_seq=%u", seq,
+                    ack_msg.ackSeq);
         }
       } else {
-        TRACE(FLAGCX_NET, "No ACK needed for seq=%u (expect=%u)", seq,
-              rComm->retrans.recvSeq);
+        TRACE_BIN(FLAGCX_NET, "No ACK needed for seq=%u (expect=%u)", seq,
+                  rComm->retrans.recvSeq);
       }
     } else if (!rComm->retrans.enabled &&
                wc->opcode == IBV_WC_RECV_RDMA_WITH_IMM) {
@@ -7,6 +7,7 @@
 #ifdef USE_IBUC
 
 #include "adaptor.h"
+#include "bintrace.h"
 #include "core.h"
 #include "flagcx_common.h"
 #include "flagcx_net.h"
@@ -145,8 +146,8 @@ static flagcxResult_t flagcxIbucProcessWc(struct flagcxIbRequest *r,
     if (r->base->isSend) {
       struct flagcxIbSendComm *sComm = (struct flagcxIbSendComm *)r->base;
       sComm->outstanding_retrans--;
-      TRACE(FLAGCX_NET, "SEND retrans completed, outstanding_retrans=%d",
-            sComm->outstanding_retrans);
+      TRACE_BIN(FLAGCX_NET, "SEND retrans completed, outstanding_retrans=%d",
+                sComm->outstanding_retrans);
     }
     *handled = true;
     return flagcxSuccess;
@@ -182,16 +183,16 @@ static flagcxResult_t flagcxIbucProcessWc(struct flagcxIbRequest *r,
             flagcxResult_t ack_result =
                 flagcxIbRetransSendAckViaUd(rComm, &ack_msg, 0);
             if (ack_result != flagcxSuccess) {
-              TRACE(FLAGCX_NET, "Failed to send ACK for seq=%u (result=%d)",
-                    seq, ack_result);
+              TRACE_BIN(FLAGCX_NET, "Failed to send ACK for seq=%u (result=%d)",
+                        seq, ack_result);
             } else {
-              TRACE(FLAGCX_NET, "Sent ACK for seq=%u, ack_seq=%u", seq,
-                    ack_msg.ackSeq);
+              TRACE_BIN(FLAGCX_NET, "Sent ACK for seq=%u, ack_seq=%u", seq,
+                        ack_msg.ackSeq);
             }
           }
 
-          TRACE(FLAGCX_NET, "Received SEND retransmission from SRQ: seq=%u",
-                seq);
+          TRACE_BIN(FLAGCX_NET, "Received SEND retransmission from SRQ: seq=%u",
+                    seq);
         }
 
         rComm->srqMgr.bufs[buf_idx].inUse = 0;
@@ -218,15 +219,16 @@ static flagcxResult_t flagcxIbucProcessWc(struct flagcxIbRequest *r,
               flagcxResult_t ack_result =
                   flagcxIbRetransSendAckViaUd(rComm, &ack_msg, 0);
               if (ack_result != flagcxSuccess) {
-                TRACE(FLAGCX_NET, "Failed to send ACK for seq=%u (result=%d)",
-                      seq, ack_result);
+                TRACE_BIN(FLAGCX_NET,
+                          "Failed to send ACK for seq=%u (result=%d)", seq,
+                          ack_result);
               } else {
-                TRACE(FLAGCX_NET, "Sent ACK for seq=%u, ack_seq=%u", seq,
-                      ack_msg.ackSeq);
+                TRACE_BIN(FLAGCX_NET, "Sent ACK for seq=%u, ack_seq=%u", seq,
+                          ack_msg.ackSeq);
               }
             } else {
-              TRACE(FLAGCX_NET, "No ACK needed for seq=%u (expect=%u)", seq,
-                    rComm->retrans.recvSeq);
+              TRACE_BIN(FLAGCX_NET, "No ACK needed for seq=%u (expect=%u)", seq,
+                        rComm->retrans.recvSeq);
             }
           } else {
             r->recv.sizes[0] = wc->imm_data;
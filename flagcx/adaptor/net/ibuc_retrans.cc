@@ -6,6 +6,7 @@
  ************************************************************************/
 
 #include "ibuc_retrans.h"
+#include "bintrace.h"
 #include "flagcx_common.h"
 #include "ibvcore.h"
 #include "ibvwrap.h"
@@ -179,8 +180,9 @@ flagcxResult_t flagcxIbRetransProcessAck(struct flagcxIbRetransState *state,
   uint32_t ack_seq = ack_msg->ackSeq;
   uint64_t now_us = flagcxIbGetTimeUs();
 
-  TRACE(FLAGCX_NET, "Processing ACK: ack_seq=%u, send_una=%u, buffer_count=%d",
-        ack_seq, state->sendUna, state->bufferCount);
+  TRACE_BIN(FLAGCX_NET,
+            "Processing ACK: ack_seq=%u, send_una=%u, buffer_count=%d",
+            ack_seq, state->sendUna, state->bufferCount);
 
   if (ack_msg->timestampUs > 0) {
     uint64_t rtt_us = now_us - ack_msg->timestampUs;
@@ -217,8 +219,8 @@ flagcxResult_t flagcxIbRetransProcessAck(struct flagcxIbRetransState *state,
   uint16_t sack_count = ack_msg->sackBitmapCount;
 
   if (sack_bitmap != 0 && sack_count > 0) {
-    TRACE(FLAGCX_NET, "Processing SACK: bitmap=0x%lx, count=%u",
-          (unsigned long)sack_bitmap, sack_count);
+    TRACE_BIN(FLAGCX_NET, "Processing SACK: bitmap=0x%lx, count=%u",
+              (unsigned long)sack_bitmap, sack_count);
 
     int idx = state->bufferHead;
     for (int i = 0; i < state->bufferCount && i < 64; i++) {
@@ -229,7 +231,7 @@ flagcxResult_t flagcxIbRetransProcessAck(struct flagcxIbRetransState *state,
 
         if (entry_offset < 64) {
           if (sack_bitmap & (1ULL << entry_offset)) {
-            TRACE(FLAGCX_NET, "SACK confirmed packet: seq=%u", entry->seq);
+            TRACE_BIN(FLAGCX_NET, "SACK confirmed packet: seq=%u", entry->seq);
             entry->valid = 0;
             state->totalAcked++;
             freed++;
@@ -253,9 +255,9 @@ flagcxResult_t flagcxIbRetransProcessAck(struct flagcxIbRetransState *state,
   }
 
   if (freed > 0) {
-    TRACE(FLAGCX_NET,
-          "ACK processed: freed %d packets, remaining=%d, ack_seq=%u", freed,
-          state->bufferCount, ack_seq);
+    TRACE_BIN(FLAGCX_NET,
+              "ACK processed: freed %d packets, remaining=%d, ack_seq=%u",
+              freed, state->bufferCount, ack_seq);
   }
 
   return flagcxSuccess;
@@ -514,8 +516,8 @@ flagcxResult_t flagcxIbRetransRecvPacket(struct flagcxIbRetransState *state,
         bitmap >>= 1;
       }
 
-      TRACE(FLAGCX_NET, "SACK: gap=%d, bitmap=0x%lx, count=%u", gap,
-            (unsigned long)ack_msg->sackBitmap, ack_msg->sackBitmapCount);
+      TRACE_BIN(FLAGCX_NET, "SACK: gap=%d, bitmap=0x%lx, count=%u", gap,
+                (unsigned long)ack_msg->sackBitmap, ack_msg->sackBitmapCount);
     }
   }
 
@@ -0,0 +1,455 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include "adaptor.h"
+#include "check.h"
+#include "core.h"
+#include "net.h"
+#include "param.h"
+#include "shmutils.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Same-host net adaptor. Every connection owns one POSIX shared memory
+// segment created by the receiver on listen() and attached once by the sender
+// on connect(). The segment holds a single-producer/single-consumer FIFO of
+// message sizes followed by a byte ring that carries the payload, so messages
+// larger than the ring are streamed through the same mapping instead of
+// allocating new segments.
+//
+// The segment file is unlinked by flagcxShmOpen as soon as the sender has
+// attached, so only a receiver that dies before its peer connects leaves it
+// behind in /dev/shm. Such segments record their owner, and the next process
+// that initializes this adaptor on the host removes them.
+
+#define FLAGCX_NET_SHM_MAGIC 0x666c61676378736dULL
+#define FLAGCX_NET_SHM_MAX_MSGS 64
+#define FLAGCX_NET_SHM_PATH_LEN 24
+#define MAX_REQUESTS FLAGCX_NET_MAX_REQUESTS
+
+FLAGCX_PARAM(NetShmBuffSize, "NET_SHM_BUFFSIZE", 8LL * 1024 * 1024);
+
+enum flagcxNetShmOp { flagcxNetShmOpSend = 0, flagcxNetShmOpRecv = 1 };
+
+// Shared between sender and receiver. Counters are monotonically increasing
+// and each one has a single writer.
+struct flagcxNetShmFifo {
+  uint64_t magic;
+  uint64_t ringSize;
+  uint64_t ownerHostHash; // receiver that created the segment
+  int64_t ownerPid;
+  alignas(64) uint64_t connected; // written by the sender
+  alignas(64) uint64_t msgHead;   // messages announced by the sender
+  uint64_t head;                  // bytes written by the sender
+  alignas(64) uint64_t msgTail;   // messages picked up by the receiver
+  uint64_t tail;                  // bytes consumed by the receiver
+  alignas(64) uint64_t msgSizes[FLAGCX_NET_SHM_MAX_MSGS];
+};
+
+// Exchanged through the bootstrap in a flagcxIbHandle sized buffer; the
+// sender side overwrites flagcxIbHandle::stage, so stay in front of it.
+struct flagcxNetShmHandle {
+  char shmPath[FLAGCX_NET_SHM_PATH_LEN];
+  uint64_t ringSize;
+  uint64_t magic;
+};
+static_assert(sizeof(struct flagcxNetShmHandle) <=
+                  offsetof(struct flagcxIbHandle, stage),
+              "flagcxNetShmHandle size too large");
+
+struct flagcxNetShmComm;
+
+struct flagcxNetShmRequest {
+  int op;
+  int used;
+  int announced; // size published (send) or picked up (recv)
+  int finished;
+  char *data;
+  size_t size;
+  size_t offset;
+  struct flagcxNetShmComm *comm;
+};
+
+struct flagcxNetShmComm {
+  flagcxShmHandle_t shmHandle;
+  struct flagcxNetShmFifo *fifo;
+  char *ring;
+  uint64_t ringSize;
+  uint64_t posted;    // requests handed out, in order
+  uint64_t completed; // requests fully progressed, in order
+  struct flagcxNetShmRequest requests[MAX_REQUESTS];
+};
+
+struct flagcxNetShmListenComm {
+  flagcxShmHandle_t shmHandle; // moved to the recv comm on accept
+  struct flagcxNetShmFifo *fifo;
+  char shmPath[FLAGCX_NET_SHM_PATH_LEN];
+};
+
+// Remove the segments of receivers on this host that died before their
+// sender attached
+static void flagcxNetShmSweep() {
+  DIR *dir = opendir("/dev/shm");
+  if (dir == NULL)
+    return;
+  uint64_t hostHash = getHostHash();
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, "flagcx-", strlen("flagcx-")) != 0)
+      continue;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "/dev/shm/%s", entry->d_name);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+      continue;
+    struct flagcxNetShmFifo fifo;
+    struct stat st;
+    bool stale =
+        fstat(fd, &st) == 0 &&
+        pread(fd, &fifo, sizeof(fifo), 0) == (ssize_t)sizeof(fifo) &&
+        fifo.magic == FLAGCX_NET_SHM_MAGIC &&
+        (uint64_t)st.st_size ==
+            sizeof(fifo) + fifo.ringSize + sizeof(int) && // + refcount
+        fifo.ownerHostHash == hostHash && fifo.connected == 0 &&
+        kill((pid_t)fifo.ownerPid, 0) != 0 && errno == ESRCH;
+    close(fd);
+    if (stale && unlink(path) == 0) {
+      INFO(FLAGCX_INIT | FLAGCX_NET,
+           "NET/SHM : removed %s left by dead process %ld", path,
+           (long)fifo.ownerPid);
+    }
+  }
+  closedir(dir);
+}
+
+flagcxResult_t flagcxNetShmInit() {
+  if (access("/dev/shm", R_OK | W_OK) != 0) {
+    INFO(FLAGCX_INIT | FLAGCX_NET, "NET/SHM : /dev/shm is not accessible");
+    return flagcxSystemError;
+  }
+  flagcxNetShmSweep();
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmDevices(int *ndev) {
+  *ndev = 1;
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmGetProperties(int dev, void *props) {
+  flagcxNetProperties_t *netProps = (flagcxNetProperties_t *)props;
+  netProps->name = (char *)"shm";
+  netProps->pciPath = NULL;
+  netProps->guid = dev;
+  netProps->ptrSupport = FLAGCX_PTR_HOST;
+  netProps->regIsGlobal = 0;
+  netProps->speed = 100000;
+  netProps->latency = 0;
+  netProps->port = 0;
+  netProps->maxComms = 65536;
+  netProps->maxRecvs = 1;
+  netProps->netDeviceType = FLAGCX_NET_DEVICE_HOST;
+  netProps->netDeviceVersion = FLAGCX_NET_DEVICE_INVALID_VERSION;
+  return flagcxSuccess;
+}
+
+static flagcxResult_t flagcxNetShmCommInit(flagcxShmHandle_t shmHandle,
+                                           struct flagcxNetShmFifo *fifo,
+                                           void **comm) {
+  struct flagcxNetShmComm *c;
+  FLAGCXCHECK(flagcxCalloc(&c, 1));
+  c->shmHandle = shmHandle;
+  c->fifo = fifo;
+  c->ring = (char *)(fifo + 1);
+  c->ringSize = fifo->ringSize;
+  *comm = c;
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmListen(int dev, void *opaqueHandle,
+                                  void **listenComm) {
+  struct flagcxNetShmHandle *handle = (struct flagcxNetShmHandle *)opaqueHandle;
+  struct flagcxNetShmListenComm *comm;
+  int64_t ringSize = flagcxParamNetShmBuffSize();
+  void *shmPtr = NULL;
+
+  if (ringSize <= 0) {
+    WARN("NET/SHM : invalid FLAGCX_NET_SHM_BUFFSIZE %ld", ringSize);
+    return flagcxInvalidArgument;
+  }
+  memset(handle, 0, sizeof(struct flagcxNetShmHandle));
+  FLAGCXCHECK(flagcxCalloc(&comm, 1));
+  FLAGCXCHECK(flagcxShmOpen(comm->shmPath, sizeof(comm->shmPath),
+                            sizeof(struct flagcxNetShmFifo) + ringSize, &shmPtr,
+                            NULL, 1, &comm->shmHandle));
+  comm->fifo = (struct flagcxNetShmFifo *)shmPtr;
+  comm->fifo->ringSize = ringSize;
+  comm->fifo->ownerHostHash = getHostHash();
+  comm->fifo->ownerPid = getpid();
+  __atomic_store_n(&comm->fifo->magic, FLAGCX_NET_SHM_MAGIC, __ATOMIC_RELEASE);
+  memcpy(handle->shmPath, comm->shmPath, sizeof(handle->shmPath));
+  handle->ringSize = ringSize;
+  handle->magic = FLAGCX_NET_SHM_MAGIC;
+  *listenComm = comm;
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmConnect(int dev, void *opaqueHandle,
+                                   void **sendComm) {
+  struct flagcxNetShmHandle *handle = (struct flagcxNetShmHandle *)opaqueHandle;
+  flagcxShmHandle_t shmHandle;
+  void *shmPtr = NULL;
+
+  *sendComm = NULL;
+  if (handle->magic != FLAGCX_NET_SHM_MAGIC) {
+    WARN("NET/SHM : invalid connect handle (magic %lx)", handle->magic);
+    return flagcxInternalError;
+  }
+  FLAGCXCHECK(flagcxShmOpen(handle->shmPath, sizeof(handle->shmPath),
+                            sizeof(struct flagcxNetShmFifo) + handle->ringSize,
+                            &shmPtr, NULL, -1, &shmHandle));
+  struct flagcxNetShmFifo *fifo = (struct flagcxNetShmFifo *)shmPtr;
+  if (fifo->magic != FLAGCX_NET_SHM_MAGIC ||
+      fifo->ringSize != handle->ringSize) {
+    WARN("NET/SHM : segment %s does not match its handle", handle->shmPath);
+    flagcxShmClose(shmHandle);
+    return flagcxInternalError;
+  }
+  FLAGCXCHECK(flagcxNetShmCommInit(shmHandle, fifo, sendComm));
+  __atomic_store_n(&fifo->connected, 1, __ATOMIC_RELEASE);
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmAccept(void *listenComm, void **recvComm) {
+  struct flagcxNetShmListenComm *lComm =
+      (struct flagcxNetShmListenComm *)listenComm;
+
+  *recvComm = NULL;
+  if (lComm->shmHandle == NULL) {
+    WARN("NET/SHM : listen comm %p was already accepted", lComm);
+    return flagcxInternalError;
+  }
+  if (__atomic_load_n(&lComm->fifo->connected, __ATOMIC_ACQUIRE) == 0) {
+    return flagcxSuccess;
+  }
+  FLAGCXCHECK(flagcxNetShmCommInit(lComm->shmHandle, lComm->fifo, recvComm));
+  lComm->shmHandle = NULL;
+  lComm->fifo = NULL;
+  return flagcxSuccess;
+}
+
+static flagcxResult_t flagcxNetShmProgressSend(struct flagcxNetShmComm *comm,
+                                               struct flagcxNetShmRequest *r) {
+  struct flagcxNetShmFifo *fifo = comm->fifo;
+  if (!r->announced) {
+    uint64_t msgHead = fifo->msgHead;
+    uint64_t msgTail = __atomic_load_n(&fifo->msgTail, __ATOMIC_ACQUIRE);
+    if (msgHead - msgTail >= FLAGCX_NET_SHM_MAX_MSGS)
+      return flagcxSuccess;
+    fifo->msgSizes[msgHead % FLAGCX_NET_SHM_MAX_MSGS] = r->size;
+    __atomic_store_n(&fifo->msgHead, msgHead + 1, __ATOMIC_RELEASE);
+    r->announced = 1;
+  }
+  while (r->offset < r->size) {
+    uint64_t head = fifo->head;
+    uint64_t tail = __atomic_load_n(&fifo->tail, __ATOMIC_ACQUIRE);
+    uint64_t pos = head % comm->ringSize;
+    size_t bytes =
+        std::min(comm->ringSize - (head - tail),
+                 std::min(r->size - r->offset, comm->ringSize - pos));
+    if (bytes == 0)
+      return flagcxSuccess;
+    memcpy(comm->ring + pos, r->data + r->offset, bytes);
+    __atomic_store_n(&fifo->head, head + bytes, __ATOMIC_RELEASE);
+    r->offset += bytes;
+  }
+  r->finished = 1;
+  return flagcxSuccess;
+}
+
+static flagcxResult_t flagcxNetShmProgressRecv(struct flagcxNetShmComm *comm,
+                                               struct flagcxNetShmRequest *r) {
+  struct flagcxNetShmFifo *fifo = comm->fifo;
+  if (!r->announced) {
+    uint64_t msgTail = fifo->msgTail;
+    if (__atomic_load_n(&fifo->msgHead, __ATOMIC_ACQUIRE) == msgTail)
+      return flagcxSuccess;
+    size_t size = fifo->msgSizes[msgTail % FLAGCX_NET_SHM_MAX_MSGS];
+    if (size > r->size) {
+      WARN("NET/SHM : message truncated : receiving %ld bytes instead of %ld",
+           size, r->size);
+      return flagcxInvalidUsage;
+    }
+    r->size = size;
+    __atomic_store_n(&fifo->msgTail, msgTail + 1, __ATOMIC_RELEASE);
+    r->announced = 1;
+  }
+  while (r->offset < r->size) {
+    uint64_t tail = fifo->tail;
+    uint64_t head = __atomic_load_n(&fifo->head, __ATOMIC_ACQUIRE);
+    uint64_t pos = tail % comm->ringSize;
+    size_t bytes = std::min(head - tail, std::min(r->size - r->offset,
+                                                  comm->ringSize - pos));
+    if (bytes == 0)
+      return flagcxSuccess;
+    memcpy(r->data + r->offset, comm->ring + pos, bytes);
+    __atomic_store_n(&fifo->tail, tail + bytes, __ATOMIC_RELEASE);
+    r->offset += bytes;
+  }
+  r->finished = 1;
+  return flagcxSuccess;
+}
+
+// Messages share one byte stream, so requests are always progressed in the
+// order they were posted.
+static flagcxResult_t flagcxNetShmProgress(struct flagcxNetShmComm *comm) {
+  while (comm->completed < comm->posted) {
+    struct flagcxNetShmRequest *r =
+        comm->requests + comm->completed % MAX_REQUESTS;
+    if (r->op == flagcxNetShmOpSend) {
+      FLAGCXCHECK(flagcxNetShmProgressSend(comm, r));
+    } else {
+      FLAGCXCHECK(flagcxNetShmProgressRecv(comm, r));
+    }
+    if (!r->finished)
+      break;
+    comm->completed++;
+  }
+  return flagcxSuccess;
+}
+
+static flagcxResult_t flagcxNetShmGetRequest(struct flagcxNetShmComm *comm,
+                                             int op, void *data, size_t size,
+                                             void **request) {
+  struct flagcxNetShmRequest *r = comm->requests + comm->posted % MAX_REQUESTS;
+  *request = NULL;
+  // The slot is released once the caller has seen it complete in test()
+  if (r->used)
+    return flagcxSuccess;
+  r->op = op;
+  r->used = 1;
+  r->announced = 0;
+  r->finished = 0;
+  r->data = (char *)data;
+  r->size = size;
+  r->offset = 0;
+  r->comm = comm;
+  comm->posted++;
+  FLAGCXCHECK(flagcxNetShmProgress(comm));
+  *request = r;
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmTest(void *request, int *done, int *size) {
+  struct flagcxNetShmRequest *r = (struct flagcxNetShmRequest *)request;
+  *done = 0;
+  if (r == NULL) {
+    WARN("NET/SHM : test called with NULL request");
+    return flagcxInternalError;
+  }
+  if (!r->finished)
+    FLAGCXCHECK(flagcxNetShmProgress(r->comm));
+  if (r->finished) {
+    *done = 1;
+    if (size)
+      *size = r->size;
+    r->used = 0;
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmRegMr(void *comm, void *data, size_t size, int type,
+                                 void **mhandle) {
+  // Only host memory can be copied through the ring; a NULL handle makes the
+  // proxy fall back to its host staging buffer for device memory.
+  *mhandle = NULL;
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmDeregMr(void *comm, void *mhandle) {
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmIsend(void *sendComm, void *data, size_t size,
+                                 int tag, void *mhandle, void *phandle,
+                                 void **request) {
+  struct flagcxNetShmComm *comm = (struct flagcxNetShmComm *)sendComm;
+  FLAGCXCHECK(
+      flagcxNetShmGetRequest(comm, flagcxNetShmOpSend, data, size, request));
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmIrecv(void *recvComm, int n, void **data,
+                                 size_t *sizes, int *tags, void **mhandles,
+                                 void **phandles, void **request) {
+  struct flagcxNetShmComm *comm = (struct flagcxNetShmComm *)recvComm;
+  if (n != 1)
+    return flagcxInternalError;
+  FLAGCXCHECK(flagcxNetShmGetRequest(comm, flagcxNetShmOpRecv, data[0],
+                                     sizes[0], request));
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmIflush(void *recvComm, int n, void **data,
+                                  int *sizes, void **mhandles, void **request) {
+  // Data is received into host memory, there is nothing to flush
+  *request = NULL;
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmCloseListen(void *opaqueComm) {
+  struct flagcxNetShmListenComm *comm =
+      (struct flagcxNetShmListenComm *)opaqueComm;
+  if (comm) {
+    if (comm->shmHandle)
+      FLAGCXCHECK(flagcxShmClose(comm->shmHandle));
+    free(comm);
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxNetShmClose(void *opaqueComm) {
+  struct flagcxNetShmComm *comm = (struct flagcxNetShmComm *)opaqueComm;
+  if (comm) {
+    FLAGCXCHECK(flagcxShmClose(comm->shmHandle));
+    free(comm);
+  }
+  return flagcxSuccess;
+}
+
+flagcxNetAdaptor flagcxNetShm = {
+    // Basic functions
+    "SHM", flagcxNetShmInit, flagcxNetShmDevices, flagcxNetShmGetProperties,
+    NULL, // reduceSupport - not implemented
+    NULL, // getDeviceMr - not implemented
+    NULL, // irecvConsumed - not implemented
+
+    // Setup functions
+    flagcxNetShmListen, flagcxNetShmConnect, flagcxNetShmAccept,
+    flagcxNetShmClose, // closeSend
+    flagcxNetShmClose, // closeRecv (same as closeSend for shm)
+    flagcxNetShmCloseListen,
+
+    // Memory region functions
+    flagcxNetShmRegMr,
+    NULL, // regMrDmaBuf - No DMA-BUF support
+    flagcxNetShmDeregMr,
+
+    // Two-sided functions
+    flagcxNetShmIsend, flagcxNetShmIrecv, flagcxNetShmIflush, flagcxNetShmTest,
+
+    // One-sided functions
+    NULL, // write - not implemented
+    NULL, // read - not implemented
+    NULL, // signal - not implemented
+
+    // Device name lookup
+    NULL, // getDevFromName
+};
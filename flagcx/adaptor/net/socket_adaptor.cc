@@ -5,6 +5,7 @@
  ************************************************************************/
 
 #include "adaptor.h"
+#include "affinity.h"
 #include "comm.h"
 #include "core.h"
 #include "net.h"
@@ -15,12 +16,16 @@
 #include <poll.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 static int flagcxNetIfs = -1;
 struct flagcxNetSocketDev {
   union flagcxSocketAddress addr;
   char devName[MAX_IF_NAME_SIZE];
   char *pciPath;
+  struct flagcxAffinity affinity; // cores of the helper threads
 };
 static struct flagcxNetSocketDev flagcxNetSocketDevs[MAX_IFS];
 
@@ -57,6 +62,9 @@ flagcxResult_t flagcxNetSocketInit() {
                  sizeof(union flagcxSocketAddress));
           FLAGCXCHECK(flagcxNetSocketGetPciPath(
               flagcxNetSocketDevs[i].devName, &flagcxNetSocketDevs[i].pciPath));
+          FLAGCXCHECK(flagcxAffinityInit(&flagcxNetSocketDevs[i].affinity,
+                                         flagcxNetSocketDevs[i].pciPath, 0,
+                                         0));
           snprintf(line + strlen(line), MAX_LINE_LEN - strlen(line),
                    " [%d]%s:%s", i, names + i * MAX_IF_NAME_SIZE,
                    flagcxSocketToString(&addrs[i], addrline));
@@ -118,6 +126,8 @@ flagcxResult_t flagcxNetSocketGetProperties(int dev, void *props) {
 #define MAX_THREADS 16
 #define MAX_REQUESTS FLAGCX_NET_MAX_REQUESTS
 #define MIN_CHUNKSIZE (64 * 1024)
+// Request op of one-sided requests, next to FLAGCX_SOCKET_SEND/RECV
+#define FLAGCX_NET_SOCKET_RMA 2
 
 FLAGCX_PARAM(SocketNsocksPerThread, "NSOCKS_PERTHREAD", -2);
 FLAGCX_PARAM(SocketNthreads, "SOCKET_NTHREADS", -2);
@@ -181,6 +191,50 @@ struct flagcxNetSocketThreadResources {
   pthread_cond_t threadCond;
 };
 
+enum flagcxNetSocketRmaOp {
+  flagcxNetSocketRmaWrite = 0,
+  flagcxNetSocketRmaRead = 1,
+  flagcxNetSocketRmaSignal = 2,
+};
+
+// Sent ahead of every one-sided operation and echoed back as its ack
+struct flagcxNetSocketRmaHeader {
+  uint32_t op;
+  int32_t status; // flagcxResult_t of the target, only meaningful in acks
+  uint64_t key;
+  uint64_t addr;
+  uint64_t size;
+};
+
+struct flagcxNetSocketRmaRequest {
+  int op; // FLAGCX_NET_SOCKET_RMA, aliases flagcxNetSocketRequest::op
+  int used; // 1: in flight, 2: acked and waiting for test()
+  struct flagcxNetSocketComm *comm;
+  struct flagcxNetSocketRmaHeader hdr;
+  struct flagcxNetSocketRmaHeader ack;
+  char *data;
+  int sendOffset; // header + payload bytes sent
+  int recvOffset; // ack + payload bytes received
+  flagcxResult_t result;
+};
+
+// Remote key of a window, stored in the key bytes of its descriptor
+struct flagcxNetSocketRmaKey {
+  uint64_t key;    // window key, only valid on the comm that registered it
+  uint64_t commId; // comm that registered the window
+  union flagcxSocketAddress addr; // RMA listener of the target process
+};
+static_assert(sizeof(struct flagcxNetSocketRmaKey) <=
+                  FLAGCX_NET_RMA_KEY_MAXSIZE,
+              "flagcxNetSocketRmaKey size too large");
+
+// Registration handle; desc is what the peer passes back as phandle
+struct flagcxNetSocketMr {
+  flagcxNetRmaDesc_t desc;
+  struct flagcxNetSocketComm *comm;
+  int inflight; // operations of the service thread using the window
+};
+
 struct flagcxNetSocketListenComm {
   struct flagcxSocket sock;
   struct flagcxNetSocketCommStage stage;
@@ -200,6 +254,28 @@ struct flagcxNetSocketComm {
   struct flagcxNetSocketRequest requests[MAX_REQUESTS];
   pthread_t helperThread[MAX_THREADS];
   struct flagcxNetSocketThreadResources threadResources[MAX_THREADS];
+  // One-sided state. Connections are only opened when a window is exposed
+  // (target side) or an operation is posted (initiator side).
+  uint64_t rmaId; // random id of the comm once it exposes a window, or 0
+  pthread_mutex_t rmaWindowLock;
+  pthread_cond_t rmaWindowCond; // signaled when a window is released
+  std::unordered_map<uint64_t, struct flagcxNetSocketMr *> *rmaWindows;
+  struct flagcxSocket rmaPassive; // accepted and served by the RMA thread
+  int rmaPassiveState;            // 0: none, 1: served, 2: closed
+  // Operation being served on rmaPassive, only touched by the RMA thread
+  struct flagcxNetSocketRmaHeader rmaServeHdr;
+  struct flagcxNetSocketRmaHeader rmaServeAck;
+  struct flagcxNetSocketMr *rmaServeMr; // window held until the payload moved
+  char *rmaServeTarget;
+  uint64_t rmaServeValue; // operand of a signal
+  int rmaServeStage;      // 0: header, 1: payload in, 2: ack, 3: payload out
+  int rmaServeOffset;
+  struct flagcxSocket rmaActive;  // one-sided operations issued by us
+  uint64_t rmaTarget;             // rmaId of the peer comm, 0: not connected
+  struct flagcxNetSocketRmaRequest rmaRequests[MAX_REQUESTS];
+  uint64_t rmaPosted; // requests posted
+  uint64_t rmaSent;   // requests whose header and payload are sent
+  uint64_t rmaDone;   // requests acked by the target
 };
 
 void *persistentSocketThread(void *args_) {
@@ -486,6 +562,8 @@ flagcxResult_t flagcxNetSocketGetTask(struct flagcxNetSocketComm *comm, int op,
     flagcxSetThreadName(comm->helperThread[tid], "FLAGCX Sock%c%1u%2u%2u",
                         op == FLAGCX_SOCKET_SEND ? 'S' : 'R', comm->dev, tid,
                         comm->cudaDev);
+    flagcxAffinityBind(&flagcxNetSocketDevs[comm->dev].affinity,
+                       flagcxThreadSocketHelper, comm->helperThread[tid]);
   }
   struct flagcxNetSocketTask *r = queue->tasks + queue->next;
   if (r->used == 0) {
@@ -508,6 +586,459 @@ flagcxResult_t flagcxNetSocketGetTask(struct flagcxNetSocketComm *comm, int op,
   return flagcxInternalError;
 }
 
+/* One-sided functions */
+
+// One-sided operations are emulated over one extra connection per initiating
+// comm, opened on its first operation to the RMA listener of the target
+// process named in the window descriptor. The target side is served by a
+// single per-process thread, started when a comm first exposes a window,
+// which accepts these connections and polls them, so operations complete
+// without any call on the target: writes and signals are applied to the
+// windows of the comm the connection was opened to, reads are answered from
+// them, and every operation is acked once it took effect.
+
+static pthread_mutex_t flagcxNetSocketRmaLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flagcxNetSocketRmaCond = PTHREAD_COND_INITIALIZER;
+static pthread_t flagcxNetSocketRmaThread;
+static int flagcxNetSocketRmaWakeFd[2] = {-1, -1};
+static uint64_t flagcxNetSocketRmaEpoch = 0; // bumped at each poll set rebuild
+static std::vector<struct flagcxNetSocketComm *> flagcxNetSocketRmaComms;
+static struct flagcxSocket flagcxNetSocketRmaListenSocks[MAX_IFS];
+static union flagcxSocketAddress flagcxNetSocketRmaListenAddrs[MAX_IFS];
+static bool flagcxNetSocketRmaListening[MAX_IFS];
+
+static flagcxResult_t flagcxNetSocketRmaRandom(uint64_t *value) {
+  do {
+    FLAGCXCHECK(getRandomData(value, sizeof(*value)));
+  } while (*value == 0);
+  return flagcxSuccess;
+}
+
+// Resolve [addr, addr+size) inside a window of comm. The window is held
+// until flagcxNetSocketRmaRelease, so that it cannot be deregistered while
+// the payload is moved unlocked.
+static flagcxResult_t
+flagcxNetSocketRmaLookup(struct flagcxNetSocketComm *comm,
+                         struct flagcxNetSocketRmaHeader *hdr) {
+  comm->rmaServeMr = NULL;
+  comm->rmaServeTarget = NULL;
+  bool aligned = hdr->op != flagcxNetSocketRmaSignal ||
+                 (hdr->size == sizeof(uint64_t) &&
+                  hdr->addr % sizeof(uint64_t) == 0);
+  flagcxResult_t ret = flagcxInvalidArgument;
+  pthread_mutex_lock(&comm->rmaWindowLock);
+  auto it = comm->rmaWindows->find(hdr->key);
+  if (it != comm->rmaWindows->end() && aligned) {
+    flagcxNetRmaDesc_t *desc = &it->second->desc;
+    if (hdr->addr >= desc->addr && hdr->size <= desc->size &&
+        hdr->addr - desc->addr <= desc->size - hdr->size) {
+      comm->rmaServeMr = it->second;
+      comm->rmaServeMr->inflight++;
+      comm->rmaServeTarget = (char *)hdr->addr;
+      ret = flagcxSuccess;
+    }
+  }
+  pthread_mutex_unlock(&comm->rmaWindowLock);
+  if (ret != flagcxSuccess) {
+    WARN("NET/Socket : one-sided op %u on invalid window key %lu addr 0x%lx "
+         "size %lu",
+         hdr->op, hdr->key, hdr->addr, hdr->size);
+  }
+  return ret;
+}
+
+static void flagcxNetSocketRmaRelease(struct flagcxNetSocketComm *comm) {
+  if (comm->rmaServeMr == NULL)
+    return;
+  pthread_mutex_lock(&comm->rmaWindowLock);
+  if (--comm->rmaServeMr->inflight == 0)
+    pthread_cond_broadcast(&comm->rmaWindowCond);
+  pthread_mutex_unlock(&comm->rmaWindowLock);
+  comm->rmaServeMr = NULL;
+  comm->rmaServeTarget = NULL;
+}
+
+// Progress the operation served on the passive socket of comm as far as the
+// socket allows without blocking, so that one large payload does not hold up
+// the other connections of the service thread
+static flagcxResult_t
+flagcxNetSocketRmaServe(struct flagcxNetSocketComm *comm) {
+  struct flagcxNetSocketRmaHeader *hdr = &comm->rmaServeHdr;
+  const int hdrSize = sizeof(struct flagcxNetSocketRmaHeader);
+  if (comm->rmaServeStage == 0) {
+    // Headers are small enough to be received whole once the first byte is
+    // in, and this detects the initiator closing between operations
+    int closed;
+    flagcxResult_t res =
+        flagcxSocketTryRecv(&comm->rmaPassive, hdr, hdrSize, &closed, false);
+    if (res == flagcxInProgress)
+      return flagcxSuccess;
+    FLAGCXCHECK(res);
+    if (closed) {
+      comm->rmaPassiveState = 2;
+      return flagcxSuccess;
+    }
+    if (hdr->size > INT_MAX) {
+      WARN("NET/Socket : one-sided op of %lu bytes", hdr->size);
+      return flagcxInvalidUsage;
+    }
+    comm->rmaServeAck = *hdr;
+    comm->rmaServeAck.status = flagcxNetSocketRmaLookup(comm, hdr);
+    comm->rmaServeStage = hdr->op == flagcxNetSocketRmaRead ? 2 : 1;
+    comm->rmaServeOffset = 0;
+  }
+  if (comm->rmaServeStage == 1) {
+    char *target = comm->rmaServeTarget;
+    if (hdr->op == flagcxNetSocketRmaWrite && target && hdr->size > 0) {
+      FLAGCXCHECK(flagcxSocketProgress(FLAGCX_SOCKET_RECV, &comm->rmaPassive,
+                                       target, hdr->size,
+                                       &comm->rmaServeOffset));
+    } else if (hdr->op == flagcxNetSocketRmaSignal && target) {
+      FLAGCXCHECK(flagcxSocketProgress(
+          FLAGCX_SOCKET_RECV, &comm->rmaPassive, &comm->rmaServeValue,
+          sizeof(uint64_t), &comm->rmaServeOffset));
+    } else {
+      // Drain the payload of a rejected operation
+      char scratch[4096];
+      while (comm->rmaServeOffset < (int)hdr->size) {
+        int offset = 0;
+        FLAGCXCHECK(flagcxSocketProgress(
+            FLAGCX_SOCKET_RECV, &comm->rmaPassive, scratch,
+            std::min((int)hdr->size - comm->rmaServeOffset,
+                     (int)sizeof(scratch)),
+            &offset));
+        if (offset == 0)
+          break;
+        comm->rmaServeOffset += offset;
+      }
+    }
+    if (comm->rmaServeOffset < (int)hdr->size)
+      return flagcxSuccess;
+    if (hdr->op == flagcxNetSocketRmaSignal && target)
+      __atomic_fetch_add((uint64_t *)target, comm->rmaServeValue,
+                         __ATOMIC_SEQ_CST);
+    flagcxNetSocketRmaRelease(comm);
+    comm->rmaServeStage = 2;
+    comm->rmaServeOffset = 0;
+  }
+  if (comm->rmaServeStage == 2) {
+    FLAGCXCHECK(flagcxSocketProgress(FLAGCX_SOCKET_SEND, &comm->rmaPassive,
+                                     &comm->rmaServeAck, hdrSize,
+                                     &comm->rmaServeOffset));
+    if (comm->rmaServeOffset < hdrSize)
+      return flagcxSuccess;
+    comm->rmaServeStage = comm->rmaServeTarget ? 3 : 0;
+    comm->rmaServeOffset = 0;
+  }
+  if (comm->rmaServeStage == 3) {
+    FLAGCXCHECK(flagcxSocketProgress(FLAGCX_SOCKET_SEND, &comm->rmaPassive,
+                                     comm->rmaServeTarget, hdr->size,
+                                     &comm->rmaServeOffset));
+    if (comm->rmaServeOffset < (int)hdr->size)
+      return flagcxSuccess;
+    flagcxNetSocketRmaRelease(comm);
+    comm->rmaServeStage = 0;
+  }
+  return flagcxSuccess;
+}
+
+// Accept a connection on the RMA listener of dev and bind it to the comm
+// named by the id the initiator sends first
+static flagcxResult_t flagcxNetSocketRmaAccept(int dev) {
+  flagcxResult_t ret = flagcxSuccess;
+  struct flagcxSocket sock;
+  uint64_t id;
+  struct flagcxNetSocketComm *comm = NULL;
+  FLAGCXCHECK(flagcxSocketInit(&sock));
+  FLAGCXCHECKGOTO(
+      flagcxSocketAccept(&sock, &flagcxNetSocketRmaListenSocks[dev]), ret,
+      fail);
+  FLAGCXCHECKGOTO(flagcxSocketRecv(&sock, &id, sizeof(id)), ret, fail);
+  pthread_mutex_lock(&flagcxNetSocketRmaLock);
+  for (auto c : flagcxNetSocketRmaComms) {
+    if (c->rmaId == id && c->rmaPassiveState == 0) {
+      comm = c;
+      memcpy(&comm->rmaPassive, &sock, sizeof(struct flagcxSocket));
+      comm->rmaPassiveState = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&flagcxNetSocketRmaLock);
+  if (comm == NULL) {
+    WARN("NET/Socket : one-sided connection to unknown comm %lx", id);
+    ret = flagcxInvalidUsage;
+    goto fail;
+  }
+  return flagcxSuccess;
+fail:
+  flagcxSocketClose(&sock);
+  return ret;
+}
+
+static void *flagcxNetSocketRmaService(void *args) {
+  std::vector<struct pollfd> fds;
+  std::vector<int> devs;
+  std::vector<struct flagcxNetSocketComm *> comms;
+  while (1) {
+    pthread_mutex_lock(&flagcxNetSocketRmaLock);
+    fds.assign(1, {flagcxNetSocketRmaWakeFd[0], POLLIN, 0});
+    devs.clear();
+    comms.clear();
+    for (int d = 0; d < MAX_IFS; d++) {
+      if (!flagcxNetSocketRmaListening[d])
+        continue;
+      fds.push_back({flagcxNetSocketRmaListenSocks[d].fd, POLLIN, 0});
+      devs.push_back(d);
+    }
+    for (auto comm : flagcxNetSocketRmaComms) {
+      if (comm->rmaPassiveState != 1)
+        continue;
+      // Acks and read payloads wait for room in the socket
+      short events = comm->rmaServeStage >= 2 ? POLLOUT : POLLIN;
+      fds.push_back({comm->rmaPassive.fd, events, 0});
+      comms.push_back(comm);
+    }
+    flagcxNetSocketRmaEpoch++;
+    pthread_cond_broadcast(&flagcxNetSocketRmaCond);
+    pthread_mutex_unlock(&flagcxNetSocketRmaLock);
+
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      WARN("NET/Socket : RMA service poll failed : %s", strerror(errno));
+      return NULL;
+    }
+    if (fds[0].revents) {
+      char buf[64];
+      while (read(flagcxNetSocketRmaWakeFd[0], buf, sizeof(buf)) > 0)
+        ;
+    }
+    for (size_t i = 0; i < devs.size(); i++) {
+      if (fds[1 + i].revents &&
+          flagcxNetSocketRmaAccept(devs[i]) != flagcxSuccess)
+        WARN("NET/Socket : RMA service could not accept a connection");
+    }
+    for (size_t i = 0; i < comms.size(); i++) {
+      struct flagcxNetSocketComm *comm = comms[i];
+      if (fds[1 + devs.size() + i].revents == 0)
+        continue;
+      // A comm being closed stays allocated until the next rebuild, but its
+      // socket must not be touched once it left the list
+      pthread_mutex_lock(&flagcxNetSocketRmaLock);
+      bool live = std::find(flagcxNetSocketRmaComms.begin(),
+                            flagcxNetSocketRmaComms.end(),
+                            comm) != flagcxNetSocketRmaComms.end();
+      pthread_mutex_unlock(&flagcxNetSocketRmaLock);
+      if (live && flagcxNetSocketRmaServe(comm) != flagcxSuccess) {
+        WARN("NET/Socket : RMA service error, dropping connection");
+        comm->rmaPassiveState = 2;
+        flagcxNetSocketRmaRelease(comm);
+      }
+    }
+  }
+  return NULL;
+}
+
+static void flagcxNetSocketRmaWake() {
+  char c = 0;
+  if (write(flagcxNetSocketRmaWakeFd[1], &c, 1) < 0 && errno != EAGAIN)
+    WARN("NET/Socket : RMA service wake failed : %s", strerror(errno));
+}
+
+// Make the windows of comm reachable: start the service thread and the
+// listener of its device if needed, and give comm an id peers can name
+static flagcxResult_t
+flagcxNetSocketRmaExpose(struct flagcxNetSocketComm *comm) {
+  if (comm->rmaId != 0)
+    return flagcxSuccess;
+  flagcxResult_t ret = flagcxSuccess;
+  struct flagcxSocket *listenSock = flagcxNetSocketRmaListenSocks + comm->dev;
+  pthread_mutex_lock(&flagcxNetSocketRmaLock);
+  if (flagcxNetSocketRmaWakeFd[0] == -1) {
+    if (pipe2(flagcxNetSocketRmaWakeFd, O_NONBLOCK | O_CLOEXEC) != 0) {
+      WARN("NET/Socket : RMA service pipe failed : %s", strerror(errno));
+      ret = flagcxSystemError;
+      goto exit;
+    }
+    pthread_create(&flagcxNetSocketRmaThread, NULL, flagcxNetSocketRmaService,
+                   NULL);
+    pthread_detach(flagcxNetSocketRmaThread);
+    flagcxSetThreadName(flagcxNetSocketRmaThread, "FLAGCX SockRma");
+  }
+  if (!flagcxNetSocketRmaListening[comm->dev]) {
+    FLAGCXCHECKGOTO(flagcxSocketInit(listenSock,
+                                     &flagcxNetSocketDevs[comm->dev].addr,
+                                     FLAGCX_SOCKET_MAGIC,
+                                     flagcxSocketTypeNetSocket, NULL, 0),
+                    ret, exit);
+    FLAGCXCHECKGOTO(flagcxSocketListen(listenSock), ret, exit);
+    FLAGCXCHECKGOTO(flagcxSocketGetAddr(
+                        listenSock, flagcxNetSocketRmaListenAddrs + comm->dev),
+                    ret, exit);
+    flagcxNetSocketRmaListening[comm->dev] = true;
+  }
+  pthread_mutex_init(&comm->rmaWindowLock, NULL);
+  pthread_cond_init(&comm->rmaWindowCond, NULL);
+  comm->rmaWindows =
+      new std::unordered_map<uint64_t, struct flagcxNetSocketMr *>();
+  FLAGCXCHECKGOTO(flagcxNetSocketRmaRandom(&comm->rmaId), ret, exit);
+  flagcxNetSocketRmaComms.push_back(comm);
+  flagcxNetSocketRmaWake();
+exit:
+  pthread_mutex_unlock(&flagcxNetSocketRmaLock);
+  return ret;
+}
+
+// Wait until the service thread rebuilt its poll set without comm, so that
+// the sockets can be closed and comm freed
+static flagcxResult_t
+flagcxNetSocketRmaRemoveComm(struct flagcxNetSocketComm *comm) {
+  pthread_mutex_lock(&flagcxNetSocketRmaLock);
+  auto it = std::find(flagcxNetSocketRmaComms.begin(),
+                      flagcxNetSocketRmaComms.end(), comm);
+  if (it != flagcxNetSocketRmaComms.end()) {
+    flagcxNetSocketRmaComms.erase(it);
+    uint64_t epoch = flagcxNetSocketRmaEpoch;
+    flagcxNetSocketRmaWake();
+    while (flagcxNetSocketRmaEpoch == epoch)
+      pthread_cond_wait(&flagcxNetSocketRmaCond, &flagcxNetSocketRmaLock);
+  }
+  pthread_mutex_unlock(&flagcxNetSocketRmaLock);
+  return flagcxSuccess;
+}
+
+// Open the initiator connection of comm to the comm owning the window
+static flagcxResult_t
+flagcxNetSocketRmaConnect(struct flagcxNetSocketComm *comm,
+                          struct flagcxNetSocketRmaKey *rkey) {
+  if (comm->rmaTarget != 0) {
+    if (comm->rmaTarget == rkey->commId)
+      return flagcxSuccess;
+    WARN("NET/Socket : one-sided operations of a comm must target the "
+         "windows of a single peer comm");
+    return flagcxInvalidArgument;
+  }
+  flagcxResult_t ret = flagcxSuccess;
+  FLAGCXCHECK(flagcxSocketInit(&comm->rmaActive, &rkey->addr,
+                               FLAGCX_SOCKET_MAGIC, flagcxSocketTypeNetSocket,
+                               NULL, 0));
+  FLAGCXCHECKGOTO(flagcxSocketConnect(&comm->rmaActive), ret, fail);
+  FLAGCXCHECKGOTO(
+      flagcxSocketSend(&comm->rmaActive, &rkey->commId, sizeof(uint64_t)),
+      ret, fail);
+  comm->rmaTarget = rkey->commId;
+  return flagcxSuccess;
+fail:
+  flagcxSocketClose(&comm->rmaActive);
+  return ret;
+}
+
+// Push headers and payloads, then pull acks (and read payloads), both in
+// posted order
+static flagcxResult_t
+flagcxNetSocketRmaProgress(struct flagcxNetSocketComm *comm) {
+  const int hdrSize = sizeof(struct flagcxNetSocketRmaHeader);
+  while (comm->rmaSent < comm->rmaPosted) {
+    struct flagcxNetSocketRmaRequest *r =
+        comm->rmaRequests + comm->rmaSent % MAX_REQUESTS;
+    if (r->sendOffset < hdrSize) {
+      FLAGCXCHECK(flagcxSocketProgress(FLAGCX_SOCKET_SEND, &comm->rmaActive,
+                                       &r->hdr, hdrSize, &r->sendOffset));
+      if (r->sendOffset < hdrSize)
+        return flagcxSuccess;
+    }
+    int payload = (r->hdr.op == flagcxNetSocketRmaRead) ? 0 : r->hdr.size;
+    if (payload > 0) {
+      int offset = r->sendOffset - hdrSize;
+      FLAGCXCHECK(flagcxSocketProgress(FLAGCX_SOCKET_SEND, &comm->rmaActive,
+                                       r->data, payload, &offset));
+      r->sendOffset = hdrSize + offset;
+      if (offset < payload)
+        return flagcxSuccess;
+    }
+    comm->rmaSent++;
+  }
+  while (comm->rmaDone < comm->rmaSent) {
+    struct flagcxNetSocketRmaRequest *r =
+        comm->rmaRequests + comm->rmaDone % MAX_REQUESTS;
+    if (r->recvOffset < hdrSize) {
+      FLAGCXCHECK(flagcxSocketProgress(FLAGCX_SOCKET_RECV, &comm->rmaActive,
+                                       &r->ack, hdrSize, &r->recvOffset));
+      if (r->recvOffset < hdrSize)
+        return flagcxSuccess;
+      r->result = (flagcxResult_t)r->ack.status;
+    }
+    int payload = (r->hdr.op == flagcxNetSocketRmaRead &&
+                   r->result == flagcxSuccess)
+                      ? r->hdr.size
+                      : 0;
+    if (payload > 0) {
+      int offset = r->recvOffset - hdrSize;
+      FLAGCXCHECK(flagcxSocketProgress(FLAGCX_SOCKET_RECV, &comm->rmaActive,
+                                       r->data, payload, &offset));
+      r->recvOffset = hdrSize + offset;
+      if (offset < payload)
+        return flagcxSuccess;
+    }
+    r->used = 2;
+    comm->rmaDone++;
+  }
+  return flagcxSuccess;
+}
+
+static flagcxResult_t flagcxNetSocketRmaPost(struct flagcxNetSocketComm *comm,
+                                             int op, void *data, size_t size,
+                                             void *phandle, void **request) {
+  flagcxNetRmaDesc_t *desc = (flagcxNetRmaDesc_t *)phandle;
+  struct flagcxNetSocketRmaKey rkey;
+  *request = NULL;
+  if (desc == NULL || desc->keyLen != sizeof(rkey) || size > desc->size ||
+      size > INT_MAX) {
+    WARN("NET/Socket : invalid one-sided operation of %zu bytes", size);
+    return flagcxInvalidArgument;
+  }
+  memcpy(&rkey, desc->key, sizeof(rkey));
+  FLAGCXCHECK(flagcxNetSocketRmaConnect(comm, &rkey));
+  struct flagcxNetSocketRmaRequest *r =
+      comm->rmaRequests + comm->rmaPosted % MAX_REQUESTS;
+  if (r->used != 0)
+    return flagcxSuccess; // all slots in flight -- retry later
+  r->op = FLAGCX_NET_SOCKET_RMA;
+  r->used = 1;
+  r->comm = comm;
+  r->hdr.op = op;
+  r->hdr.status = flagcxSuccess;
+  r->hdr.key = rkey.key;
+  r->hdr.addr = desc->addr;
+  r->hdr.size = size;
+  r->data = (char *)data;
+  r->sendOffset = 0;
+  r->recvOffset = 0;
+  r->result = flagcxSuccess;
+  comm->rmaPosted++;
+  FLAGCXCHECK(flagcxNetSocketRmaProgress(comm));
+  *request = r;
+  return flagcxSuccess;
+}
+
+static flagcxResult_t
+flagcxNetSocketRmaTest(struct flagcxNetSocketRmaRequest *r, int *done,
+                       int *size) {
+  if (r->used == 1)
+    FLAGCXCHECK(flagcxNetSocketRmaProgress(r->comm));
+  if (r->used == 2) {
+    *done = 1;
+    if (size)
+      *size = r->hdr.size;
+    r->used = 0;
+    if (r->result != flagcxSuccess) {
+      WARN("NET/Socket : one-sided operation rejected by the target");
+      return r->result;
+    }
+  }
+  return flagcxSuccess;
+}
+
 flagcxResult_t flagcxNetSocketTest(void *request, int *done, int *size) {
   *done = 0;
   struct flagcxNetSocketRequest *r = (struct flagcxNetSocketRequest *)request;
@@ -515,6 +1046,9 @@ flagcxResult_t flagcxNetSocketTest(void *request, int *done, int *size) {
     WARN("NET/Socket : test called with NULL request");
     return flagcxInternalError;
   }
+  if (r->op == FLAGCX_NET_SOCKET_RMA)
+    return flagcxNetSocketRmaTest((struct flagcxNetSocketRmaRequest *)request,
+                                  done, size);
   if (r->used == 1) { /* try to send/recv size */
     int data = r->size;
     int offset = 0;
@@ -596,10 +1130,51 @@ flagcxResult_t flagcxNetSocketTest(void *request, int *done, int *size) {
 
 flagcxResult_t flagcxNetSocketRegMr(void *comm, void *data, size_t size,
                                     int type, void **mhandle) {
-  return (type != FLAGCX_PTR_HOST) ? flagcxInternalError : flagcxSuccess;
+  if ((type & ~FLAGCX_PTR_RMA) != FLAGCX_PTR_HOST)
+    return flagcxInternalError;
+  // Host memory needs no registration for two-sided transfers; only windows
+  // exposed to one-sided operations get a handle
+  *mhandle = NULL;
+  if ((type & FLAGCX_PTR_RMA) == 0)
+    return flagcxSuccess;
+  struct flagcxNetSocketComm *sComm = (struct flagcxNetSocketComm *)comm;
+  FLAGCXCHECK(flagcxNetSocketRmaExpose(sComm));
+  struct flagcxNetSocketRmaKey rkey;
+  rkey.commId = sComm->rmaId;
+  memcpy(&rkey.addr, flagcxNetSocketRmaListenAddrs + sComm->dev,
+         sizeof(rkey.addr));
+  struct flagcxNetSocketMr *mr;
+  FLAGCXCHECK(flagcxCalloc(&mr, 1));
+  mr->comm = sComm;
+  mr->desc.addr = (uint64_t)data;
+  mr->desc.size = size;
+  mr->desc.keyLen = sizeof(rkey);
+  FLAGCXCHECK(flagcxNetSocketRmaRandom(&rkey.key));
+  pthread_mutex_lock(&sComm->rmaWindowLock);
+  (*sComm->rmaWindows)[rkey.key] = mr;
+  pthread_mutex_unlock(&sComm->rmaWindowLock);
+  memcpy(mr->desc.key, &rkey, sizeof(rkey));
+  *mhandle = mr;
+  return flagcxSuccess;
 }
 
 flagcxResult_t flagcxNetSocketDeregMr(void *comm, void *mhandle) {
+  struct flagcxNetSocketMr *mr = (struct flagcxNetSocketMr *)mhandle;
+  if (mr == NULL)
+    return flagcxSuccess;
+  struct flagcxNetSocketRmaKey rkey;
+  memcpy(&rkey, mr->desc.key, sizeof(rkey));
+  struct flagcxNetSocketComm *sComm = mr->comm;
+  if (sComm != NULL) { // NULL once the comm is closed
+    // Unreachable for new operations once erased; wait for the one the
+    // service thread may still be moving in or out of the window
+    pthread_mutex_lock(&sComm->rmaWindowLock);
+    sComm->rmaWindows->erase(rkey.key);
+    while (mr->inflight > 0)
+      pthread_cond_wait(&sComm->rmaWindowCond, &sComm->rmaWindowLock);
+    pthread_mutex_unlock(&sComm->rmaWindowLock);
+  }
+  free(mr);
   return flagcxSuccess;
 }
 
@@ -632,6 +1207,30 @@ flagcxResult_t flagcxNetSocketIflush(void *recvComm, int n, void **data,
   return flagcxInternalError;
 }
 
+flagcxResult_t flagcxNetSocketWrite(void *sendComm, void *data, size_t size,
+                                    int tag, void *mhandle, void *phandle,
+                                    void **request) {
+  return flagcxNetSocketRmaPost((struct flagcxNetSocketComm *)sendComm,
+                                flagcxNetSocketRmaWrite, data, size, phandle,
+                                request);
+}
+
+flagcxResult_t flagcxNetSocketRead(void *recvComm, void *data, size_t size,
+                                   int tag, void *mhandle, void *phandle,
+                                   void **request) {
+  return flagcxNetSocketRmaPost((struct flagcxNetSocketComm *)recvComm,
+                                flagcxNetSocketRmaRead, data, size, phandle,
+                                request);
+}
+
+flagcxResult_t flagcxNetSocketSignal(void *sendComm, void *data, size_t size,
+                                     int tag, void *mhandle, void *phandle,
+                                     void **request) {
+  return flagcxNetSocketRmaPost((struct flagcxNetSocketComm *)sendComm,
+                                flagcxNetSocketRmaSignal, data, size, phandle,
+                                request);
+}
+
 flagcxResult_t flagcxNetSocketCloseListen(void *opaqueComm) {
   struct flagcxNetSocketListenComm *comm =
       (struct flagcxNetSocketListenComm *)opaqueComm;
@@ -659,6 +1258,9 @@ flagcxResult_t flagcxNetSocketClose(void *opaqueComm) {
       }
       free(res->threadTaskQueue.tasks);
     }
+    FLAGCXCHECK(flagcxNetSocketRmaRemoveComm(comm));
+    if (comm->rmaId != 0)
+      flagcxNetSocketRmaRelease(comm);
     int ready;
     FLAGCXCHECK(flagcxSocketReady(&comm->ctrlSock, &ready));
     if (ready)
@@ -668,6 +1270,17 @@ flagcxResult_t flagcxNetSocketClose(void *opaqueComm) {
       if (ready)
         FLAGCXCHECK(flagcxSocketClose(&comm->socks[i]));
     }
+    if (comm->rmaPassiveState != 0)
+      FLAGCXCHECK(flagcxSocketClose(&comm->rmaPassive));
+    if (comm->rmaTarget != 0)
+      FLAGCXCHECK(flagcxSocketClose(&comm->rmaActive));
+    if (comm->rmaId != 0) {
+      for (auto &window : *comm->rmaWindows)
+        window.second->comm = NULL;
+      delete comm->rmaWindows;
+      pthread_cond_destroy(&comm->rmaWindowCond);
+      pthread_mutex_destroy(&comm->rmaWindowLock);
+    }
     free(comm);
   }
   return flagcxSuccess;
@@ -697,9 +1310,7 @@ flagcxNetAdaptor flagcxNetSocket = {
     flagcxNetSocketTest,
 
     // One-sided functions
-    NULL, // write - not implemented
-    NULL, // read - not implemented
-    NULL, // signal - not implemented
+    flagcxNetSocketWrite, flagcxNetSocketRead, flagcxNetSocketSignal,
 
     // Device name lookup
     NULL, // getDevFromName
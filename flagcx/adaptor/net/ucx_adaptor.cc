@@ -1041,12 +1041,30 @@ flagcxResult_t flagcxUcxRegMr(void *comm, void *data, size_t size, int type,
       UCP_MEM_MAP_PARAM_FIELD_ADDRESS | UCP_MEM_MAP_PARAM_FIELD_LENGTH;
   mmap_params.address = (void *)reg_addr;
   mmap_params.length = reg_size;
-  mh->mem_type =
-      (type == FLAGCX_PTR_HOST) ? UCS_MEMORY_TYPE_HOST : UCS_MEMORY_TYPE_CUDA;
+  mh->mem_type = ((type & ~FLAGCX_PTR_RMA) == FLAGCX_PTR_HOST)
+                     ? UCS_MEMORY_TYPE_HOST
+                     : UCS_MEMORY_TYPE_CUDA;
   mmap_params.field_mask |= UCP_MEM_MAP_PARAM_FIELD_MEMORY_TYPE;
   mmap_params.memory_type = (ucs_memory_type_t)mh->mem_type;
 
   UCXCHECK(ucp_mem_map(ctx->flagcxUcxCtx, &mmap_params, &mh->ucp_memh));
+  mh->desc.addr = addr;
+  mh->desc.size = size;
+  mh->desc.keyLen = 0;
+  if (type & FLAGCX_PTR_RMA) {
+    // Publish the region for one-sided operations when its rkey fits
+    UCXCHECK(ucp_rkey_pack(ctx->flagcxUcxCtx, mh->ucp_memh, &rkey_buf,
+                           &rkey_buf_size));
+    if (rkey_buf_size <= FLAGCX_NET_RMA_KEY_MAXSIZE) {
+      memcpy(mh->desc.key, rkey_buf, rkey_buf_size);
+      mh->desc.keyLen = rkey_buf_size;
+    } else {
+      INFO(FLAGCX_NET,
+           "NET/UCX: rkey of %zu bytes too large for one-sided use",
+           rkey_buf_size);
+    }
+    ucp_rkey_buffer_release(rkey_buf);
+  }
   if (ctx->gpuFlush.enabled) {
     UCXCHECK(ucp_rkey_pack(ctx->flagcxUcxCtx, mh->ucp_memh, &rkey_buf,
                            &rkey_buf_size));
@@ -1090,6 +1108,7 @@ static flagcxUcxRequest_t *flagcxUcxRequestGet(flagcxUcxComm_t *comm) {
   req->worker = comm->ucx_worker->worker;
   req->pending = 0;
   req->count = 0;
+  req->rkey = NULL;
   return req;
 }
 
@@ -1377,6 +1396,144 @@ flagcxResult_t flagcxUcxIflush(void *recv_comm, int n, void **data, int *sizes,
   return flagcxSuccess;
 }
 
+enum flagcxUcxRmaOp {
+  flagcxUcxRmaWrite = 0,
+  flagcxUcxRmaRead = 1,
+  flagcxUcxRmaSignal = 2,
+};
+
+static flagcxResult_t flagcxUcxRmaAdd(flagcxUcxRequest_t *req, void *ucp_req,
+                                      const char *what) {
+  if (UCS_PTR_IS_ERR(ucp_req)) {
+    WARN("ucx_%s: unable to post operation (%s)", what,
+         ucs_status_string(UCS_PTR_STATUS(ucp_req)));
+    return flagcxSystemError;
+  } else if (ucp_req == NULL) {
+    req->pending--;
+  }
+  return flagcxSuccess;
+}
+
+// One-sided operations map onto UCP RMA on the endpoint of the comm. Writes
+// and signals are followed by an endpoint flush, so their completion means
+// the data is visible at the target, like reads.
+static flagcxResult_t flagcxUcxRma(flagcxUcxComm_t *comm, int op, void *data,
+                                   size_t size, void *mhandle, void *phandle,
+                                   void **request) {
+  flagcxUcxMhandle_t *mh = (flagcxUcxMhandle_t *)mhandle;
+  flagcxNetRmaDesc_t *desc = (flagcxNetRmaDesc_t *)phandle;
+  const char *what = op == flagcxUcxRmaWrite  ? "write"
+                     : op == flagcxUcxRmaRead ? "read"
+                                              : "signal";
+  flagcxUcxRequest_t *req;
+  ucp_request_param_t params;
+  ucs_status_t status;
+  void *ucp_req;
+
+  *request = NULL;
+  if (desc == NULL || desc->keyLen == 0 || size > desc->size ||
+      (op == flagcxUcxRmaSignal && size != sizeof(uint64_t))) {
+    WARN("ucx_%s: invalid remote descriptor for %zu bytes", what, size);
+    return flagcxInvalidArgument;
+  }
+
+  if (comm->ready == 0) {
+    if (op == flagcxUcxRmaRead) {
+      FLAGCXCHECK(flagcxUcxRecvCheck(comm));
+    } else {
+      FLAGCXCHECK(flagcxUcxSendCheck(comm));
+    }
+    if (comm->ready == 0) {
+      return flagcxSuccess;
+    }
+  }
+
+  req = flagcxUcxRequestGet(comm);
+  if (req == NULL) {
+    return flagcxInternalError;
+  }
+  status = ucp_ep_rkey_unpack(comm->ep, desc->key, &req->rkey);
+  if (status != UCS_OK) {
+    WARN("ucx_%s: unable to unpack the remote key (%s)", what,
+         ucs_status_string(status));
+    req->rkey = NULL;
+    goto fail;
+  }
+
+  params.op_attr_mask =
+      UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA;
+  params.cb.send = send_handler_nbx;
+  params.user_data = &req->pending;
+  if (mh) {
+    params.op_attr_mask |= UCP_OP_ATTR_FIELD_MEMH;
+    params.memh = mh->ucp_memh;
+  }
+
+  if (op == flagcxUcxRmaSignal) {
+    // Order the atomic after all previous writes on this endpoint
+    status = ucp_worker_fence(comm->ucx_worker->worker);
+    if (status != UCS_OK) {
+      WARN("ucx_signal: fence failed (%s)", ucs_status_string(status));
+      goto fail;
+    }
+  }
+
+  flagcxUcxRequestAdd(req, size);
+  if (op == flagcxUcxRmaWrite) {
+    ucp_req =
+        ucp_put_nbx(comm->ep, data, size, desc->addr, req->rkey, &params);
+  } else if (op == flagcxUcxRmaRead) {
+    ucp_req =
+        ucp_get_nbx(comm->ep, data, size, desc->addr, req->rkey, &params);
+  } else {
+    params.op_attr_mask |= UCP_OP_ATTR_FIELD_DATATYPE;
+    params.datatype = ucp_dt_make_contig(sizeof(uint64_t));
+    ucp_req = ucp_atomic_op_nbx(comm->ep, UCP_ATOMIC_OP_ADD, data, 1,
+                                desc->addr, req->rkey, &params);
+  }
+  if (flagcxUcxRmaAdd(req, ucp_req, what) != flagcxSuccess) {
+    goto fail; // nothing was posted
+  }
+
+  if (op != flagcxUcxRmaRead) {
+    params.op_attr_mask &= ~(UCP_OP_ATTR_FIELD_MEMH |
+                             UCP_OP_ATTR_FIELD_DATATYPE);
+    req->pending++;
+    FLAGCXCHECK(flagcxUcxRmaAdd(req, ucp_ep_flush_nbx(comm->ep, &params),
+                                what));
+  }
+
+  *request = req;
+  return flagcxSuccess;
+
+fail:
+  if (req->rkey != NULL) {
+    ucp_rkey_destroy(req->rkey);
+  }
+  flagcxUcxRequestRelease(req);
+  return flagcxSystemError;
+}
+
+flagcxResult_t flagcxUcxWrite(void *send_comm, void *data, size_t size,
+                              int tag, void *mhandle, void *phandle,
+                              void **request) {
+  return flagcxUcxRma((flagcxUcxComm_t *)send_comm, flagcxUcxRmaWrite, data,
+                      size, mhandle, phandle, request);
+}
+
+flagcxResult_t flagcxUcxRead(void *recv_comm, void *data, size_t size, int tag,
+                             void *mhandle, void *phandle, void **request) {
+  return flagcxUcxRma((flagcxUcxComm_t *)recv_comm, flagcxUcxRmaRead, data,
+                      size, mhandle, phandle, request);
+}
+
+flagcxResult_t flagcxUcxSignal(void *send_comm, void *data, size_t size,
+                               int tag, void *mhandle, void *phandle,
+                               void **request) {
+  return flagcxUcxRma((flagcxUcxComm_t *)send_comm, flagcxUcxRmaSignal, data,
+                      size, mhandle, phandle, request);
+}
+
 flagcxResult_t flagcxUcxTest(void *request, int *done, int *size) {
   flagcxUcxRequest_t *req = (flagcxUcxRequest_t *)request;
   unsigned p;
@@ -1394,6 +1551,9 @@ flagcxResult_t flagcxUcxTest(void *request, int *done, int *size) {
     /* Posted receives have completed */
     memcpy(size, req->size, sizeof(*size) * req->count);
   }
+  if (req->rkey != NULL) {
+    ucp_rkey_destroy(req->rkey);
+  }
 
   flagcxUcxRequestRelease(req);
   return flagcxSuccess;
@@ -1509,9 +1669,9 @@ struct flagcxNetAdaptor flagcxNetUcx = {
     flagcxUcxTest,   // test
 
     // One-sided functions
-    NULL, // write - TODO: Implement
-    NULL, // read - TODO: Implement
-    NULL, // signal - TODO: Implement
+    flagcxUcxWrite,  // write
+    flagcxUcxRead,   // read
+    flagcxUcxSignal, // signal
 
     // Device name lookup
     flagcxUcxGetDevFromName // getDevFromName
@@ -0,0 +1,10 @@
+#include "tuner/tuner_util.h"
+
+#ifdef USE_HOST_ADAPTOR
+// The host emulation has no algorithm to choose. Its candidates only differ
+// in a variable hostccl reports when it creates a communicator, so that the
+// tuner search and its communicator pool can be exercised without devices.
+static EnvVar config("FLAGCX_HOSTCCL_TUNER_CONFIG", {"0", "1", "2", "3"}, "0");
+
+std::vector<EnvVar> hostcclTunerVars = {config};
+#endif // USE_HOST_ADAPTOR
@@ -6,6 +6,8 @@ std::vector<EnvVar> &vars = ncclTunerVars;
 std::vector<EnvVar> &vars = mcclTunerVars;
 #elif USE_KUNLUNXIN_ADAPTOR
 std::vector<EnvVar> &vars = xcclTunerVars;
+#elif USE_HOST_ADAPTOR
+std::vector<EnvVar> &vars = hostcclTunerVars;
 #else
 std::vector<EnvVar> emptyVars = {};
 std::vector<EnvVar> &vars = emptyVars;
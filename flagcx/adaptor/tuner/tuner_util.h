@@ -23,6 +23,7 @@ static void safeStrCopy(char *dst, size_t dstSize, const std::string &src);
 extern std::vector<EnvVar> ncclTunerVars;
 extern std::vector<EnvVar> mcclTunerVars;
 extern std::vector<EnvVar> xcclTunerVars;
+extern std::vector<EnvVar> hostcclTunerVars;
 extern std::vector<EnvVar> &vars;
 
 #endif // end include guard
\ No newline at end of file
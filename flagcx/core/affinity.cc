@@ -0,0 +1,267 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ ************************************************************************/
+
+#include "affinity.h"
+#include "core.h"
+#include "cpuset.h"
+#include <limits.h>
+#include <linux/mempolicy.h>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <vector>
+
+#define AFFINITY_SPEC_MAX 1024
+#define AFFINITY_MAX_NODES 1024
+
+// Threads of a rank that get a core of their own
+#define AFFINITY_PINNED_ROLES 3
+
+static const char *affinityRoleNames[flagcxThreadNumRoles] = {
+    "progress", "service", "kernel", "socket"};
+
+// numa_node of the closest ancestor of pciPath that has one
+static int affinityNicNode(const char *pciPath) {
+  if (pciPath == NULL)
+    return -1;
+  char path[PATH_MAX];
+  strncpy(path, pciPath, PATH_MAX - 1);
+  path[PATH_MAX - 1] = '\0';
+  while (strncmp(path, "/sys/devices/", strlen("/sys/devices/")) == 0) {
+    char file[PATH_MAX + 16];
+    snprintf(file, sizeof(file), "%s/numa_node", path);
+    FILE *f = fopen(file, "r");
+    if (f != NULL) {
+      int node = -1;
+      if (fscanf(f, "%d", &node) != 1)
+        node = -1;
+      fclose(f);
+      return node;
+    }
+    char *slash = strrchr(path, '/');
+    if (slash == NULL)
+      break;
+    *slash = '\0';
+  }
+  return -1;
+}
+
+static bool affinityNodeCpus(int node, cpu_set_t *cpus) {
+  char file[PATH_MAX];
+  snprintf(file, sizeof(file), "/sys/devices/system/node/node%d/cpumap",
+           node);
+  FILE *f = fopen(file, "r");
+  if (f == NULL)
+    return false;
+  char line[CPU_SETSIZE / 4 + CPU_SETSIZE / 32 + 2];
+  bool ok = fgets(line, sizeof(line), f) != NULL;
+  fclose(f);
+  CPU_ZERO(cpus);
+  if (ok)
+    flagcxStrToCpuset(line, cpus);
+  return ok && CPU_COUNT(cpus) > 0;
+}
+
+static flagcxResult_t affinityParseCpus(const char *str, cpu_set_t *cpus) {
+  if (flagcxCpulistToCpuset(str, cpus) != flagcxSuccess ||
+      CPU_COUNT(cpus) == 0) {
+    WARN("FLAGCX_THREAD_AFFINITY: invalid cpulist '%s'", str);
+    return flagcxInvalidArgument;
+  }
+  return flagcxSuccess;
+}
+
+// The n-th core of the set counting down from the highest one, wrapping
+static int affinityPickCore(cpu_set_t *cpus, int n) {
+  int count = CPU_COUNT(cpus);
+  n = count - 1 - n % count;
+  for (int c = 0; c < CPU_SETSIZE; c++) {
+    if (CPU_ISSET(c, cpus) && n-- == 0)
+      return c;
+  }
+  return -1;
+}
+
+// Slots held by the live communicators of the process, per node
+static std::mutex affinitySlotMutex;
+static std::map<int, std::vector<bool>> affinitySlots;
+
+static int affinityTakeSlot(int node) {
+  std::lock_guard<std::mutex> lock(affinitySlotMutex);
+  std::vector<bool> &slots = affinitySlots[node];
+  size_t slot = 0;
+  while (slot < slots.size() && slots[slot])
+    slot++;
+  if (slot == slots.size())
+    slots.push_back(true);
+  else
+    slots[slot] = true;
+  return (int)slot;
+}
+
+void flagcxAffinityRelease(struct flagcxAffinity *affinity) {
+  if (affinity->slot < 0)
+    return;
+  std::lock_guard<std::mutex> lock(affinitySlotMutex);
+  affinitySlots[affinity->numaNode][affinity->slot] = false;
+  affinity->slot = -1;
+}
+
+void flagcxAffinityLocalRank(const uint64_t *hostHashes, int nRanks, int rank,
+                             int *localRank, int *localRanks) {
+  *localRank = 0;
+  *localRanks = 0;
+  for (int r = 0; r < nRanks; r++) {
+    if (hostHashes[r] != hostHashes[rank])
+      continue;
+    if (r < rank)
+      (*localRank)++;
+    (*localRanks)++;
+  }
+}
+
+flagcxResult_t flagcxAffinityInit(struct flagcxAffinity *affinity,
+                                  const char *pciPath, int localRank,
+                                  int localRanks) {
+  affinity->numaNode = -1;
+  affinity->slot = -1;
+  for (int r = 0; r < flagcxThreadNumRoles; r++)
+    CPU_ZERO(&affinity->cpus[r]);
+  const char *spec = flagcxGetEnv("FLAGCX_THREAD_AFFINITY");
+  if (spec == NULL || spec[0] == '\0')
+    spec = "auto";
+  if (strcmp(spec, "none") == 0)
+    return flagcxSuccess;
+
+  cpu_set_t pool, given[flagcxThreadNumRoles];
+  bool havePool = false, haveGiven[flagcxThreadNumRoles] = {};
+  int node = -1;
+  bool automatic = strcmp(spec, "auto") == 0;
+  if (!automatic && strchr(spec, '=') == NULL) {
+    FLAGCXCHECK(affinityParseCpus(spec, &pool));
+    havePool = true;
+  } else if (!automatic) {
+    char buf[AFFINITY_SPEC_MAX];
+    strncpy(buf, spec, AFFINITY_SPEC_MAX - 1);
+    buf[AFFINITY_SPEC_MAX - 1] = '\0';
+    char *save = NULL;
+    for (char *item = strtok_r(buf, ";", &save); item != NULL;
+         item = strtok_r(NULL, ";", &save)) {
+      char *value = strchr(item, '=');
+      if (value == NULL) {
+        WARN("FLAGCX_THREAD_AFFINITY: expected key=value, got '%s'", item);
+        return flagcxInvalidArgument;
+      }
+      *value++ = '\0';
+      if (strcmp(item, "numa") == 0) {
+        char *end;
+        node = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || node < 0 ||
+            node >= AFFINITY_MAX_NODES) {
+          WARN("FLAGCX_THREAD_AFFINITY: invalid numa node '%s'", value);
+          return flagcxInvalidArgument;
+        }
+        continue;
+      }
+      int r = 0;
+      while (r < flagcxThreadNumRoles && strcmp(item, affinityRoleNames[r]))
+        r++;
+      if (r == flagcxThreadNumRoles) {
+        WARN("FLAGCX_THREAD_AFFINITY: unknown thread '%s'", item);
+        return flagcxInvalidArgument;
+      }
+      FLAGCXCHECK(affinityParseCpus(value, &given[r]));
+      haveGiven[r] = true;
+    }
+  }
+  if (node < 0)
+    node = affinityNicNode(pciPath);
+  affinity->numaNode = node;
+  if (!havePool && node >= 0)
+    havePool = affinityNodeCpus(node, &pool);
+
+  if (havePool) {
+    // Stay within the cores the process may use unless that leaves none,
+    // in which case the kernel reports the conflict when binding
+    cpu_set_t allowed, inter;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+      CPU_AND(&inter, &pool, &allowed);
+      if (CPU_COUNT(&inter) > 0)
+        pool = inter;
+    }
+  }
+  bool pick = false;
+  for (int r = 0; r < AFFINITY_PINNED_ROLES; r++)
+    pick |= havePool && localRanks > 0 && !haveGiven[r];
+  int first = -1;
+  if (pick) {
+    affinity->slot = affinityTakeSlot(node);
+    if (localRanks <= localRank)
+      localRanks = localRank + 1;
+    int n = (affinity->slot * localRanks + localRank) * AFFINITY_PINNED_ROLES;
+    if (n + AFFINITY_PINNED_ROLES <= CPU_COUNT(&pool)) {
+      first = n;
+    } else {
+      INFO(FLAGCX_INIT,
+           "Thread affinity: no cores left on numa node %d for slot %d of "
+           "local rank %d, using the whole node",
+           node, affinity->slot, localRank);
+    }
+  }
+  for (int r = 0; r < flagcxThreadNumRoles; r++) {
+    if (haveGiven[r]) {
+      affinity->cpus[r] = given[r];
+    } else if (havePool && (r == flagcxThreadSocketHelper || first < 0)) {
+      affinity->cpus[r] = pool;
+    } else if (havePool) {
+      CPU_SET(affinityPickCore(&pool, first + r), &affinity->cpus[r]);
+    }
+  }
+
+  char str[flagcxThreadNumRoles][CPU_SETSIZE / 4 + CPU_SETSIZE / 32 + 1];
+  for (int r = 0; r < flagcxThreadNumRoles; r++)
+    flagcxCpusetToStr(&affinity->cpus[r], str[r]);
+  INFO(FLAGCX_INIT,
+       "Thread affinity %s: numa node %d, progress %s service %s kernel %s "
+       "socket %s",
+       spec, node, str[0], str[1], str[2], str[3]);
+  return flagcxSuccess;
+}
+
+void flagcxAffinityBind(struct flagcxAffinity *affinity,
+                        flagcxThreadRole_t role, pthread_t thread) {
+  cpu_set_t *cpus = &affinity->cpus[role];
+  if (CPU_COUNT(cpus) == 0)
+    return;
+  int err = pthread_setaffinity_np(thread, sizeof(cpu_set_t), cpus);
+  if (err != 0) {
+    char str[CPU_SETSIZE / 4 + CPU_SETSIZE / 32 + 1];
+    flagcxCpusetToStr(cpus, str);
+    WARN("Could not pin %s thread to cpus %s : %s", affinityRoleNames[role],
+         str, strerror(err));
+  }
+}
+
+void *flagcxNumaAlloc(size_t size, int numaNode) {
+  void *ptr = NULL;
+  size_t page = sysconf(_SC_PAGESIZE);
+  if (posix_memalign(&ptr, page, size) != 0)
+    return NULL;
+  if (numaNode >= 0 && numaNode < AFFINITY_MAX_NODES) {
+    // The pages are not touched yet, so the policy decides where they land.
+    // MPOL_PREFERRED falls back to other nodes when this one is full.
+    const int bits = 8 * sizeof(unsigned long);
+    unsigned long mask[AFFINITY_MAX_NODES / bits] = {};
+    mask[numaNode / bits] = 1UL << (numaNode % bits);
+    if (syscall(SYS_mbind, ptr, ROUNDUP(size, page), MPOL_PREFERRED, mask,
+                AFFINITY_MAX_NODES + 1, 0) != 0) {
+      INFO(FLAGCX_INIT | FLAGCX_NET,
+           "Could not bind %zu bytes to numa node %d : %s", size, numaNode,
+           strerror(errno));
+    }
+  }
+  return ptr;
+}
@@ -0,0 +1,75 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ *
+ * CPU and NUMA placement of the communication threads.
+ *
+ * The proxy progress, proxy service and kernel service threads of a
+ * communicator are each pinned to one core of the NUMA node local to its
+ * NIC, picked from the top of the node so that they stay clear of the low
+ * cores most frameworks hand to their dataloaders. Every live communicator
+ * of the process holds a slot on the node, and the slot together with the
+ * rank of the process among the ranks of its host selects the cores, so
+ * communicators of one process and the processes of one host get distinct
+ * cores, however devices are made visible to them. Once the node
+ * runs out of cores these threads are confined to the whole node instead,
+ * as socket helper threads always are.
+ * Host staging buffers of the network transport are allocated from the
+ * same node. FLAGCX_THREAD_AFFINITY overrides the automatic choice:
+ *   auto (default)  pin when the NUMA node of the NIC is known
+ *   none            leave all threads to the scheduler
+ *   <cpulist>       pick the cores from this list instead of the node
+ *   role=<cpulist>;...;numa=<node>
+ *                   with role one of progress, service, kernel, socket,
+ *                   gives the exact cores of a role; numa picks the node
+ *                   the cores and the staging buffers come from
+ ************************************************************************/
+
+#ifndef FLAGCX_AFFINITY_H_
+#define FLAGCX_AFFINITY_H_
+
+#include "flagcx.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  flagcxThreadProxyProgress = 0,
+  flagcxThreadProxyService = 1,
+  flagcxThreadKernelService = 2,
+  flagcxThreadSocketHelper = 3,
+  flagcxThreadNumRoles = 4
+} flagcxThreadRole_t;
+
+struct flagcxAffinity {
+  int numaNode; // node of the staging buffers, -1 when unknown
+  int slot;     // slot held on numaNode, -1 when none
+  // Cores of every role, an empty set leaves the thread unpinned
+  cpu_set_t cpus[flagcxThreadNumRoles];
+};
+
+// Rank of rank among the ranks with the same host hash, and their number
+void flagcxAffinityLocalRank(const uint64_t *hostHashes, int nRanks, int rank,
+                             int *localRank, int *localRanks);
+
+// Place the threads of a communicator of node-local rank localRank (out of
+// localRanks) driving the NIC at pciPath, which may be NULL. Takes a slot
+// that flagcxAffinityRelease gives back, unless localRanks is 0 for a
+// placement that only serves socket helper threads. Fails only on a
+// malformed FLAGCX_THREAD_AFFINITY.
+flagcxResult_t flagcxAffinityInit(struct flagcxAffinity *affinity,
+                                  const char *pciPath, int localRank,
+                                  int localRanks);
+
+// Give back the slot of a communicator that is going away
+void flagcxAffinityRelease(struct flagcxAffinity *affinity);
+
+// Pin a thread of the given role, failures are only reported
+void flagcxAffinityBind(struct flagcxAffinity *affinity,
+                        flagcxThreadRole_t role, pthread_t thread);
+
+// Page-aligned memory preferably backed by the given node (any node when
+// negative), released with free()
+void *flagcxNumaAlloc(size_t size, int numaNode);
+
+#endif
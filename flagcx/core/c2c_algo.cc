@@ -1,5 +1,6 @@
 #include "c2c_algo.h"
 #include "c2c_ir.h"
+#include "timeline.h"
 #include <cstdint>
 #include <cstdlib>
 #include <stdlib.h>
@@ -679,9 +680,7 @@ flagcxC2cPlanner::flagcxC2cPlanner(size_t sendCount, size_t recvCount,
   nPipePostSteps_ = 0;
   nSeqPostSteps_ = 1;
   // use ring pipeline algo if FLAGCX_C2C_ALGO=RING_PIPELINED
-  const char *algorithm = getenv("FLAGCX_C2C_ALGO");
-  if (algorithm != NULL && (strcmp(algorithm, "RING_PIPELINED") == 0 ||
-                            strcmp(algorithm, "Ring_pipelined") == 0)) {
+  if (comm_->config.c2cAlgo == flagcxConfigC2cAlgoRingPipelined) {
     // pipeline optimizations for AllGather
     if (commOp_ == flagcxCommOpAllGather) {
       algorithm_ = flagcxAlgoPipeline;
@@ -2026,13 +2025,13 @@ flagcxResult_t flagcxC2cPlanner::findStrategy() {
       }
     }
   }
-  if (getenv("FLAGCX_ALGO_EXPORT_PREFIX")) {
-    exportXml(getenv("FLAGCX_ALGO_EXPORT_PREFIX"));
-  } else if (getenv("FLAGCX_ALGO_EXPORT_PATH")) {
-    const char *algo_path = getenv("FLAGCX_ALGO_EXPORT_PATH");
+  if (comm_->config.algoExportPrefix[0] != '\0') {
+    exportXml(comm_->config.algoExportPrefix);
+  } else if (comm_->config.algoExportPath[0] != '\0') {
+    const char *algo_path = comm_->config.algoExportPath;
     size_t algo_hash =
         genC2cAlgoHash(sendCount_, recvCount_, rootClusterId_, commOp_, redOp_);
-    char prefix[128];
+    char prefix[FLAGCX_CONFIG_PATH_MAX + 32];
     snprintf(prefix, sizeof(prefix), "%s/%lu", algo_path, algo_hash);
     exportXml(prefix);
   }
@@ -2044,6 +2043,8 @@ flagcxResult_t flagcxC2cPlanner::execute(const void *sendbuff, void *recvbuff,
                                          flagcxStream_t stream,
                                          size_t *sendCounts, size_t *sDispls,
                                          size_t *recvCounts, size_t *rDispls) {
+  TIMELINE_SCOPE("c2c", "c2cExecute", "commOp", commOp_, "count", totalCount_);
+
   // redOp validation
   if (redOp_ != flagcxRedNoOp) {
     if (redOp_ != flagcxSum && redOp_ != flagcxMax && redOp_ != flagcxMin) {
@@ -2094,18 +2095,16 @@ flagcxResult_t flagcxC2cPlanner::execute(const void *sendbuff, void *recvbuff,
   }
 
   int importAlgoFromXmlFile = 0;
-  const char *algorithm = getenv("FLAGCX_C2C_ALGO");
-  if (algorithm != NULL && (strcmp(algorithm, "XML_INPUT") == 0 ||
-                            strcmp(algorithm, "Xml_input") == 0)) {
-    const char *algo_path = getenv("FLAGCX_ALGO_IMPORT_PATH");
-    const char *algo_prefix = getenv("FLAGCX_ALGO_IMPORT_PREFIX");
-    if (algo_prefix) {
+  if (comm_->config.c2cAlgo == flagcxConfigC2cAlgoXmlInput) {
+    const char *algo_path = comm_->config.algoImportPath;
+    const char *algo_prefix = comm_->config.algoImportPrefix;
+    if (algo_prefix[0] != '\0') {
       FLAGCXCHECK(importXml(algo_prefix));
       importAlgoFromXmlFile = 1;
-    } else if (algo_path) {
+    } else if (algo_path[0] != '\0') {
       size_t algo_hash = genC2cAlgoHash(sendCount_, recvCount_, rootClusterId_,
                                         commOp_, redOp_);
-      char prefix[128];
+      char prefix[FLAGCX_CONFIG_PATH_MAX + 32];
       snprintf(prefix, sizeof(prefix), "%s/%lu", algo_path, algo_hash);
       FLAGCXCHECK(importXml(prefix));
       importAlgoFromXmlFile = 1;
@@ -2140,17 +2139,21 @@ flagcxResult_t flagcxC2cPlanner::execute(const void *sendbuff, void *recvbuff,
   deviceAdaptor->streamCreate(&het_stream);
 
   // execute sequential preHomoFunc steps
-  cclAdaptors[flagcxCCLAdaptorDevice]->groupStart();
-  for (int s = 0; s < nSeqPreSteps_; ++s) {
-    for (int i = 0; i < preHomoFuncSteps_[s].size(); ++i) {
-      preHomoFuncSteps_[s][i].run(sendbuff, recvbuff, scratchBuffer_, datatype,
-                                  redOp_, comm_->globalrank2homorank[root],
-                                  comm_, stream, sendCounts_, sDispls_,
-                                  recvCounts_, rDispls_);
+  {
+    TIMELINE_SCOPE("c2c", "c2cSeqPreHomo", "steps", nSeqPreSteps_, NULL, 0);
+    cclAdaptors[flagcxCCLAdaptorDevice]->groupStart();
+    for (int s = 0; s < nSeqPreSteps_; ++s) {
+      for (int i = 0; i < preHomoFuncSteps_[s].size(); ++i) {
+        preHomoFuncSteps_[s][i].run(sendbuff, recvbuff, scratchBuffer_,
+                                    datatype, redOp_,
+                                    comm_->globalrank2homorank[root], comm_,
+                                    stream, sendCounts_, sDispls_, recvCounts_,
+                                    rDispls_);
+      }
     }
+    cclAdaptors[flagcxCCLAdaptorDevice]->groupEnd();
+    deviceAdaptor->streamSynchronize(stream);
   }
-  cclAdaptors[flagcxCCLAdaptorDevice]->groupEnd();
-  deviceAdaptor->streamSynchronize(stream);
 
   // execute pipelined preHomoFunc and heteroFunc steps
   // execute refreshFunc
@@ -2162,9 +2165,13 @@ flagcxResult_t flagcxC2cPlanner::execute(const void *sendbuff, void *recvbuff,
       refreshFunc_.start_ = clusterOffset_ * totalCount_ / comm_->nranks;
     }
   }
-  refreshFunc_.run(recvbuff, scratchBuffer_, datatype, stream);
-  deviceAdaptor->streamSynchronize(stream);
+  {
+    TIMELINE_SCOPE("c2c", "c2cRefresh", NULL, 0, NULL, 0);
+    refreshFunc_.run(recvbuff, scratchBuffer_, datatype, stream);
+    deviceAdaptor->streamSynchronize(stream);
+  }
   for (int s = 0; s < nPipePreSteps_; ++s) {
+    TIMELINE_SCOPE("c2c", "c2cPipePreHomoHetero", "step", s, NULL, 0);
     cclAdaptors[flagcxCCLAdaptorDevice]->groupStart();
     for (int i = 0; i < preHomoFuncSteps_[nSeqPreSteps_ + s].size(); ++i) {
       preHomoFuncSteps_[nSeqPreSteps_ + s][i].run(
@@ -2201,6 +2208,7 @@ flagcxResult_t flagcxC2cPlanner::execute(const void *sendbuff, void *recvbuff,
 
   // execute sequential heteroFunc steps
   for (int s = 0; s < nSeqInterSteps_; ++s) {
+    TIMELINE_SCOPE("c2c", "c2cSeqHetero", "step", s, NULL, 0);
     for (int i = 0; i < heteroFuncSteps_[nPipePreSteps_ + s].size(); ++i) {
       // execute refreshFunc
       if (algorithm_ == flagcxAlgoSequential ||
@@ -2234,6 +2242,7 @@ flagcxResult_t flagcxC2cPlanner::execute(const void *sendbuff, void *recvbuff,
 
   // execute pipelined heteroFunc and postHomoFunc steps
   for (int s = 0; s < nPipePostSteps_; ++s) {
+    TIMELINE_SCOPE("c2c", "c2cPipeHeteroPostHomo", "step", s, NULL, 0);
     cclAdaptors[flagcxCCLAdaptorDevice]->groupStart();
     // execute postHomoFunc
     for (int i = 0; i < postHomoFuncSteps_[s].size(); ++i) {
@@ -2272,22 +2281,26 @@ flagcxResult_t flagcxC2cPlanner::execute(const void *sendbuff, void *recvbuff,
   }
 
   // execute sequential postHomoFunc steps
-  cclAdaptors[flagcxCCLAdaptorDevice]->groupStart();
-  for (int s = 0; s < nSeqPostSteps_; ++s) {
-    for (int i = 0; i < postHomoFuncSteps_[nPipePostSteps_ + s].size(); ++i) {
-      // execute refresh func
-      if (algorithm_ == flagcxAlgoSequential ||
-          (nPipePreSteps_ == 0 && nPipePostSteps_ == 0)) {
-        refreshFunc_.run(recvbuff, scratchBuffer_, datatype, stream);
-      }
+  {
+    TIMELINE_SCOPE("c2c", "c2cSeqPostHomo", "steps", nSeqPostSteps_, NULL, 0);
+    cclAdaptors[flagcxCCLAdaptorDevice]->groupStart();
+    for (int s = 0; s < nSeqPostSteps_; ++s) {
+      for (int i = 0; i < postHomoFuncSteps_[nPipePostSteps_ + s].size();
+           ++i) {
+        // execute refresh func
+        if (algorithm_ == flagcxAlgoSequential ||
+            (nPipePreSteps_ == 0 && nPipePostSteps_ == 0)) {
+          refreshFunc_.run(recvbuff, scratchBuffer_, datatype, stream);
+        }
 
-      // execute postHomoFunc
-      postHomoFuncSteps_[nPipePostSteps_ + s][i].run(
-          sendbuff, recvbuff, scratchBuffer_, datatype, redOp_,
-          comm_->globalrank2homorank[root], comm_, stream);
+        // execute postHomoFunc
+        postHomoFuncSteps_[nPipePostSteps_ + s][i].run(
+            sendbuff, recvbuff, scratchBuffer_, datatype, redOp_,
+            comm_->globalrank2homorank[root], comm_, stream);
+      }
     }
+    cclAdaptors[flagcxCCLAdaptorDevice]->groupEnd();
   }
-  cclAdaptors[flagcxCCLAdaptorDevice]->groupEnd();
 
   // free scratch buffer if needed
   if (scratchBuffer_ != nullptr) {
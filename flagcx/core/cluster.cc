@@ -25,101 +25,74 @@ flagcxResult_t flagcxCollectClusterInfos(const flagcxVendor *allData,
                                          int *homo_rank, int *homo_root_rank,
                                          int *homo_ranks, int *cluster_id,
                                          int *cluster_inter_rank, int *ncluster,
-                                         int rank, int nranks) {
-  *homo_rank = rank;
-  *homo_root_rank = 0;
-  *homo_ranks = 1;
-  *cluster_id = 0;
-  *cluster_inter_rank = -1; // deprecated, to be removed
-  *ncluster = 1;
-  *type = flagcxCommunicatorHomo;
-
-  if (nranks <= 1)
-    return flagcxSuccess;
-
-  std::map<std::string, int> clusterMap;
-  clusterMap[allData[0].internal] = 1;
-  int numClusters = 1;
-  int currCluster = 0;
-  int aggRanks = 1;
-  int homoRootRank = 0;
-  std::string myCls = allData[rank].internal;
-  for (int i = 1; i < nranks; ++i) {
-    std::string cls = allData[i].internal;
-    auto it = clusterMap.find(cls);
-    if (it != clusterMap.end()) {
-      it->second = it->second + 1;
-    } else {
-      clusterMap[cls] = 1;
-      numClusters += 1;
-      if (myCls == cls) {
-        *homo_rank = *homo_rank - aggRanks;
-        currCluster = numClusters - 1;
-        homoRootRank = i;
-      }
-    }
-    aggRanks += 1;
-
-    if (i == rank) {
-      *homo_root_rank = homoRootRank;
+                                         int nranks) {
+  // Clusters are numbered in order of first appearance; the ranks of one
+  // cluster are expected to be contiguous, starting at its first rank.
+  std::map<std::string, int> clusterIndex;
+  std::vector<int> firstRank;
+  std::vector<int> clusterCount;
+  std::vector<int> vendorCluster(nranks);
+  for (int i = 0; i < nranks; ++i) {
+    auto it = clusterIndex.emplace(allData[i].internal, (int)firstRank.size());
+    if (it.second) {
+      firstRank.push_back(i);
+      clusterCount.push_back(0);
     }
+    vendorCluster[i] = it.first->second;
+    clusterCount[vendorCluster[i]]++;
   }
+  int numClusters = firstRank.size();
+  *type = numClusters > 1 ? flagcxCommunicatorHybrid : flagcxCommunicatorHomo;
+  *ncluster = numClusters > 1 ? numClusters : 1;
 
-  *homo_ranks = clusterMap[myCls];
-
-  if (clusterMap.size() > 1) {
-    *type = flagcxCommunicatorHybrid;
-  } else {
-    *type = flagcxCommunicatorHomo;
-  }
-
-  if (*type == flagcxCommunicatorHybrid) {
-    *cluster_id = currCluster;
-    *ncluster = numClusters;
+  for (int r = 0; r < nranks; ++r) {
+    int c = vendorCluster[r];
+    homo_rank[r] = r - firstRank[c];
+    homo_root_rank[r] = firstRank[c];
+    homo_ranks[r] = clusterCount[c];
+    cluster_id[r] = numClusters > 1 ? c : 0;
+    cluster_inter_rank[r] = -1; // deprecated, to be removed
   }
 
   // split and obtain sub-clusters
   const char *clusterSplitInfo = flagcxGetEnv("FLAGCX_CLUSTER_SPLIT_LIST");
-  if (clusterSplitInfo != NULL) {
-    std::vector<int> clusterSplitList;
-    FLAGCXCHECK(parseClusterSplitList(clusterSplitInfo, clusterSplitList));
-    if (*ncluster != int(clusterSplitList.size())) {
-      WARN("Invalid cluster split info, its length should be equal to the "
-           "number of homogeneous cluster");
-      return flagcxSystemError;
-    }
-
-    int subClusterId = 0;
-    for (int i = 0; i < currCluster; ++i) {
-      subClusterId += clusterSplitList[i];
-    }
-    int subHomoRanks = (*homo_ranks) / clusterSplitList[currCluster];
-    int hasRes =
-        (((*homo_rank) / subHomoRanks) >= clusterSplitList[currCluster]) ? 1
-                                                                         : 0;
-    subClusterId += (hasRes == 1) ? ((*homo_rank) / subHomoRanks) - 1
-                                  : ((*homo_rank) / subHomoRanks);
+  if (nranks <= 1 || clusterSplitInfo == NULL)
+    return flagcxSuccess;
+  std::vector<int> clusterSplitList;
+  FLAGCXCHECK(parseClusterSplitList(clusterSplitInfo, clusterSplitList));
+  if (*ncluster != int(clusterSplitList.size())) {
+    WARN("Invalid cluster split info, its length should be equal to the "
+         "number of homogeneous cluster");
+    return flagcxSystemError;
+  }
+  std::vector<int> subClusterBase(numClusters, 0);
+  int subNClusters = 0;
+  for (int i = 0; i < *ncluster; ++i) {
+    subClusterBase[i] = subNClusters;
+    subNClusters += clusterSplitList[i];
+  }
+  for (int r = 0; r < nranks; ++r) {
+    int currCluster = vendorCluster[r];
+    int splits = clusterSplitList[currCluster];
+    int subHomoRanks = homo_ranks[r] / splits;
+    int hasRes = ((homo_rank[r] / subHomoRanks) >= splits) ? 1 : 0;
+    int subClusterId = subClusterBase[currCluster];
+    subClusterId += (hasRes == 1) ? (homo_rank[r] / subHomoRanks) - 1
+                                  : (homo_rank[r] / subHomoRanks);
     int subHomoRank = (hasRes == 1)
-                          ? subHomoRanks + ((*homo_rank) % subHomoRanks)
-                          : ((*homo_rank) % subHomoRanks);
-    int subHomoRootRank = rank - subHomoRank;
-    if (hasRes == 1 ||
-        ((*homo_rank) / subHomoRanks) == clusterSplitList[currCluster] - 1) {
-      subHomoRanks += (*homo_ranks) % clusterSplitList[currCluster];
+                          ? subHomoRanks + (homo_rank[r] % subHomoRanks)
+                          : (homo_rank[r] % subHomoRanks);
+    if (hasRes == 1 || (homo_rank[r] / subHomoRanks) == splits - 1) {
+      subHomoRanks += homo_ranks[r] % splits;
     }
-    int subNClusters = 0;
-    for (int i = 0; i < (*ncluster); ++i) {
-      subNClusters += clusterSplitList[i];
-    }
-    *homo_rank = subHomoRank;
-    *homo_root_rank = subHomoRootRank;
-    *homo_ranks = subHomoRanks;
-    *cluster_id = subClusterId;
-    *ncluster = subNClusters;
-    *type =
-        (subNClusters > 1) ? flagcxCommunicatorHybrid : flagcxCommunicatorHomo;
+    homo_rank[r] = subHomoRank;
+    homo_root_rank[r] = r - subHomoRank;
+    homo_ranks[r] = subHomoRanks;
+    cluster_id[r] = subClusterId;
   }
-
+  *ncluster = subNClusters;
+  *type =
+      (subNClusters > 1) ? flagcxCommunicatorHybrid : flagcxCommunicatorHomo;
   return flagcxSuccess;
 }
 
@@ -13,12 +13,15 @@
 flagcxResult_t parseClusterSplitList(const char *input,
                                      std::vector<int> &output);
 
+// Derives the cluster layout from the vendor names of all ranks. Every rank
+// computes the same result, so the per-rank outputs are arrays of nranks
+// entries and need not be exchanged afterwards.
 flagcxResult_t flagcxCollectClusterInfos(const flagcxVendor *allData,
                                          flagcxCommunicatorType_t *type,
                                          int *homo_rank, int *homo_root_rank,
                                          int *homo_ranks, int *cluster_id,
                                          int *cluster_inter_rank,
-                                         int *nclusters, int rank, int nranks);
+                                         int *nclusters, int nranks);
 
 flagcxResult_t flagcxFillClusterVendorInfo(const flagcxVendor *allData,
                                            flagcxComm *comm, int *clusterIdData,
@@ -7,6 +7,7 @@
 #ifndef FLAGCX_COMM_H_
 #define FLAGCX_COMM_H_
 
+#include "affinity.h"
 #include "bootstrap.h"
 #include "device.h"
 #include "flagcx_kernel.h"
@@ -178,6 +179,8 @@ struct flagcxHeteroComm {
   struct flagcxInterServerTopo *interServerTopo;
 
   struct flagcxNetAdaptor *netAdaptor;
+  // Per-rank /dev/shm identity, equal for ranks that can use the SHM net
+  uint64_t *shmDomains;
   struct bootstrapState *bootstrap;
   // Bitmasks for flagcxTransportP2pSetup
   uint64_t *connectSend;
@@ -197,6 +200,8 @@ struct flagcxHeteroComm {
   int64_t busId;              // my PCI bus ID in int format
   cpu_set_t cpuAffinity;      // CPU affinity of the GPU
   int cudaArch;               // matches __CUDA_ARCH__ of device
+  // Cores of the proxy threads and node of the staging buffers
+  struct flagcxAffinity affinity;
 
   int node;
   int nNodes;
@@ -285,6 +290,8 @@ struct flagcxHeteroComm {
 
   struct flagcxProxyState *proxyState;
   int proxyRefCountOld; /* store proxy post-atomic-sub refcount */
+  // flags and events of device func ops, created on first use
+  struct flagcxFuncPool *funcPool;
   // Whether this communicator uses collNet
   int collNetSupport;
   bool collNetRegSupport;
@@ -327,6 +334,9 @@ struct flagcxHeteroComm {
       callbackQueue;
 
   flagcxConfig_t config;
+  // FLAGCX_DEVICE_FUNC_RELAXED_ORDERING of the owning flagcxComm, taken from
+  // its config at init and by flagcxCommReloadConfig
+  int deviceFuncRelaxedOrdering;
   // initState is to more conveniently reclaim resources when errors happen.
   flagcxResult_t initState;
   // flag to indicate if flagcxCommFinalize() is called
@@ -46,6 +46,35 @@ static flagcxResult_t flagcxStrToCpuset(const char *str, cpu_set_t *mask) {
   return flagcxSuccess;
 }
 
+// Convert a cpulist, e.g. 0-3,8,10-11 to cpu_set_t
+
+static flagcxResult_t flagcxCpulistToCpuset(const char *str, cpu_set_t *mask) {
+  CPU_ZERO(mask);
+  while (*str) {
+    char *end;
+    long first = strtol(str, &end, 10);
+    long last = first;
+    if (end == str || first < 0)
+      return flagcxInvalidArgument;
+    if (*end == '-') {
+      str = end + 1;
+      last = strtol(str, &end, 10);
+      if (end == str || last < first)
+        return flagcxInvalidArgument;
+    }
+    if (last >= CPU_SETSIZE)
+      return flagcxInvalidArgument;
+    for (long c = first; c <= last; c++)
+      CPU_SET(c, mask);
+    if (*end == ',')
+      end++;
+    else if (*end != '\0')
+      return flagcxInvalidArgument;
+    str = end;
+  }
+  return flagcxSuccess;
+}
+
 static flagcxResult_t flagcxCpusetToStr(cpu_set_t *mask, char *str) {
   int c = 0;
   uint8_t *m8 = (uint8_t *)mask;
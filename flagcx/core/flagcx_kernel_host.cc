@@ -52,22 +52,43 @@ flagcxResult_t flagcxFifo::flagcxFifoDestroy() {
 
 FLAGCX_HOST_DECORATOR flagcxResult_t dequeue(void *fifoBuffer,
                                              flagcxDeviceTrigger_t trigger) {
-  int idx = -1;
-  uint64_t *buffer = (uint64_t *)fifoBuffer;
+  int nTriggers;
+  FLAGCXCHECK(dequeueBatch(fifoBuffer, trigger, 1, &nTriggers));
+  if (nTriggers == 0) {
+    memset((void *)trigger, 0, sizeof(flagcxDeviceTrigger));
+  }
+  return flagcxSuccess;
+}
+
+FLAGCX_HOST_DECORATOR flagcxResult_t
+dequeueBatch(void *fifoBuffer, flagcxDeviceTrigger_t triggers, int maxTriggers,
+             int *nTriggers) {
+  const uint64_t ready = 1ull << flagcxDeviceTriggerOffFifoReserved;
+  volatile uint64_t *buffer = (volatile uint64_t *)fifoBuffer;
   uint64_t capacity = buffer[0];
   uint64_t cons = buffer[1];
-  uint64_t prod = buffer[2];
-  int distance = prod - cons;
-  if (distance > 0) {
-    idx = cons % capacity;
-    memcpy((void *)trigger,
-           (void *)(buffer + 3 +
-                    sizeof(flagcxDeviceTrigger) / sizeof(uint64_t) * idx),
-           sizeof(flagcxDeviceTrigger));
+  int n = 0;
+  // Slots are published out of order by concurrent producers, stop at the
+  // first one that is not ready yet
+  while (n < maxTriggers) {
+    uint64_t idx = (cons + n) % capacity;
+    volatile uint64_t *slot =
+        buffer + 3 + sizeof(flagcxDeviceTrigger) / sizeof(uint64_t) * idx;
+    uint64_t snd = slot[1];
+    if (!(snd & ready)) {
+      break;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    triggers[n].fst = slot[0];
+    triggers[n].snd = snd & ~ready;
+    slot[1] = 0;
+    n++;
+  }
+  if (n > 0) {
+    // slots must read as empty before producers may reuse them
     __sync_synchronize();
-    buffer[1] = buffer[1] + 1;
-  } else {
-    memset((void *)trigger, 0, sizeof(flagcxDeviceTrigger));
+    buffer[1] = cons + n;
   }
+  *nTriggers = n;
   return flagcxSuccess;
 }
@@ -17,10 +17,25 @@
 #define FLAGCX_PTR_HOST 0x1
 #define FLAGCX_PTR_CUDA 0x2
 #define FLAGCX_PTR_DMABUF 0x4
+// OR'ed into the type of regMr to expose the region to one-sided operations
+#define FLAGCX_PTR_RMA 0x8
 
 // Maximum number of requests per comm object
 #define FLAGCX_NET_MAX_REQUESTS 32
 
+// Remote memory descriptor for one-sided write/read/signal. Adaptors that
+// implement them return handles starting with a flagcxNetRmaDesc for regions
+// registered with FLAGCX_PTR_RMA; the target ships those bytes to the
+// initiator, which passes them (optionally with addr moved inside the window)
+// as phandle.
+#define FLAGCX_NET_RMA_KEY_MAXSIZE 232
+typedef struct {
+  uint64_t addr;   // remote address targeted by the operation
+  uint64_t size;   // bytes accessible from addr
+  uint32_t keyLen; // 0 if the region cannot be accessed remotely
+  char key[FLAGCX_NET_RMA_KEY_MAXSIZE]; // adaptor-specific remote key
+} flagcxNetRmaDesc_t;
+
 #define FLAGCX_NET_MAX_DEVS_PER_NIC_V10 4
 
 typedef struct {
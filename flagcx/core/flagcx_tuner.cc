@@ -5,8 +5,12 @@
 #include "timer.h"
 #include "tuner/tuner_util.h"
 #include "utils.h"
+#include <algorithm>
 #include <cfloat>
+#include <climits>
+#include <cmath>
 #include <iostream>
+#include <list>
 #include <map>
 #include <sstream>
 #include <string>
@@ -85,29 +89,47 @@ struct TunerProfileKey {
   }
 };
 
-// (collType,nBytes,configIdx)
-// Used for counting the number of configs corresponding to each Collective Op
-struct TunerCommTagCounterKey {
-  size_t nBytes;
-  uint32_t collType;   // flagcxCommOp_t
-  uint32_t commTagIdx; // index of commTag in configList
-};
-
-static bool operator<(const struct TunerCommTagCounterKey &lhs,
-                      const struct TunerCommTagCounterKey &rhs) {
-  if (lhs.nBytes != rhs.nBytes)
-    return lhs.nBytes < rhs.nBytes;
-  if (lhs.collType != rhs.collType)
-    return lhs.collType < rhs.collType;
-  return lhs.commTagIdx < rhs.commTagIdx;
-}
-
 // number loops of collectives call before using profiled data.
 // Each loop will go thoroughly through all search space of all candidates.
 #define TUNER_SEARCH_NLOOPS 5
 #define PROFILE_ROUND                                                          \
   2 // Use data from the 3rd round, as it's likely more stable.
 
+// Collectives are tuned per size bucket rather than per exact size. Every power
+// of two is split into FLAGCX_TUNER_SIZE_BUCKETS equal buckets, and at most
+// FLAGCX_TUNER_MAX_SEARCH_BUCKETS buckets of each collective are searched.
+// Other buckets take their config from the searched ones.
+FLAGCX_PARAM(TunerSizeBuckets, "TUNER_SIZE_BUCKETS", 1);
+FLAGCX_PARAM(TunerMaxSearchBuckets, "TUNER_MAX_SEARCH_BUCKETS", 8);
+
+// Number of further calls of a collective category during which the ranks
+// agree on its best config in the background, using the last searched config
+// meanwhile. 0 agrees synchronously when the search ends.
+FLAGCX_PARAM(TunerAgreeLag, "TUNER_AGREE_LAG", 0);
+#define TUNER_MAX_SIZE_BUCKETS 64
+
+// Drift detection, see checkDrift. Once a category uses its best config, one
+// call out of every FLAGCX_TUNER_RETUNE_INTERVAL is timed, and every
+// FLAGCX_TUNER_RETUNE_SAMPLES samples the median is compared with the first
+// one measured. A category slower by more than FLAGCX_TUNER_RETUNE_THRESHOLD
+// percent is searched again, at most FLAGCX_TUNER_RETUNE_BUDGET times per
+// communicator. An interval of 0 disables it.
+FLAGCX_PARAM(TunerRetuneInterval, "TUNER_RETUNE_INTERVAL", 0);
+FLAGCX_PARAM(TunerRetuneSamples, "TUNER_RETUNE_SAMPLES", 16);
+FLAGCX_PARAM(TunerRetuneThreshold, "TUNER_RETUNE_THRESHOLD", 20);
+FLAGCX_PARAM(TunerRetuneBudget, "TUNER_RETUNE_BUDGET", 4);
+
+// Maximum number of live homo communicators, one per config, shared by all
+// categories. The least recently used one that is not the best communicator
+// of a category is destroyed to make room for a new one.
+FLAGCX_PARAM(TunerCommPoolSize, "TUNER_COMM_POOL_SIZE", 4);
+
+// Latency samples of a category since it uses its best config
+struct TunerDriftState {
+  uint32_t start = 0;     // seqId of the first sample of the current period
+  float baseline = -1.0f; // median of the first period, max over ranks
+};
+
 // customized context structure for internal use
 struct flagcxTunerContext {
   // configure related struct
@@ -115,6 +137,8 @@ struct flagcxTunerContext {
   flagcxDebugLogger_t logger = NULL;
   int envTagIdx = -1; // the index of envTag in configList
   uint32_t searchNLoops = TUNER_SEARCH_NLOOPS;
+  size_t sizeBuckets = 1; // size buckets per power of two
+  uint32_t maxSearchBuckets = 8;
 
   // runtime related struct
   std::vector<int> activeCommList; // List of active communicator. Holds indices
@@ -126,8 +150,50 @@ struct flagcxTunerContext {
   std::map<TunerCollCategory, int>
       collBestCommMap; // record the best communicator for each collective
                        // category. value is comm index in configList.
-  std::map<struct TunerCommTagCounterKey, int>
-      configCounterMap; // record per (collType,nBytes,configIdx) counter.
+  std::map<uint32_t, uint32_t>
+      collSearchCount; // number of size buckets searched per collType
+  std::map<TunerCollCategory, std::vector<float>>
+      collTimeMap; // profiled time of each config in configList, max over
+                   // ranks, for the searched collective categories.
+                   // Non-positive if there is no data for that config.
+  std::map<TunerCollCategory, TunerCollCategory>
+      collFollowMap; // categories that use the configs of a category still
+                     // being searched, until it has found its best config
+
+  // agreement on profiled times running in the background, see
+  // startAgreement. At most one is in flight since they share the bootstrap.
+  uint32_t agreeLag = 0;
+  struct {
+    bool pending = false;
+    TunerCollCategory cat;
+    std::vector<float> times;
+    pthread_t thread;
+    flagcxResult_t result;
+  } agreement;
+
+  // configs of the pooled communicators, most recently used first
+  uint32_t commPoolSize = 4;
+  std::list<int> commPoolLru;
+
+  // drift detection, see checkDrift
+  uint32_t retuneInterval = 0;
+  uint32_t retuneSamples = 16;
+  uint32_t retuneThreshold = 20; // percent
+  uint32_t retuneBudget = 4;
+  std::map<TunerCollCategory, TunerDriftState> driftMap;
+  struct {
+    bool active = false; // cat is being searched again
+    TunerCollCategory cat;
+    uint32_t count = 0; // searches started so far
+  } retune;
+
+  // tuning database, see tunerDbLoad
+  std::string dbFile;
+  uint64_t dbFingerprint = 0;
+  bool dbWriter = false; // lowest rank of its node, the only one saving
+  std::map<TunerCollCategory, int>
+      dbBestCommMap; // best comm index in configList of every category in the
+                     // database for this fingerprint, including new results
 
   // timer
   flagcxTimer<TunerProfileKey> timer;
@@ -157,6 +223,183 @@ static flagcxResult_t setEnvConfig(const struct flagcxEnvConfig &cfg,
   return flagcxSuccess;
 }
 
+/* Tuning database
+ *
+ * FLAGCX_TUNER_DB_FILE names a text file that keeps the best config of every
+ * searched collective category across runs, one per line:
+ *   <fingerprint> <collType> <size bucket> <commTag>
+ * The fingerprint covers what the results depend on besides the category:
+ * device vendor, number of ranks and their layout over hosts, candidate
+ * configs and size bucketing. Lines of other fingerprints are kept when the
+ * file is rewritten, so one file can serve several jobs.
+ */
+#define TUNER_DB_HEADER "# flagcx tuner db v1\n"
+
+struct tunerDbRankInfo {
+  uint64_t hostHash;
+  uint64_t entryHash; // of the entries of this job's fingerprint
+};
+
+// Returns false if the file cannot be read
+static bool readTunerDb(const char *path, std::string &content) {
+  content.clear();
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    content.append(buf, n);
+  }
+  fclose(file);
+  return true;
+}
+
+// Load the entries of this job's fingerprint. Every rank reads its own copy
+// of the file, which may live on a node-local disk, and the entries are only
+// used if every rank found the same ones, so that all start from the same
+// configs. Entries of other jobs may differ between copies. Collective over
+// the tuner bootstrap.
+static flagcxResult_t tunerDbLoad(struct flagcxTunerContext *ctx) {
+  const char *path = flagcxGetEnv("FLAGCX_TUNER_DB_FILE");
+  if (path == NULL || path[0] == '\0') {
+    return flagcxSuccess;
+  }
+  ctx->dbFile = path;
+  std::string content;
+  bool found = readTunerDb(path, content);
+
+  // The fingerprint covers the layout of the ranks over hosts
+  int rank = internalTuner.rank;
+  int nranks = internalTuner.nranks;
+  struct tunerDbRankInfo *infos = NULL;
+  FLAGCXCHECK(flagcxCalloc(&infos, nranks));
+  infos[rank].hostHash = getHostHash();
+  flagcxResult_t ret = bootstrapAllGather(
+      internalTuner.bootstrap, (void *)infos, sizeof(struct tunerDbRankInfo));
+  if (ret != flagcxSuccess) {
+    free(infos);
+    return ret;
+  }
+
+  flagcxVendor vendor;
+  memset(&vendor, 0, sizeof(vendor));
+  deviceAdaptor->getVendor(vendor.internal);
+  std::ostringstream fp;
+  fp << vendor.internal << ";" << nranks << ";" << ctx->sizeBuckets << ";";
+  for (int r = 0; r < nranks; r++) {
+    int host = 0;
+    while (infos[host].hostHash != infos[r].hostHash) {
+      host++;
+    }
+    fp << host << ",";
+    if (r == rank) {
+      ctx->dbWriter = host == rank;
+    }
+  }
+  for (const auto &cfg : ctx->configList) {
+    fp << ";" << cfg.commTag.tag;
+    for (int i = 0; i < cfg.envCount; i++) {
+      fp << ":" << cfg.envs[i].name << "=" << cfg.envs[i].value;
+    }
+  }
+  ctx->dbFingerprint = getHash(fp.str().c_str(), fp.str().size());
+
+  std::istringstream lines(content);
+  std::string line;
+  while (std::getline(lines, line)) {
+    unsigned long fingerprint;
+    int collType, offset = 0;
+    size_t nBytes;
+    if (sscanf(line.c_str(), "%lx %d %zu %n", &fingerprint, &collType, &nBytes,
+               &offset) != 3 ||
+        fingerprint != ctx->dbFingerprint || offset == 0) {
+      continue;
+    }
+    struct flagcxCommTag tag;
+    snprintf(tag.tag, FLAGCX_COMM_TAG_MAX_LENGTH, "%s", line.c_str() + offset);
+    auto it = ctx->commTagIdxMap.find(tag);
+    if (it == ctx->commTagIdxMap.end()) {
+      continue;
+    }
+    struct TunerCollCategory cat = {(flagcxCommOp_t)collType, nBytes};
+    ctx->dbBestCommMap[cat] = it->second;
+  }
+
+  std::ostringstream entries;
+  for (const auto &item : ctx->dbBestCommMap) {
+    entries << item.first.collType << " " << item.first.nBytes << " "
+            << item.second << "\n";
+  }
+  infos[rank].entryHash = getHash(entries.str().c_str(), entries.str().size());
+  ret = bootstrapAllGather(internalTuner.bootstrap, (void *)infos,
+                           sizeof(struct tunerDbRankInfo));
+  bool agree = true;
+  for (int r = 0; r < nranks; r++) {
+    agree = agree && infos[r].entryHash == infos[0].entryHash;
+  }
+  free(infos);
+  FLAGCXCHECK(ret);
+  if (!agree) {
+    WARN("Tuner DB %s has different entries for fingerprint %016lx across "
+         "ranks, searching from scratch.",
+         path, (unsigned long)ctx->dbFingerprint);
+    ctx->dbBestCommMap.clear();
+    return flagcxSuccess;
+  }
+  INFO(FLAGCX_TUNING, "Tuner DB %s %s, %zu entries for fingerprint %016lx.",
+       path, found ? "loaded" : "not found", ctx->dbBestCommMap.size(),
+       (unsigned long)ctx->dbFingerprint);
+  return flagcxSuccess;
+}
+
+// Rewrite the database with the current entries of this fingerprint. Every
+// rank agreed on the same entries, so only the lowest rank of each node
+// writes its copy. The new file is written aside and renamed over the old
+// one, so readers never see a partial file even if nodes share it.
+static flagcxResult_t tunerDbSave(struct flagcxTunerContext *ctx) {
+  if (ctx->dbFile.empty() || !ctx->dbWriter) {
+    return flagcxSuccess;
+  }
+  std::string content;
+  readTunerDb(ctx->dbFile.c_str(), content);
+
+  char tmp[PATH_MAX];
+  snprintf(tmp, sizeof(tmp), "%s.%lx.%d", ctx->dbFile.c_str(),
+           (unsigned long)getHostHash(), getpid());
+  FILE *file = fopen(tmp, "w");
+  if (file == NULL) {
+    WARN("Tuner DB: cannot open %s : %s", tmp, strerror(errno));
+    return flagcxSystemError;
+  }
+  fputs(TUNER_DB_HEADER, file);
+  std::istringstream lines(content);
+  std::string line;
+  while (std::getline(lines, line)) {
+    unsigned long fingerprint;
+    if (line.empty() || line[0] == '#' ||
+        (sscanf(line.c_str(), "%lx", &fingerprint) == 1 &&
+         fingerprint == ctx->dbFingerprint)) {
+      continue;
+    }
+    fprintf(file, "%s\n", line.c_str());
+  }
+  for (const auto &item : ctx->dbBestCommMap) {
+    fprintf(file, "%016lx %d %zu %s\n", (unsigned long)ctx->dbFingerprint,
+            item.first.collType, item.first.nBytes,
+            ctx->configList[item.second].commTag.tag);
+  }
+  fclose(file);
+  if (rename(tmp, ctx->dbFile.c_str()) != 0) {
+    WARN("Tuner DB: cannot rename %s to %s : %s", tmp, ctx->dbFile.c_str(),
+         strerror(errno));
+    unlink(tmp);
+    return flagcxSystemError;
+  }
+  return flagcxSuccess;
+}
+
 flagcxResult_t flagcxTunerInit(size_t nRanks, size_t nNodes,
                                flagcxDebugLogger_t logFunction,
                                void **context) {
@@ -206,9 +449,33 @@ flagcxResult_t flagcxTunerInit(size_t nRanks, size_t nNodes,
     }
   }
 
-  // initialize profilingResults pointer
-  FLAGCXCHECK(
-      flagcxCalloc(&internalTuner.profilingResults, internalTuner.nranks));
+  int64_t sizeBuckets = flagcxParamTunerSizeBuckets();
+  while (ctx->sizeBuckets * 2 <= (size_t)sizeBuckets &&
+         ctx->sizeBuckets < TUNER_MAX_SIZE_BUCKETS) {
+    ctx->sizeBuckets *= 2;
+  }
+  ctx->maxSearchBuckets =
+      std::max<int64_t>(flagcxParamTunerMaxSearchBuckets(), 1);
+  INFO(FLAGCX_TUNING,
+       "Tuner uses %zu size buckets per power of two, searches at most %u "
+       "buckets per collective.",
+       ctx->sizeBuckets, ctx->maxSearchBuckets);
+  ctx->agreeLag = std::max<int64_t>(flagcxParamTunerAgreeLag(), 0);
+  ctx->commPoolSize = std::max<int64_t>(flagcxParamTunerCommPoolSize(), 1);
+  ctx->retuneInterval = std::max<int64_t>(flagcxParamTunerRetuneInterval(), 0);
+  ctx->retuneSamples = std::max<int64_t>(flagcxParamTunerRetuneSamples(), 1);
+  ctx->retuneThreshold =
+      std::max<int64_t>(flagcxParamTunerRetuneThreshold(), 0);
+  ctx->retuneBudget = std::max<int64_t>(flagcxParamTunerRetuneBudget(), 0);
+  if (ctx->retuneInterval > 0) {
+    INFO(FLAGCX_TUNING,
+         "Tuner samples 1 of %u calls, searches again after %u%% drift over "
+         "%u samples, at most %u times.",
+         ctx->retuneInterval, ctx->retuneThreshold, ctx->retuneSamples,
+         ctx->retuneBudget);
+  }
+  FLAGCXCHECK(tunerDbLoad(ctx));
+
   // start timer
   ctx->timer.start();
   return flagcxSuccess;
@@ -265,21 +532,34 @@ static int getSeqIdForCommIdx(const struct flagcxTunerContext *ctx, int commIdx,
   return (found ? (seqId * ctx->searchNLoops) + round : -1);
 }
 
+// Lower bound of the size bucket nBytes falls in. Sizes too small to be split
+// into sizeBuckets parts are their own bucket.
+static size_t getSizeBucket(const struct flagcxTunerContext *ctx,
+                            size_t nBytes) {
+  if (nBytes == 0) {
+    return 0;
+  }
+  size_t base = (size_t)1 << (63 - __builtin_clzll(nBytes));
+  if (base < ctx->sizeBuckets) {
+    return nBytes;
+  }
+  size_t step = base / ctx->sizeBuckets;
+  return base + (nBytes - base) / step * step;
+}
+
+static double logSize(size_t nBytes) { return std::log2((double)nBytes + 1); }
+
 // add a small factor to avoid switching between two close communicators caused
 // by measurement noise
 const float tunerProfileFactor = 0.95f;
 
-// Helper function to find the best communicator for a collective category based
-// on profiling data Strategy: For each active communicator, check if we have
-// profiling data for that collective category. If yes, use that data to
-// calculate the time for that collective category. If no, skip that
-// communicator. Finally, select the communicator with the minimum time as the
-// best communicator.
-static flagcxResult_t findBestComm(struct flagcxTunerContext *ctx,
-                                   const struct TunerCollCategory &cat) {
-  int bestCommIdx = -1; // index of best communicator in configList
-  float minTime = FLT_MAX;
-  // calculate the best communicator based on profiling data
+// Profiled time of every active config for a collective category on this
+// rank. Configs without profiling data get FLT_MAX so that they lose the
+// max-reduction in agreeTimes on every rank alike.
+static void collectLocalTimes(struct flagcxTunerContext *ctx,
+                              const struct TunerCollCategory &cat,
+                              std::vector<float> &times) {
+  times.assign(ctx->configList.size(), FLT_MAX);
   const uint32_t profileDataRound = PROFILE_ROUND;
   for (const auto &idx : ctx->activeCommList) {
     int seqId = getSeqIdForCommIdx(
@@ -290,34 +570,79 @@ static flagcxResult_t findBestComm(struct flagcxTunerContext *ctx,
                                static_cast<uint32_t>(seqId), idx);
     struct flagcxRecordKey<TunerProfileKey> rkey(profileKey);
     float duration = ctx->timer.getRecord(rkey, true);
-
     if (duration <= 0) {
       // no profiling data for this communicator and collective category
       WARN("No profiling data for (commId=%d,coll=%d,size=%zu,seq=%u).", idx,
            cat.collType, cat.nBytes, seqId);
       continue;
     }
+    times[idx] = duration;
+  }
+}
 
-    memcpy(internalTuner.profilingResults + internalTuner.rank, &duration,
-           sizeof(float));
-    // get average duration across all ranks
-    FLAGCXCHECK(bootstrapAllGather(internalTuner.bootstrap,
-                                   (void *)internalTuner.profilingResults,
-                                   sizeof(float)));
-    FLAGCXCHECK(bootstrapBarrier(internalTuner.bootstrap, internalTuner.rank,
-                                 internalTuner.nranks, 0));
-    duration = 0.0f;
-    for (int i = 0; i < internalTuner.nranks; ++i) {
-      duration += internalTuner.profilingResults[i];
-    }
-    duration /= internalTuner.nranks;
+// A collective takes as long as its slowest rank, so configs are compared on
+// their maximum time over ranks, agreed on in a single reduction.
+static flagcxResult_t agreeTimes(std::vector<float> &times) {
+  return AllReduceBootstrap(internalTuner.bootstrap, times.data(),
+                            times.data(), times.size(), flagcxFloat,
+                            flagcxMax);
+}
 
-    INFO(FLAGCX_TUNING,
-         "Profiling data for (commId=%d,coll=%d,size=%zu,seq=%u) is %.3fms.",
-         idx, cat.collType, cat.nBytes, seqId, duration);
+static void *agreeTimesThread(void *arg) {
+  struct flagcxTunerContext *ctx = (struct flagcxTunerContext *)arg;
+  ctx->agreement.result = agreeTimes(ctx->agreement.times);
+  return NULL;
+}
 
-    if (duration < minTime * tunerProfileFactor) {
-      minTime = duration;
+// Wait for the agreement running in the background, if any, and keep its
+// result for selectBestComm. Must be called before anything else uses the
+// bootstrap, at the same point on every rank.
+static flagcxResult_t waitAgreement(struct flagcxTunerContext *ctx) {
+  if (!ctx->agreement.pending) {
+    return flagcxSuccess;
+  }
+  pthread_join(ctx->agreement.thread, NULL);
+  ctx->agreement.pending = false;
+  FLAGCXCHECK(ctx->agreement.result);
+  ctx->collTimeMap[ctx->agreement.cat].swap(ctx->agreement.times);
+  return flagcxSuccess;
+}
+
+// Start agreeing on the times of a collective category in the background.
+static flagcxResult_t startAgreement(struct flagcxTunerContext *ctx,
+                                     const struct TunerCollCategory &cat) {
+  FLAGCXCHECK(waitAgreement(ctx));
+  ctx->agreement.cat = cat;
+  collectLocalTimes(ctx, cat, ctx->agreement.times);
+  ctx->agreement.pending = true;
+  int err = pthread_create(&ctx->agreement.thread, NULL, agreeTimesThread, ctx);
+  if (err != 0) {
+    WARN("Tuner: cannot start agreement thread : %s", strerror(err));
+    ctx->agreement.pending = false;
+    return flagcxSystemError;
+  }
+  return flagcxSuccess;
+}
+
+// Select the best communicator of a collective category from the agreed
+// times in ctx->collTimeMap: the fastest config, unless it is within the
+// measurement noise of one found earlier.
+static flagcxResult_t selectBestComm(struct flagcxTunerContext *ctx,
+                                     const struct TunerCollCategory &cat) {
+  int bestCommIdx = -1; // index of best communicator in configList
+  float minTime = FLT_MAX;
+  std::vector<float> &times = ctx->collTimeMap[cat];
+  for (const auto &idx : ctx->activeCommList) {
+    if (times[idx] == FLT_MAX) {
+      // some rank has no profiling data for this communicator
+      times[idx] = -1.0f;
+      continue;
+    }
+    INFO(FLAGCX_TUNING,
+         "Profiling data for (commId=%d,coll=%d,size=%zu) is %.3fms.", idx,
+         cat.collType, cat.nBytes, times[idx]);
+    if (times[idx] < minTime * tunerProfileFactor) {
+      minTime = times[idx];
       bestCommIdx = idx;
     }
   }
@@ -341,58 +666,339 @@ static flagcxResult_t findBestComm(struct flagcxTunerContext *ctx,
        cat.collType, cat.nBytes, bestCommIdx, msg.str().c_str());
 
   ctx->collBestCommMap[cat] = bestCommIdx;
+  ctx->dbBestCommMap[cat] = bestCommIdx;
+  // A failed write only costs a search in the next run
+  (void)tunerDbSave(ctx);
   return flagcxSuccess;
 }
 
+// Find the best communicator for a collective category based on profiling
+// data. Only configs profiled on every rank are considered.
+static flagcxResult_t findBestComm(struct flagcxTunerContext *ctx,
+                                   const struct TunerCollCategory &cat) {
+  FLAGCXCHECK(waitAgreement(ctx));
+  std::vector<float> &times = ctx->collTimeMap[cat];
+  collectLocalTimes(ctx, cat, times);
+  FLAGCXCHECK(agreeTimes(times));
+  return selectBestComm(ctx, cat);
+}
+
+// Whether a pooled communicator is the best communicator of some category
+static bool isBestComm(flagcxComm_t comm, flagcxInnerComm_t innerComm) {
+  for (const auto &item : comm->homoBestCommMap) {
+    if (item.second == innerComm) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Get the communicator of config idx from the pool, creating it if needed.
+// Every rank sees the same sequence of collectives, so they all create and
+// evict the same communicators in the same order.
+static flagcxResult_t getPooledComm(flagcxComm_t comm,
+                                    struct flagcxTunerContext *ctx, int idx,
+                                    flagcxInnerComm_t *innerComm) {
+  auto it = comm->homoCommPool.find(idx);
+  if (it != comm->homoCommPool.end()) {
+    ctx->commPoolLru.remove(idx);
+    ctx->commPoolLru.push_front(idx);
+    *innerComm = it->second;
+    return flagcxSuccess;
+  }
+
+  // Communicator init uses the bootstrap
+  FLAGCXCHECK(waitAgreement(ctx));
+  FLAGCXCHECK(flagcxReleaseHomoComms(comm, false));
+  // Best communicators are never evicted, so the pool may grow beyond its
+  // size if there are more of them. Evicted ones may still have ops in an
+  // open group or in flight, they are only destroyed once those are done.
+  auto victim = ctx->commPoolLru.end();
+  while (comm->homoCommPool.size() >= ctx->commPoolSize &&
+         victim != ctx->commPoolLru.begin()) {
+    --victim;
+    if (isBestComm(comm, comm->homoCommPool[*victim])) {
+      continue;
+    }
+    FLAGCXCHECK(flagcxRetireHomoCommByTag(comm, *victim));
+    victim = ctx->commPoolLru.erase(victim);
+  }
+  FLAGCXCHECK(flagcxCreateHomoCommForTag(comm, idx));
+  ctx->commPoolLru.push_front(idx);
+  *innerComm = comm->homoCommPool[idx];
+  return flagcxSuccess;
+}
+
+// Make the communicator of the config searched at seqId the one collCat
+// uses. Switching configs only swaps pointers once the pool holds them.
 flagcxResult_t flagcxCreateOrReplaceHomoComm(
     flagcxComm_t *comm, struct flagcxTunerContext *ctx, uint32_t seqId,
     const struct TunerCollCategory &collCat, bool createBest) {
-
-  // If a communicator has already been created for the corresponding collCat in
-  // comm->homoCommMap, delete it before creating a new one to ensure that each
-  // collCat has only one communicator.
-  auto it = (*comm)->homoCommMap.find(collCat);
-  if (it != (*comm)->homoCommMap.end()) {
-    // Destroy Comm of collCat
-    FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->commDestroy(it->second));
-    // Remove entry from map
-    (*comm)->homoCommMap.erase(it);
-  }
-
-  uint32_t nConfigs = 0;
-  uint32_t idx = getCommIdxFromSeqId(ctx, seqId);
-  struct flagcxCommTag tag = {""};
-  FLAGCXCHECK(flagcxTunerSetCandidate((*comm)->tunerContext, idx, &tag));
-  FLAGCXCHECK(
-      (*comm)->tuner->getCandidateNumber((*comm)->tunerContext, &nConfigs));
+  int idx = getCommIdxFromSeqId(ctx, seqId);
+  if (idx == -1) {
+    WARN("No active communicator found for seqId=%u.", seqId);
+    return flagcxInternalError;
+  }
   if (createBest) {
-    INFO(FLAGCX_INIT | FLAGCX_TUNING,
-         "create the communicator of the best Config (CommId = %d)",
-         ctx->collBestCommMap[collCat]);
-  } else {
-    INFO(FLAGCX_INIT | FLAGCX_TUNING,
-         "start to prepare communicator tag=%s(%u/%u)", tag.tag, idx, nConfigs);
+    INFO(FLAGCX_TUNING, "use the communicator of the best Config (CommId = %d)",
+         idx);
   }
-
   flagcxInnerComm_t innerComm = NULL;
-  FLAGCXCHECK(flagcxHomoCommInit(
-      (*comm)->commId, (*comm)->uniqueIdData,
-      (struct bootstrapState *)((*comm)->tuner->bootstrap), *comm, &innerComm));
-  // Store new communicator of collCat into homoCommMap
+  FLAGCXCHECK(getPooledComm(*comm, ctx, idx, &innerComm));
   (*comm)->homoCommMap[collCat] = innerComm;
   // For backward compatible, also assign homo_comm field.
   (*comm)->homo_comm = innerComm;
   return flagcxSuccess;
 }
 
+// Whether the best communicator of a collective category is known and created
+static bool hasBestComm(flagcxComm_t comm,
+                        const struct TunerCollCategory &cat) {
+  auto it = comm->homoBestCommMap.find(cat);
+  return it != comm->homoBestCommMap.end() && it->second != nullptr;
+}
+
+// Make bestCommIdx the best communicator of a collective category that is not
+// searched. Shares the communicator of a category of the same collective with
+// that config, or takes it from the pool if no such category has one yet.
+static flagcxResult_t setBestComm(flagcxComm_t *comm,
+                                  struct flagcxTunerContext *ctx,
+                                  const struct TunerCollCategory &collCat,
+                                  int bestCommIdx) {
+  ctx->collSeqMap[collCat] = ctx->searchNLoops * ctx->activeCommList.size();
+  ctx->collBestCommMap[collCat] = bestCommIdx;
+  for (const auto &item : ctx->collBestCommMap) {
+    if (item.first.collType == collCat.collType &&
+        item.second == bestCommIdx && hasBestComm(*comm, item.first)) {
+      (*comm)->homoBestCommMap[collCat] = (*comm)->homoBestCommMap[item.first];
+      return flagcxSuccess;
+    }
+  }
+  FLAGCXCHECK(flagcxCreateOrReplaceHomoComm(
+      comm, ctx, getSeqIdForCommIdx(ctx, bestCommIdx, 0), collCat, true));
+  (*comm)->homoBestCommMap[collCat] = (*comm)->homoCommMap[collCat];
+  return flagcxSuccess;
+}
+
+// Estimate the best config for a size between two searched buckets by
+// interpolating the profiled time of every config linearly in log(size).
+// Returns -1 if no config was profiled in both buckets.
+static int interpolateBestComm(struct flagcxTunerContext *ctx,
+                               const struct TunerCollCategory &lo,
+                               const struct TunerCollCategory &hi,
+                               size_t nBytes) {
+  const std::vector<float> &loTimes = ctx->collTimeMap[lo];
+  const std::vector<float> &hiTimes = ctx->collTimeMap[hi];
+  double w = (logSize(nBytes) - logSize(lo.nBytes)) /
+             (logSize(hi.nBytes) - logSize(lo.nBytes));
+  int bestCommIdx = -1;
+  float minTime = FLT_MAX;
+  for (const auto &idx : ctx->activeCommList) {
+    if ((size_t)idx >= loTimes.size() || (size_t)idx >= hiTimes.size() ||
+        loTimes[idx] <= 0 || hiTimes[idx] <= 0) {
+      continue;
+    }
+    float time = loTimes[idx] + w * (hiTimes[idx] - loTimes[idx]);
+    if (time < minTime * tunerProfileFactor) {
+      minTime = time;
+      bestCommIdx = idx;
+    }
+  }
+  return bestCommIdx;
+}
+
+// Choose the config of a size bucket seen for the first time without
+// searching it, from the buckets of the same collective that were searched.
+// Every rank sees the same sequence of collectives and the same averaged
+// profiling data, so they all take the same decision.
+// A bucket is searched (*borrowed = false) while the search budget of the
+// collective is not spent, unless the searched buckets around it agree on
+// their best config. Otherwise it takes the config of the nearest searched
+// bucket, interpolated between the two around it when there are two. If no
+// bucket has finished searching yet, it follows the nearest one until it has.
+static flagcxResult_t borrowSizeBucket(flagcxComm_t *comm,
+                                       struct flagcxTunerContext *ctx,
+                                       const struct TunerCollCategory &collCat,
+                                       bool *borrowed) {
+  const struct TunerCollCategory *lo = NULL, *hi = NULL, *nearest = NULL;
+  double nearestDist = DBL_MAX;
+  for (const auto &item : ctx->collSeqMap) {
+    const struct TunerCollCategory &cat = item.first;
+    if (cat.collType != collCat.collType ||
+        ctx->collFollowMap.count(cat) != 0) {
+      continue;
+    }
+    if (!hasBestComm(*comm, cat)) {
+      double dist = std::fabs(logSize(cat.nBytes) - logSize(collCat.nBytes));
+      if (dist < nearestDist) {
+        nearestDist = dist;
+        nearest = &cat;
+      }
+      continue;
+    }
+    // collSeqMap is ordered by size within a collective
+    if (cat.nBytes < collCat.nBytes) {
+      lo = &cat;
+    } else if (hi == NULL) {
+      hi = &cat;
+    }
+  }
+
+  const uint32_t window = ctx->searchNLoops * ctx->activeCommList.size();
+  bool neighborsAgree = lo != NULL && hi != NULL &&
+                        ctx->collBestCommMap[*lo] == ctx->collBestCommMap[*hi];
+  *borrowed = ctx->collSearchCount[collCat.collType] >= ctx->maxSearchBuckets ||
+              neighborsAgree;
+  if (!*borrowed) {
+    return flagcxSuccess;
+  }
+  ctx->collSeqMap[collCat] = window;
+
+  if (lo == NULL && hi == NULL) {
+    ctx->collFollowMap[collCat] = *nearest;
+    INFO(FLAGCX_TUNING, "Size bucket (coll=%d,size=%zu) follows size %zu.",
+         collCat.collType, collCat.nBytes, nearest->nBytes);
+    return flagcxSuccess;
+  }
+
+  int bestCommIdx = -1;
+  if (neighborsAgree) {
+    bestCommIdx = ctx->collBestCommMap[*lo];
+  } else if (lo != NULL && hi != NULL) {
+    bestCommIdx = interpolateBestComm(ctx, *lo, *hi, collCat.nBytes);
+  }
+  if (bestCommIdx == -1) {
+    double x = logSize(collCat.nBytes);
+    bool useLo = hi == NULL || (lo != NULL && x - logSize(lo->nBytes) <=
+                                                  logSize(hi->nBytes) - x);
+    bestCommIdx = ctx->collBestCommMap[useLo ? *lo : *hi];
+  }
+  INFO(FLAGCX_TUNING,
+       "Size bucket (coll=%d,size=%zu) uses CommId=%d without searching.",
+       collCat.collType, collCat.nBytes, bestCommIdx);
+  return setBestComm(comm, ctx, collCat, bestCommIdx);
+}
+
+// Whether a call is timed while its category is searched. Only the round
+// read by collectLocalTimes is, so that no record is left behind in the timer
+// when a category is searched again.
+static bool isSearchSample(const struct flagcxTunerContext *ctx,
+                           uint32_t seqId) {
+  const uint32_t profileDataRound =
+      std::min<uint32_t>(PROFILE_ROUND, ctx->searchNLoops - 1);
+  return seqId < ctx->searchNLoops * ctx->activeCommList.size() &&
+         seqId % ctx->searchNLoops == profileDataRound;
+}
+
+// Whether a call of a category using its best config is timed for checkDrift
+static bool isDriftSample(const struct flagcxTunerContext *ctx,
+                          const struct TunerCollCategory &cat,
+                          uint32_t seqId) {
+  auto it = ctx->driftMap.find(cat);
+  if (it == ctx->driftMap.end()) {
+    return false;
+  }
+  uint32_t offset = seqId - it->second.start;
+  return offset % ctx->retuneInterval == 0 &&
+         offset / ctx->retuneInterval < ctx->retuneSamples;
+}
+
+// Search a category again from its first config. Its current best
+// communicator stays pinned in the pool until the search ends.
+static void startRetune(struct flagcxTunerContext *ctx,
+                        const struct TunerCollCategory &cat) {
+  ctx->retune.active = true;
+  ctx->retune.cat = cat;
+  ctx->retune.count++;
+  ctx->collSeqMap[cat] = 0;
+  ctx->driftMap.erase(cat);
+  if (ctx->retune.count >= ctx->retuneBudget) {
+    // no sampling is needed once no search can be started
+    ctx->driftMap.clear();
+  }
+}
+
+// Called on every call of a category that uses its best config. Each period
+// of retuneInterval * retuneSamples calls, the median of the samples timed
+// in that period is taken on every rank and the maximum over ranks compared
+// with the first period's. The periods are counted in calls of the category,
+// so every rank checks at the same call and takes the same decision. The
+// check is made one interval after the last sample, which has most likely
+// completed by then. Sets *retune if the category is to be searched again.
+static flagcxResult_t checkDrift(struct flagcxTunerContext *ctx,
+                                 const struct TunerCollCategory &cat,
+                                 uint32_t seqId, bool *retune) {
+  *retune = false;
+  if (ctx->retuneInterval == 0 || ctx->retune.count >= ctx->retuneBudget) {
+    return flagcxSuccess;
+  }
+  auto it = ctx->driftMap.find(cat);
+  if (it == ctx->driftMap.end()) {
+    ctx->driftMap[cat].start = seqId;
+    return flagcxSuccess;
+  }
+  struct TunerDriftState &drift = it->second;
+  if (seqId - drift.start < ctx->retuneInterval * ctx->retuneSamples) {
+    return flagcxSuccess;
+  }
+
+  std::vector<float> samples;
+  uint32_t commIdx = ctx->collBestCommMap[cat];
+  for (uint32_t i = 0; i < ctx->retuneSamples; i++) {
+    TunerProfileKey profileKey(cat.nBytes, static_cast<uint32_t>(cat.collType),
+                               drift.start + i * ctx->retuneInterval, commIdx);
+    struct flagcxRecordKey<TunerProfileKey> rkey(profileKey);
+    float duration = ctx->timer.getRecord(rkey, true);
+    if (duration > 0) {
+      samples.push_back(duration);
+    }
+  }
+  // FLT_MAX makes a rank without samples skip this period on every rank
+  std::vector<float> time(1, FLT_MAX);
+  if (!samples.empty()) {
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                     samples.end());
+    time[0] = samples[samples.size() / 2];
+  }
+  FLAGCXCHECK(waitAgreement(ctx));
+  FLAGCXCHECK(agreeTimes(time));
+  drift.start = seqId;
+  if (time[0] == FLT_MAX) {
+    return flagcxSuccess;
+  }
+  if (drift.baseline < 0) {
+    drift.baseline = time[0];
+    INFO(FLAGCX_TUNING, "Baseline of (coll=%d,size=%zu) CommId=%u is %.3fms.",
+         cat.collType, cat.nBytes, commIdx, drift.baseline);
+    return flagcxSuccess;
+  }
+  if (time[0] <= drift.baseline * (1.0f + ctx->retuneThreshold / 100.0f)) {
+    return flagcxSuccess;
+  }
+  if (ctx->retune.active) {
+    // one category is searched at a time, try again next period
+    return flagcxSuccess;
+  }
+  INFO(FLAGCX_TUNING,
+       "(coll=%d,size=%zu) CommId=%u drifted from %.3fms to %.3fms, searching "
+       "again (%u/%u).",
+       cat.collType, cat.nBytes, commIdx, drift.baseline, time[0],
+       ctx->retune.count + 1, ctx->retuneBudget);
+  startRetune(ctx, cat);
+  *retune = true;
+  return flagcxSuccess;
+}
+
 // Communicator selection logic:
 // 1) Honor environment override when ctx->envTagIdx is set.
 // 2) Otherwise, for the initial searchNLoops * activeCommCount invocations of
-//    each {collType, nBytes}, cycle through ctx->activeCommList via seqId
-//    (tuning phase).
+//    each {collType, size bucket}, cycle through ctx->activeCommList via seqId
+//    (tuning phase). Buckets beyond the search budget skip this phase, see
+//    borrowSizeBucket.
 // 3) After the tuning window, rely on the best communicator recorded in
 //    ctx->collBestCommMap (populated via profiling). If no best entry exists,
-//    return flagcxInternalError.
+//    return flagcxInternalError. A category whose best communicator slows
+//    down goes back to 2), see checkDrift.
 flagcxResult_t flagcxTunerGetCollInfo(void *context, flagcxCommOp_t collType,
                                       size_t nBytes, int numPipeOps,
                                       float **collCostTable, int regBuff,
@@ -410,17 +1016,65 @@ flagcxResult_t flagcxTunerGetCollInfo(void *context, flagcxCommOp_t collType,
     return flagcxSuccess;
   }
 
-  // get a seqId for {collType, nBytes}
-  struct TunerCollCategory collCat = {collType, nBytes};
+  // get a seqId for {collType, size bucket}
+  struct TunerCollCategory collCat = {collType, getSizeBucket(ctx, nBytes)};
+  nBytes = collCat.nBytes;
   auto it = ctx->collSeqMap.find(collCat);
   uint32_t seqId = 0;
   if (it == ctx->collSeqMap.end()) {
-    ctx->collSeqMap[collCat] = 0;
+    bool borrowed = false;
+    auto dit = ctx->dbBestCommMap.find(collCat);
+    if (dit != ctx->dbBestCommMap.end()) {
+      INFO(FLAGCX_TUNING,
+           "Use (coll=%d,size=%zu) best CommId=%d from the tuner DB.",
+           collType, nBytes, dit->second);
+      FLAGCXCHECK(setBestComm(comm, ctx, collCat, dit->second));
+      borrowed = true;
+    } else {
+      FLAGCXCHECK(borrowSizeBucket(comm, ctx, collCat, &borrowed));
+    }
+    if (borrowed) {
+      seqId = ctx->collSeqMap[collCat];
+    } else {
+      ctx->collSeqMap[collCat] = 0;
+      ctx->collSearchCount[collType]++;
+    }
   } else {
     it->second++;
     seqId = it->second;
   }
 
+  auto fit = ctx->collFollowMap.find(collCat);
+  if (fit != ctx->collFollowMap.end()) {
+    const struct TunerCollCategory target = fit->second;
+    if (!hasBestComm(*comm, target)) {
+      // Use whichever config the followed bucket is being profiled with
+      uint32_t window = ctx->searchNLoops * ctx->activeCommList.size();
+      uint32_t targetSeqId = std::min(ctx->collSeqMap[target], window - 1);
+      const auto &cfg =
+          ctx->configList[getCommIdxFromSeqId(ctx, targetSeqId)];
+      FLAGCXCHECK(setEnvConfig(cfg, FLAGCX_ENV_TYPE_COLL));
+      *commTag = cfg.commTag;
+      FLAGCXCHECK(flagcxCreateOrReplaceHomoComm(comm, ctx, targetSeqId,
+                                                collCat, false));
+      (*comm)->tunerInnerComm = (*comm)->homoCommMap[collCat];
+      ctx->collSeqMap[collCat] = window;
+      return flagcxSuccess;
+    }
+    ctx->collBestCommMap[collCat] = ctx->collBestCommMap[target];
+    (*comm)->homoBestCommMap[collCat] = (*comm)->homoBestCommMap[target];
+    ctx->collFollowMap.erase(fit);
+  }
+
+  bool retuning = ctx->retune.active && !(ctx->retune.cat < collCat) &&
+                  !(collCat < ctx->retune.cat);
+  if (hasBestComm(*comm, collCat) && !retuning) {
+    FLAGCXCHECK(checkDrift(ctx, collCat, seqId, &retuning));
+    if (retuning) {
+      seqId = 0;
+    }
+  }
+
   if (seqId < ctx->searchNLoops * ctx->activeCommList.size()) {
 
     // Every {collType, nBytes, commTagIdx} will be profiled searchNLoops times.
@@ -429,20 +1083,10 @@ flagcxResult_t flagcxTunerGetCollInfo(void *context, flagcxCommOp_t collType,
       WARN("No active communicator found for startup phase seqId=%u.", seqId);
       return flagcxInternalError;
     }
-    TunerCommTagCounterKey key{nBytes, static_cast<uint32_t>(collType),
-                               static_cast<uint32_t>(cfgIdx)};
-    auto cit = ctx->configCounterMap.find(key);
-    if (cit == ctx->configCounterMap.end()) {
-      // create a new communicator and destroy old communicator
-      FLAGCXCHECK(
-          flagcxCreateOrReplaceHomoComm(comm, ctx, seqId, collCat, false));
-      (*comm)->tunerInnerComm = (*comm)->homoCommMap[collCat];
-      ctx->configCounterMap[key] = 1;
-    } else {
-      // use old communicator
-      (*comm)->tunerInnerComm = (*comm)->homoCommMap[collCat];
-      ctx->configCounterMap[key]++;
-    }
+    // the pool creates the communicator of a config on its first use
+    FLAGCXCHECK(
+        flagcxCreateOrReplaceHomoComm(comm, ctx, seqId, collCat, false));
+    (*comm)->tunerInnerComm = (*comm)->homoCommMap[collCat];
     const auto &cfg = ctx->configList[cfgIdx];
     *commTag = cfg.commTag;
     FLAGCXCHECK(setEnvConfig(cfg, FLAGCX_ENV_TYPE_COLL));
@@ -451,10 +1095,31 @@ flagcxResult_t flagcxTunerGetCollInfo(void *context, flagcxCommOp_t collType,
 
   // Select a communicator from active communicators based on profiling data
   // after searchNLoops * activeCommCount collectives. If we do not have a best
-  // communicator recorded for this collective category, find it.
-  if ((*comm)->homoBestCommMap[collCat] == nullptr) {
+  // communicator recorded for this collective category, or it is searched
+  // again, find it.
+  if (!hasBestComm(*comm, collCat) || retuning) {
+    uint32_t window = ctx->searchNLoops * ctx->activeCommList.size();
+    if (seqId < window + ctx->agreeLag) {
+      // Agree on the best config in the background and keep the last
+      // searched communicator until the agreement is due
+      if (seqId == window) {
+        FLAGCXCHECK(startAgreement(ctx, collCat));
+      }
+      const auto &cfg = ctx->configList[getCommIdxFromSeqId(ctx, window - 1)];
+      FLAGCXCHECK(setEnvConfig(cfg, FLAGCX_ENV_TYPE_COLL));
+      *commTag = cfg.commTag;
+      FLAGCXCHECK(
+          flagcxCreateOrReplaceHomoComm(comm, ctx, window - 1, collCat, false));
+      (*comm)->tunerInnerComm = (*comm)->homoCommMap[collCat];
+      return flagcxSuccess;
+    }
     // Find the best config
-    FLAGCXCHECK(findBestComm(ctx, collCat));
+    if (ctx->agreeLag > 0) {
+      FLAGCXCHECK(waitAgreement(ctx));
+      FLAGCXCHECK(selectBestComm(ctx, collCat));
+    } else {
+      FLAGCXCHECK(findBestComm(ctx, collCat));
+    }
     // Check whether the optimal config has been found; if not, return an error.
     auto it2 = ctx->collBestCommMap.find(collCat);
     if (it2 == ctx->collBestCommMap.end()) {
@@ -462,7 +1127,7 @@ flagcxResult_t flagcxTunerGetCollInfo(void *context, flagcxCommOp_t collType,
            collType, nBytes);
       return flagcxInternalError;
     }
-    // If the optimal config has been found, create a communicator of best
+    // If the optimal config has been found, use the communicator of the best
     // config
     const uint32_t profileDataRound = PROFILE_ROUND;
     uint32_t bestSeqId = getSeqIdForCommIdx(
@@ -475,8 +1140,12 @@ flagcxResult_t flagcxTunerGetCollInfo(void *context, flagcxCommOp_t collType,
     FLAGCXCHECK(setEnvConfig(cfg, FLAGCX_ENV_TYPE_COLL));
     *commTag = cfg.commTag;
     (*comm)->tunerInnerComm = (*comm)->homoCommMap[collCat];
-    // Store the best communicator of collCat into homoBestCommMap
+    // Store the best communicator of collCat into homoBestCommMap, which
+    // keeps it in the pool. A previous best one is unpinned.
     (*comm)->homoBestCommMap[collCat] = (*comm)->homoCommMap[collCat];
+    if (retuning) {
+      ctx->retune.active = false;
+    }
   } else {
     // The best communicator has been created
     // get it in collBestCommMap directly
@@ -503,7 +1172,8 @@ flagcxResult_t flagcxTunerStartProfiling(void *context, flagcxCommOp_t collType,
                                          struct flagcxProfileKey *key) {
   struct flagcxTunerContext *ctx =
       static_cast<struct flagcxTunerContext *>(context);
-  struct TunerCollCategory collCat = {collType, nBytes};
+  struct TunerCollCategory collCat = {collType, getSizeBucket(ctx, nBytes)};
+  nBytes = collCat.nBytes;
 
   auto it = ctx->collSeqMap.find(collCat);
   uint32_t seqId = 0;
@@ -533,8 +1203,8 @@ flagcxResult_t flagcxTunerStartProfiling(void *context, flagcxCommOp_t collType,
   */
   *key = profileKey;
 
-  // do profile only for startup collectives
-  if (seqId < ctx->searchNLoops * ctx->activeCommList.size()) {
+  // do profile only for startup collectives and drift samples
+  if (isSearchSample(ctx, seqId) || isDriftSample(ctx, collCat, seqId)) {
     struct flagcxRecordKey<TunerProfileKey> rkey(profileKey);
     FLAGCXCHECK(ctx->timer.begin(rkey, stream));
   }
@@ -556,8 +1226,11 @@ flagcxResult_t flagcxTunerStopProfiling(void *context,
   (commId=%d,coll=%d,size=%zu,seq=%u).", profileKey.commTagIdx,
   profileKey.collType, profileKey.nBytes, profileKey.seqId);
   */
-  // do profile only for startup collectives
-  if (profileKey.seqId < ctx->searchNLoops * ctx->activeCommList.size()) {
+  // do profile only for startup collectives and drift samples
+  struct TunerCollCategory collCat = {(flagcxCommOp_t)profileKey.collType,
+                                      profileKey.nBytes};
+  if (isSearchSample(ctx, profileKey.seqId) ||
+      isDriftSample(ctx, collCat, profileKey.seqId)) {
     struct flagcxRecordKey<TunerProfileKey> rkey(profileKey);
     FLAGCXCHECK(ctx->timer.end(rkey));
   }
@@ -574,18 +1247,18 @@ flagcxResult_t flagcxTunerDestroy(void *context) {
       static_cast<struct flagcxTunerContext *>(context);
   // INFO(FLAGCX_TUNING, "Enter flagcxTunerDestroy.");
 
+  // the bootstrap must not be closed under a running agreement
+  flagcxResult_t res = waitAgreement(ctx);
   // stop timer
   ctx->timer.stop();
-  free(internalTuner.profilingResults);
   delete ctx;
-  return flagcxSuccess;
+  return res;
 }
 
 flagcxTuner_t internalTuner = {"internal tuner",
                                NULL, // assigned during flagcxCommInit
                                0,    // assigned during flagcxCommInit
                                0,    // assigned during flagcxCommInit
-                               NULL, // initialized during tunerInit
                                flagcxTunerInit,
                                flagcxTunerGetCandidateNumber,
                                flagcxTunerSetCandidate,
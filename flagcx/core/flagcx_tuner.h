@@ -6,7 +6,7 @@
 // A category of collective operation. the minimal unit for tuning.
 struct TunerCollCategory {
   flagcxCommOp_t collType;
-  size_t nBytes;
+  size_t nBytes; // lower bound of the size bucket
 };
 
 bool operator<(const struct TunerCollCategory &lhs,
@@ -21,7 +21,6 @@ struct flagcxTuner {
   int rank;
   int nranks;
 
-  float *profilingResults;
   // Initializes tuner states.
   // Inputs:
   //   - nRanks: number of ranks in current communicator. Each communicator
@@ -102,7 +101,8 @@ struct flagcxTuner {
   // Terminates the tuner and cleans up any resources that the tuner allocated.
   flagcxResult_t (*destroy)(void *context);
 
-  // Create/destroy communicator
+  // Switch the communicator a category uses to that of another config,
+  // created on first use and kept in a pool
   flagcxResult_t (*createOrReplaceHomoComm)(
       flagcxComm_t *comm, struct flagcxTunerContext *ctx, uint32_t seqId,
       const struct TunerCollCategory &collCat, bool createBest);
@@ -119,7 +119,8 @@ extern flagcxTuner_t internalTuner;
 
 // On-demand communicator lifecycle helpers implemented in flagcx/flagcx.cc
 flagcxResult_t flagcxCreateHomoCommForTag(flagcxComm_t comm, uint32_t idx);
-flagcxResult_t flagcxDestroyHomoCommByTag(flagcxComm_t comm, uint32_t idx);
+flagcxResult_t flagcxRetireHomoCommByTag(flagcxComm_t comm, uint32_t idx);
+flagcxResult_t flagcxReleaseHomoComms(flagcxComm_t comm, bool wait);
 
 #define FLAGCXCALLWITHTUNER(call, comm, commOp, count, datatype, stream)       \
   do {                                                                         \
@@ -132,6 +133,7 @@ flagcxResult_t flagcxDestroyHomoCommByTag(flagcxComm_t comm, uint32_t idx);
     FLAGCXCHECK(comm->tuner->startProfiling(comm->tunerContext, commOp,        \
                                             nBytes, stream, &tag, &pkey));     \
     FLAGCXCHECK(call);                                                         \
+    comm->homoCommStreams[comm->tunerInnerComm].insert(stream);                \
     FLAGCXCHECK(comm->tuner->stopProfiling(comm->tunerContext, &pkey));        \
     return flagcxSuccess;                                                      \
   } while (0);
@@ -2,10 +2,12 @@
 #define FLAGCX_GLOBAL_COMM_H_
 
 #include "bootstrap.h"
+#include "config.h"
 #include "flagcx.h"
 #include "flagcx_tuner.h"
 
 #include <map>
+#include <set>
 #include <vector>
 
 /* Opaque handle to flagcxInnerComm */
@@ -20,6 +22,15 @@ typedef enum {
   flagcxCommunicatorHybrid = 2 // Hybrid Communicator
 } flagcxCommunicatorType_t;
 
+// Pooled homo communicator evicted by the tuner. It is destroyed once the
+// events recorded on the streams it was used on have completed; they are
+// recorded when it is retired, or at group end if a group was open then.
+struct flagcxRetiredHomoComm {
+  flagcxInnerComm_t comm;
+  std::vector<flagcxStream_t> streams;
+  std::vector<flagcxEvent_t> events;
+};
+
 struct flagcxComm {
   // TODO: adjust code format
   int rank;
@@ -41,6 +52,11 @@ struct flagcxComm {
   flagcxInnerComm_t host_comm;
   flagcxInnerComm_t homo_comm;
   flagcxHeteroComm_t hetero_comm;
+  uint64_t interClusterMsgs;  // hetero sends to other clusters
+  uint64_t interClusterBytes; // and their payload
+  void *gatherScratch;        // cluster block of hierarchical gathers
+  size_t gatherScratchSize;
+  flagcxEvent_t gatherScratchEvent; // recorded after its last use
   flagcxInnerComm_t homoInterComm;
   // experimental for multi-nic support
   int homoInterRootRank;
@@ -50,13 +66,21 @@ struct flagcxComm {
   std::vector<flagcxVendorType> clusterVendorMap;
   struct flagcxTuner *tuner;
   void *tunerContext;
+  std::map<uint32_t, flagcxInnerComm_t>
+      homoCommPool; // live communicators of the tuner, key: config index
   std::map<struct TunerCollCategory, flagcxInnerComm_t>
-      homoCommMap; // key: commTag returned by tuner
+      homoCommMap; // communicator last used by each category, from the pool
   std::map<struct TunerCollCategory, flagcxInnerComm_t>
-      homoBestCommMap;              // key: commTag returned by tuner
+      homoBestCommMap;              // best communicator, from the pool
+  std::map<flagcxInnerComm_t, std::set<flagcxStream_t>>
+      homoCommStreams; // streams each pooled communicator was used on
+  std::vector<struct flagcxRetiredHomoComm>
+      homoCommRetired; // evicted from the pool, waiting for their ops
+  int groupDepth;      // open flagcxGroupStart calls
   flagcxInnerComm_t tunerInnerComm; // innerComm selected by tuner
   flagcxUniqueId_t commId;
   flagcxUniqueId *uniqueIdData;
+  struct flagcxConfig config; // settings snapshot, see config.h
 };
 
 #endif // end include guard
@@ -12,6 +12,7 @@
 #include "launch_kernel.h"
 #include "net.h"
 #include "p2p.h"
+#include "timeline.h"
 #include "transport.h"
 #include "type.h"
 #include <pthread.h>
@@ -78,11 +79,29 @@ void *flagcxAsyncJobMain(void *arg) {
   return arg;
 }
 
+// Take the flags and event of a device func op from the comm's pool, which
+// the proxy gives them back to once the op has completed
+static flagcxResult_t getFuncPoolSlot(struct flagcxHeteroComm *comm,
+                                      struct flagcxProxyOp *op) {
+  if (comm->funcPool == NULL) {
+    FLAGCXCHECK(flagcxFuncPoolCreate(&comm->funcPool));
+  }
+  bool *flags;
+  FLAGCXCHECK(flagcxFuncPoolGet(comm->funcPool, op->stream, &op->funcSlot,
+                                &flags, &op->event));
+  op->funcPool = comm->funcPool;
+  op->args.dlArgs = flags;
+  op->args.dEventReady = flags + 1;
+  return flagcxSuccess;
+}
+
 static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
   flagcxResult_t ret = flagcxSuccess;
   // bool errorJobAbortFlag = false;
   struct flagcxGroupJob *gjob = (struct flagcxGroupJob *)job_;
   struct flagcxHeteroComm *groupCommHeadMain = *gjob->groupCommHeadPtr;
+  TIMELINE_SCOPE("group", "groupLaunch", "rank",
+                 groupCommHeadMain ? groupCommHeadMain->rank : -1, NULL, 0);
 
   struct flagcxHeteroComm *groupCommPreconnectHeadMain =
       *gjob->groupCommPreconnectHeadPtr;
@@ -98,16 +117,8 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
   std::queue<std::vector<void *>> argsQueue;
   // When relaxed ordering is enabled, the H2D copy is issued on cpStream
   // Otherwise, it shares commStream with the device function to guarantee
-  // execution order
-  int deviceFuncRelaxedOrdering = 0;
-  const char *dfroStr = std::getenv("FLAGCX_DEVICE_FUNC_RELAXED_ORDERING");
-  if (dfroStr) {
-    if (std::stoi(dfroStr) == 1) {
-      deviceFuncRelaxedOrdering = 1;
-    } else {
-      deviceFuncRelaxedOrdering = 0;
-    }
-  }
+  // execution order. Each comm of the group follows its own setting.
+  std::queue<int> orderingQueue;
 
   // Each groupLaunch we create a semaphore to track the p2p ops
   // and a stream to launch host or device func
@@ -179,7 +190,8 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
             op->args.chunkSize = CHUNKSIZE;
             op->args.chunkSteps = (p2p->bytes + CHUNKSIZE - 1) / (CHUNKSIZE);
             op->args.sendStepMask = MAXSTEPS - 1;
-            op->args.deviceFuncRelaxedOrdering = deviceFuncRelaxedOrdering;
+            op->args.deviceFuncRelaxedOrdering =
+                comm->deviceFuncRelaxedOrdering;
             op->stream = p2p->stream;
             if (op->connection->transport == TRANSPORT_P2P) {
               setP2pSlotInfo(comm->rank, peer, p2p->bytes, p2p->dtype, 0,
@@ -206,16 +218,9 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
             }
             // we don't use semaphore tracking for device func for the moment
             if (deviceAsyncLoad && deviceAsyncStore) {
-              FLAGCXCHECK(deviceAdaptor->eventCreate(&op->event,
-                                                     flagcxEventDisableTiming));
-              FLAGCXCHECK(deviceAdaptor->eventRecord(op->event, op->stream));
               std::vector<void *> argList;
-              FLAGCXCHECK(deviceAdaptor->deviceMalloc(
-                  (void **)&op->args.dlArgs, sizeof(bool), flagcxMemDevice,
-                  op->stream));
-              FLAGCXCHECK(deviceAdaptor->deviceMalloc(
-                  (void **)&op->args.dEventReady, sizeof(bool), flagcxMemDevice,
-                  op->stream));
+              FLAGCXCHECK(getFuncPoolSlot(comm, op));
+              FLAGCXCHECK(deviceAdaptor->eventRecord(op->event, op->stream));
               FLAGCXCHECK(deviceAdaptor->launchDeviceFunc(
                   op->stream, deviceAsyncStore, op->args.dEventReady));
               FLAGCXCHECK(deviceAdaptor->deviceMemcpy(
@@ -225,6 +230,7 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
                          (void *)&op->args.hlArgs, (void *)op->args.dlArgs};
               funcQueue.push({op->stream, op->event, argList.data()});
               argsQueue.push(std::move(argList));
+              orderingQueue.push(op->args.deviceFuncRelaxedOrdering);
             } else {
               op->args.semaphore = semaphore;
               op->event = semaphore->getEvent();
@@ -258,7 +264,8 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
             op->args.chunkSize = CHUNKSIZE;
             op->args.chunkSteps = (p2p->bytes + CHUNKSIZE - 1) / (CHUNKSIZE);
             op->args.sendStepMask = MAXSTEPS - 1;
-            op->args.deviceFuncRelaxedOrdering = deviceFuncRelaxedOrdering;
+            op->args.deviceFuncRelaxedOrdering =
+                comm->deviceFuncRelaxedOrdering;
             op->stream = p2p->stream;
             if (op->connection->transport == TRANSPORT_P2P) {
               setP2pSlotInfo(comm->rank, peer, p2p->bytes, p2p->dtype, 1,
@@ -285,15 +292,8 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
             // we don't use semaphore tracking for device func for the moment
             if (deviceAsyncLoad && deviceAsyncStore) {
               std::vector<void *> argList;
-              FLAGCXCHECK(deviceAdaptor->eventCreate(&op->event,
-                                                     flagcxEventDisableTiming));
+              FLAGCXCHECK(getFuncPoolSlot(comm, op));
               FLAGCXCHECK(deviceAdaptor->eventRecord(op->event, op->stream));
-              FLAGCXCHECK(deviceAdaptor->deviceMalloc(
-                  (void **)&op->args.dlArgs, sizeof(bool), flagcxMemDevice,
-                  op->stream));
-              FLAGCXCHECK(deviceAdaptor->deviceMalloc(
-                  (void **)&op->args.dEventReady, sizeof(bool), flagcxMemDevice,
-                  op->stream));
               FLAGCXCHECK(deviceAdaptor->launchDeviceFunc(
                   op->stream, deviceAsyncStore, op->args.dEventReady));
               FLAGCXCHECK(deviceAdaptor->deviceMemcpy(
@@ -303,6 +303,7 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
                          (void *)&op->args.hlArgs, (void *)op->args.dlArgs};
               funcQueue.push({op->stream, op->event, argList.data()});
               argsQueue.push(std::move(argList));
+              orderingQueue.push(op->args.deviceFuncRelaxedOrdering);
             } else {
               op->args.semaphore = semaphore;
               op->event = semaphore->getEvent();
@@ -400,7 +401,7 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
       flagcxFuncArgs args = funcQueue.front();
 
       // launch device func
-      if (deviceFuncRelaxedOrdering == 0) {
+      if (orderingQueue.front() == 0) {
         bool *volatile hlArgs = (bool *)args.argList[1];
         while (!__atomic_load_n(hlArgs, __ATOMIC_RELAXED)) {
         }
@@ -419,6 +420,7 @@ static flagcxResult_t groupLaunch(struct flagcxAsyncJob *job_) {
       // pop item
       funcQueue.pop();
       argsQueue.pop();
+      orderingQueue.pop();
     }
   } else {
     if (launchStream != nullptr) {
@@ -8,13 +8,16 @@
 #include "bootstrap.h"
 #include "check.h"
 #include "collectives.h"
+#include "config.h"
 #include "flagcx.h"
 #include "group.h"
+#include "launch_kernel.h"
 #include "net.h"
 #include "topo.h"
 #include "transport.h"
 #include "type.h"
 #include <string.h>
+#include <vector>
 
 static bool initialized = false;
 pthread_mutex_t initLock = PTHREAD_MUTEX_INITIALIZER;
@@ -79,6 +82,7 @@ static flagcxResult_t fillPeerInfo(flagcxHeteroComm_t comm,
   info->hostHash = getHostHash() + commHash;
   info->pidHash = getPidHash() + commHash;
   info->busId = comm->busId;
+  info->shmDomain = flagcxNetShmDomain();
   info->comm = comm;
 
   return flagcxSuccess;
@@ -104,6 +108,13 @@ static flagcxResult_t initTransportsRank(flagcxHeteroComm_t comm,
                   ret, fail);
   FLAGCXCHECKGOTO(bootstrapBarrier(comm->bootstrap, rank, nranks, 0), ret,
                   fail);
+  {
+    std::vector<uint64_t> shmDomains(nranks);
+    for (int i = 0; i < nranks; i++)
+      shmDomains[i] = comm->peerInfo[i].shmDomain;
+    FLAGCXCHECKGOTO(flagcxNetShmSetDomains(comm, shmDomains.data()), ret,
+                    fail);
+  }
 
   // check for duplicate GPUs
   INFO(FLAGCX_INIT, "start check for duplicate GPUs");
@@ -141,6 +152,43 @@ fail:
   return flagcxInternalError;
 }
 
+// Place the proxy threads and staging buffers next to the NIC. The proxy is
+// usually started before the net device is known and is pinned here.
+static flagcxResult_t flagcxCommInitAffinity(struct flagcxHeteroComm *comm) {
+  flagcxResult_t ret = flagcxSuccess;
+  flagcxNetProperties_v8_t props;
+  const char *pciPath = NULL;
+  uint64_t *hostHashes = NULL;
+  int localRank, localRanks;
+  if (comm->netAdaptor->getProperties(comm->netDev, (void *)&props) ==
+      flagcxSuccess) {
+    pciPath = props.pciPath;
+  }
+  // Cores are split among the ranks of this host; the device index cannot
+  // tell them apart when every rank only sees its own device
+  FLAGCXCHECK(flagcxCalloc(&hostHashes, comm->nRanks));
+  if (comm->peerInfo) {
+    for (int r = 0; r < comm->nRanks; r++)
+      hostHashes[r] = comm->peerInfo[r].hostHash;
+  } else {
+    hostHashes[comm->rank] = getHostHash();
+    FLAGCXCHECKGOTO(
+        bootstrapAllGather(comm->bootstrap, hostHashes, sizeof(uint64_t)), ret,
+        exit);
+  }
+  flagcxAffinityLocalRank(hostHashes, comm->nRanks, comm->rank, &localRank,
+                          &localRanks);
+  FLAGCXCHECKGOTO(
+      flagcxAffinityInit(&comm->affinity, pciPath, localRank, localRanks), ret,
+      exit);
+  if (comm->proxyState && comm->proxyState->initialized) {
+    flagcxProxyBindThreads(comm);
+  }
+exit:
+  free(hostHashes);
+  return ret;
+}
+
 static flagcxResult_t flagcxCommInitRankFunc(struct flagcxAsyncJob *job_) {
   struct flagcxCommInitRankAsyncJob *job =
       (struct flagcxCommInitRankAsyncJob *)job_;
@@ -176,15 +224,11 @@ static flagcxResult_t flagcxCommInitRankFunc(struct flagcxAsyncJob *job_) {
     FLAGCXCHECK(flagcxCalloc(&comm->proxyState, 1));
     FLAGCXCHECK(flagcxCalloc(&comm->tasks.peers, nranks));
     FLAGCXCHECK(flagcxCalloc(&comm->tasks.p2pOrder, 2 * nranks));
-    // Setup mutex/cond to work inter-process
+    // Setup mutex to work inter-process
     pthread_mutexattr_t mutexAttr;
     pthread_mutexattr_init(&mutexAttr);
     pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
     pthread_mutex_init(&comm->proxyState->mutex, &mutexAttr);
-    pthread_condattr_t condAttr;
-    pthread_condattr_init(&condAttr);
-    pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
-    pthread_cond_init(&comm->proxyState->cond, &condAttr);
 
     for (int i = 0; i < MAXCHANNELS; i++) {
       FLAGCXCHECK(
@@ -231,6 +275,7 @@ static flagcxResult_t flagcxCommInitRankFunc(struct flagcxAsyncJob *job_) {
   } else {
     flagcxGetLocalNetFromGpu(comm->cudaDev, &comm->netDev, comm);
   }
+  FLAGCXCHECKGOTO(flagcxCommInitAffinity(comm), res, fail);
 
 exit:
   return res;
@@ -273,6 +318,9 @@ static flagcxResult_t flagcxCommInitRankDev(flagcxHeteroComm_t *newcomm,
   comm->nRanks = nranks;
   comm->rank = myrank;
   comm->cudaDev = cudaDev;
+  comm->deviceFuncRelaxedOrdering =
+      flagcxConfigGet()->deviceFuncRelaxedOrdering;
+  comm->affinity.slot = -1;
   *newcomm = comm;
 
   FLAGCXCHECKGOTO(flagcxCalloc(&job, 1), res, fail);
@@ -322,6 +370,8 @@ flagcxResult_t flagcxHeteroCommUserRank(const flagcxHeteroComm_t comm,
 
 flagcxResult_t flagcxHeteroCommDestroy(flagcxHeteroComm_t comm) {
   flagcxProxyDestroy(comm);
+  flagcxAffinityRelease(&comm->affinity);
+  FLAGCXCHECK(flagcxFuncPoolDestroy(comm->funcPool));
   for (int i = 0; i < MAXCHANNELS; i++) {
     for (int r = 0; r < comm->nRanks; r++) {
       free(comm->channels[i].peers[r]);
@@ -345,6 +395,7 @@ flagcxResult_t flagcxHeteroCommDestroy(flagcxHeteroComm_t comm) {
     flagcxInterServerTopoFree(comm->interServerTopo);
   }
   free(comm->peerInfo);
+  free(comm->shmDomains);
   free(comm);
 
   return flagcxSuccess;
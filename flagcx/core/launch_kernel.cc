@@ -53,4 +53,83 @@ void cpuAsyncKernel(void *args) {
   semaphore->signalStart();
   semaphore->wait();
   semaphore->signalEnd();
-}
\ No newline at end of file
+}
+flagcxResult_t flagcxFuncPoolCreate(struct flagcxFuncPool **pool) {
+  *pool = new flagcxFuncPool();
+  pthread_mutex_init(&(*pool)->mutex, NULL);
+  (*pool)->nEvents = 0;
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxFuncPoolGet(struct flagcxFuncPool *pool,
+                                 flagcxStream_t stream, int *slot,
+                                 bool **flags, flagcxEvent_t *event) {
+  flagcxResult_t ret = flagcxSuccess;
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->freeSlots.empty()) {
+    bool *slab;
+    FLAGCXCHECKGOTO(
+        deviceAdaptor->deviceMalloc((void **)&slab,
+                                    2 * FLAGCX_FUNC_POOL_SLAB * sizeof(bool),
+                                    flagcxMemDevice, NULL),
+        ret, exit);
+    int base = pool->slabs.size() * FLAGCX_FUNC_POOL_SLAB;
+    pool->slabs.push_back(slab);
+    for (int i = FLAGCX_FUNC_POOL_SLAB - 1; i >= 0; i--) {
+      pool->freeSlots.push_back(base + i);
+    }
+    INFO(FLAGCX_ALLOC, "Device func pool grown to %d slots",
+         (int)pool->slabs.size() * FLAGCX_FUNC_POOL_SLAB);
+  }
+  if (pool->freeEvents.empty()) {
+    flagcxEvent_t newEvent;
+    FLAGCXCHECKGOTO(
+        deviceAdaptor->eventCreate(&newEvent, flagcxEventDisableTiming), ret,
+        exit);
+    pool->freeEvents.push_back(newEvent);
+    pool->nEvents++;
+  }
+  *slot = pool->freeSlots.back();
+  pool->freeSlots.pop_back();
+  *event = pool->freeEvents.back();
+  pool->freeEvents.pop_back();
+  *flags = pool->slabs[*slot / FLAGCX_FUNC_POOL_SLAB] +
+           2 * (*slot % FLAGCX_FUNC_POOL_SLAB);
+exit:
+  pthread_mutex_unlock(&pool->mutex);
+  if (ret == flagcxSuccess) {
+    // The previous user of the slot is done with it: its event, recorded
+    // after the load, had completed before the slot was put back
+    FLAGCXCHECK(deviceAdaptor->deviceMemset(*flags, 0, 2 * sizeof(bool),
+                                            flagcxMemDevice, stream));
+  }
+  return ret;
+}
+
+flagcxResult_t flagcxFuncPoolPut(struct flagcxFuncPool *pool, int slot,
+                                 flagcxEvent_t event) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->freeSlots.push_back(slot);
+  pool->freeEvents.push_back(event);
+  pthread_mutex_unlock(&pool->mutex);
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxFuncPoolDestroy(struct flagcxFuncPool *pool) {
+  if (pool == NULL) {
+    return flagcxSuccess;
+  }
+  if ((int)pool->freeEvents.size() != pool->nEvents) {
+    WARN("Device func pool destroyed with %d events in use",
+         pool->nEvents - (int)pool->freeEvents.size());
+  }
+  for (auto event : pool->freeEvents) {
+    FLAGCXCHECK(deviceAdaptor->eventDestroy(event));
+  }
+  for (auto slab : pool->slabs) {
+    FLAGCXCHECK(deviceAdaptor->deviceFree(slab, flagcxMemDevice, NULL));
+  }
+  pthread_mutex_destroy(&pool->mutex);
+  delete pool;
+  return flagcxSuccess;
+}
@@ -13,9 +13,11 @@
 #include <iostream>
 #include <math.h>
 #include <memory.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <vector>
 
 #ifdef __cplusplus
 extern "C" {
@@ -68,4 +70,28 @@ struct flagcxHostSemaphore {
 
 void cpuAsyncKernel(void *args);
 
+// Device flags and events of the device func launch path, recycled across
+// group launches instead of being allocated for every proxy op. Flags are
+// allocated in slabs of FLAGCX_FUNC_POOL_SLAB slots; a slot holds the dlArgs
+// and dEventReady flags of one op. Slots and events are taken by groupLaunch
+// and given back by the proxy thread once the op's event has completed.
+#define FLAGCX_FUNC_POOL_SLAB 64
+
+struct flagcxFuncPool {
+  pthread_mutex_t mutex;
+  std::vector<bool *> slabs;
+  std::vector<int> freeSlots;
+  std::vector<flagcxEvent_t> freeEvents;
+  int nEvents; // events created, free or in use
+};
+
+flagcxResult_t flagcxFuncPoolCreate(struct flagcxFuncPool **pool);
+// Flags are reset to false on stream before they are handed out
+flagcxResult_t flagcxFuncPoolGet(struct flagcxFuncPool *pool,
+                                 flagcxStream_t stream, int *slot,
+                                 bool **flags, flagcxEvent_t *event);
+flagcxResult_t flagcxFuncPoolPut(struct flagcxFuncPool *pool, int slot,
+                                 flagcxEvent_t event);
+flagcxResult_t flagcxFuncPoolDestroy(struct flagcxFuncPool *pool);
+
 #endif
\ No newline at end of file
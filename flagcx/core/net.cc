@@ -1,11 +1,15 @@
 #include "net.h"
 #include "adaptor.h"
+#include "bootstrap.h"
 #include "device.h"
+#include "param.h"
 #include "proxy.h"
 #include "reg_pool.h"
+#include "timeline.h"
 
 #include <errno.h>
 #include <string.h>
+#include <sys/stat.h>
 
 static pthread_mutex_t netLock = PTHREAD_MUTEX_INITIALIZER;
 // Use adaptor system for all network types
@@ -70,6 +74,64 @@ static flagcxResult_t netGetState(int i, enum flagcxNetState *state) {
   return flagcxSuccess;
 }
 
+FLAGCX_PARAM(NetShmEnable, "NET_SHM_ENABLE", 1);
+static enum flagcxNetState flagcxNetShmState = flagcxNetStateInit;
+
+// Processes can share memory when they run on the same kernel and see the
+// same /dev/shm mount, whatever their hostname or FLAGCX_HOSTID says.
+uint64_t flagcxNetShmDomain() {
+  struct stat statbuf;
+  if (flagcxParamNetShmEnable() == 0 || stat("/dev/shm", &statbuf) != 0)
+    return 0;
+  return getBootHash() ^ ((uint64_t)statbuf.st_dev * 0x9e3779b97f4a7c15ULL);
+}
+
+flagcxResult_t flagcxNetShmSetDomains(struct flagcxHeteroComm *comm,
+                                      const uint64_t *domains) {
+  if (comm->shmDomains == NULL)
+    FLAGCXCHECK(flagcxCalloc(&comm->shmDomains, comm->nRanks));
+  int enabled = 0;
+  for (int i = 0; i < comm->nRanks; i++) {
+    comm->shmDomains[i] = domains[i];
+    enabled += domains[i] != 0 ? 1 : 0;
+  }
+  // A pair only uses SHM when both ranks publish the same identity, so the
+  // choice stays symmetric, but ranks that disabled SHM fall back to the net
+  if (enabled != 0 && enabled != comm->nRanks && comm->rank == 0) {
+    WARN("NET/SHM : only %d of %d ranks have FLAGCX_NET_SHM_ENABLE set, the "
+         "others use %s for same-host peers",
+         enabled, comm->nRanks, comm->netAdaptor->name);
+  }
+  return flagcxSuccess;
+}
+
+struct flagcxNetAdaptor *flagcxNetGetPeerAdaptor(struct flagcxHeteroComm *comm,
+                                                 int peer) {
+  struct flagcxNetAdaptor *shm = getUnifiedNetAdaptor(SHM);
+  if (comm->shmDomains == NULL || comm->shmDomains[comm->rank] == 0 ||
+      comm->shmDomains[peer] != comm->shmDomains[comm->rank])
+    return comm->netAdaptor;
+
+  pthread_mutex_lock(&netLock);
+  if (flagcxNetShmState == flagcxNetStateInit) {
+    int ndev;
+    if (shm->init() != flagcxSuccess || shm->devices(&ndev) != flagcxSuccess ||
+        ndev <= 0) {
+      flagcxNetShmState = flagcxNetStateDisabled;
+    } else {
+      flagcxNetShmState = flagcxNetStateEnabled;
+    }
+  }
+  bool enabled = flagcxNetShmState == flagcxNetStateEnabled;
+  pthread_mutex_unlock(&netLock);
+  return enabled ? shm : comm->netAdaptor;
+}
+
+bool flagcxNetIsHostStaged(struct flagcxNetAdaptor *net) {
+  return net == getUnifiedNetAdaptor(SOCKET) ||
+         net == getUnifiedNetAdaptor(SHM);
+}
+
 flagcxResult_t flagcxNetInit(struct flagcxHeteroComm *comm) {
   // Initialize main communication network
   const char *netName;
@@ -136,7 +198,7 @@ flagcxResult_t flagcxNetInit(struct flagcxHeteroComm *comm) {
 
 flagcxResult_t flagcxProxySend(sendNetResources *resources, void *data,
                                size_t size, flagcxProxyArgs *args) {
-  if (!args->semaphore->pollStart()) {
+  if (!flagcxProxyArgsReady(args)) {
     return flagcxSuccess;
   }
   if (args->transmitted < args->chunkSteps) {
@@ -154,7 +216,7 @@ flagcxResult_t flagcxProxySend(sendNetResources *resources, void *data,
               args->subs[step].stepBuff, (char *)data + args->totalCopySize,
               args->subs[step].stepSize, flagcxMemcpyDeviceToDevice,
               resources->cpStream, args->subs[step].copyArgs));
-        } else if (resources->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
+        } else if (flagcxNetIsHostStaged(resources->netAdaptor)) {
           FLAGCXCHECK(deviceAdaptor->deviceMemcpy(
               args->subs[step].stepBuff, (char *)data + args->totalCopySize,
               args->subs[step].stepSize, flagcxMemcpyDeviceToHost,
@@ -190,6 +252,8 @@ flagcxResult_t flagcxProxySend(sendNetResources *resources, void *data,
           args->regBufFlag ? args->regHandle : resources->mhandles[0], NULL,
           &req);
       if (req) {
+        TIMELINE_BEGIN("net", "netIsend", req, "step", args->posted, "bytes",
+                       args->subs[args->posted & stepMask].stepSize);
         args->subs[args->posted++ & stepMask].requests[0] = req;
       }
     }
@@ -199,12 +263,13 @@ flagcxResult_t flagcxProxySend(sendNetResources *resources, void *data,
       int done = 0, sizes;
       resources->netAdaptor->test(req, &done, &sizes);
       if (done) {
+        TIMELINE_END("net", "netIsend", req);
         args->transmitted++;
       }
     }
   } else {
     if (args->done != 1) {
-      args->semaphore->signalCounter(1);
+      flagcxProxyArgsDone(args);
       if (deviceAsyncLoad && deviceAsyncStore) {
         if (args->deviceFuncRelaxedOrdering == 1) {
           FLAGCXCHECK(deviceAdaptor->deviceMemcpy(
@@ -220,7 +285,7 @@ flagcxResult_t flagcxProxySend(sendNetResources *resources, void *data,
 
 flagcxResult_t flagcxProxyRecv(recvNetResources *resources, void *data,
                                size_t size, flagcxProxyArgs *args) {
-  if (!args->semaphore->pollStart()) {
+  if (!flagcxProxyArgsReady(args)) {
     return flagcxSuccess;
   }
   if (args->copied < args->chunkSteps) {
@@ -245,6 +310,8 @@ flagcxResult_t flagcxProxyRecv(recvNetResources *resources, void *data,
           args->regBufFlag ? &args->regHandle : resources->mhandles, NULL,
           &req);
       if (req) {
+        TIMELINE_BEGIN("net", "netIrecv", req, "step", args->posted, "bytes",
+                       args->subs[args->posted & stepMask].stepSize);
         args->subs[args->posted & stepMask].requests[0] = req;
         args->totalPostSize += args->subs[args->posted++ & stepMask].stepSize;
       }
@@ -255,6 +322,7 @@ flagcxResult_t flagcxProxyRecv(recvNetResources *resources, void *data,
       int done = 0, sizes;
       resources->netAdaptor->test(req, &done, &sizes);
       if (done) {
+        TIMELINE_END("net", "netIrecv", req);
         args->transmitted++;
       }
     }
@@ -270,7 +338,7 @@ flagcxResult_t flagcxProxyRecv(recvNetResources *resources, void *data,
         if (req) {
           args->subs[args->postFlush++ & stepMask].requests[0] = req;
         }
-      } else if (resources->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
+      } else if (flagcxNetIsHostStaged(resources->netAdaptor)) {
         args->subs[args->postFlush & stepMask].requests[0] = (void *)0x1;
         args->postFlush++;
       }
@@ -279,7 +347,7 @@ flagcxResult_t flagcxProxyRecv(recvNetResources *resources, void *data,
     if (args->flushed < args->postFlush) {
       void *req = args->subs[args->flushed & stepMask].requests[0];
       int done = 0, sizes;
-      if (resources->netAdaptor == getUnifiedNetAdaptor(SOCKET) &&
+      if (flagcxNetIsHostStaged(resources->netAdaptor) &&
           req == (void *)0x1) {
         done = 1;
         sizes = 0;
@@ -299,7 +367,7 @@ flagcxResult_t flagcxProxyRecv(recvNetResources *resources, void *data,
               (char *)data + args->totalCopySize, args->subs[step].stepBuff,
               args->subs[step].stepSize, flagcxMemcpyDeviceToDevice,
               resources->cpStream, args->subs[step].copyArgs));
-        } else if (resources->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
+        } else if (flagcxNetIsHostStaged(resources->netAdaptor)) {
           FLAGCXCHECK(deviceAdaptor->deviceMemcpy(
               (char *)data + args->totalCopySize, args->subs[step].stepBuff,
               args->subs[step].stepSize, flagcxMemcpyHostToDevice,
@@ -325,7 +393,7 @@ flagcxResult_t flagcxProxyRecv(recvNetResources *resources, void *data,
     }
   } else {
     if (args->done != 1) {
-      args->semaphore->signalCounter(1);
+      flagcxProxyArgsDone(args);
       if (deviceAsyncLoad && deviceAsyncStore) {
         if (args->deviceFuncRelaxedOrdering == 1) {
           FLAGCXCHECK(deviceAdaptor->deviceMemcpy(
@@ -347,7 +415,7 @@ flagcxResult_t flagcxSendProxyFree(sendNetResources *resources) {
   resources->netAdaptor->deregMr(resources->netSendComm,
                                  resources->mhandles[0]);
   resources->netAdaptor->closeSend(resources->netSendComm);
-  if (resources->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
+  if (flagcxNetIsHostStaged(resources->netAdaptor)) {
     free(resources->buffers[0]);
   } else if (resources->netAdaptor == getUnifiedNetAdaptor(IBRC)) {
     FLAGCXCHECK(deviceAdaptor->gdrMemFree(resources->buffers[0], NULL));
@@ -364,7 +432,7 @@ flagcxResult_t flagcxRecvProxyFree(recvNetResources *resources) {
                                  resources->mhandles[0]);
   resources->netAdaptor->closeRecv(resources->netRecvComm);
   resources->netAdaptor->closeListen(resources->netListenComm);
-  if (resources->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
+  if (flagcxNetIsHostStaged(resources->netAdaptor)) {
     free(resources->buffers[0]);
   } else if (resources->netAdaptor == getUnifiedNetAdaptor(IBRC)) {
     FLAGCXCHECK(deviceAdaptor->gdrMemFree(resources->buffers[0], NULL));
@@ -24,6 +24,18 @@ static_assert((MAXSTEPS & (MAXSTEPS - 1)) == 0, "send step must a power of 2");
 
 flagcxResult_t flagcxNetInit(struct flagcxHeteroComm *comm);
 int flagcxNetVersion(struct flagcxHeteroComm *comm);
+// Adaptor used for a NET connection with peer: the SHM adaptor when the peer
+// shares this host's /dev/shm, comm->netAdaptor otherwise.
+struct flagcxNetAdaptor *flagcxNetGetPeerAdaptor(struct flagcxHeteroComm *comm,
+                                                 int peer);
+// /dev/shm identity of this process, 0 when FLAGCX_NET_SHM_ENABLE=0. The
+// identities of all ranks travel with the other init metadata and are
+// handed to the communicator with flagcxNetShmSetDomains.
+uint64_t flagcxNetShmDomain();
+flagcxResult_t flagcxNetShmSetDomains(struct flagcxHeteroComm *comm,
+                                      const uint64_t *domains);
+// Whether net only moves host memory and needs device staging copies.
+bool flagcxNetIsHostStaged(struct flagcxNetAdaptor *net);
 
 // Test whether the current GPU support GPU Direct RDMA.
 flagcxResult_t flagcxGpuGdrSupport(struct flagcxHeteroComm *comm,
@@ -32,6 +44,7 @@ flagcxResult_t flagcxGpuGdrSupport(struct flagcxHeteroComm *comm,
 // Network adaptor declarations
 extern struct flagcxNetAdaptor flagcxNetSocket;
 extern struct flagcxNetAdaptor flagcxNetIb;
+extern struct flagcxNetAdaptor flagcxNetShm;
 
 struct sendNetResources {
   void *netSendComm;
@@ -44,7 +44,7 @@ flagcxResult_t flagcxP2pProxySend(struct flagcxP2pResources *resources,
   if (args->done == 1)
     return flagcxSuccess;
   // Make sure data is valid
-  if (!args->semaphore->pollStart())
+  if (!flagcxProxyArgsReady(args))
     return flagcxSuccess;
 
   struct flagcxP2pSyncSlot *slotPtr =
@@ -118,7 +118,7 @@ flagcxResult_t flagcxP2pProxySend(struct flagcxP2pResources *resources,
         if (slotPtr->peerDone == 1) {
           __atomic_store_n(&slotPtr->opHash, -1, __ATOMIC_RELAXED);
           __atomic_store_n(&slotPtr->done, 1, __ATOMIC_RELEASE);
-          args->semaphore->signalCounter(1);
+          flagcxProxyArgsDone(args);
           if (deviceAsyncLoad && deviceAsyncStore) {
             if (args->deviceFuncRelaxedOrdering == 1) {
               FLAGCXCHECK(deviceAdaptor->deviceMemcpy(
@@ -141,7 +141,7 @@ flagcxResult_t flagcxP2pProxyRecv(struct flagcxP2pResources *resources,
   if (args->done == 1)
     return flagcxSuccess;
   // Make sure data is valid
-  if (!args->semaphore->pollStart())
+  if (!flagcxProxyArgsReady(args))
     return flagcxSuccess;
 
   struct flagcxP2pSyncSlot *slotPtr =
@@ -215,7 +215,7 @@ flagcxResult_t flagcxP2pProxyRecv(struct flagcxP2pResources *resources,
         if (slotPtr->peerDone == 1) {
           __atomic_store_n(&slotPtr->opHash, -1, __ATOMIC_RELAXED);
           __atomic_store_n(&slotPtr->done, 1, __ATOMIC_RELEASE);
-          args->semaphore->signalCounter(1);
+          flagcxProxyArgsDone(args);
           if (deviceAsyncLoad && deviceAsyncStore) {
             if (args->deviceFuncRelaxedOrdering == 1) {
               FLAGCXCHECK(deviceAdaptor->deviceMemcpy(
@@ -236,7 +236,7 @@ flagcxResult_t flagcxP2pProxySelfCopy(struct flagcxP2pResources *resources,
                                       size_t size,
                                       struct flagcxProxyArgs *args) {
   // Make sure data is valid
-  if (!args->semaphore->pollStart())
+  if (!flagcxProxyArgsReady(args))
     return flagcxSuccess;
 
   if (args->transmitted < args->chunkSteps) {
@@ -261,7 +261,7 @@ flagcxResult_t flagcxP2pProxySelfCopy(struct flagcxP2pResources *resources,
     }
   } else {
     if (args->done != 1) {
-      args->semaphore->signalCounter(1);
+      flagcxProxyArgsDone(args);
       // Deprecated device func handling
       if (deviceAsyncLoad && deviceAsyncStore) {
         if (args->deviceFuncRelaxedOrdering == 1) {
@@ -6,12 +6,15 @@
 
 #include "proxy.h"
 #include "adaptor.h"
+#include "bintrace.h"
 #include "collectives.h"
 #include "comm.h"
 #include "info.h"
+#include "latency.h"
 #include "net.h"
 #include "p2p.h"
 #include "socket.h"
+#include "timeline.h"
 #include "transport.h"
 #define ENABLE_TIMER 0
 #include "timer.h"
@@ -21,6 +24,7 @@
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <vector>
 using namespace std;
 
 enum { proxyRecv = 0, proxySend = 1 };
@@ -98,6 +102,18 @@ static flagcxResult_t SaveProxy(struct flagcxHeteroComm *comm,
   if (justInquire)
     *justInquire = true;
   else {
+    if (flagcxLatencyEnabled()) {
+      if (flagcxLatencyCurrent.op >= 0) {
+        op->latCommHash = flagcxLatencyCurrent.commHash;
+        op->latOp = flagcxLatencyCurrent.op;
+        op->latBytes = flagcxLatencyCurrent.bytes;
+      } else {
+        op->latCommHash = comm->magic;
+        op->latOp = type == proxySend ? flagcxCommOpSend : flagcxCommOpRecv;
+        op->latBytes = op->nbytes;
+      }
+      op->latSave = clockNano();
+    }
     struct flagcxProxyOps *proxyOps;
     struct flagcxIntruQueue<struct flagcxProxyOp, &flagcxProxyOp::next> *queue;
 
@@ -109,8 +125,8 @@ static flagcxResult_t SaveProxy(struct flagcxHeteroComm *comm,
     flagcxProdProgChannelListEnList(&comm->proxyState->prodProgChannelHead,
                                     proxyOps);
     flagcxIntruQueueEnqueue(queue, op);
-    pthread_cond_signal(&comm->proxyState->cond);
     pthread_mutex_unlock(&comm->proxyState->mutex);
+    flagcxWaiterWake(&comm->proxyState->progressState.waiter);
   }
   return flagcxSuccess;
 }
@@ -167,10 +183,70 @@ static void flagcxProgressQueEmptyCheck(struct flagcxProxyState *proxyState) {
 // process all the ProxyOps in the consumer queue
 // idle is set to 1 if no operations are pending
 // if idle is set to 0, it means there are pending operations
+// Latency accounting of a proxy op: saved -> device reached the op (queue),
+// -> last chunk completed (net), -> op retired by the proxy thread (proxy).
+// Each proxy op is one sample, accounted to the call that issued it.
+static inline void latencyProgress(struct flagcxProxyOp *op) {
+  if (op->latSave == 0)
+    return;
+  if (op->latStart == 0 && flagcxProxyArgsReady(&op->args))
+    op->latStart = clockNano();
+  if (op->latDone == 0 && op->args.done == 1)
+    op->latDone = clockNano();
+}
+
+static inline void latencyRetire(struct flagcxProxyOp *op) {
+  if (op->latSave == 0)
+    return;
+  uint64_t now = clockNano();
+  uint64_t start = op->latStart ? op->latStart : op->latSave;
+  uint64_t done = op->latDone ? op->latDone : now;
+  uint64_t ns[flagcxLatencyNumPhases] = {0};
+  ns[flagcxLatencyQueue] = start - op->latSave;
+  ns[flagcxLatencyNet] = done - start;
+  ns[flagcxLatencyProxy] = now - done;
+  flagcxLatencyRecord(op->latCommHash, op->latOp, op->latBytes,
+                      FLAGCX_LATENCY_PHASE(flagcxLatencyQueue) |
+                          FLAGCX_LATENCY_PHASE(flagcxLatencyNet) |
+                          FLAGCX_LATENCY_PHASE(flagcxLatencyProxy),
+                      ns);
+}
+
+// Timeline span of a proxy op, from the device reaching it to its retirement
+static inline void timelineProgress(struct flagcxProxyOp *op, int send) {
+  if (op->timelineStarted || !flagcxTimelineOn() ||
+      !flagcxProxyArgsReady(&op->args))
+    return;
+  op->timelineStarted = 1;
+  if (send) {
+    TIMELINE_BEGIN("proxy", "proxySend", op, "peer", op->root, "bytes",
+                   op->nbytes);
+  } else {
+    TIMELINE_BEGIN("proxy", "proxyRecv", op, "peer", op->root, "bytes",
+                   op->nbytes);
+  }
+}
+
+static inline void timelineRetire(struct flagcxProxyOp *op, int send) {
+  if (!op->timelineStarted)
+    return;
+  if (send) {
+    TIMELINE_END("proxy", "proxySend", op);
+  } else {
+    TIMELINE_END("proxy", "proxyRecv", op);
+  }
+}
+
+// Counters of a proxy op that move whenever it makes progress
+static inline int opProgressMark(struct flagcxProxyArgs *args) {
+  return args->posted + args->copied + args->waitCopy + args->postFlush +
+         args->flushed + args->transmitted + args->done;
+}
+
 // For simplicity, if these are any pending operations in queue, we set idle to
-// 0
+// 0. progressed is set if an op moved forward or retired.
 static flagcxResult_t progressOps(struct flagcxProxyState *proxyState,
-                                  int *idle) {
+                                  int *idle, int *progressed) {
   *idle = 1;
   if (!flagcxConsProgChannelListEmpty(proxyState->consProgChannelHead)) {
     struct flagcxProxyOps *proxyOps = proxyState->consProgChannelHead;
@@ -187,17 +263,23 @@ static flagcxResult_t progressOps(struct flagcxProxyState *proxyState,
           if (!flagcxIntruQueueEmpty(queue)) {
             *idle &= 0;
             struct flagcxProxyOp *op = flagcxIntruQueueHead(queue);
+            int mark = opProgressMark(&op->args);
             if (op->connection->transport == TRANSPORT_NET) {
               struct sendNetResources *resources =
                   (sendNetResources *)op->connection->transportResources;
               flagcxProxySend(resources, op->recvbuff, op->nbytes, &op->args);
+              latencyProgress(op);
+              timelineProgress(op, 1);
               if (deviceAsyncLoad && deviceAsyncStore) {
                 if (op->args.done == 1 && op->args.eventRecorded) {
                   // The P2P object should not be destroyed until the associated
                   // event has completed
                   if (deviceAdaptor->eventQuery(op->event) == flagcxSuccess) {
                     flagcxIntruQueueDelete(queue, op);
-                    FLAGCXCHECK(deviceAdaptor->eventDestroy(op->event));
+                    FLAGCXCHECK(flagcxFuncPoolPut(op->funcPool, op->funcSlot,
+                                                  op->event));
+                    latencyRetire(op);
+                    timelineRetire(op, 1);
                     free(op);
                   }
                 }
@@ -205,6 +287,8 @@ static flagcxResult_t progressOps(struct flagcxProxyState *proxyState,
                 if (op->args.done == 1 && op->args.semaphore->pollEnd()) {
                   op->args.semaphore.reset();
                   flagcxIntruQueueDelete(queue, op);
+                  latencyRetire(op);
+                  timelineRetire(op, 1);
                   free(op);
                 }
               }
@@ -218,11 +302,16 @@ static flagcxResult_t progressOps(struct flagcxProxyState *proxyState,
                 flagcxP2pProxySelfCopy(resources, op->sendbuff, op->recvbuff,
                                        op->nbytes, &op->args);
               }
+              latencyProgress(op);
+              timelineProgress(op, 1);
               if (deviceAsyncLoad && deviceAsyncStore) {
                 if (op->args.done == 1 && op->args.eventRecorded) {
                   if (deviceAdaptor->eventQuery(op->event) == flagcxSuccess) {
                     flagcxIntruQueueDelete(queue, op);
-                    FLAGCXCHECK(deviceAdaptor->eventDestroy(op->event));
+                    FLAGCXCHECK(flagcxFuncPoolPut(op->funcPool, op->funcSlot,
+                                                  op->event));
+                    latencyRetire(op);
+                    timelineRetire(op, 1);
                     free(op);
                   }
                 }
@@ -230,26 +319,40 @@ static flagcxResult_t progressOps(struct flagcxProxyState *proxyState,
                 if (op->args.done == 1 && op->args.semaphore->pollEnd()) {
                   op->args.semaphore.reset();
                   flagcxIntruQueueDelete(queue, op);
+                  latencyRetire(op);
+                  timelineRetire(op, 1);
                   free(op);
                 }
               }
             }
+            // a retired op is no longer the head
+            if (flagcxIntruQueueEmpty(queue) ||
+                flagcxIntruQueueHead(queue) != op ||
+                opProgressMark(&op->args) != mark) {
+              *progressed = 1;
+            }
           }
           queue = &peer->recvQueue;
           if (!flagcxIntruQueueEmpty(queue)) {
             *idle &= 0;
             struct flagcxProxyOp *op = flagcxIntruQueueHead(queue);
+            int mark = opProgressMark(&op->args);
             if (op->connection->transport == TRANSPORT_NET) {
               struct recvNetResources *resources =
                   (recvNetResources *)op->connection->transportResources;
               flagcxProxyRecv(resources, op->recvbuff, op->nbytes, &op->args);
+              latencyProgress(op);
+              timelineProgress(op, 0);
               if (deviceAsyncLoad && deviceAsyncStore) {
                 if (op->args.done == 1 && op->args.eventRecorded) {
                   // The P2P object should not be destroyed until the associated
                   // event has completed
                   if (deviceAdaptor->eventQuery(op->event) == flagcxSuccess) {
                     flagcxIntruQueueDelete(queue, op);
-                    FLAGCXCHECK(deviceAdaptor->eventDestroy(op->event));
+                    FLAGCXCHECK(flagcxFuncPoolPut(op->funcPool, op->funcSlot,
+                                                  op->event));
+                    latencyRetire(op);
+                    timelineRetire(op, 0);
                     free(op);
                   }
                 }
@@ -258,6 +361,8 @@ static flagcxResult_t progressOps(struct flagcxProxyState *proxyState,
                   // update refcount and delete semaphore when refcount = 0
                   op->args.semaphore.reset();
                   flagcxIntruQueueDelete(queue, op);
+                  latencyRetire(op);
+                  timelineRetire(op, 0);
                   free(op);
                 }
               }
@@ -266,13 +371,18 @@ static flagcxResult_t progressOps(struct flagcxProxyState *proxyState,
                   (flagcxP2pResources *)op->connection->transportResources;
               flagcxP2pProxyRecv(resources, op->recvbuff, op->nbytes,
                                  &op->args);
+              latencyProgress(op);
+              timelineProgress(op, 0);
               if (deviceAsyncLoad && deviceAsyncStore) {
                 if (op->args.done == 1 && op->args.eventRecorded) {
                   // The P2P object should not be destroyed until the associated
                   // event has completed
                   if (deviceAdaptor->eventQuery(op->event) == flagcxSuccess) {
                     flagcxIntruQueueDelete(queue, op);
-                    FLAGCXCHECK(deviceAdaptor->eventDestroy(op->event));
+                    FLAGCXCHECK(flagcxFuncPoolPut(op->funcPool, op->funcSlot,
+                                                  op->event));
+                    latencyRetire(op);
+                    timelineRetire(op, 0);
                     free(op);
                   }
                 }
@@ -281,10 +391,18 @@ static flagcxResult_t progressOps(struct flagcxProxyState *proxyState,
                   // update refcount and delete semaphore when refcount = 0
                   op->args.semaphore.reset();
                   flagcxIntruQueueDelete(queue, op);
+                  latencyRetire(op);
+                  timelineRetire(op, 0);
                   free(op);
                 }
               }
             }
+            // a retired op is no longer the head
+            if (flagcxIntruQueueEmpty(queue) ||
+                flagcxIntruQueueHead(queue) != op ||
+                opProgressMark(&op->args) != mark) {
+              *progressed = 1;
+            }
           }
           if (flagcxIntruQueueEmpty(&peer->sendQueue) &&
               flagcxIntruQueueEmpty(&peer->recvQueue)) {
@@ -317,18 +435,11 @@ flagcxProxyGetPostedOps(struct flagcxProxyState *proxyState, int *added) {
     return flagcxSuccess;
   }
 
-  // If we have ops to progress, no need to block waiting for something to
-  // arrive
-  if (flagcxConsProgChannelListEmpty(proxyState->consProgChannelHead)) {
-    while (flagcxProdProgChannelListEmpty(proxyState->prodProgChannelHead) &&
-           state->stop == 0) {
-      pthread_cond_wait(&proxyState->cond, &proxyState->mutex);
-    }
-    if (state->stop != 0) {
-      pthread_mutex_unlock(&proxyState->mutex);
-      *added = 0;
-      return flagcxSuccess;
-    }
+  // Waiting for something to arrive is left to the progress loop
+  if (state->stop != 0) {
+    pthread_mutex_unlock(&proxyState->mutex);
+    *added = 0;
+    return flagcxSuccess;
   }
 
   // Put anything available right now in the producer queue into the consumer
@@ -377,10 +488,15 @@ inline void *flagcxProxyProgress(void *proxyState_) {
   deviceAdaptor->setDevice(proxyState->cudaDev);
   struct flagcxProxyProgressState *state = &proxyState->progressState;
 
+  flagcxWaiterInit(&state->waiter);
+
   while (state->stop == 0 || idle == 0) {
+    // taken before looking at the queues so that no wake is missed
+    uint32_t wakeSeq = flagcxWaiterPrepare(&state->waiter);
+    int progressed = 0;
     idle = 1;
     // consume the operations in the consumer queue
-    progressOps(proxyState, &idle);
+    progressOps(proxyState, &idle, &progressed);
 
     if (idle || (++proxyOpAppendCounter == flagcxParamProgressAppendOpFreq())) {
       int added = 0;
@@ -389,12 +505,18 @@ inline void *flagcxProxyProgress(void *proxyState_) {
         // move all the operations from the producer queue to the consumer queue
         flagcxProxyGetPostedOps(proxyState, &added);
       }
-      if (added == 0) {
-        sched_yield(); // No request progressed. Let others run.
-      }
+      progressed |= added;
+    }
+    if (progressed) {
+      flagcxWaiterProgress(&state->waiter);
+    } else {
+      // Without pending ops only SaveProxy or stop can give us work, with
+      // some the network and the device may, which do not wake us
+      flagcxWaiterIdle(&state->waiter, wakeSeq, idle && state->stop == 0);
     }
   }
 
+  flagcxWaiterReport(&state->waiter, "proxy progress", proxyState->tpRank);
   flagcxProgressQueEmptyCheck(proxyState);
   return NULL;
 }
@@ -632,7 +754,7 @@ static flagcxResult_t proxyProgressAsync(flagcxProxyAsyncOp **opHead,
               FLAGCXCHECK(resources->netAdaptor->regMr(
                   resources->netSendComm, resources->buffers[0],
                   resources->buffSizes[0], 2, &resources->mhandles[0]));
-            } else if (resources->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
+            } else if (flagcxNetIsHostStaged(resources->netAdaptor)) {
               FLAGCXCHECK(resources->netAdaptor->regMr(
                   resources->netSendComm, resources->buffers[0],
                   resources->buffSizes[0], 1, &resources->mhandles[0]));
@@ -664,7 +786,7 @@ static flagcxResult_t proxyProgressAsync(flagcxProxyAsyncOp **opHead,
               FLAGCXCHECK(resources->netAdaptor->regMr(
                   resources->netRecvComm, resources->buffers[0],
                   resources->buffSizes[0], 2, &resources->mhandles[0]));
-            } else if (resources->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
+            } else if (flagcxNetIsHostStaged(resources->netAdaptor)) {
               FLAGCXCHECK(resources->netAdaptor->regMr(
                   resources->netRecvComm, resources->buffers[0],
                   resources->buffSizes[0], 1, &resources->mhandles[0]));
@@ -907,6 +1029,7 @@ flagcxResult_t flagcxProxyInit(struct flagcxHeteroComm *comm) {
   memcpy(proxyMsg, (string("Proxy: ") + to_string(comm->rank)).c_str(), 10);
   flagcxSocketSend(proxySock, proxyMsg, 10);
   comm->proxyState->cudaDev = comm->cudaDev;
+  comm->proxyState->tpRank = comm->rank;
   pthread_create(&comm->proxyState->thread, NULL, flagcxProxyService,
                  (void *)comm);
   pthread_create(&comm->proxyState->progressState.thread, NULL,
@@ -915,11 +1038,24 @@ flagcxResult_t flagcxProxyInit(struct flagcxHeteroComm *comm) {
     pthread_create(&comm->proxyState->kernelState.thread, NULL,
                    flagcxProxyKernelService, (void *)comm);
   }
+  flagcxProxyBindThreads(comm);
 
   comm->proxyState->initialized = 1;
   return flagcxSuccess;
 }
 
+void flagcxProxyBindThreads(struct flagcxHeteroComm *comm) {
+  struct flagcxProxyState *state = comm->proxyState;
+  flagcxAffinityBind(&comm->affinity, flagcxThreadProxyService,
+                     state->thread);
+  flagcxAffinityBind(&comm->affinity, flagcxThreadProxyProgress,
+                     state->progressState.thread);
+  if (state->enableProxyKernel) {
+    flagcxAffinityBind(&comm->affinity, flagcxThreadKernelService,
+                       state->kernelState.thread);
+  }
+}
+
 void *flagcxProxyService(void *args) {
   int stop = 0;
   int closeConn = 0;
@@ -1021,8 +1157,8 @@ out:
   // Stop progress thread before freeing any resource
   pthread_mutex_lock(&comm->proxyState->mutex);
   comm->proxyState->progressState.stop = 1;
-  pthread_cond_signal(&comm->proxyState->cond);
   pthread_mutex_unlock(&comm->proxyState->mutex);
+  flagcxWaiterWake(&comm->proxyState->progressState.waiter);
   pthread_join(comm->proxyState->progressState.thread, nullptr);
   // Stop kernel thread if needed
   if (comm->proxyState->enableProxyKernel) {
@@ -1071,11 +1207,78 @@ out:
   return NULL;
 }
 
+// Device triggers of one kind to one peer; with FLAGCX_KERNEL_COALESCE=1
+// contiguous triggers are merged into a single op. Both sides of a transfer
+// must then see contiguous buffers, or send and recv sizes would not match.
+FLAGCX_PARAM(KernelCoalesce, "KERNEL_COALESCE", 0);
+
+struct flagcxKernelP2pDesc {
+  uintptr_t addr;
+  size_t count;
+  flagcxDataType_t datatype;
+  int peer;
+  uint64_t type;
+};
+
+static void flagcxKernelAppendP2p(std::vector<flagcxKernelP2pDesc> &descs,
+                                  flagcxDeviceTrigger_t trigger,
+                                  bool coalesce) {
+  flagcxKernelP2pDesc desc = {
+      (uintptr_t)trigger->getAddr(), trigger->getCount(),
+      (flagcxDataType_t)trigger->getDatatype(), (int)trigger->getPeerRank(),
+      trigger->getType()};
+  if (coalesce) {
+    // only the latest op of the same kind to the peer may grow, so that ops
+    // to one peer keep their order
+    for (auto it = descs.rbegin(); it != descs.rend(); ++it) {
+      if (it->type != desc.type || it->peer != desc.peer)
+        continue;
+      if (it->datatype == desc.datatype &&
+          it->addr + it->count * getFlagcxDataTypeSize(it->datatype) ==
+              desc.addr) {
+        it->count += desc.count;
+        return;
+      }
+      break;
+    }
+  }
+  descs.push_back(desc);
+}
+
+static flagcxResult_t
+flagcxKernelIssueP2p(struct flagcxHeteroComm *comm,
+                     std::vector<flagcxKernelP2pDesc> &descs, int nTriggers,
+                     flagcxStream_t stream) {
+  for (auto &desc : descs) {
+    if (desc.type == flagcxDevicePrimSend) {
+      FLAGCXCHECK(flagcxHeteroSend((const void *)desc.addr, desc.count,
+                                   desc.datatype, desc.peer, comm, stream));
+    } else {
+      FLAGCXCHECK(flagcxHeteroRecv((void *)desc.addr, desc.count,
+                                   desc.datatype, desc.peer, comm, stream));
+    }
+  }
+  TRACE_BIN(FLAGCX_P2P, "rank=%d issued %zu p2p ops for %d device triggers",
+            comm->rank, descs.size(), nTriggers);
+  descs.clear();
+  return flagcxSuccess;
+}
+
 void *flagcxProxyKernelService(void *args) {
   int groupCount = 0;
   flagcxDeviceTrigger_t ptr = NULL;
+  flagcxDeviceTrigger triggers[FLAGCX_KERNEL_FIFO_CAPACITY];
+  int nTriggers = 0;
+  int passGroup = 0;
+  std::vector<flagcxKernelP2pDesc> descs;
+  int groupTriggers = 0;
+  // The device posted ops and has not waited for them yet, so more triggers
+  // are expected and it cannot wake this thread
+  bool armed = false;
+  bool coalesce = flagcxParamKernelCoalesce() == 1;
   flagcxFifo_t fifo = NULL;
   struct flagcxHeteroComm *comm = (struct flagcxHeteroComm *)args;
+  struct flagcxWaiter *waiter = &comm->proxyState->kernelState.waiter;
   flagcxResult_t res = flagcxSuccess;
 
   // Set device context
@@ -1097,83 +1300,101 @@ void *flagcxProxyKernelService(void *args) {
   FLAGCXCHECKGOTO(deviceAdaptor->streamCreate(&stream), res, out);
   INFO(FLAGCX_P2P, "rank %d p2p stream %lu", comm->rank, (uintptr_t)stream);
 
-  // Allocate trigger structure
-  FLAGCXCHECKGOTO(flagcxCalloc(&ptr, sizeof(flagcxDeviceTrigger)), res, out);
-
+  flagcxWaiterInit(waiter);
   while (true) {
     if (comm->proxyState->kernelState.stop == 1)
       break;
-    dequeue(fifo->buffer, ptr);
-    if ((ptr->getType() == flagcxDevicePrimSend ||
-         ptr->getType() == flagcxDevicePrimRecv) &&
-        ptr->getAddr() == 0) {
-      sched_yield();
+    // Drain every trigger that is ready, device threads keep producing
+    // while the batch is handled
+    dequeueBatch(fifo->buffer, triggers, FLAGCX_KERNEL_FIFO_CAPACITY,
+                 &nTriggers);
+    if (nTriggers == 0) {
+      if (armed)
+        flagcxWaiterPoll(waiter);
+      else
+        flagcxWaiterIdle(waiter, flagcxWaiterPrepare(waiter), false);
       continue;
     }
-    switch (ptr->getType()) {
-      case flagcxDevicePrimSend:
-        if (groupCount == 0) {
-          res = flagcxHeteroGroupStart();
-          TRACE(FLAGCX_P2P,
-                "rank=%d flagcxHeteroGroupStart called by proxyKernelService.",
-                comm->rank);
-          groupCount++;
-        }
-        TRACE(FLAGCX_P2P,
-              "rank=%d flagcxDevicePrimSend called by proxyKernelService.",
-              comm->rank);
-        res = flagcxHeteroSend((const void *)(uintptr_t)(ptr->getAddr()),
-                               ptr->getCount(),
-                               (flagcxDataType_t)(ptr->getDatatype()),
-                               ptr->getPeerRank(), comm, stream);
-        break;
-      case flagcxDevicePrimRecv:
-        if (groupCount == 0) {
-          res = flagcxHeteroGroupStart();
-          TRACE(FLAGCX_P2P,
-                "rank=%d flagcxHeteroGroupStart called by proxyKernelService.",
-                comm->rank);
-          groupCount++;
-        }
-        TRACE(FLAGCX_P2P,
-              "rank=%d flagcxDevicePrimRecv called by proxyKernelService.",
-              comm->rank);
-        res = flagcxHeteroRecv((void *)(uintptr_t)(ptr->getAddr()),
-                               ptr->getCount(),
-                               (flagcxDataType_t)(ptr->getDatatype()),
-                               ptr->getPeerRank(), comm, stream);
-        break;
-      case flagcxDevicePrimTerm:
-        TRACE(FLAGCX_P2P,
+    flagcxWaiterProgress(waiter);
+    // One group covers the whole pass, so the device groups that end in it
+    // are launched together
+    res = flagcxHeteroGroupStart();
+    passGroup = 1;
+    for (int i = 0; i < nTriggers && res == flagcxSuccess; i++) {
+      ptr = triggers + i;
+      switch (ptr->getType()) {
+        case flagcxDevicePrimSend:
+        case flagcxDevicePrimRecv:
+          if (groupCount == 0) {
+            res = flagcxHeteroGroupStart();
+            TRACE_BIN(FLAGCX_P2P,
+                      "rank=%d flagcxHeteroGroupStart called by "
+                      "proxyKernelService.",
+                      comm->rank);
+            groupCount++;
+          }
+          if (ptr->getType() == flagcxDevicePrimSend) {
+            TRACE_BIN(FLAGCX_P2P,
+                      "rank=%d flagcxDevicePrimSend called by "
+                      "proxyKernelService, peer=%lu count=%lu",
+                      comm->rank, ptr->getPeerRank(), ptr->getCount());
+          } else {
+            TRACE_BIN(FLAGCX_P2P,
+                      "rank=%d flagcxDevicePrimRecv called by "
+                      "proxyKernelService, peer=%lu count=%lu",
+                      comm->rank, ptr->getPeerRank(), ptr->getCount());
+          }
+          // ops are only issued at Term, so that merging does not depend on
+          // how the FIFO happened to be drained
+          flagcxKernelAppendP2p(descs, ptr, coalesce);
+          groupTriggers++;
+          armed = true;
+          break;
+        case flagcxDevicePrimTerm:
+          TRACE_BIN(
+              FLAGCX_P2P,
               "rank=%d flagcxDevicePrimTerm called by proxyKernelService.",
               comm->rank);
-        if (groupCount > 0) {
-          res = flagcxHeteroGroupEnd();
-          TRACE(FLAGCX_P2P,
+          if (groupCount > 0) {
+            res = flagcxKernelIssueP2p(comm, descs, groupTriggers, stream);
+            groupTriggers = 0;
+            if (res == flagcxSuccess)
+              res = flagcxHeteroGroupEnd();
+            TRACE_BIN(
+                FLAGCX_P2P,
                 "rank=%d flagcxHeteroGroupEnd called by proxyKernelService.",
                 comm->rank);
-          groupCount--;
-        }
-        break;
-      case flagcxDevicePrimWait:
-        TRACE(FLAGCX_P2P,
+            groupCount--;
+          }
+          break;
+        case flagcxDevicePrimWait:
+          TRACE_BIN(
+              FLAGCX_P2P,
               "rank=%d flagcxDevicePrimWait called by proxyKernelService.",
               comm->rank);
-        deviceAdaptor->streamSynchronize(stream);
-        break;
-      default:
-        break;
+          // launch what has ended so far before waiting for it
+          if (passGroup) {
+            res = flagcxHeteroGroupEnd();
+            passGroup = 0;
+          }
+          deviceAdaptor->streamSynchronize(stream);
+          armed = false;
+          break;
+        default:
+          break;
+      }
     }
+    if (passGroup && res == flagcxSuccess)
+      res = flagcxHeteroGroupEnd();
     if (res != flagcxSuccess)
       break;
   }
   // destroy stream
   res = deviceAdaptor->streamSynchronize(stream);
   res = deviceAdaptor->streamDestroy(stream);
-  // deallocate trigger structure
-  free(ptr);
 
 out:
+  flagcxWaiterReport(waiter, "kernel service", comm->rank);
   // destroy fifo
   res = comm->proxyState->kernelState.fifo->flagcxFifoDestroy();
   delete comm->proxyState->kernelState.fifo;
@@ -1216,6 +1437,7 @@ flagcxResult_t flagcxProxyDestroy(struct flagcxHeteroComm *comm) {
     int type = flagcxProxyMsgStop;
     flagcxSocketSend(&comm->proxyState->peerSock, &type, sizeof(int));
     comm->proxyState->kernelState.stop = 1;
+    flagcxWaiterWake(&comm->proxyState->kernelState.waiter);
     pthread_join(comm->proxyState->thread, nullptr);
     flagcxProxyFree(comm);
   }
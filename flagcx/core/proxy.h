@@ -17,6 +17,7 @@
 #include "net.h"
 #include "reg_pool.h"
 #include "socket.h"
+#include "waiter.h"
 #include <memory>
 #include <pthread.h>
 
@@ -31,6 +32,8 @@ struct flagcxProxyKernelState {
   flagcxFifo_t fifo;
   flagcxStream_t stream;
   int stop = 0;
+  // the device cannot wake it, so its waits are always bounded
+  struct flagcxWaiter waiter;
 };
 
 struct flagcxProxyArgs;
@@ -148,6 +151,23 @@ struct flagcxProxyArgs {
   union flagcxProxyOpSpecifics specifics;
 };
 
+// Whether the device reached the op: the group semaphore has started, or,
+// for device funcs, which carry no semaphore, the ready flag was copied back
+static inline bool flagcxProxyArgsReady(struct flagcxProxyArgs *args) {
+  if (args->semaphore)
+    return args->semaphore->pollStart();
+  return __atomic_load_n(&args->hEventReady, __ATOMIC_ACQUIRE);
+}
+
+// Report the op done to the group semaphore, or to the device func waiting
+// on hlArgs
+static inline void flagcxProxyArgsDone(struct flagcxProxyArgs *args) {
+  if (args->semaphore)
+    args->semaphore->signalCounter(1);
+  else
+    __atomic_store_n(&args->hlArgs, true, __ATOMIC_RELEASE);
+}
+
 struct flagcxProxyOp {
   struct flagcxProxyConnection *connection;
   ssize_t nbytes;
@@ -186,7 +206,19 @@ struct flagcxProxyOp {
   flagcxProxyArgs args;
   flagcxStream_t stream;
   flagcxEvent_t event; // used to record host/device func
+  // device func flags and event, owned by this pool
+  struct flagcxFuncPool *funcPool;
+  int funcSlot;
   int selfCopy = 0;
+  // latency accounting timestamps, only set with FLAGCX_LATENCY_ENABLE
+  uint64_t latCommHash;
+  int latOp;
+  size_t latBytes;
+  uint64_t latSave;
+  uint64_t latStart;
+  uint64_t latDone;
+  // set once the timeline span of the op has begun
+  int timelineStarted;
 };
 
 #define FLAGCX_MAX_NETDEVS 128
@@ -259,6 +291,8 @@ struct flagcxProxyProgressState {
 
   pthread_t thread;
   volatile int stop;
+  // woken by SaveProxy and on stop
+  struct flagcxWaiter waiter;
   struct flagcxProxyPeer **localPeers;
   struct flagcxSharedNetComms *netComms[FLAGCX_MAX_NETDEVS];
   struct flagcxProxyArgs *active;
@@ -333,7 +367,6 @@ struct flagcxProxyState {
 
   // Used by main thread
   pthread_mutex_t mutex;
-  pthread_cond_t cond;
   union flagcxSocketAddress *peerAddresses;
   struct flagcxSocket peerSock;
   struct flagcxProxyOps proxyOps[MAXCHANNELS];
@@ -397,6 +430,8 @@ flagcxResult_t flagcxProxyComputeP2p(struct flagcxInfo *info,
                                      struct flagcxProxyOp *proxyOp, int reg);
 flagcxResult_t flagcxProxyStart(struct flagcxHeteroComm *comm);
 flagcxResult_t flagcxProxyInit(struct flagcxHeteroComm *comm);
+// Apply comm->affinity to the running proxy threads
+void flagcxProxyBindThreads(struct flagcxHeteroComm *comm);
 flagcxResult_t flagcxProxyCreate(struct flagcxHeteroComm *comm);
 flagcxResult_t flagcxProxyConnect(struct flagcxHeteroComm *comm, int transport,
                                   int send, int proxyRank,
@@ -1154,121 +1154,89 @@ static flagcxResult_t unflattenNode(struct flagcxTopoServer *topoServer,
   return flagcxSuccess;
 }
 
-static flagcxResult_t flattenNodeSet(struct flagcxTopoServer *topoServer,
-                                     struct flagcxTopoNodeSet *nodeSet,
-                                     struct flatTopoNodeSet *flatNodeSet) {
-  flatNodeSet->count = nodeSet->count;
-  for (int n = 0; n < flatNodeSet->count; n++) {
-    FLAGCXCHECK(
-        flattenNode(topoServer, &nodeSet->nodes[n], &flatNodeSet->nodes[n]));
-  }
-  return flagcxSuccess;
-}
-
-static flagcxResult_t unflattenNodeSet(struct flagcxTopoServer *topoServer,
-                                       struct flagcxTopoNodeSet *nodeSet,
-                                       struct flatTopoNodeSet *flatNodeSet) {
-  nodeSet->count = flatNodeSet->count;
-  for (int n = 0; n < nodeSet->count; n++) {
-    FLAGCXCHECK(
-        unflattenNode(topoServer, &nodeSet->nodes[n], &flatNodeSet->nodes[n]));
-  }
-  return flagcxSuccess;
-}
-
-static flagcxResult_t flattenTopoServer(struct flagcxTopoServer *topoServer,
-                                        struct flatTopoServer *flatTopo) {
-  flatTopo->serverId = topoServer->serverId;
-  INFO(FLAGCX_GRAPH, "FLATTEN_SERVER: serverId = [%d]", flatTopo->serverId);
-  flatTopo->nHosts = topoServer->nHosts;
-  INFO(FLAGCX_GRAPH, "FLATTEN_SERVER: nHosts = [%d]", flatTopo->nHosts);
-  for (int h = 0; h < topoServer->nHosts; h++) {
-    flatTopo->hostHashes[h] = topoServer->hostHashes[h];
-  }
-
-  // flatten node set
-  for (int t = 0; t < FLAGCX_TOPO_NODE_TYPES; t++) {
-    INFO(FLAGCX_GRAPH, "FLATTEN_SERVER: start flattening node set of type [%d]",
-         t);
-    FLAGCXCHECK(
-        flattenNodeSet(topoServer, &topoServer->nodes[t], &flatTopo->nodes[t]));
-  }
-  // need to flatten all nodes first before flattening links
-  for (int t = 0; t < FLAGCX_TOPO_NODE_TYPES; t++) {
-    for (int n = 0; n < topoServer->nodes[t].count; n++) {
-      for (int l = 0; l < topoServer->nodes[t].nodes[n].nlinks; l++) {
-        struct flagcxTopoLink *link = &topoServer->nodes[t].nodes[n].links[l];
-        struct flatTopoLink *flatLink = &flatTopo->nodes[t].nodes[n].links[l];
-        FLAGCXCHECK(flattenLink(topoServer, link, flatLink));
-      }
+#define FLAGCX_TOPO_EXCHANGE_TAG 0x746f706f
+
+// Compact serialization of a server topology. Only the nodes and links in
+// use are written: per node type, a count followed by the fixed part of
+// each flatTopoNode and then its nlinks links.
+struct topoWriter {
+  std::vector<char> buf;
+  void put(const void *data, size_t size) {
+    const char *p = (const char *)data;
+    buf.insert(buf.end(), p, p + size);
+  }
+};
+
+struct topoReader {
+  const char *buf;
+  size_t size;
+  size_t offset;
+  flagcxResult_t get(void *data, size_t len) {
+    if (offset + len > size) {
+      WARN("Truncated topology data: need %zu bytes at offset %zu of %zu", len,
+           offset, size);
+      return flagcxInternalError;
     }
+    memcpy(data, buf + offset, len);
+    offset += len;
+    return flagcxSuccess;
   }
-  return flagcxSuccess;
-}
-
-static flagcxResult_t unflattenTopoServer(struct flagcxTopoServer *topoServer,
-                                          struct flatTopoServer *flatTopo) {
-  topoServer->serverId = flatTopo->serverId;
-  topoServer->nHosts = flatTopo->nHosts;
-  INFO(FLAGCX_GRAPH, "UNFLATTEN_SERVER: assigning host hashes");
-  for (int h = 0; h < topoServer->nHosts; h++) {
-    topoServer->hostHashes[h] = flatTopo->hostHashes[h];
-  }
-
-  // unflatten node set
-  INFO(FLAGCX_GRAPH, "UNFLATTEN_SERVER: start unflattening node set");
-  for (int t = 0; t < FLAGCX_TOPO_NODE_TYPES; t++) {
-    FLAGCXCHECK(unflattenNodeSet(topoServer, &topoServer->nodes[t],
-                                 &flatTopo->nodes[t]));
-  }
+};
 
-  // need to unflatten all nodes first before flattening links
-  INFO(FLAGCX_GRAPH, "UNFLATTEN_SERVER: start unflattening links");
+static flagcxResult_t serializeTopoServer(struct flagcxTopoServer *topoServer,
+                                          struct topoWriter *writer) {
+  struct flatTopoNode flatNode;
+  struct flatTopoLink flatLink;
   for (int t = 0; t < FLAGCX_TOPO_NODE_TYPES; t++) {
-    for (int n = 0; n < flatTopo->nodes[t].count; n++) {
-      for (int l = 0; l < flatTopo->nodes[t].nodes[n].nlinks; l++) {
-        struct flagcxTopoLink *link = &topoServer->nodes[t].nodes[n].links[l];
-        struct flatTopoLink *flatLink = &flatTopo->nodes[t].nodes[n].links[l];
-        FLAGCXCHECK(unflattenLink(topoServer, link, flatLink));
+    struct flagcxTopoNodeSet *nodeSet = &topoServer->nodes[t];
+    writer->put(&nodeSet->count, sizeof(int));
+    for (int n = 0; n < nodeSet->count; n++) {
+      struct flagcxTopoNode *node = &nodeSet->nodes[n];
+      FLAGCXCHECK(flattenNode(topoServer, node, &flatNode));
+      writer->put(&flatNode, offsetof(struct flatTopoNode, links));
+      for (int l = 0; l < node->nlinks; l++) {
+        FLAGCXCHECK(flattenLink(topoServer, &node->links[l], &flatLink));
+        writer->put(&flatLink, sizeof(flatLink));
       }
     }
   }
-
   return flagcxSuccess;
 }
 
-static flagcxResult_t
-flagcxTopoReorderServerId(struct flatTopoServer *flatTopoServer, int nRanks) {
-  // get all host hashes
-  std::map<uint64_t, int> hostHashToServerId;
-  int serverId = 0;
-  int nHosts = 0;
-  for (int i = 0; i < nRanks; i++) {
-    // get host hash of server
-    uint64_t hostHash =
-        flatTopoServer[i].hostHashes[flatTopoServer[i].serverId];
-    auto it = hostHashToServerId.find(hostHash);
-    if (it == hostHashToServerId.end()) {
-      // assign new serverId
-      flatTopoServer[i].serverId = serverId;
-      // if we haven't seen this host hash before, add it to the map
-      hostHashToServerId[hostHash] = serverId;
-      serverId++;
-      nHosts++;
-    } else {
-      // if we have seen this host hash before, reorder serverId
-      flatTopoServer[i].serverId = it->second;
+static flagcxResult_t deserializeTopoServer(struct flagcxTopoServer *topoServer,
+                                            struct topoReader *reader) {
+  struct flatTopoNode flatNode;
+  struct flatTopoLink flatLink;
+  for (int t = 0; t < FLAGCX_TOPO_NODE_TYPES; t++) {
+    struct flagcxTopoNodeSet *nodeSet = &topoServer->nodes[t];
+    FLAGCXCHECK(reader->get(&nodeSet->count, sizeof(int)));
+    if (nodeSet->count < 0 || nodeSet->count > FLAGCX_TOPO_MAX_NODES) {
+      WARN("Invalid topology node count %d for type %d", nodeSet->count, t);
+      return flagcxInternalError;
     }
-  }
-  for (int i = 0; i < nRanks; i++) {
-    // clear original host hash array
-    memset(flatTopoServer[i].hostHashes, 0,
-           sizeof(uint64_t) * FLAGCX_TOPO_MAX_NODES);
-    flatTopoServer[i].nHosts = nHosts;
-    for (auto it = hostHashToServerId.begin(); it != hostHashToServerId.end();
-         ++it) {
-      // reorder host hashes
-      flatTopoServer[i].hostHashes[it->second] = it->first;
+    for (int n = 0; n < nodeSet->count; n++) {
+      struct flagcxTopoNode *node = &nodeSet->nodes[n];
+      FLAGCXCHECK(
+          reader->get(&flatNode, offsetof(struct flatTopoNode, links)));
+      if (flatNode.nlinks < 0 || flatNode.nlinks > FLAGCX_TOPO_MAX_LINKS) {
+        WARN("Invalid topology link count %d", flatNode.nlinks);
+        return flagcxInternalError;
+      }
+      FLAGCXCHECK(unflattenNode(topoServer, node, &flatNode));
+      // links only point into the preallocated node arrays, so they can be
+      // restored before the nodes they refer to
+      for (int l = 0; l < node->nlinks; l++) {
+        FLAGCXCHECK(reader->get(&flatLink, sizeof(flatLink)));
+        if (flatLink.remNodeType < 0 ||
+            flatLink.remNodeType >= FLAGCX_TOPO_NODE_TYPES ||
+            flatLink.remNodeIdx < 0 ||
+            flatLink.remNodeIdx >= FLAGCX_TOPO_MAX_NODES) {
+          WARN("Invalid topology link to node %d of type %d",
+               flatLink.remNodeIdx, flatLink.remNodeType);
+          return flagcxInternalError;
+        }
+        FLAGCXCHECK(unflattenLink(topoServer, &node->links[l], &flatLink));
+      }
     }
   }
   return flagcxSuccess;
@@ -1476,104 +1444,169 @@ flagcxResult_t
 flagcxGetInterServerTopo(struct flagcxHeteroComm *comm,
                          struct flagcxInterServerTopo **interServerTopo,
                          struct flagcxTopoServer *topoServer) {
-  auto ret = flagcxSuccess;
   int rank = comm->rank;
   int nRanks = comm->nRanks;
-  uint64_t currRankHostHash = topoServer->hostHashes[topoServer->serverId];
-  // FLAGCXCHECK(flagcxCalloc(interServerTopo, 1));
   *interServerTopo = new flagcxInterServerTopo(); // remember to delete this
                                                   // when destroying comm
   flagcxInterServerTopo *interServer = *interServerTopo;
-  flatTopoServer *flatServerData;
-  FLAGCXCHECK(flagcxCalloc(&flatServerData, nRanks));
-  // we need to flatten topoServer first to remove all pointer types in the
-  // structure before copying and trasferring it to other ranks
-  FLAGCXCHECK(flattenTopoServer(topoServer, flatServerData + rank));
-  FLAGCXCHECK(bootstrapAllGather(comm->bootstrap, (void *)flatServerData,
-                                 sizeof(flatTopoServer)));
-  FLAGCXCHECK(bootstrapBarrier(comm->bootstrap, rank, nRanks, 0));
-
-  // reorder serverId
-  FLAGCXCHECK(flagcxTopoReorderServerId(flatServerData, nRanks));
-
-  // get unique flatServers
-  std::map<int, flatTopoServer *> flatServerMap;
-  flatServerMap[flatServerData[0].serverId] = &flatServerData[0];
-  int serverCount = 1;
-  for (int i = 1; i < nRanks; i++) {
-    auto it = flatServerMap.find(flatServerData[i].serverId);
-    if (it != flatServerMap.end()) {
-      continue;
+
+  // All ranks of a host detect the same topology, so only the lowest rank of
+  // every host, its leader, sends it. Server ids follow the leader order.
+  std::vector<int> leaders;
+  std::map<uint64_t, int> hostToServer;
+  interServer->rankToServer.resize(nRanks);
+  for (int r = 0; r < nRanks; r++) {
+    auto it = hostToServer.find(comm->peerInfo[r].hostHash);
+    if (it == hostToServer.end()) {
+      it = hostToServer
+               .emplace(comm->peerInfo[r].hostHash, (int)leaders.size())
+               .first;
+      leaders.push_back(r);
     }
-    flatServerMap[flatServerData[i].serverId] = &flatServerData[i];
-    serverCount++;
+    interServer->rankToServer[r] = it->second;
   }
-  // unflatten the flatServers to topoServers
-  flagcxTopoServer *topoServers;
-  FLAGCXCHECK(flagcxCalloc(&topoServers, serverCount));
-  int i = 0;
-  for (auto it = flatServerMap.begin(); it != flatServerMap.end(); ++it, i++) {
-    flatTopoServer *server = it->second;
-    if (server->hostHashes[server->serverId] == currRankHostHash) {
-      // this is the current server, no need to flatten, but neet to change
-      // serverId, and node ids
-      topoServer->serverId = server->serverId;
-      topoServer->nHosts = server->nHosts;
-      memcpy(topoServer->hostHashes, server->hostHashes,
-             sizeof(uint64_t) * FLAGCX_TOPO_MAX_NODES);
-      FLAGCXCHECK(flagcxModifyNodeIds(topoServer, server->serverId));
-      continue;
+  int serverCount = leaders.size();
+  if (serverCount > FLAGCX_TOPO_MAX_NODES) {
+    WARN("INTERSERVER_TOPO: %d servers exceed the limit of %d", serverCount,
+         FLAGCX_TOPO_MAX_NODES);
+    return flagcxInternalError;
+  }
+  int localServer = interServer->rankToServer[rank];
+  int leader = leaders[localServer];
+
+  // the current server keeps its nodes, but needs the new serverId and ids
+  topoServer->serverId = localServer;
+  topoServer->nHosts = serverCount;
+  memset(topoServer->hostHashes, 0, sizeof(topoServer->hostHashes));
+  for (int s = 0; s < serverCount; s++) {
+    // do not consider commHash here
+    topoServer->hostHashes[s] =
+        comm->peerInfo[leaders[s]].hostHash - comm->commHash;
+  }
+  FLAGCXCHECK(flagcxModifyNodeIds(topoServer, localServer));
+
+  std::vector<std::vector<char>> serverData(serverCount);
+  std::vector<size_t> sizes(nRanks, 0);
+  if (rank == leader) {
+    struct topoWriter writer;
+    FLAGCXCHECK(serializeTopoServer(topoServer, &writer));
+    serverData[localServer].swap(writer.buf);
+    sizes[rank] = serverData[localServer].size();
+  }
+  FLAGCXCHECK(bootstrapAllGather(comm->bootstrap, (void *)sizes.data(),
+                                 sizeof(size_t)));
+  size_t remoteBytes = 0;
+  for (int s = 0; s < serverCount; s++) {
+    if (s != localServer) {
+      serverData[s].resize(sizes[leaders[s]]);
+      remoteBytes += sizes[leaders[s]];
     }
-    FLAGCXCHECK(unflattenTopoServer(topoServers + i, server));
-    FLAGCXCHECK(flagcxModifyNodeIds(topoServers + i, server->serverId));
-    // reconstruct paths because we didn't send path info in allgather
-    FLAGCXCHECK(flagcxTopoComputePaths(topoServers + i, comm));
   }
+
+  // Leaders exchange topologies with each other, then forward the remote
+  // ones to the other ranks of their host in a single message
+  std::vector<char> remoteData(remoteBytes);
+  if (rank == leader) {
+    for (int step = 1; step < serverCount; step++) {
+      int sendTo = (localServer + step) % serverCount;
+      int recvFrom = (localServer - step + serverCount) % serverCount;
+      FLAGCXCHECK(bootstrapSend(comm->bootstrap, leaders[sendTo],
+                                FLAGCX_TOPO_EXCHANGE_TAG,
+                                serverData[localServer].data(),
+                                serverData[localServer].size()));
+      FLAGCXCHECK(bootstrapRecv(comm->bootstrap, leaders[recvFrom],
+                                FLAGCX_TOPO_EXCHANGE_TAG,
+                                serverData[recvFrom].data(),
+                                serverData[recvFrom].size()));
+    }
+    size_t offset = 0;
+    for (int s = 0; s < serverCount; s++) {
+      if (s != localServer) {
+        memcpy(remoteData.data() + offset, serverData[s].data(),
+               serverData[s].size());
+        offset += serverData[s].size();
+      }
+    }
+    for (int r = leader + 1; r < nRanks && remoteBytes > 0; r++) {
+      if (interServer->rankToServer[r] == localServer) {
+        FLAGCXCHECK(bootstrapSend(comm->bootstrap, r, FLAGCX_TOPO_EXCHANGE_TAG,
+                                  remoteData.data(), remoteBytes));
+      }
+    }
+  } else if (remoteBytes > 0) {
+    FLAGCXCHECK(bootstrapRecv(comm->bootstrap, leader,
+                              FLAGCX_TOPO_EXCHANGE_TAG, remoteData.data(),
+                              remoteBytes));
+    size_t offset = 0;
+    for (int s = 0; s < serverCount; s++) {
+      if (s != localServer) {
+        memcpy(serverData[s].data(), remoteData.data() + offset,
+               serverData[s].size());
+        offset += serverData[s].size();
+      }
+    }
+  }
+
+  // rebuild remote servers; their paths are computed on first use in
+  // flagcxTopoGetServerFromRank
+  flagcxTopoServer *topoServers;
+  FLAGCXCHECK(flagcxCalloc(&topoServers, serverCount));
   interServer->numServers = serverCount;
-  INFO(FLAGCX_GRAPH, "INTERSERVER_TOPO: numServers = %d", serverCount);
   interServer->servers = topoServers;
+  interServer->pathsReady.assign(serverCount, false);
+  for (int s = 0; s < serverCount; s++) {
+    if (s == localServer) {
+      continue;
+    }
+    struct topoReader reader = {serverData[s].data(), serverData[s].size(), 0};
+    FLAGCXCHECK(deserializeTopoServer(topoServers + s, &reader));
+    if (reader.offset != reader.size) {
+      WARN("INTERSERVER_TOPO: %zu trailing bytes in topology of server %d",
+           reader.size - reader.offset, s);
+      return flagcxInternalError;
+    }
+    topoServers[s].serverId = s;
+    topoServers[s].nHosts = serverCount;
+    memcpy(topoServers[s].hostHashes, topoServer->hostHashes,
+           sizeof(topoServer->hostHashes));
+    FLAGCXCHECK(flagcxModifyNodeIds(topoServers + s, s));
+  }
+  INFO(FLAGCX_GRAPH, "INTERSERVER_TOPO: numServers = %d, received %zu bytes",
+       serverCount, remoteBytes);
   // populate entries of netToServerIdMap
   FLAGCXCHECK(fillNetToServerMap(interServer, topoServer));
 
-  // verify final topoServers
-  // if (rank == 0) {
-  //   for (int i = 0; i < serverCount; i++) {
-  //     if (topoServer->serverId == i) {
-  //       FLAGCXCHECK(flagcxTopoPrint(topoServer));
-  //     } else {
-  //       FLAGCXCHECK(flagcxTopoPrint(topoServers + i));
-  //     }
-  //   }
-  // }
   const char *interserverFile = flagcxGetEnv("FLAGCX_INTERSERVER_ROUTE_FILE");
   if (!interserverFile) {
     INFO(FLAGCX_ENV, "FLAGCX_INTERSERVER_ROUTE_FILE is not set");
-    goto exit; // TODO: need to find a way to determine interserver bw if no
-               // file is provided
+    // TODO: need to find a way to determine interserver bw if no file is
+    // provided
+    return flagcxSuccess;
   }
   // parse the interserver route file
   FLAGCXCHECK(flagcxGetInterServerRouteFromFile(interserverFile, interServer,
                                                 topoServer));
-
-  // record all net guid and serverId mappings
-exit:
-  free(flatServerData);
-  return ret;
+  return flagcxSuccess;
 }
 
 flagcxResult_t
 flagcxTopoGetServerFromRank(int rank, struct flagcxInterServerTopo *interServer,
                             struct flagcxTopoServer *currServer,
                             struct flagcxTopoServer **retServer) {
-  for (int i = 0; i < interServer->numServers; i++) {
-    struct flagcxTopoServer *server =
-        i == currServer->serverId ? currServer : interServer->servers + i;
-    for (int n = 0; n < server->nodes[APU].count; n++) {
-      if (server->nodes[APU].nodes[n].apu.rank == rank) {
-        *retServer = server;
-        return flagcxSuccess;
-      }
-    }
+  if (rank < 0 || rank >= (int)interServer->rankToServer.size()) {
+    return flagcxInternalError;
   }
-  return flagcxInternalError;
+  int serverId = interServer->rankToServer[rank];
+  if (serverId == currServer->serverId) {
+    *retServer = currServer;
+    return flagcxSuccess;
+  }
+  struct flagcxTopoServer *server = interServer->servers + serverId;
+  if (!interServer->pathsReady[serverId]) {
+    // paths were not part of the exchange; comm is not used to compute them
+    FLAGCXCHECK(flagcxTopoComputePaths(server, NULL));
+    interServer->pathsReady[serverId] = true;
+  }
+  *retServer = server;
+  return flagcxSuccess;
 }
@@ -11,6 +11,7 @@
 #include "graph.h"
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #define LOC_BW 5000.0
 #define SM60_NVLINK_BW 18.0
@@ -201,6 +202,8 @@ struct flagcxInterServerTopo {
   std::unordered_map<
       uint64_t, std::unordered_map<uint64_t, struct flagcxInterServerRoute *>>
       routeMap; // {{localNetGuid, {remoteNetGuid, route}}, ...}
+  std::vector<int> rankToServer; // {serverId of rank, ...}
+  std::vector<bool> pathsReady;  // paths of remote servers are computed lazily
   char interServerTopoFile[256];
 };
 
@@ -258,18 +261,6 @@ struct flatTopoNode {
   struct flatTopoLink links[FLAGCX_TOPO_MAX_LINKS];
 };
 
-struct flatTopoNodeSet {
-  int count;
-  struct flatTopoNode nodes[FLAGCX_TOPO_MAX_NODES];
-};
-
-struct flatTopoServer {
-  int serverId;
-  uint64_t hostHashes[FLAGCX_TOPO_MAX_NODES];
-  int nHosts;
-  struct flatTopoNodeSet nodes[FLAGCX_TOPO_NODE_TYPES];
-};
-
 struct flagcxNicDistance {
   int distance;
   uint64_t netGuid;
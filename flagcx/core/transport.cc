@@ -64,26 +64,27 @@ flagcxResult_t flagcxTransportP2pSetup(struct flagcxHeteroComm *comm,
           conn->proxyConn.connection->send = 0;
           conn->proxyConn.connection->transportResources = (void *)resources;
           resources->netDev = comm->netDev;
-          resources->netAdaptor = comm->netAdaptor;
+          resources->netAdaptor = flagcxNetGetPeerAdaptor(comm, peer);
           deviceAdaptor->streamCreate(&resources->cpStream);
           for (int s = 0; s < MAXSTEPS; s++) {
             deviceAdaptor->eventCreate(&resources->cpEvents[s],
                                        flagcxEventDisableTiming);
           }
           resources->buffSizes[0] = REGMRBUFFERSIZE;
-          if (comm->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
-            resources->buffers[0] = (char *)malloc(resources->buffSizes[0]);
+          if (flagcxNetIsHostStaged(resources->netAdaptor)) {
+            resources->buffers[0] = (char *)flagcxNumaAlloc(
+                resources->buffSizes[0], comm->affinity.numaNode);
             if (!resources->buffers[0]) {
               return flagcxSystemError;
             }
-          } else if (comm->netAdaptor == getUnifiedNetAdaptor(IBRC)) {
+          } else if (resources->netAdaptor == getUnifiedNetAdaptor(IBRC)) {
             deviceAdaptor->gdrMemAlloc((void **)&resources->buffers[0],
                                        resources->buffSizes[0], NULL);
           }
           struct flagcxIbHandle *handle = NULL;
           FLAGCXCHECK(flagcxCalloc(&handle, 1));
-          comm->netAdaptor->listen(resources->netDev, (void *)handle,
-                                   &resources->netListenComm);
+          resources->netAdaptor->listen(resources->netDev, (void *)handle,
+                                        &resources->netListenComm);
           bootstrapSend(comm->bootstrap, peer, 1001 + c, (void *)handle,
                         sizeof(flagcxIbHandle));
           FLAGCXCHECK(flagcxProxyCallAsync(
@@ -130,19 +131,20 @@ flagcxResult_t flagcxTransportP2pSetup(struct flagcxHeteroComm *comm,
           conn->proxyConn.connection->transport = TRANSPORT_NET;
           conn->proxyConn.connection->transportResources = (void *)resources;
           resources->netDev = comm->netDev;
-          resources->netAdaptor = comm->netAdaptor;
+          resources->netAdaptor = flagcxNetGetPeerAdaptor(comm, peer);
           deviceAdaptor->streamCreate(&resources->cpStream);
           for (int s = 0; s < MAXSTEPS; s++) {
             deviceAdaptor->eventCreate(&resources->cpEvents[s],
                                        flagcxEventDisableTiming);
           }
           resources->buffSizes[0] = REGMRBUFFERSIZE;
-          if (comm->netAdaptor == getUnifiedNetAdaptor(SOCKET)) {
-            resources->buffers[0] = (char *)malloc(resources->buffSizes[0]);
+          if (flagcxNetIsHostStaged(resources->netAdaptor)) {
+            resources->buffers[0] = (char *)flagcxNumaAlloc(
+                resources->buffSizes[0], comm->affinity.numaNode);
             if (!resources->buffers[0]) {
               return flagcxSystemError;
             }
-          } else if (comm->netAdaptor == getUnifiedNetAdaptor(IBRC)) {
+          } else if (resources->netAdaptor == getUnifiedNetAdaptor(IBRC)) {
             deviceAdaptor->gdrMemAlloc((void **)&resources->buffers[0],
                                        resources->buffSizes[0], NULL);
           }
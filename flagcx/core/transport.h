@@ -38,6 +38,7 @@ struct flagcxPeerInfo {
   uint64_t hostHash;
   uint64_t pidHash;
   dev_t shmDev;
+  uint64_t shmDomain; // flagcxNetShmDomain()
   int64_t busId;
   struct flagcxHeteroComm *comm;
   int cudaCompCap;
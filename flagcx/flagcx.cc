@@ -1,25 +1,32 @@
 #include "flagcx.h"
 #include "adaptor.h"
 #include "alloc.h"
+#include "bintrace.h"
 #include "bootstrap.h"
 #include "c2c_algo.h"
 #include "check.h"
 #include "cluster.h"
 #include "comm.h"
+#include "config.h"
 #include "cost_model.h"
 #include "flagcx_hetero.h"
 #include "flagcx_tuner.h"
+#include "latency.h"
 #include "launch_kernel.h"
+#include "net.h"
 #include "param.h"
 #include "proxy.h"
 #include "reg_pool.h"
+#include "timeline.h"
 #include "utils.h"
 
 #include "timer.h"
+#include <algorithm>
 #include <cassert>
 #include <stdio.h>
 #include <string.h>
 #include <unordered_map>
+#include <vector>
 
 #define FLAGCX_CACHE_CAPACITY 16
 static flagcxLRUCache<size_t, flagcxC2cPlanner>
@@ -110,20 +117,169 @@ bool isHomoComm(flagcxComm_t comm) {
 #endif
 }
 
-bool useHostComm() {
-  const char *useHostComm = getenv("FLAGCX_USE_HOST_COMM");
-  if (useHostComm) {
-    return std::stoi(useHostComm) == 1;
+static bool useHostComm(flagcxComm_t comm) {
+  return comm->config.useHostComm;
+}
+
+static bool useHeteroComm(flagcxComm_t comm) {
+  return comm->config.useHeteroComm;
+}
+
+// Hetero AllGather and Gather of at most this many bytes per rank go through
+// the cluster leaders. Larger ones send every block directly, which spreads
+// the inter-cluster traffic over all ranks. 0 disables the hierarchical path.
+FLAGCX_PARAM(HeteroHierMaxBytes, "HETERO_HIER_MAX_BYTES", 8 << 20);
+
+static bool useHeteroHier(flagcxComm_t comm, size_t bytes) {
+  int64_t maxBytes = flagcxParamHeteroHierMaxBytes();
+  return maxBytes > 0 && bytes <= (size_t)maxBytes && comm->tuner == NULL &&
+         comm->homo_comm != NULL;
+}
+
+// First global rank of a cluster. The ranks of a cluster are contiguous and
+// in homo rank order, see flagcxCommInitRank. The hierarchical hetero
+// collectives use it as the cluster leader: cluster_inter_ranks is only
+// elected for the C2C path and is unset with FLAGCX_USE_HETERO_COMM.
+static int clusterStart(flagcxComm_t comm, int cluster) {
+  int start = 0;
+  for (int c = 0; c < cluster; c++) {
+    start += comm->cluster_sizes[c];
   }
-  return false;
+  return start;
 }
 
-bool useHeteroComm() {
-  const char *useHeteroComm = flagcxGetEnv("FLAGCX_USE_HETERO_COMM");
-  if (useHeteroComm) {
-    return std::stoi(useHeteroComm) == 1;
+// flagcxHeteroSend that accounts the messages and bytes leaving the cluster
+static flagcxResult_t heteroSend(flagcxComm_t comm, const void *sendbuff,
+                                 size_t count, flagcxDataType_t datatype,
+                                 int peer, flagcxStream_t stream) {
+  if (comm->cluster_ids[peer] != comm->cluster_ids[comm->rank]) {
+    comm->interClusterMsgs++;
+    comm->interClusterBytes += count * getFlagcxDataTypeSize(datatype);
   }
-  return false;
+  return flagcxHeteroSend(sendbuff, count, datatype, peer, comm->hetero_comm,
+                          stream);
+}
+
+// Hierarchical hetero AllGather. Every cluster gathers the blocks of its
+// ranks at its leader with the homo CCL, the leaders pass the cluster blocks
+// around a ring, and every leader broadcasts the result in its cluster. A
+// leader only connects to its two ring neighbours, and each cluster block
+// crosses nclusters - 1 inter-cluster links instead of every rank sending
+// its block to every rank of the other clusters.
+static flagcxResult_t heteroHierAllGather(const void *sendbuff, void *recvbuff,
+                                          size_t count,
+                                          flagcxDataType_t datatype,
+                                          flagcxComm_t comm,
+                                          flagcxStream_t stream) {
+  size_t size = count * getFlagcxDataTypeSize(datatype);
+  char *buffer = static_cast<char *>(recvbuff);
+  int nclusters = comm->nclusters;
+  int cid = comm->cluster_ids[comm->rank];
+  FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->gather(
+      sendbuff, buffer + clusterStart(comm, cid) * size, count, datatype,
+      0, comm->homo_comm, stream));
+  if (comm->homo_rank == 0) {
+    int next = clusterStart(comm, (cid + 1) % nclusters);
+    int prev = clusterStart(comm, (cid + nclusters - 1) % nclusters);
+    for (int step = 0; step < nclusters - 1; step++) {
+      int sendCid = (cid - step + nclusters) % nclusters;
+      int recvCid = (cid - step - 1 + nclusters) % nclusters;
+      FLAGCXCHECK(flagcxHeteroGroupStart());
+      FLAGCXCHECK(heteroSend(comm, buffer + clusterStart(comm, sendCid) * size,
+                             count * comm->cluster_sizes[sendCid], datatype,
+                             next, stream));
+      FLAGCXCHECK(flagcxHeteroRecv(
+          buffer + clusterStart(comm, recvCid) * size,
+          count * comm->cluster_sizes[recvCid], datatype, prev,
+          comm->hetero_comm, stream));
+      FLAGCXCHECK(flagcxHeteroGroupEnd());
+    }
+  }
+  FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->broadcast(
+      recvbuff, recvbuff, count * comm->nranks, datatype, 0, comm->homo_comm,
+      stream));
+  return flagcxSuccess;
+}
+
+// Device buffer a cluster leader gathers its block into, kept on the comm
+// and grown on demand. Its last use may still be in flight on another
+// stream, which must wait for it, and it is only reallocated once idle.
+static flagcxResult_t getGatherScratch(flagcxComm_t comm, size_t size,
+                                       flagcxStream_t stream, void **buff) {
+  if (comm->gatherScratchEvent == NULL) {
+    FLAGCXCHECK(deviceAdaptor->eventCreate(&comm->gatherScratchEvent,
+                                           flagcxEventDisableTiming));
+  } else if (size > comm->gatherScratchSize) {
+    FLAGCXCHECK(deviceAdaptor->eventSynchronize(comm->gatherScratchEvent));
+  } else {
+    FLAGCXCHECK(
+        deviceAdaptor->streamWaitEvent(stream, comm->gatherScratchEvent));
+  }
+  if (size > comm->gatherScratchSize) {
+    // At least double it, so that growing sizes reallocate only a few times
+    size_t newSize = std::max(size, 2 * comm->gatherScratchSize);
+    FLAGCXCHECK(deviceAdaptor->deviceFree(comm->gatherScratch,
+                                          flagcxMemDevice, NULL));
+    comm->gatherScratch = NULL;
+    comm->gatherScratchSize = 0;
+    FLAGCXCHECK(deviceAdaptor->deviceMalloc(&comm->gatherScratch, newSize,
+                                            flagcxMemDevice, NULL));
+    comm->gatherScratchSize = newSize;
+    INFO(FLAGCX_ALLOC, "rank %d gather scratch grown to %zu bytes",
+         comm->rank, newSize);
+  }
+  *buff = comm->gatherScratch;
+  return flagcxSuccess;
+}
+
+// Hierarchical hetero Gather. The cluster of the root gathers at the root
+// with the homo CCL. Every other cluster gathers at its leader, which sends
+// the whole cluster block to the root in one message.
+static flagcxResult_t heteroHierGather(const void *sendbuff, void *recvbuff,
+                                       size_t count, flagcxDataType_t datatype,
+                                       int root, flagcxComm_t comm,
+                                       flagcxStream_t stream) {
+  size_t size = count * getFlagcxDataTypeSize(datatype);
+  char *buffer = static_cast<char *>(recvbuff);
+  int cid = comm->cluster_ids[comm->rank];
+  int rootCid = comm->cluster_ids[root];
+  if (cid == rootCid) {
+    void *clusterBuff =
+        comm->rank == root ? buffer + clusterStart(comm, cid) * size : NULL;
+    FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->gather(
+        sendbuff, clusterBuff, count, datatype, comm->globalrank2homorank[root],
+        comm->homo_comm, stream));
+    if (comm->rank == root && comm->nclusters > 1) {
+      FLAGCXCHECK(flagcxHeteroGroupStart());
+      for (int c = 0; c < comm->nclusters; c++) {
+        if (c == cid) {
+          continue;
+        }
+        FLAGCXCHECK(flagcxHeteroRecv(buffer + clusterStart(comm, c) * size,
+                                     count * comm->cluster_sizes[c], datatype,
+                                     clusterStart(comm, c), comm->hetero_comm,
+                                     stream));
+      }
+      FLAGCXCHECK(flagcxHeteroGroupEnd());
+    }
+    return flagcxSuccess;
+  }
+
+  bool isLeader = comm->homo_rank == 0;
+  size_t clusterSize = size * comm->cluster_sizes[cid];
+  void *clusterBuff = NULL;
+  if (isLeader) {
+    FLAGCXCHECK(getGatherScratch(comm, clusterSize, stream, &clusterBuff));
+  }
+  FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->gather(
+      sendbuff, clusterBuff, count, datatype, 0, comm->homo_comm, stream));
+  if (isLeader) {
+    FLAGCXCHECK(heteroSend(comm, clusterBuff,
+                           count * comm->cluster_sizes[cid], datatype, root,
+                           stream));
+    FLAGCXCHECK(deviceAdaptor->eventRecord(comm->gatherScratchEvent, stream));
+  }
+  return flagcxSuccess;
 }
 
 flagcxResult_t flagcxHandleInit(flagcxHandlerGroup_t *handler) {
@@ -261,6 +417,102 @@ const char *flagcxGetLastError(flagcxComm_t comm) {
   return "Not implemented.";
 }
 
+// Per-rank metadata exchanged by flagcxCommInitRank. Everything a rank knows
+// about itself before any communicator exists goes into one record, so that
+// init needs a single bootstrap allgather for it. The record travels in a
+// slot whose size never changes, so ranks built from different versions
+// still complete the allgather and are then rejected on the version. Append
+// new fields at the end and bump the version.
+#define FLAGCX_INIT_RECORD_VERSION 3
+#define FLAGCX_INIT_RECORD_SLOT 512
+struct flagcxInitRankRecord {
+  uint32_t version;
+  uint32_t size;
+  flagcxVendor vendor;
+  uint32_t timeline; // FLAGCX_TIMELINE_ENABLE, clocks are aligned if all set
+  uint64_t shmDomain; // flagcxNetShmDomain(), for the hetero communicator
+};
+static_assert(sizeof(struct flagcxInitRankRecord) <= FLAGCX_INIT_RECORD_SLOT,
+              "flagcxInitRankRecord outgrew its allgather slot");
+
+union flagcxInitRankSlot {
+  struct flagcxInitRankRecord record;
+  char pad[FLAGCX_INIT_RECORD_SLOT];
+};
+
+// Unique ids of the inner communicators, each one only filled in by the rank
+// that generated it
+struct flagcxInitIdRecord {
+  flagcxUniqueId homoId;      // homo root ranks, without tuner
+  flagcxUniqueId heteroId;    // rank 0
+  flagcxUniqueId homoInterId; // homo inter root rank
+};
+
+// Experimental for multi-nic support
+// Pick the ranks closest to a nic in each cluster as homo inter ranks
+static void flagcxSetupHomoInterRanks(flagcxComm_t comm,
+                                      struct flagcxNicDistance *nicDistanceData,
+                                      int *clusterIdData) {
+  int rank = comm->rank;
+  int nranks = comm->nranks;
+  comm->clusterInterRankList.resize(comm->nclusters);
+  for (int i = 0; i < comm->nclusters; ++i) {
+    int minDistance = INT_MAX;
+    std::unordered_map<int, std::vector<int>> nicDistanceToRanks;
+    std::unordered_map<int, std::unordered_set<uint64_t>> nicDistanceToNic;
+    for (int j = 0; j < nranks; ++j) {
+      if (clusterIdData[j] != i) {
+        continue;
+      }
+      int val = nicDistanceData[j].distance;
+      uint64_t netGuid = nicDistanceData[j].netGuid;
+      if (nicDistanceToNic[val].find(netGuid) == nicDistanceToNic[val].end()) {
+        nicDistanceToRanks[val].push_back(j);
+        nicDistanceToNic[val].insert(netGuid);
+      }
+      minDistance = std::min(minDistance, val);
+    }
+    comm->clusterInterRankList[i] = std::move(nicDistanceToRanks[minDistance]);
+  }
+  // Set homoInterMyRank, homoInterRootRank and homoInterRanks
+  auto &myClusterInterRanks = comm->clusterInterRankList[clusterIdData[rank]];
+  for (size_t i = 0; i < myClusterInterRanks.size(); ++i) {
+    if (rank == myClusterInterRanks[i]) {
+      comm->homoInterMyRank = i;
+    }
+  }
+  if (comm->homoInterMyRank != -1) {
+    comm->homoInterRootRank = myClusterInterRanks[0];
+    comm->homoInterRanks = myClusterInterRanks.size();
+  }
+}
+
+// Release what a flagcxCommInitRank that failed half way set up, including
+// the comm itself
+static void flagcxCommInitFree(flagcxComm_t comm) {
+  if (comm->homoInterComm != NULL)
+    cclAdaptors[flagcxCCLAdaptorDevice]->commDestroy(comm->homoInterComm);
+  if (comm->host_comm != NULL)
+    cclAdaptors[flagcxCCLAdaptorHost]->commDestroy(comm->host_comm);
+  if (comm->hetero_comm != NULL)
+    flagcxHeteroCommDestroy(comm->hetero_comm);
+  if (comm->homo_comm != NULL)
+    cclAdaptors[flagcxCCLAdaptorDevice]->commDestroy(comm->homo_comm);
+  if (comm->tuner != NULL && comm->tunerContext != NULL)
+    comm->tuner->destroy(comm->tunerContext);
+  free(comm->uniqueIdData);
+  free(comm->cluster_ids);
+  free(comm->cluster_sizes);
+  free(comm->cluster_inter_ranks);
+  free(comm->globalrank2homorank);
+  bootstrapAbort(comm->bootstrap);
+  free(comm);
+}
+
+static flagcxResult_t flagcxCommInitRankSetup(flagcxComm_t *comm, int nranks,
+                                              flagcxUniqueId_t commId,
+                                              int rank);
+
 flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
                                   flagcxUniqueId_t commId, int rank) {
   if (nranks < 1 || rank < 0 || rank >= nranks) {
@@ -269,7 +521,21 @@ flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
   }
 
   (*comm) = NULL;
-  flagcxCalloc(comm, 1);
+  FLAGCXCHECK(flagcxCalloc(comm, 1));
+  flagcxResult_t res = flagcxCommInitRankSetup(comm, nranks, commId, rank);
+  if (res != flagcxSuccess) {
+    flagcxCommInitFree(*comm);
+    *comm = NULL;
+  }
+  return res;
+}
+
+// Everything flagcxCommInitRank does past allocating the comm. On failure it
+// may return at any point: what the comm holds is released by the caller,
+// the temporaries are released here.
+static flagcxResult_t flagcxCommInitRankSetup(flagcxComm_t *comm, int nranks,
+                                              flagcxUniqueId_t commId,
+                                              int rank) {
   (*comm)->rank = rank;
   (*comm)->nranks = nranks;
   (*comm)->nclusters = -1;
@@ -283,10 +549,16 @@ flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
   (*comm)->host_comm = NULL;
   (*comm)->homo_comm = NULL;
   (*comm)->hetero_comm = NULL;
+  (*comm)->interClusterMsgs = 0;
+  (*comm)->interClusterBytes = 0;
+  (*comm)->gatherScratch = NULL;
+  (*comm)->gatherScratchSize = 0;
+  (*comm)->gatherScratchEvent = NULL;
   (*comm)->cluster_ids = NULL;
   (*comm)->cluster_sizes = NULL;
   (*comm)->cluster_inter_ranks = NULL;
   (*comm)->globalrank2homorank = NULL;
+  (*comm)->config = *flagcxConfigGet();
   (*comm)->comm_type = flagcxCommunicatorUnknown;
   (*comm)->homoInterRootRank = -1;
   (*comm)->homoInterMyRank = -1;
@@ -298,59 +570,89 @@ flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
   state->rank = rank;
   state->nranks = nranks;
   state->abortFlag = (*comm)->abortFlag;
-  (*comm)->bootstrap = state;
   state->magic = ((struct flagcxBootstrapHandle *)commId)->magic;
   (*comm)->magic = ((struct flagcxBootstrapHandle *)commId)->magic;
 
   // Init bootstrap net
-  FLAGCXCHECK(bootstrapNetInit());
-
-  // Init bootstrap state
-  FLAGCXCHECK(bootstrapInit((struct flagcxBootstrapHandle *)commId, state));
+  flagcxResult_t res = bootstrapNetInit();
+
+  // Init bootstrap state; the comm only owns it once its sockets exist
+  if (res == flagcxSuccess)
+    res = bootstrapInit((struct flagcxBootstrapHandle *)commId, state);
+  if (res != flagcxSuccess) {
+    free(state);
+    return res;
+  }
+  (*comm)->bootstrap = state;
 
   // Ready to detect heterogeneous/homogeneous communicator
-  // Use bootstrap allgather to exchange Device info
-  flagcxVendor *vendorData =
-      NULL; // temp data used for device vendor gather operation.
-
-  // Get current gpu vendor
-  flagcxVendor vendor;
-  deviceAdaptor->getVendor(vendor.internal);
-  FLAGCXCHECK(flagcxCalloc(&vendorData, nranks));
-  memcpy(vendorData + rank, &vendor, sizeof(flagcxVendor));
-  FLAGCXCHECK(
-      bootstrapAllGather(state, (void *)vendorData, sizeof(flagcxVendor)));
-  FLAGCXCHECK(bootstrapBarrier(state, rank, nranks, 0));
+  // Exchange everything this rank knows about itself in a single allgather
+  uint64_t initStart = clockNano();
+  std::vector<union flagcxInitRankSlot> rankSlots(nranks);
+  struct flagcxInitRankRecord *myRecord = &rankSlots[rank].record;
+  myRecord->version = FLAGCX_INIT_RECORD_VERSION;
+  myRecord->size = sizeof(struct flagcxInitRankRecord);
+  deviceAdaptor->getVendor(myRecord->vendor.internal);
+  myRecord->timeline = flagcxTimelineOn();
+  myRecord->shmDomain = flagcxNetShmDomain();
+  FLAGCXCHECK(bootstrapAllGather(state, (void *)rankSlots.data(),
+                                 sizeof(union flagcxInitRankSlot)));
+  for (int i = 0; i < nranks; ++i) {
+    struct flagcxInitRankRecord *record = &rankSlots[i].record;
+    if (record->version != FLAGCX_INIT_RECORD_VERSION ||
+        record->size != sizeof(struct flagcxInitRankRecord)) {
+      WARN("Rank %d uses init record version %u size %u, expected version %u "
+           "size %zu; all ranks must run the same FlagCX version",
+           i, record->version, record->size, FLAGCX_INIT_RECORD_VERSION,
+           sizeof(struct flagcxInitRankRecord));
+      return flagcxInvalidUsage;
+    }
+  }
+  std::vector<flagcxVendor> vendorData(nranks);
+  std::vector<uint64_t> shmDomains(nranks);
+  int timelineRanks = 0;
+  for (int i = 0; i < nranks; ++i) {
+    vendorData[i] = rankSlots[i].record.vendor;
+    timelineRanks += rankSlots[i].record.timeline ? 1 : 0;
+    shmDomains[i] = rankSlots[i].record.shmDomain;
+  }
+  if (timelineRanks == nranks) {
+    FLAGCXCHECK(flagcxTimelineAlignClock(state, rank, nranks));
+  } else if (timelineRanks > 0 && rank == 0) {
+    WARN("FLAGCX_TIMELINE_ENABLE is only set on %d of %d ranks, timelines "
+         "are not aligned",
+         timelineRanks, nranks);
+  }
 
-  // Init cluster info
+  // Init cluster info, every rank derives the same layout from vendorData
   int *globalRankToHomoRankData;
   int *clusterIdData;
-  int *clusterInterRankData;
+  std::vector<int> homoRootRankData(nranks);
+  std::vector<int> homoRanksData(nranks);
+  std::vector<int> clusterInterRankData(nranks);
   FLAGCXCHECK(flagcxCalloc(&globalRankToHomoRankData, nranks));
+  (*comm)->globalrank2homorank = globalRankToHomoRankData;
   FLAGCXCHECK(flagcxCalloc(&clusterIdData, nranks));
-  FLAGCXCHECK(flagcxCalloc(&clusterInterRankData, nranks));
+  (*comm)->cluster_ids = clusterIdData;
   FLAGCXCHECK(flagcxCollectClusterInfos(
-      vendorData, &(*comm)->comm_type, globalRankToHomoRankData + rank,
-      &(*comm)->homo_root_rank, &(*comm)->homo_ranks, clusterIdData + rank,
-      clusterInterRankData + rank, &(*comm)->nclusters, rank, nranks));
-  FLAGCXCHECK(
-      bootstrapAllGather(state, (void *)globalRankToHomoRankData, sizeof(int)));
-  FLAGCXCHECK(bootstrapAllGather(state, (void *)clusterIdData, sizeof(int)));
-  FLAGCXCHECK(
-      bootstrapAllGather(state, (void *)clusterInterRankData, sizeof(int)));
-  FLAGCXCHECK(bootstrapBarrier(state, rank, nranks, 0));
+      vendorData.data(), &(*comm)->comm_type, globalRankToHomoRankData,
+      homoRootRankData.data(), homoRanksData.data(), clusterIdData,
+      clusterInterRankData.data(), &(*comm)->nclusters, nranks));
   (*comm)->homo_rank = globalRankToHomoRankData[rank];
-  (*comm)->cluster_ids = clusterIdData;
-  (*comm)->globalrank2homorank = globalRankToHomoRankData;
+  (*comm)->homo_root_rank = homoRootRankData[rank];
+  (*comm)->homo_ranks = homoRanksData[rank];
 
   // fill clusterVendorMap
-  FLAGCXCHECK(flagcxFillClusterVendorInfo(vendorData, (*comm), clusterIdData,
-                                          nranks, (*comm)->nclusters));
+  FLAGCXCHECK(flagcxFillClusterVendorInfo(vendorData.data(), (*comm),
+                                          clusterIdData, nranks,
+                                          (*comm)->nclusters));
 
   int *clusterSizes;
   int *clusterInterRanks;
   FLAGCXCHECK(flagcxCalloc(&clusterSizes, (*comm)->nclusters));
+  (*comm)->cluster_sizes = clusterSizes;
   FLAGCXCHECK(flagcxCalloc(&clusterInterRanks, (*comm)->nclusters));
+  (*comm)->cluster_inter_ranks = clusterInterRanks;
   for (int i = 0; i < (*comm)->nclusters; ++i) {
     clusterInterRanks[i] = -1;
   }
@@ -365,14 +667,12 @@ flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
     }
   }
   clusterSizes[cid] = nranks - sum;
-  (*comm)->cluster_sizes = clusterSizes;
 
   for (int i = 0; i < nranks; ++i) {
     if (clusterInterRankData[i] != -1) {
       clusterInterRanks[clusterIdData[i]] = clusterInterRankData[i];
     }
   }
-  (*comm)->cluster_inter_ranks = clusterInterRanks;
 
   int start = 0;
   if (clusterIdData[rank] >= 1) {
@@ -396,17 +696,60 @@ flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
     (*comm)->has_single_rank_homo_comm = 0;
   }
 
-  flagcxUniqueId *uniqueIdData;
-  FLAGCXCHECK(flagcxCalloc(&uniqueIdData, nranks));
+  bool useTuner = (*comm)->config.useTuner;
+  INFO(FLAGCX_INIT, "Flagcx USE_TUNER flag set to %d", useTuner);
+
+  bool initHetero = !isHomoComm(*comm) || useHeteroComm(*comm);
+  // nic distance is only available after topo detection, i.e. once the
+  // hetero comm exists, and has to be exchanged separately then
+  bool topoDetect = (*comm)->config.topoDetect;
+  std::vector<struct flagcxNicDistance> nicDistanceData;
+  if (initHetero) {
+    nicDistanceData.resize(nranks);
+    if (!topoDetect) {
+      for (int i = 0; i < nranks; ++i) {
+        nicDistanceData[i].distance = i % 2 + 1;
+        nicDistanceData[i].netGuid = i; // give a dummy value
+      }
+      flagcxSetupHomoInterRanks(*comm, nicDistanceData.data(), clusterIdData);
+    }
+  }
 
-  // Tuner init
-  bool useTuner = false;
-  const char *useTunerEnv = flagcxGetEnv("FLAGCX_USE_TUNER");
-  if (useTunerEnv) {
-    useTuner = (std::stoi(useTunerEnv) == 1) ? true : false;
+  // Second and last exchange: the unique ids this rank is the root of. Each
+  // rank generates only the ids it owns, so only one allgather is needed for
+  // the homo, hetero and homo inter communicators together.
+  bool needHomoId = !useTuner;
+  bool needHeteroId = initHetero;
+  bool needHomoInterId = initHetero && !topoDetect;
+  std::vector<struct flagcxInitIdRecord> idRecords;
+  if (needHomoId || needHeteroId || needHomoInterId) {
+    idRecords.resize(nranks);
+    struct flagcxInitIdRecord *mine = &idRecords[rank];
+    if (needHomoId && (*comm)->homo_rank == 0) {
+      memset((void *)commId, 0, sizeof(flagcxUniqueId));
+      FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->getUniqueId(&commId));
+      memcpy((void *)&mine->homoId, (void *)commId, sizeof(flagcxUniqueId));
+    }
+    if (needHeteroId && rank == 0) {
+      memset((void *)commId, 0, sizeof(flagcxUniqueId));
+      FLAGCXCHECK(flagcxHeteroGetUniqueId(commId));
+      memcpy((void *)&mine->heteroId, (void *)commId, sizeof(flagcxUniqueId));
+    }
+    if (needHomoInterId && rank == (*comm)->homoInterRootRank) {
+      memset((void *)commId, 0, sizeof(flagcxUniqueId));
+      FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->getUniqueId(&commId));
+      memcpy((void *)&mine->homoInterId, (void *)commId,
+             sizeof(flagcxUniqueId));
+    }
+    FLAGCXCHECK(bootstrapAllGather(state, (void *)idRecords.data(),
+                                   sizeof(struct flagcxInitIdRecord)));
   }
-  INFO(FLAGCX_INIT, "Flagcx USE_TUNER flag set to %d", useTuner);
+  INFO(FLAGCX_INIT, "rank %d nranks %d - init metadata exchanged in %.2fms",
+       rank, nranks, (clockNano() - initStart) / 1e6);
+
   if (useTuner) {
+    flagcxUniqueId *uniqueIdData;
+    FLAGCXCHECK(flagcxCalloc(&uniqueIdData, nranks));
     (*comm)->tuner = &internalTuner;
     (*comm)->tuner->bootstrap = state;
     (*comm)->tuner->rank = rank;
@@ -423,89 +766,59 @@ flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
       WARN("Tuner returned 0 candidates, at least 1 is required.");
       return flagcxInternalError;
     }
+    (*comm)->homoCommPool.clear();
     (*comm)->homoCommMap.clear();
     (*comm)->homoBestCommMap.clear();
+    (*comm)->homoCommStreams.clear();
+    (*comm)->homoCommRetired.clear();
   } else {
     (*comm)->tuner = NULL;
-    FLAGCXCHECK(flagcxHomoCommInit(commId, uniqueIdData, state, *comm,
-                                   &((*comm)->homo_comm)));
+    memcpy((void *)commId, (void *)&idRecords[(*comm)->homo_root_rank].homoId,
+           sizeof(flagcxUniqueId));
+    FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->commInitRank(
+        &(*comm)->homo_comm, (*comm)->homo_ranks, commId, (*comm)->homo_rank,
+        NULL));
   }
 
-  if (!isHomoComm(*comm) || useHeteroComm()) {
-    // Reset commId and hetero root rank calls flagcxHeteroGetUniqueId
-    memset((void *)commId, 0, sizeof(flagcxUniqueId));
-    memset((void *)uniqueIdData, 0, nranks * sizeof(flagcxUniqueId));
-    if (rank == 0) {
-      flagcxHeteroGetUniqueId(commId);
-      memcpy((void *)&uniqueIdData[0], (void *)commId, sizeof(flagcxUniqueId));
-    }
-    FLAGCXCHECK(bootstrapAllGather(state, (void *)uniqueIdData,
-                                   sizeof(flagcxUniqueId)));
-    FLAGCXCHECK(bootstrapBarrier(state, rank, nranks, 0));
-
-    memcpy((void *)commId, (void *)&uniqueIdData[0], sizeof(flagcxUniqueId));
+  if (initHetero) {
+    memcpy((void *)commId, (void *)&idRecords[0].heteroId,
+           sizeof(flagcxUniqueId));
     // call flagcxHeteroCommInitRank
     FLAGCXCHECK(
         flagcxHeteroCommInitRank(&(*comm)->hetero_comm, nranks, *commId, rank));
+    (*comm)->hetero_comm->deviceFuncRelaxedOrdering =
+        (*comm)->config.deviceFuncRelaxedOrdering;
+    // initTransportsRank already set them when it exchanged the peer info
+    if ((*comm)->hetero_comm->shmDomains == NULL)
+      FLAGCXCHECK(
+          flagcxNetShmSetDomains((*comm)->hetero_comm, shmDomains.data()));
 
     // Init host cclAdaptor
-    if (useHostComm() || (*comm)->has_single_rank_homo_comm) {
+    if (useHostComm(*comm) || (*comm)->has_single_rank_homo_comm) {
       FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorHost]->commInitRank(
           &(*comm)->host_comm, nranks, commId, rank, state));
     }
-  }
 
-  if (!isHomoComm(*comm) || useHeteroComm()) {
     // Experimental for multi-nic support
-    // Collect nic distance to ranks
-    (*comm)->clusterInterRankList.resize((*comm)->nclusters);
-    struct flagcxNicDistance *nicDistanceData;
-    FLAGCXCHECK(flagcxCalloc(&nicDistanceData, nranks));
-    const char *enableTopoDetect = flagcxGetEnv("FLAGCX_ENABLE_TOPO_DETECT");
-    if (enableTopoDetect && (strcmp(enableTopoDetect, "TRUE") == 0 ||
-                             strcmp(enableTopoDetect, "True") ==
-                                 0)) { // safety check nic distance is only
-                                       // available after topo detection
+    if (topoDetect) {
+      // Collect nic distance to ranks
       FLAGCXCHECK(flagcxGetNicDistance((*comm)->hetero_comm->topoServer, rank,
-                                       nicDistanceData + rank));
-    } else {
-      nicDistanceData[rank].distance = rank % 2 + 1;
-      nicDistanceData[rank].netGuid = rank; // give a dummy value
-    }
-    FLAGCXCHECK(bootstrapAllGather(state, (void *)nicDistanceData,
-                                   sizeof(flagcxNicDistance)));
-    FLAGCXCHECK(bootstrapBarrier(state, rank, nranks, 0));
-    for (int i = 0; i < (*comm)->nclusters; ++i) {
-      int minDistance = INT_MAX;
-      std::unordered_map<int, std::vector<int>> nicDistanceToRanks;
-      std::unordered_map<int, std::unordered_set<uint64_t>> nicDistanceToNic;
-      for (int j = 0; j < nranks; ++j) {
-        if (clusterIdData[j] != i) {
-          continue;
-        }
-        int val = nicDistanceData[j].distance;
-        uint64_t netGuid = nicDistanceData[j].netGuid;
-        if (nicDistanceToNic[val].find(netGuid) ==
-            nicDistanceToNic[val].end()) {
-          nicDistanceToRanks[val].push_back(j);
-          nicDistanceToNic[val].insert(netGuid);
-        }
-        minDistance = std::min(minDistance, val);
-      }
-      (*comm)->clusterInterRankList[i] =
-          std::move(nicDistanceToRanks[minDistance]);
-    }
-    // Set homoInterMyRank, homoInterRootRank and homoInterRanks
-    auto &myClusterInterRanks =
-        (*comm)->clusterInterRankList[clusterIdData[rank]];
-    for (size_t i = 0; i < myClusterInterRanks.size(); ++i) {
-      if (rank == myClusterInterRanks[i]) {
-        (*comm)->homoInterMyRank = i;
+                                       &nicDistanceData[rank]));
+      FLAGCXCHECK(bootstrapAllGather(state, (void *)nicDistanceData.data(),
+                                     sizeof(flagcxNicDistance)));
+      flagcxSetupHomoInterRanks(*comm, nicDistanceData.data(), clusterIdData);
+      // Let homoInterRootRank call underlying GetUniqueId function
+      // for initialization of homo inter communicator
+      memset((void *)idRecords.data(), 0,
+             nranks * sizeof(struct flagcxInitIdRecord));
+      if (rank == (*comm)->homoInterRootRank) {
+        memset((void *)commId, 0, sizeof(flagcxUniqueId));
+        FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->getUniqueId(&commId));
+        memcpy((void *)&idRecords[rank].homoInterId, (void *)commId,
+               sizeof(flagcxUniqueId));
       }
-    }
-    if ((*comm)->homoInterMyRank != -1) {
-      (*comm)->homoInterRootRank = myClusterInterRanks[0];
-      (*comm)->homoInterRanks = myClusterInterRanks.size();
+      FLAGCXCHECK(bootstrapAllGather(state, (void *)idRecords.data(),
+                                     sizeof(struct flagcxInitIdRecord)));
     }
 
     INFO(
@@ -525,30 +838,15 @@ flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
         (*comm)->homoInterRanks);
 
     // Experimental for multi-nic support
-    // Reset commId and homo inter root rank calls underlying GetUniqueId
-    // function for initialization of homo inter communicator
-    memset((void *)commId, 0, sizeof(flagcxUniqueId));
-    memset((void *)uniqueIdData, 0, nranks * sizeof(flagcxUniqueId));
-    // Let homoInterRootRank call underlying GetUniqueId function
-    // for initialization of homo inter communicator
-    if (rank == (*comm)->homoInterRootRank) {
-      cclAdaptors[flagcxCCLAdaptorDevice]->getUniqueId(&commId);
-      memcpy((void *)&uniqueIdData[rank], (void *)commId,
-             sizeof(flagcxUniqueId));
-    }
-    // Collect uniqueIdData globally
-    FLAGCXCHECK(bootstrapAllGather(state, (void *)uniqueIdData,
-                                   sizeof(flagcxUniqueId)));
-    FLAGCXCHECK(bootstrapBarrier(state, rank, nranks, 0));
-    // Call cclAdaptor->commInitRank
+    // Call cclAdaptor->commInitRank for the homo inter communicator
     if ((*comm)->homoInterRootRank != -1) {
-      memcpy((void *)commId, (void *)&uniqueIdData[(*comm)->homoInterRootRank],
+      memcpy((void *)commId,
+             (void *)&idRecords[(*comm)->homoInterRootRank].homoInterId,
              sizeof(flagcxUniqueId));
       FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->commInitRank(
           &(*comm)->homoInterComm, (*comm)->homoInterRanks, commId,
           (*comm)->homoInterMyRank, NULL));
     }
-    free(nicDistanceData);
     const char *deviceFuncPathEnv = flagcxGetEnv("FLAGCX_DEVICE_FUNC_PATH");
     if (deviceFuncPathEnv) {
       FLAGCXCHECK(loadKernelSymbol(deviceFuncPathEnv, "deviceAsyncLoad",
@@ -562,14 +860,137 @@ flagcxResult_t flagcxCommInitRank(flagcxComm_t *comm, int nranks,
     }
   }
 
-  free(clusterInterRankData);
-  free(vendorData);
-  if (!useTuner) {
-    free(uniqueIdData);
+  FLAGCXCHECK(flagcxConfigDump(&(*comm)->config, rank));
+  return flagcxSuccess;
+}
+
+// Create the homo communicator of tuner config idx into the pool, with the
+// creation envs of that config. Collective over the tuner bootstrap.
+flagcxResult_t flagcxCreateHomoCommForTag(flagcxComm_t comm, uint32_t idx) {
+  if (comm->homoCommPool.find(idx) != comm->homoCommPool.end()) {
+    return flagcxSuccess;
+  }
+  struct flagcxCommTag tag = {""};
+  FLAGCXCHECK(comm->tuner->setCandidate(comm->tunerContext, idx, &tag));
+  flagcxInnerComm_t innerComm = NULL;
+  FLAGCXCHECK(flagcxHomoCommInit(
+      comm->commId, comm->uniqueIdData,
+      (struct bootstrapState *)(comm->tuner->bootstrap), comm, &innerComm));
+  comm->homoCommPool[idx] = innerComm;
+  INFO(FLAGCX_INIT | FLAGCX_TUNING,
+       "Created communicator tag=%s, %zu communicators pooled", tag.tag,
+       comm->homoCommPool.size());
+  return flagcxSuccess;
+}
+
+// Note that the pooled homo_comm of a tuned communicator has an op on stream
+static inline void homoCommUsed(flagcxComm_t comm, flagcxStream_t stream) {
+  if (comm->tuner != NULL) {
+    comm->homoCommStreams[comm->homo_comm].insert(stream);
+  }
+}
+
+// Record an event after the last op on every stream the retired homo
+// communicators were used on. Inside a group their ops are only launched at
+// group end, which records them then.
+static flagcxResult_t flagcxRecordRetiredHomoComms(flagcxComm_t comm) {
+  if (comm->groupDepth > 0) {
+    return flagcxSuccess;
+  }
+  for (auto &retired : comm->homoCommRetired) {
+    if (!retired.events.empty()) {
+      continue;
+    }
+    for (auto stream : retired.streams) {
+      flagcxEvent_t event;
+      FLAGCXCHECK(
+          deviceAdaptor->eventCreate(&event, flagcxEventDisableTiming));
+      retired.events.push_back(event);
+      FLAGCXCHECK(deviceAdaptor->eventRecord(event, stream));
+    }
   }
   return flagcxSuccess;
 }
 
+// Take the homo communicator of tuner config idx, if any, out of the pool.
+// The caller must make sure it is not the best communicator of a category.
+// Ops may still use it, so it is only destroyed by flagcxReleaseHomoComms.
+flagcxResult_t flagcxRetireHomoCommByTag(flagcxComm_t comm, uint32_t idx) {
+  auto it = comm->homoCommPool.find(idx);
+  if (it == comm->homoCommPool.end()) {
+    return flagcxSuccess;
+  }
+  flagcxInnerComm_t innerComm = it->second;
+  comm->homoCommPool.erase(it);
+  for (auto cit = comm->homoCommMap.begin(); cit != comm->homoCommMap.end();) {
+    if (cit->second == innerComm) {
+      cit = comm->homoCommMap.erase(cit);
+    } else {
+      ++cit;
+    }
+  }
+  if (comm->homo_comm == innerComm) {
+    comm->homo_comm = NULL;
+  }
+  struct flagcxRetiredHomoComm retired;
+  retired.comm = innerComm;
+  auto sit = comm->homoCommStreams.find(innerComm);
+  if (sit != comm->homoCommStreams.end()) {
+    retired.streams.assign(sit->second.begin(), sit->second.end());
+    comm->homoCommStreams.erase(sit);
+  }
+  comm->homoCommRetired.push_back(retired);
+  FLAGCXCHECK(flagcxRecordRetiredHomoComms(comm));
+  INFO(FLAGCX_INIT | FLAGCX_TUNING,
+       "Retired communicator of config %u, %zu communicators pooled", idx,
+       comm->homoCommPool.size());
+  return flagcxSuccess;
+}
+
+// Destroy the retired homo communicators whose ops are done, none while a
+// group is open. With wait set, blocks until all of them are destroyed.
+flagcxResult_t flagcxReleaseHomoComms(flagcxComm_t comm, bool wait) {
+  if (comm->groupDepth > 0) {
+    return flagcxSuccess;
+  }
+  for (auto it = comm->homoCommRetired.begin();
+       it != comm->homoCommRetired.end();) {
+    bool done = true;
+    for (auto event : it->events) {
+      if (wait) {
+        FLAGCXCHECK(deviceAdaptor->eventSynchronize(event));
+      } else if (deviceAdaptor->eventQuery(event) != flagcxSuccess) {
+        done = false;
+        break;
+      }
+    }
+    if (!done) {
+      ++it;
+      continue;
+    }
+    for (auto event : it->events) {
+      FLAGCXCHECK(deviceAdaptor->eventDestroy(event));
+    }
+    FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->commDestroy(it->comm));
+    it = comm->homoCommRetired.erase(it);
+    INFO(FLAGCX_INIT | FLAGCX_TUNING,
+         "Destroyed retired communicator, %zu still retired",
+         comm->homoCommRetired.size());
+  }
+  return flagcxSuccess;
+}
+
+flagcxResult_t flagcxCommReloadConfig(flagcxComm_t comm) {
+  FLAGCXCHECK(flagcxEnsureCommReady(comm));
+  flagcxConfigReload();
+  flagcxConfigUpdate(&comm->config, flagcxConfigGet());
+  if (comm->hetero_comm != NULL) {
+    comm->hetero_comm->deviceFuncRelaxedOrdering =
+        comm->config.deviceFuncRelaxedOrdering;
+  }
+  return flagcxConfigDump(&comm->config, comm->rank);
+}
+
 flagcxResult_t flagcxCommFinalize(flagcxComm_t comm) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
   FLAGCXCHECK(
@@ -584,11 +1005,32 @@ flagcxResult_t flagcxCommFinalize(flagcxComm_t comm) {
 flagcxResult_t flagcxCommDestroy(flagcxComm_t comm) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
 
+  if (comm->interClusterMsgs > 0) {
+    INFO(FLAGCX_COLL,
+         "rank %d sent %lu hetero messages (%lu bytes) to other clusters",
+         comm->rank, comm->interClusterMsgs, comm->interClusterBytes);
+  }
+
+  // The last hierarchical gather may still be sending from the scratch
+  if (comm->gatherScratchEvent != NULL) {
+    FLAGCXCHECK(deviceAdaptor->eventSynchronize(comm->gatherScratchEvent));
+    FLAGCXCHECK(deviceAdaptor->eventDestroy(comm->gatherScratchEvent));
+    FLAGCXCHECK(deviceAdaptor->deviceFree(comm->gatherScratch,
+                                          flagcxMemDevice, NULL));
+  }
+
   // Destroy cluster info
   free(comm->cluster_ids);
   free(comm->cluster_sizes);
   free(comm->globalrank2homorank);
 
+  // Destroy tuner, which may still be using the bootstrap
+  if (comm->tuner) {
+    comm->tuner->destroy(comm->tunerContext);
+    // Free uniqueIdData
+    free(comm->uniqueIdData);
+  }
+
   // Destroy bootstrap state and net
   bootstrapClose(comm->bootstrap);
 
@@ -596,34 +1038,34 @@ flagcxResult_t flagcxCommDestroy(flagcxComm_t comm) {
     // Destroy hetero comm
     FLAGCXCHECK(flagcxHeteroCommDestroy(comm->hetero_comm));
     // Destroy host comm
-    if (useHostComm()) {
+    if (useHostComm(comm)) {
       FLAGCXCHECK(
           cclAdaptors[flagcxCCLAdaptorHost]->commDestroy(comm->host_comm));
     }
   }
   // Destroy homo comms
   if (comm->tuner) {
-    for (const auto &item : comm->homoCommMap) {
-      if (item.second != nullptr) {
-        FLAGCXCHECK(
-            cclAdaptors[flagcxCCLAdaptorDevice]->commDestroy(item.second));
-      }
+    // homoCommMap and homoBestCommMap only refer to pooled communicators
+    comm->groupDepth = 0;
+    FLAGCXCHECK(flagcxReleaseHomoComms(comm, true));
+    for (const auto &item : comm->homoCommPool) {
+      FLAGCXCHECK(
+          cclAdaptors[flagcxCCLAdaptorDevice]->commDestroy(item.second));
     }
+    comm->homoCommPool.clear();
   } else {
     cclAdaptors[flagcxCCLAdaptorDevice]->commDestroy(comm->homo_comm);
   }
 
-  // Destroy tuner
-  if (comm->tuner) {
-    comm->tuner->destroy(comm->tunerContext);
-    // Free uniqueIdData
-    free(comm->uniqueIdData);
-  }
+  // The process may not exit through atexit, e.g. under some launchers
+  flagcxTimelineFlush();
 
   return flagcxSuccess;
 }
 
 flagcxResult_t flagcxCommAbort(flagcxComm_t comm) {
+  // keep what led to the abort even if the process does not exit cleanly
+  flagcxBintraceFlush();
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
   FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->commAbort(comm->homo_comm));
   if (!isHomoComm(comm)) {
@@ -714,6 +1156,8 @@ flagcxResult_t flagcxReduce(const void *sendbuff, void *recvbuff, size_t count,
                             int root, flagcxComm_t comm,
                             flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpReduce,
+                             count * getFlagcxDataTypeSize(datatype), stream);
   if (isHomoComm(comm)) {
     if (comm->tuner == NULL) {
       FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->reduce(
@@ -725,7 +1169,7 @@ flagcxResult_t flagcxReduce(const void *sendbuff, void *recvbuff, size_t count,
                               comm->tunerInnerComm, stream),
                           comm, flagcxCommOpReduce, count, datatype, stream);
     }
-  } else if (useHostComm() || comm->has_single_rank_homo_comm) {
+  } else if (useHostComm(comm) || comm->has_single_rank_homo_comm) {
     char *useBootstrap = getenv("USE_BOOTSTRAP_CCL");
     if (useBootstrap) {
       // TODO: to be implemented.
@@ -822,7 +1266,13 @@ flagcxResult_t flagcxGather(const void *sendbuff, void *recvbuff, size_t count,
                             flagcxDataType_t datatype, int root,
                             flagcxComm_t comm, flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
-  if (useHeteroComm()) {
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpGather,
+                             count * getFlagcxDataTypeSize(datatype), stream);
+  if (useHeteroComm(comm) &&
+      useHeteroHier(comm, count * getFlagcxDataTypeSize(datatype))) {
+    FLAGCXCHECK(heteroHierGather(sendbuff, recvbuff, count, datatype, root,
+                                 comm, stream));
+  } else if (useHeteroComm(comm)) {
     size_t size = count * getFlagcxDataTypeSize(datatype);
     char *buffer = static_cast<char *>(recvbuff);
 
@@ -834,8 +1284,7 @@ flagcxResult_t flagcxGather(const void *sendbuff, void *recvbuff, size_t count,
                                      stream));
       }
     }
-    FLAGCXCHECK(flagcxHeteroSend(sendbuff, count, datatype, root,
-                                 comm->hetero_comm, stream));
+    FLAGCXCHECK(heteroSend(comm, sendbuff, count, datatype, root, stream));
     FLAGCXCHECK(flagcxHeteroGroupEnd());
   } else if (isHomoComm(comm)) {
     if (comm->tuner == NULL) {
@@ -847,7 +1296,7 @@ flagcxResult_t flagcxGather(const void *sendbuff, void *recvbuff, size_t count,
                               comm->tunerInnerComm, stream),
                           comm, flagcxCommOpGather, count, datatype, stream);
     }
-  } else if (useHostComm() || comm->has_single_rank_homo_comm) {
+  } else if (useHostComm(comm) || comm->has_single_rank_homo_comm) {
     // c2c validation
     if (comm->has_single_rank_homo_comm) {
       WARN("Host comm is required to perform C2C gather op when "
@@ -936,16 +1385,18 @@ flagcxResult_t flagcxScatter(const void *sendbuff, void *recvbuff, size_t count,
                              flagcxDataType_t datatype, int root,
                              flagcxComm_t comm, flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
-  if (useHeteroComm()) {
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpScatter,
+                             count * getFlagcxDataTypeSize(datatype), stream);
+  if (useHeteroComm(comm)) {
     size_t size = count * getFlagcxDataTypeSize(datatype);
     const char *buffer = static_cast<const char *>(sendbuff);
 
     FLAGCXCHECK(flagcxHeteroGroupStart());
     if (comm->rank == root) {
       for (int r = 0; r < comm->nranks; r++) {
-        FLAGCXCHECK(
-            flagcxHeteroSend(static_cast<const void *>(buffer + r * size),
-                             count, datatype, r, comm->hetero_comm, stream));
+        FLAGCXCHECK(heteroSend(comm,
+                               static_cast<const void *>(buffer + r * size),
+                               count, datatype, r, stream));
       }
     }
     FLAGCXCHECK(flagcxHeteroRecv(recvbuff, count, datatype, root,
@@ -961,7 +1412,7 @@ flagcxResult_t flagcxScatter(const void *sendbuff, void *recvbuff, size_t count,
                               comm->tunerInnerComm, stream),
                           comm, flagcxCommOpScatter, count, datatype, stream);
     }
-  } else if (useHostComm() || comm->has_single_rank_homo_comm) {
+  } else if (useHostComm(comm) || comm->has_single_rank_homo_comm) {
     // c2c validation
     if (comm->has_single_rank_homo_comm) {
       WARN("Host comm is required to perform C2C scatter op when "
@@ -1052,12 +1503,13 @@ flagcxResult_t flagcxBroadcast(const void *sendbuff, void *recvbuff,
                                int root, flagcxComm_t comm,
                                flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
-  if (useHeteroComm()) {
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpBroadcast,
+                             count * getFlagcxDataTypeSize(datatype), stream);
+  if (useHeteroComm(comm)) {
     FLAGCXCHECK(flagcxHeteroGroupStart());
     if (comm->rank == root) {
       for (int r = 0; r < comm->nranks; r++) {
-        FLAGCXCHECK(flagcxHeteroSend(sendbuff, count, datatype, r,
-                                     comm->hetero_comm, stream));
+        FLAGCXCHECK(heteroSend(comm, sendbuff, count, datatype, r, stream));
       }
     }
     FLAGCXCHECK(flagcxHeteroRecv(recvbuff, count, datatype, root,
@@ -1073,7 +1525,7 @@ flagcxResult_t flagcxBroadcast(const void *sendbuff, void *recvbuff,
                               comm->tunerInnerComm, stream),
                           comm, flagcxCommOpBroadcast, count, datatype, stream);
     }
-  } else if (useHostComm() || comm->has_single_rank_homo_comm) {
+  } else if (useHostComm(comm) || comm->has_single_rank_homo_comm) {
     // c2c validation
     if (comm->has_single_rank_homo_comm) {
       WARN("Host comm is required to perform C2C broadcast op when "
@@ -1164,6 +1616,8 @@ flagcxResult_t flagcxAllReduce(const void *sendbuff, void *recvbuff,
                                flagcxRedOp_t op, flagcxComm_t comm,
                                flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpAllReduce,
+                             count * getFlagcxDataTypeSize(datatype), stream);
   if (isHomoComm(comm)) {
     if (comm->tuner == NULL) {
       FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->allReduce(
@@ -1174,7 +1628,7 @@ flagcxResult_t flagcxAllReduce(const void *sendbuff, void *recvbuff,
                               comm->tunerInnerComm, stream),
                           comm, flagcxCommOpAllReduce, count, datatype, stream);
     }
-  } else if (useHostComm() || comm->has_single_rank_homo_comm) {
+  } else if (useHostComm(comm) || comm->has_single_rank_homo_comm) {
     // c2c validation
     if (comm->has_single_rank_homo_comm) {
       WARN("Host comm is required to perform C2C allreduce op when "
@@ -1269,6 +1723,9 @@ flagcxResult_t flagcxReduceScatter(const void *sendbuff, void *recvbuff,
                                    flagcxRedOp_t op, flagcxComm_t comm,
                                    flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpReduceScatter,
+                             recvcount * getFlagcxDataTypeSize(datatype),
+                             stream);
   if (isHomoComm(comm)) {
     if (comm->tuner == NULL) {
       FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->reduceScatter(
@@ -1281,7 +1738,7 @@ flagcxResult_t flagcxReduceScatter(const void *sendbuff, void *recvbuff,
                           comm, flagcxCommOpReduceScatter, recvcount, datatype,
                           stream);
     }
-  } else if (useHostComm() || comm->has_single_rank_homo_comm) {
+  } else if (useHostComm(comm) || comm->has_single_rank_homo_comm) {
     // c2c validation
     if (comm->has_single_rank_homo_comm) {
       WARN("Host comm is required to perform C2C reducescatter op when "
@@ -1373,13 +1830,19 @@ flagcxResult_t flagcxAllGather(const void *sendbuff, void *recvbuff,
                                size_t sendcount, flagcxDataType_t datatype,
                                flagcxComm_t comm, flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
-  if (useHeteroComm()) {
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpAllGather,
+                             sendcount * getFlagcxDataTypeSize(datatype),
+                             stream);
+  if (useHeteroComm(comm) &&
+      useHeteroHier(comm, sendcount * getFlagcxDataTypeSize(datatype))) {
+    FLAGCXCHECK(heteroHierAllGather(sendbuff, recvbuff, sendcount, datatype,
+                                    comm, stream));
+  } else if (useHeteroComm(comm)) {
     size_t size = sendcount * getFlagcxDataTypeSize(datatype);
     char *bufferOut = static_cast<char *>(recvbuff);
     FLAGCXCHECK(flagcxHeteroGroupStart());
     for (int r = 0; r < comm->nranks; r++) {
-      FLAGCXCHECK(flagcxHeteroSend(sendbuff, sendcount, datatype, r,
-                                   comm->hetero_comm, stream));
+      FLAGCXCHECK(heteroSend(comm, sendbuff, sendcount, datatype, r, stream));
       FLAGCXCHECK(flagcxHeteroRecv(static_cast<void *>(bufferOut + r * size),
                                    sendcount, datatype, r, comm->hetero_comm,
                                    stream));
@@ -1396,7 +1859,7 @@ flagcxResult_t flagcxAllGather(const void *sendbuff, void *recvbuff,
                           comm, flagcxCommOpAllGather, sendcount, datatype,
                           stream);
     }
-  } else if (useHostComm()) {
+  } else if (useHostComm(comm)) {
     uint64_t timers[TIMERS_COLL_COUNT] = {0};
     timers[TIMER_COLL_TOTAL] = clockNano();
     void *buff_in;
@@ -1482,15 +1945,17 @@ flagcxResult_t flagcxAlltoAll(const void *sendbuff, void *recvbuff,
                               size_t count, flagcxDataType_t datatype,
                               flagcxComm_t comm, flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
-  if (useHeteroComm()) {
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpAlltoAll,
+                             count * getFlagcxDataTypeSize(datatype), stream);
+  if (useHeteroComm(comm)) {
     size_t size = count * getFlagcxDataTypeSize(datatype);
     const char *bufferIn = static_cast<const char *>(sendbuff);
     char *bufferOut = static_cast<char *>(recvbuff);
     FLAGCXCHECK(flagcxHeteroGroupStart());
     for (int r = 0; r < comm->nranks; r++) {
-      FLAGCXCHECK(
-          flagcxHeteroSend(static_cast<const void *>(bufferIn + r * size),
-                           count, datatype, r, comm->hetero_comm, stream));
+      FLAGCXCHECK(heteroSend(comm,
+                             static_cast<const void *>(bufferIn + r * size),
+                             count, datatype, r, stream));
       FLAGCXCHECK(flagcxHeteroRecv(static_cast<void *>(bufferOut + r * size),
                                    count, datatype, r, comm->hetero_comm,
                                    stream));
@@ -1506,7 +1971,7 @@ flagcxResult_t flagcxAlltoAll(const void *sendbuff, void *recvbuff,
                               comm->tunerInnerComm, stream),
                           comm, flagcxCommOpAlltoAll, count, datatype, stream);
     }
-  } else if (useHostComm()) {
+  } else if (useHostComm(comm)) {
     uint64_t timers[TIMERS_COLL_COUNT] = {0};
     timers[TIMER_COLL_TOTAL] = clockNano();
     void *buff_in;
@@ -1592,16 +2057,23 @@ flagcxResult_t flagcxAlltoAllv(const void *sendbuff, size_t *sendcounts,
                                flagcxStream_t stream) {
 
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
-  if (useHeteroComm()) {
+  size_t latencyBytes = 0;
+  if (flagcxLatencyEnabled()) {
+    for (int r = 0; r < comm->nranks; r++)
+      latencyBytes += sendcounts[r] * getFlagcxDataTypeSize(datatype);
+  }
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpAlltoAllv, latencyBytes,
+                             stream);
+  if (useHeteroComm(comm)) {
     size_t size = getFlagcxDataTypeSize(datatype);
     const char *bufferIn = static_cast<const char *>(sendbuff);
     char *bufferOut = static_cast<char *>(recvbuff);
     FLAGCXCHECK(flagcxHeteroGroupStart());
     for (int r = 0; r < comm->nranks; r++) {
       if (flagcxCCLAdaptorNeedSendrecv(sendcounts[r])) {
-        FLAGCXCHECK(flagcxHeteroSend(
-            static_cast<const void *>(bufferIn + sdispls[r] * size),
-            sendcounts[r], datatype, r, comm->hetero_comm, stream));
+        FLAGCXCHECK(heteroSend(
+            comm, static_cast<const void *>(bufferIn + sdispls[r] * size),
+            sendcounts[r], datatype, r, stream));
       }
       if (flagcxCCLAdaptorNeedSendrecv(recvcounts[r])) {
         FLAGCXCHECK(flagcxHeteroRecv(
@@ -1614,7 +2086,8 @@ flagcxResult_t flagcxAlltoAllv(const void *sendbuff, size_t *sendcounts,
     FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->alltoAllv(
         sendbuff, sendcounts, sdispls, recvbuff, recvcounts, rdispls, datatype,
         comm->homo_comm, stream));
-  } else if (useHostComm()) {
+    homoCommUsed(comm, stream);
+  } else if (useHostComm(comm)) {
     uint64_t timers[TIMERS_COLL_COUNT] = {0};
     timers[TIMER_COLL_TOTAL] = clockNano();
     void *buff_in;
@@ -1705,13 +2178,15 @@ flagcxResult_t flagcxSend(const void *sendbuff, size_t count,
                           flagcxDataType_t datatype, int peer,
                           flagcxComm_t comm, flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
-  if (useHeteroComm()) {
-    FLAGCXCHECK(flagcxHeteroSend(sendbuff, count, datatype, peer,
-                                 comm->hetero_comm, stream));
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpSend,
+                             count * getFlagcxDataTypeSize(datatype), stream);
+  if (useHeteroComm(comm)) {
+    FLAGCXCHECK(heteroSend(comm, sendbuff, count, datatype, peer, stream));
   } else if (isHomoComm(comm)) {
     FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->send(
         sendbuff, count, datatype, peer, comm->homo_comm, stream));
-  } else if (useHostComm()) {
+    homoCommUsed(comm, stream);
+  } else if (useHostComm(comm)) {
     uint64_t timers[TIMERS_COLL_COUNT] = {0};
     timers[TIMER_COLL_TOTAL] = clockNano();
     void *buff_in;
@@ -1752,8 +2227,7 @@ flagcxResult_t flagcxSend(const void *sendbuff, size_t count,
           sendbuff, count, datatype, comm->globalrank2homorank[peer],
           comm->homo_comm, stream));
     } else {
-      FLAGCXCHECK(flagcxHeteroSend(sendbuff, count, datatype, peer,
-                                   comm->hetero_comm, stream));
+      FLAGCXCHECK(heteroSend(comm, sendbuff, count, datatype, peer, stream));
     }
   }
   return flagcxSuccess;
@@ -1763,13 +2237,16 @@ flagcxResult_t flagcxRecv(void *recvbuff, size_t count,
                           flagcxDataType_t datatype, int peer,
                           flagcxComm_t comm, flagcxStream_t stream) {
   FLAGCXCHECK(flagcxEnsureCommReady(comm));
-  if (useHeteroComm()) {
+  flagcxLatencyScope latency(comm->magic, flagcxCommOpRecv,
+                             count * getFlagcxDataTypeSize(datatype), stream);
+  if (useHeteroComm(comm)) {
     FLAGCXCHECK(flagcxHeteroRecv(recvbuff, count, datatype, peer,
                                  comm->hetero_comm, stream));
   } else if (isHomoComm(comm)) {
     FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->recv(
         recvbuff, count, datatype, peer, comm->homo_comm, stream));
-  } else if (useHostComm()) {
+    homoCommUsed(comm, stream);
+  } else if (useHostComm(comm)) {
     uint64_t timers[TIMERS_COLL_COUNT] = {0};
     timers[TIMER_COLL_TOTAL] = clockNano();
     void *buff_out;
@@ -1820,11 +2297,12 @@ flagcxResult_t flagcxRecv(void *recvbuff, size_t count,
 }
 
 flagcxResult_t flagcxGroupStart(flagcxComm_t comm) {
-  if (useHeteroComm()) {
+  comm->groupDepth++;
+  if (useHeteroComm(comm)) {
     FLAGCXCHECK(flagcxHeteroGroupStart());
   } else if (isHomoComm(comm)) {
     FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->groupStart());
-  } else if (useHostComm()) {
+  } else if (useHostComm(comm)) {
     FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorHost]->groupStart());
   } else {
     FLAGCXCHECK(flagcxHeteroGroupStart());
@@ -1834,15 +2312,21 @@ flagcxResult_t flagcxGroupStart(flagcxComm_t comm) {
 }
 
 flagcxResult_t flagcxGroupEnd(flagcxComm_t comm) {
-  if (useHeteroComm()) {
+  comm->groupDepth--;
+  if (useHeteroComm(comm)) {
     FLAGCXCHECK(flagcxHeteroGroupEnd());
   } else if (isHomoComm(comm)) {
     FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->groupEnd());
-  } else if (useHostComm()) {
+  } else if (useHostComm(comm)) {
     FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorHost]->groupEnd());
   } else {
     FLAGCXCHECK(cclAdaptors[flagcxCCLAdaptorDevice]->groupEnd());
     FLAGCXCHECK(flagcxHeteroGroupEnd());
   }
+  // Communicators retired inside the group have their ops launched now
+  if (comm->tuner != NULL) {
+    FLAGCXCHECK(flagcxRecordRetiredHomoComms(comm));
+    FLAGCXCHECK(flagcxReleaseHomoComms(comm, false));
+  }
   return flagcxSuccess;
 }
@@ -230,6 +230,13 @@ flagcxResult_t flagcxCommResume(flagcxComm_t comm);
 /* Suspend a communicator. */
 flagcxResult_t flagcxCommSuspend(flagcxComm_t comm);
 
+/* Re-read the settings of a communicator that may change between calls,
+ * such as FLAGCX_C2C_ALGO, from the environment. Settings that decide which
+ * inner communicators exist, such as FLAGCX_USE_HETERO_COMM, keep the value
+ * they had at init. Must not be called concurrently with operations on the
+ * communicator. */
+flagcxResult_t flagcxCommReloadConfig(flagcxComm_t comm);
+
 /* Returns a string for each error code. */
 const char *flagcxGetErrorString(flagcxResult_t result);
 
@@ -26,6 +26,9 @@ constexpr unsigned int flagcxDeviceTriggerOffPrim =
     flagcxDeviceTriggerOffDatatype + flagcxDeviceTriggerBitsDatatype;
 constexpr unsigned int flagcxDeviceTriggerBitsPrim = 4;
 constexpr unsigned int flagcxDeviceTriggerBitsFifoReserved = 1;
+// Set by the producer once a slot is fully written, cleared by the consumer
+constexpr unsigned int flagcxDeviceTriggerOffFifoReserved =
+    64 - flagcxDeviceTriggerBitsFifoReserved;
 
 constexpr unsigned int flagcxReduceTriggerBitsAddr = 64;
 constexpr unsigned int flagcxReduceTriggerBitsCount = 32;
@@ -74,6 +77,9 @@ typedef flagcxReduceTrigger *flagcxReduceTrigger_t;
 
 struct flagcxFifo {
   // [capacity, consumed, produced, trigger buffer]
+  // Producers reserve slots by atomically incrementing produced and publish
+  // a slot by setting its ready bit, so produced may run ahead of the slots
+  // that are readable. The consumer releases slots by advancing consumed.
   uint64_t *buffer;
 
 public:
@@ -86,6 +92,10 @@ typedef struct flagcxFifo *flagcxFifo_t;
 
 FLAGCX_HOST_DECORATOR flagcxResult_t dequeue(void *fifoBuffer,
                                              flagcxDeviceTrigger_t trigger);
+// Copy up to maxTriggers ready triggers in FIFO order and release their slots
+FLAGCX_HOST_DECORATOR flagcxResult_t
+dequeueBatch(void *fifoBuffer, flagcxDeviceTrigger_t triggers, int maxTriggers,
+             int *nTriggers);
 #ifdef COMPILE_KERNEL
 // device-producer + host-consumer APIs
 FLAGCX_DEVICE_DECORATOR flagcxResult_t enqueue(void *fifoBuffer, uint64_t addr,
@@ -105,20 +105,24 @@ FLAGCX_DEVICE_DECORATOR flagcxResult_t enqueue(void *fifoBuffer, uint64_t addr,
                                                uint64_t peerRank,
                                                uint64_t datatype,
                                                uint64_t type) {
-  int idx = -1;
   uint64_t *buffer = (uint64_t *)fifoBuffer;
-  int capacity = buffer[0];
-  int distance = buffer[2] - buffer[1];
+  uint64_t capacity = buffer[0];
+  // Reserve a slot, any number of device threads may produce concurrently
+  uint64_t slot =
+      atomicAdd((unsigned long long int *)(buffer + 2), 1ull);
   int iter = 0;
-  while (distance >= capacity) {
+  while (slot - *(volatile uint64_t *)(buffer + 1) >= capacity) {
     spinBackoff(iter);
     iter++;
-    distance = buffer[2] - buffer[1];
   }
-  idx = buffer[2] % capacity;
-  flagcxDeviceTrigger *trigger = ((flagcxDeviceTrigger *)(buffer + 3)) + idx;
-  trigger->setValue(addr, count, peerRank, datatype, type);
+  flagcxDeviceTrigger value;
+  value.setValue(addr, count, peerRank, datatype, type);
+  volatile uint64_t *trigger =
+      buffer + 3 +
+      sizeof(flagcxDeviceTrigger) / sizeof(uint64_t) * (slot % capacity);
+  trigger[0] = value.fst;
   FLAGCX_DEVICE_THREAD_FENCE();
-  buffer[2] = buffer[2] + 1;
+  // Publish the slot, the host only reads triggers whose ready bit is set
+  trigger[1] = value.snd | (1ull << flagcxDeviceTriggerOffFifoReserved);
   return flagcxSuccess;
 }
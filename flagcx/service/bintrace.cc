@@ -0,0 +1,271 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ ************************************************************************/
+
+#include "bintrace.h"
+#include "param.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+FLAGCX_PARAM(BintraceEvents, "BINTRACE_EVENTS", 0);
+FLAGCX_PARAM(BintraceSignals, "BINTRACE_SIGNALS", 1);
+
+void flagcxDebugInit();
+
+int flagcxBintraceState = -1;
+
+struct bintraceFormat {
+  uint64_t flags;
+  int line;
+  const char *func; // both are string literals of the call site
+  const char *fmt;
+};
+
+// A ring is only written by its owner. Rings of exited threads are kept so
+// that their events reach the file, and handed to new threads when the table
+// is full.
+struct bintraceRing {
+  uint64_t head; // number of events ever written
+  int tid;
+  int active;
+  struct flagcxBintraceEvent *events;
+};
+
+static struct bintraceFormat bintraceFormats[FLAGCX_BINTRACE_MAX_FORMATS];
+static uint32_t bintraceNumFormats = 0;
+static struct bintraceRing bintraceRings[FLAGCX_BINTRACE_MAX_THREADS];
+static int bintraceNumRings = 0;
+static uint64_t bintraceCapacity = 0; // power of two
+static pthread_mutex_t bintraceMutex = PTHREAD_MUTEX_INITIALIZER;
+static char bintracePath[PATH_MAX] = "";
+static char bintraceHost[64] = "";
+static uint64_t bintraceStartMono = 0;
+static uint64_t bintraceStartReal = 0;
+static int bintraceFlushing = 0;
+
+static const int bintraceSignals[] = {SIGSEGV, SIGBUS, SIGFPE,
+                                      SIGILL,  SIGABRT, SIGTERM};
+#define BINTRACE_NUM_SIGNALS                                                   \
+  (int)(sizeof(bintraceSignals) / sizeof(bintraceSignals[0]))
+static struct sigaction bintraceOldActions[BINTRACE_NUM_SIGNALS];
+
+static inline uint64_t bintraceClock(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Releases the ring when its thread exits
+struct bintraceOwner {
+  struct bintraceRing *ring = NULL;
+  ~bintraceOwner() {
+    if (ring)
+      __atomic_store_n(&ring->active, 0, __ATOMIC_RELEASE);
+  }
+};
+static thread_local struct bintraceOwner bintraceLocal;
+
+static void bintraceSignalHandler(int sig) {
+  flagcxBintraceFlush();
+  // Hand the signal to whoever had it before us
+  for (int i = 0; i < BINTRACE_NUM_SIGNALS; i++) {
+    if (bintraceSignals[i] == sig) {
+      sigaction(sig, &bintraceOldActions[i], NULL);
+      break;
+    }
+  }
+  raise(sig);
+}
+
+static void bintraceInitOnce() {
+  flagcxDebugInit();
+  int64_t events = flagcxParamBintraceEvents();
+  if (events <= 0) {
+    __atomic_store_n(&flagcxBintraceState, 0, __ATOMIC_RELEASE);
+    return;
+  }
+  uint64_t capacity = 1;
+  while (capacity < (uint64_t)events)
+    capacity <<= 1;
+  bintraceCapacity = capacity;
+
+  const char *path = flagcxGetEnv("FLAGCX_BINTRACE_FILE");
+  flagcxExpandPath(path && path[0] ? path : "flagcx_bintrace.%h.%p.bin",
+                   bintracePath, sizeof(bintracePath));
+  getHostName(bintraceHost, sizeof(bintraceHost), '.');
+  bintraceStartMono = bintraceClock(CLOCK_MONOTONIC);
+  bintraceStartReal = bintraceClock(CLOCK_REALTIME);
+
+  atexit(flagcxBintraceFlush);
+  if (flagcxParamBintraceSignals()) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = bintraceSignalHandler;
+    sigemptyset(&action.sa_mask);
+    for (int i = 0; i < BINTRACE_NUM_SIGNALS; i++) {
+      sigaction(bintraceSignals[i], &action, &bintraceOldActions[i]);
+    }
+  }
+  INFO(FLAGCX_INIT,
+       "Bintrace: %lu events of %zu bytes per thread, written to %s",
+       (unsigned long)capacity, sizeof(struct flagcxBintraceEvent),
+       bintracePath);
+  __atomic_store_n(&flagcxBintraceState, 1, __ATOMIC_RELEASE);
+}
+
+int flagcxBintraceInit() {
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, bintraceInitOnce);
+  return __atomic_load_n(&flagcxBintraceState, __ATOMIC_ACQUIRE);
+}
+
+uint32_t flagcxBintraceRegister(unsigned long flags, const char *func,
+                                int line, const char *fmt) {
+  pthread_mutex_lock(&bintraceMutex);
+  uint32_t id = bintraceNumFormats;
+  if (id < FLAGCX_BINTRACE_MAX_FORMATS) {
+    bintraceFormats[id] = {flags, line, func, fmt};
+    __atomic_store_n(&bintraceNumFormats, id + 1, __ATOMIC_RELEASE);
+  } else {
+    id = UINT32_MAX; // events of this call site are dropped
+  }
+  pthread_mutex_unlock(&bintraceMutex);
+  return id;
+}
+
+static struct bintraceRing *bintraceAttach() {
+  struct bintraceRing *ring = NULL;
+  pthread_mutex_lock(&bintraceMutex);
+  if (bintraceNumRings < FLAGCX_BINTRACE_MAX_THREADS) {
+    struct flagcxBintraceEvent *events = (struct flagcxBintraceEvent *)calloc(
+        bintraceCapacity, sizeof(struct flagcxBintraceEvent));
+    if (events != NULL) {
+      ring = &bintraceRings[bintraceNumRings];
+      ring->events = events;
+      __atomic_store_n(&bintraceNumRings, bintraceNumRings + 1,
+                       __ATOMIC_RELEASE);
+    }
+  } else {
+    for (int i = 0; i < bintraceNumRings; i++) {
+      if (__atomic_load_n(&bintraceRings[i].active, __ATOMIC_ACQUIRE) == 0) {
+        ring = &bintraceRings[i];
+        __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+        break;
+      }
+    }
+  }
+  if (ring != NULL) {
+    ring->tid = syscall(SYS_gettid);
+    __atomic_store_n(&ring->active, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&bintraceMutex);
+  return ring;
+}
+
+void flagcxBintraceRecord(uint32_t id, int nargs, const uint64_t *args) {
+  if (id == UINT32_MAX)
+    return;
+  struct bintraceRing *ring = bintraceLocal.ring;
+  if (__builtin_expect(ring == NULL, 0)) {
+    if ((ring = bintraceAttach()) == NULL)
+      return;
+    bintraceLocal.ring = ring;
+  }
+  uint64_t head = ring->head;
+  struct flagcxBintraceEvent *event =
+      ring->events + (head & (bintraceCapacity - 1));
+  event->time = bintraceClock(CLOCK_MONOTONIC);
+  event->id = id;
+  event->nargs = nargs;
+  for (int i = 0; i < nargs; i++)
+    event->args[i] = args[i];
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static bool bintraceWrite(int fd, const void *buf, size_t size) {
+  const char *ptr = (const char *)buf;
+  while (size > 0) {
+    ssize_t n = write(fd, ptr, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    ptr += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool bintraceWriteString(int fd, const char *str) {
+  uint32_t len = str ? strlen(str) : 0;
+  return bintraceWrite(fd, &len, sizeof(len)) && bintraceWrite(fd, str, len);
+}
+
+/* File layout, native endianness:
+ *   uint64 magic, uint32 version, uint32 pid, uint64 start monotonic ns,
+ *   uint64 start realtime ns, char host[64], uint32 event size,
+ *   uint32 nFormats, then per format: uint64 flags, int32 line, string func,
+ *   string fmt (uint32 length + bytes),
+ *   uint32 nRings, then per ring: int32 tid, uint32 nEvents, uint64 dropped,
+ *   nEvents events from the oldest to the newest.
+ * Events being written while flushing from a signal handler may be torn.
+ */
+void flagcxBintraceFlush() {
+  if (__atomic_load_n(&flagcxBintraceState, __ATOMIC_ACQUIRE) != 1)
+    return;
+  if (__atomic_exchange_n(&bintraceFlushing, 1, __ATOMIC_ACQ_REL))
+    return;
+  int fd = open(bintracePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    __atomic_store_n(&bintraceFlushing, 0, __ATOMIC_RELEASE);
+    return;
+  }
+  uint64_t magic = FLAGCX_BINTRACE_MAGIC;
+  uint32_t header[2] = {FLAGCX_BINTRACE_VERSION, (uint32_t)getpid()};
+  uint64_t starts[2] = {bintraceStartMono, bintraceStartReal};
+  uint32_t eventSize = sizeof(struct flagcxBintraceEvent);
+  uint32_t nFormats = __atomic_load_n(&bintraceNumFormats, __ATOMIC_ACQUIRE);
+  bool ok = bintraceWrite(fd, &magic, sizeof(magic)) &&
+            bintraceWrite(fd, header, sizeof(header)) &&
+            bintraceWrite(fd, starts, sizeof(starts)) &&
+            bintraceWrite(fd, bintraceHost, sizeof(bintraceHost)) &&
+            bintraceWrite(fd, &eventSize, sizeof(eventSize)) &&
+            bintraceWrite(fd, &nFormats, sizeof(nFormats));
+  for (uint32_t i = 0; ok && i < nFormats; i++) {
+    struct bintraceFormat *f = &bintraceFormats[i];
+    int32_t line = f->line;
+    ok = bintraceWrite(fd, &f->flags, sizeof(f->flags)) &&
+         bintraceWrite(fd, &line, sizeof(line)) &&
+         bintraceWriteString(fd, f->func) && bintraceWriteString(fd, f->fmt);
+  }
+  uint32_t nRings = __atomic_load_n(&bintraceNumRings, __ATOMIC_ACQUIRE);
+  ok = ok && bintraceWrite(fd, &nRings, sizeof(nRings));
+  for (uint32_t r = 0; ok && r < nRings; r++) {
+    struct bintraceRing *ring = &bintraceRings[r];
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t count = head < bintraceCapacity ? head : bintraceCapacity;
+    int32_t tid = ring->tid;
+    uint32_t nEvents = count;
+    uint64_t dropped = head - count;
+    ok = bintraceWrite(fd, &tid, sizeof(tid)) &&
+         bintraceWrite(fd, &nEvents, sizeof(nEvents)) &&
+         bintraceWrite(fd, &dropped, sizeof(dropped));
+    // Oldest events first: from the slot after head to the end, then from
+    // the start of the array up to head
+    uint64_t first = (head - count) & (bintraceCapacity - 1);
+    uint64_t tail = count < bintraceCapacity - first ? count
+                                                     : bintraceCapacity - first;
+    ok = ok && bintraceWrite(fd, ring->events + first, tail * eventSize) &&
+         bintraceWrite(fd, ring->events, (count - tail) * eventSize);
+  }
+  close(fd);
+  __atomic_store_n(&bintraceFlushing, 0, __ATOMIC_RELEASE);
+}
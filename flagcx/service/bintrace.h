@@ -0,0 +1,106 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ *
+ * Binary trace for hot paths. Enabled with FLAGCX_BINTRACE_EVENTS=<n>.
+ *
+ * TRACE_BIN stores a format id, a timestamp and the raw arguments in a ring
+ * of n fixed-size records owned by the calling thread: no formatting, no
+ * lock and no system call once the thread has its ring. The format strings
+ * are kept in a table indexed by id and written next to the rings, at exit,
+ * on flagcxCommAbort and on fatal signals, to FLAGCX_BINTRACE_FILE. The
+ * file is turned into text offline by flagcx/tools/trace_decode.py.
+ *
+ * Subsystems are selected with FLAGCX_DEBUG_SUBSYS as for TRACE. When the
+ * rings are off, TRACE_BIN falls back to TRACE. Arguments must be numbers
+ * or pointers; strings cannot be recorded since only the pointer would be.
+ ************************************************************************/
+
+#ifndef FLAGCX_BINTRACE_H_
+#define FLAGCX_BINTRACE_H_
+
+#include "debug.h"
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+#define FLAGCX_BINTRACE_MAGIC 0x3143525442584346ULL // "FCXBTRC1"
+#define FLAGCX_BINTRACE_VERSION 1
+#define FLAGCX_BINTRACE_MAX_ARGS 6
+#define FLAGCX_BINTRACE_MAX_FORMATS 4096
+#define FLAGCX_BINTRACE_MAX_THREADS 1024
+
+// One cache line per event
+struct flagcxBintraceEvent {
+  uint64_t time; // CLOCK_MONOTONIC, ns
+  uint32_t id;
+  uint32_t nargs;
+  uint64_t args[FLAGCX_BINTRACE_MAX_ARGS];
+};
+
+// -1 until the environment has been read, then 0 or 1
+extern int flagcxBintraceState;
+int flagcxBintraceInit();
+
+static inline bool flagcxBintraceOn(unsigned long flags) {
+  int state = __atomic_load_n(&flagcxBintraceState, __ATOMIC_RELAXED);
+  if (__builtin_expect(state == -1, 0))
+    state = flagcxBintraceInit();
+  return state == 1 && (flags & flagcxDebugMask);
+}
+
+// Called once per call site, returns the id of its format
+uint32_t flagcxBintraceRegister(unsigned long flags, const char *func,
+                                int line, const char *fmt);
+
+void flagcxBintraceRecord(uint32_t id, int nargs, const uint64_t *args);
+
+// Write the rings of all threads to FLAGCX_BINTRACE_FILE. Only uses
+// async-signal-safe calls, so it may run from a signal handler.
+void flagcxBintraceFlush();
+
+template <typename T>
+static inline typename std::enable_if<
+    std::is_integral<T>::value || std::is_enum<T>::value, uint64_t>::type
+flagcxBintraceArg(T v) {
+  // Signed values are sign-extended, the decoder truncates to the size
+  // given by the conversion
+  return (uint64_t)(int64_t)v;
+}
+
+static inline uint64_t flagcxBintraceArg(double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+template <typename T>
+static inline uint64_t flagcxBintraceArg(T *v) {
+  static_assert(!std::is_same<typename std::remove_cv<T>::type, char>::value,
+                "strings cannot be recorded by TRACE_BIN, use TRACE");
+  return (uint64_t)(uintptr_t)v;
+}
+
+template <typename... Args>
+static inline void flagcxBintraceLog(uint32_t id, Args... args) {
+  static_assert(sizeof...(Args) <= FLAGCX_BINTRACE_MAX_ARGS,
+                "too many arguments for TRACE_BIN");
+  uint64_t values[sizeof...(Args) + 1] = {flagcxBintraceArg(args)..., 0};
+  flagcxBintraceRecord(id, sizeof...(Args), values);
+}
+
+#ifdef ENABLE_TRACE
+#define TRACE_BIN(FLAGS, fmt, ...)                                             \
+  do {                                                                         \
+    if (flagcxBintraceOn(FLAGS)) {                                             \
+      static uint32_t flagcxBintraceId =                                       \
+          flagcxBintraceRegister((FLAGS), __func__, __LINE__, fmt);            \
+      flagcxBintraceLog(flagcxBintraceId, ##__VA_ARGS__);                      \
+    } else {                                                                   \
+      TRACE(FLAGS, fmt, ##__VA_ARGS__);                                        \
+    }                                                                          \
+  } while (0)
+#else
+#define TRACE_BIN(...)
+#endif
+
+#endif
@@ -11,7 +11,12 @@
 #include "debug.h"
 #include "param.h"
 #include "utils.h"
+#include <algorithm>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <vector>
 
@@ -107,7 +112,6 @@ static flagcxResult_t bootstrapNetSendRecv(struct flagcxSocket *sendSock,
 struct extInfo {
   int rank;
   int nranks;
-  union flagcxSocketAddress extAddressListenRoot;
   union flagcxSocketAddress extAddressListen;
 };
 
@@ -121,89 +125,113 @@ static flagcxResult_t setFilesLimit() {
   return flagcxSuccess;
 }
 
+// A connection from a local leader, carrying the registrations of every rank
+// of its host in the order they were forwarded
+struct bootstrapLeader {
+  struct flagcxSocket sock;
+  std::vector<int> ranks;
+};
+
+/* The root only talks to one leader per host (see bootstrapRegister). Each
+ * leader keeps its connection open and streams the registrations of its local
+ * ranks over it. Once every rank has checked in, each leader gets the ring
+ * neighbours of its ranks in a single message.
+ */
 static void *bootstrapRoot(void *rargs) {
   struct bootstrapRootArgs *args = (struct bootstrapRootArgs *)rargs;
   struct flagcxSocket *listenSock = args->listenSock;
-  uint64_t magic = args->magic;
   flagcxResult_t res = flagcxSuccess;
   int nranks = 0, c = 0;
   struct extInfo info;
   union flagcxSocketAddress *rankAddresses = NULL;
-  union flagcxSocketAddress *rankAddressesRoot =
-      NULL; // for initial rank <-> root information exchange
-  union flagcxSocketAddress *zero = NULL;
-  FLAGCXCHECKGOTO(flagcxCalloc(&zero, 1), res, out);
+  std::vector<struct bootstrapLeader *> leaders;
+  std::vector<struct pollfd> pfds;
+  std::vector<union flagcxSocketAddress> nextAddrs;
+  union flagcxSocketAddress zero;
+  memset(&zero, 0, sizeof(zero));
   setFilesLimit();
 
   TRACE(FLAGCX_INIT, "BEGIN");
   /* Receive addresses from all ranks */
   do {
-    struct flagcxSocket sock;
-    FLAGCXCHECKGOTO(flagcxSocketInit(&sock), res, out);
-    FLAGCXCHECKGOTO(flagcxSocketAccept(&sock, listenSock), res, out);
-    FLAGCXCHECKGOTO(bootstrapNetRecv(&sock, &info, sizeof(info)), res, out);
-    FLAGCXCHECKGOTO(flagcxSocketClose(&sock), res, out);
-
-    if (c == 0) {
-      nranks = info.nranks;
-      FLAGCXCHECKGOTO(flagcxCalloc(&rankAddresses, nranks), res, out);
-      FLAGCXCHECKGOTO(flagcxCalloc(&rankAddressesRoot, nranks), res, out);
-    }
+    pfds.resize(leaders.size() + 1);
+    pfds[0] = {listenSock->fd, POLLIN, 0};
+    for (size_t l = 0; l < leaders.size(); l++)
+      pfds[l + 1] = {leaders[l]->sock.fd, POLLIN, 0};
+    SYSCHECKGOTO(poll(pfds.data(), pfds.size(), -1), res, out);
+
+    for (size_t l = 0; l < leaders.size(); l++) {
+      if (pfds[l + 1].revents == 0)
+        continue;
+      struct bootstrapLeader *leader = leaders[l];
+      FLAGCXCHECKGOTO(bootstrapNetRecv(&leader->sock, &info, sizeof(info)), res,
+                      out);
+      if (c == 0) {
+        nranks = info.nranks;
+        FLAGCXCHECKGOTO(flagcxCalloc(&rankAddresses, nranks), res, out);
+      }
 
-    if (nranks != info.nranks) {
-      WARN("Bootstrap Root : mismatch in rank count from procs %d : %d", nranks,
-           info.nranks);
-      goto out;
-    }
+      if (nranks != info.nranks) {
+        WARN("Bootstrap Root : mismatch in rank count from procs %d : %d",
+             nranks, info.nranks);
+        goto out;
+      }
 
-    if (memcmp(zero, &rankAddressesRoot[info.rank],
-               sizeof(union flagcxSocketAddress)) != 0) {
-      WARN("Bootstrap Root : rank %d of %d ranks has already checked in",
+      if (memcmp(&zero, &rankAddresses[info.rank],
+                 sizeof(union flagcxSocketAddress)) != 0) {
+        WARN("Bootstrap Root : rank %d of %d ranks has already checked in",
+             info.rank, nranks);
+        goto out;
+      }
+
+      INFO(FLAGCX_INIT, "Bootstrap Root : rank %d of %d ranks checked in",
            info.rank, nranks);
-      goto out;
-    }
 
-    INFO(FLAGCX_INIT, "Bootstrap Root : rank %d of %d ranks checked in",
-         info.rank, nranks);
+      // Save the connection handle for that rank
+      memcpy(rankAddresses + info.rank, &info.extAddressListen,
+             sizeof(union flagcxSocketAddress));
+      leader->ranks.push_back(info.rank);
 
-    // Save the connection handle for that rank
-    memcpy(rankAddressesRoot + info.rank, &info.extAddressListenRoot,
-           sizeof(union flagcxSocketAddress));
-    memcpy(rankAddresses + info.rank, &info.extAddressListen,
-           sizeof(union flagcxSocketAddress));
+      ++c;
+      TRACE(FLAGCX_INIT, "Received connect from rank %d total %d/%d",
+            info.rank, c, nranks);
+    }
 
-    ++c;
-    TRACE(FLAGCX_INIT, "Received connect from rank %d total %d/%d", info.rank,
-          c, nranks);
-  } while (c < nranks);
-  TRACE(FLAGCX_INIT, "COLLECTED ALL %d HANDLES", nranks);
-
-  // Send the connect handle for the next rank in the AllGather ring
-  for (int r = 0; r < nranks; ++r) {
-    int next = (r + 1) % nranks;
-    struct flagcxSocket sock;
-    FLAGCXCHECKGOTO(flagcxSocketInit(&sock, rankAddressesRoot + r, magic,
-                                     flagcxSocketTypeBootstrap),
-                    res, out);
-    FLAGCXCHECKGOTO(flagcxSocketConnect(&sock), res, out);
-    FLAGCXCHECKGOTO(bootstrapNetSend(&sock, rankAddresses + next,
-                                     sizeof(union flagcxSocketAddress)),
+    if (pfds[0].revents != 0) {
+      struct bootstrapLeader *leader = new bootstrapLeader();
+      leaders.push_back(leader);
+      FLAGCXCHECKGOTO(flagcxSocketInit(&leader->sock), res, out);
+      FLAGCXCHECKGOTO(flagcxSocketAccept(&leader->sock, listenSock), res, out);
+    }
+  } while (c == 0 || c < nranks);
+  TRACE(FLAGCX_INIT, "COLLECTED ALL %d HANDLES FROM %zu LEADERS", nranks,
+        leaders.size());
+
+  // Send each leader the connect handle of the next rank in the AllGather
+  // ring for all of its ranks
+  for (struct bootstrapLeader *leader : leaders) {
+    nextAddrs.resize(leader->ranks.size());
+    for (size_t i = 0; i < leader->ranks.size(); i++)
+      nextAddrs[i] = rankAddresses[(leader->ranks[i] + 1) % nranks];
+    FLAGCXCHECKGOTO(bootstrapNetSend(&leader->sock, nextAddrs.data(),
+                                     nextAddrs.size() *
+                                         sizeof(union flagcxSocketAddress)),
                     res, out);
-    FLAGCXCHECKGOTO(flagcxSocketClose(&sock), res, out);
   }
-  INFO(FLAGCX_INIT, "SENT OUT ALL %d HANDLES", nranks);
+  INFO(FLAGCX_INIT, "SENT OUT ALL %d HANDLES TO %zu LEADERS", nranks,
+       leaders.size());
 
 out:
+  for (struct bootstrapLeader *leader : leaders) {
+    flagcxSocketClose(&leader->sock);
+    delete leader;
+  }
   if (listenSock != NULL) {
     flagcxSocketClose(listenSock);
     free(listenSock);
   }
   if (rankAddresses)
     free(rankAddresses);
-  if (rankAddressesRoot)
-    free(rankAddressesRoot);
-  if (zero)
-    free(zero);
   free(rargs);
 
   TRACE(FLAGCX_INIT, "DONE");
@@ -259,13 +287,200 @@ struct unexConn {
   struct unexConn *next;
 };
 
+FLAGCX_PARAM(BootstrapHierarchy, "BOOTSTRAP_HIERARCHY", 1);
+
+static flagcxResult_t bootstrapLocalIo(int op, int fd, void *ptr, size_t size) {
+  char *data = (char *)ptr;
+  while (size > 0) {
+    ssize_t n = op == FLAGCX_SOCKET_SEND ? send(fd, data, size, MSG_NOSIGNAL)
+                                         : recv(fd, data, size, 0);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      WARN("Bootstrap : local %s failed : %s",
+           op == FLAGCX_SOCKET_SEND ? "send" : "recv",
+           n == 0 ? "peer closed the connection" : strerror(errno));
+      return flagcxRemoteError;
+    }
+    data += n;
+    size -= n;
+  }
+  return flagcxSuccess;
+}
+
+/* Elect one leader per host for this bootstrap. Ranks with the same host hash
+ * race to bind the same abstract unix socket; the winner becomes the leader
+ * and the others connect to it. *fd is the listening socket for the
+ * leader and the connection to the leader otherwise, or -1 if unix sockets
+ * are unusable, in which case the rank acts as its own leader.
+ */
+static flagcxResult_t bootstrapLocalJoin(uint64_t magic, int *fd,
+                                         bool *leader) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  int len = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1,
+                     "flagcx-bootstrap-%lx-%lx", (unsigned long)magic,
+                     (unsigned long)getHostHash());
+  socklen_t addrLen = offsetof(struct sockaddr_un, sun_path) + 1 + len;
+
+  *leader = true;
+  *fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (*fd == -1)
+    goto fallback;
+  if (bind(*fd, (struct sockaddr *)&addr, addrLen) == 0) {
+    if (listen(*fd, SOMAXCONN) != 0)
+      goto fallback;
+    return flagcxSuccess;
+  }
+  if (errno != EADDRINUSE)
+    goto fallback;
+
+  // The leader may have bound the name but not be listening yet
+  *leader = false;
+  for (int retries = 0;; retries++) {
+    if (connect(*fd, (struct sockaddr *)&addr, addrLen) == 0)
+      return flagcxSuccess;
+    if ((errno != ECONNREFUSED && errno != EAGAIN && errno != EINTR) ||
+        retries == RETRY_REFUSED_TIMES) {
+      WARN("Bootstrap : could not reach the local leader : %s",
+           strerror(errno));
+      close(*fd);
+      *fd = -1;
+      return flagcxRemoteError;
+    }
+    usleep(SLEEP_INT);
+  }
+
+fallback:
+  INFO(FLAGCX_INIT, "Bootstrap : no local leader election (%s)",
+       strerror(errno));
+  if (*fd != -1)
+    close(*fd);
+  *fd = -1;
+  *leader = true;
+  return flagcxSuccess;
+}
+
+/* Register this rank with the root and get the listen address of the next
+ * rank in the ring. Only local leaders connect to the root: they forward the
+ * registrations of the other ranks on their host as they arrive and hand the
+ * answers back, so the root handles one connection per host instead of two
+ * per rank.
+ */
+static flagcxResult_t bootstrapRegister(struct flagcxBootstrapHandle *handle,
+                                        struct bootstrapState *state,
+                                        struct extInfo *info,
+                                        union flagcxSocketAddress *nextAddr) {
+  flagcxResult_t ret = flagcxSuccess;
+  int localFd = -1;
+  bool leader = true;
+  bool rootReady = false;
+  struct flagcxSocket rootSock;
+  std::vector<int> pending; // local connections not registered yet
+  std::vector<int> order;   // local connection per forwarded rank, -1 is me
+  std::vector<union flagcxSocketAddress> nextAddrs;
+  std::vector<struct pollfd> pfds;
+
+  if (flagcxParamBootstrapHierarchy())
+    FLAGCXCHECK(bootstrapLocalJoin(state->magic, &localFd, &leader));
+
+  if (!leader) {
+    FLAGCXCHECKGOTO(
+        bootstrapLocalIo(FLAGCX_SOCKET_SEND, localFd, info, sizeof(*info)), ret,
+        exit);
+    FLAGCXCHECKGOTO(bootstrapLocalIo(FLAGCX_SOCKET_RECV, localFd, nextAddr,
+                                     sizeof(union flagcxSocketAddress)),
+                    ret, exit);
+    goto exit;
+  }
+
+  // send info on my listening socket to root
+  FLAGCXCHECKGOTO(flagcxSocketInit(&rootSock, &handle->addr, state->magic,
+                                   flagcxSocketTypeBootstrap, state->abortFlag),
+                  ret, exit);
+  FLAGCXCHECKGOTO(flagcxSocketConnect(&rootSock), ret, close);
+  FLAGCXCHECKGOTO(bootstrapNetSend(&rootSock, info, sizeof(*info)), ret, close);
+  order.push_back(-1);
+
+  // Forward local registrations until the root answers, which it only does
+  // once every rank has checked in
+  while (!rootReady) {
+    pfds.clear();
+    pfds.push_back({rootSock.fd, POLLIN, 0});
+    if (localFd != -1)
+      pfds.push_back({localFd, POLLIN, 0});
+    for (int fd : pending)
+      pfds.push_back({fd, POLLIN, 0});
+    if (poll(pfds.data(), pfds.size(), -1) == -1) {
+      if (errno == EINTR)
+        continue;
+      WARN("Bootstrap : poll failed : %s", strerror(errno));
+      ret = flagcxSystemError;
+      goto close;
+    }
+    rootReady = pfds[0].revents != 0;
+    for (size_t p = localFd != -1 ? 2 : 1; p < pfds.size(); p++) {
+      if (pfds[p].revents == 0)
+        continue;
+      struct extInfo memberInfo;
+      FLAGCXCHECKGOTO(bootstrapLocalIo(FLAGCX_SOCKET_RECV, pfds[p].fd,
+                                       &memberInfo, sizeof(memberInfo)),
+                      ret, close);
+      FLAGCXCHECKGOTO(
+          bootstrapNetSend(&rootSock, &memberInfo, sizeof(memberInfo)), ret,
+          close);
+      order.push_back(pfds[p].fd);
+      pending.erase(std::find(pending.begin(), pending.end(), pfds[p].fd));
+    }
+    if (localFd != -1 && pfds[1].revents != 0) {
+      int fd = accept4(localFd, NULL, NULL, SOCK_CLOEXEC);
+      if (fd == -1) {
+        WARN("Bootstrap : local accept failed : %s", strerror(errno));
+        ret = flagcxSystemError;
+        goto close;
+      }
+      pending.push_back(fd);
+    }
+  }
+
+  nextAddrs.resize(order.size());
+  FLAGCXCHECKGOTO(bootstrapNetRecv(&rootSock, nextAddrs.data(),
+                                   nextAddrs.size() *
+                                       sizeof(union flagcxSocketAddress)),
+                  ret, close);
+  for (size_t i = 0; i < order.size(); i++) {
+    if (order[i] == -1) {
+      *nextAddr = nextAddrs[i];
+      continue;
+    }
+    FLAGCXCHECKGOTO(bootstrapLocalIo(FLAGCX_SOCKET_SEND, order[i],
+                                     &nextAddrs[i],
+                                     sizeof(union flagcxSocketAddress)),
+                    ret, close);
+  }
+  TRACE(FLAGCX_INIT, "rank %d registered %zu local ranks", info->rank,
+        order.size());
+
+close:
+  flagcxSocketClose(&rootSock);
+exit:
+  for (int fd : pending)
+    close(fd);
+  for (int fd : order)
+    if (fd != -1)
+      close(fd);
+  if (localFd != -1)
+    close(localFd);
+  return ret;
+}
+
 flagcxResult_t bootstrapInit(struct flagcxBootstrapHandle *handle,
                              void *commState) {
   struct bootstrapState *state = (struct bootstrapState *)commState;
   int rank = state->rank;
   int nranks = state->nranks;
   flagcxSocketAddress nextAddr;
-  struct flagcxSocket sock, listenSockRoot;
   struct extInfo info = {0};
 
   TRACE(FLAGCX_INIT, "rank %d nranks %d", rank, nranks);
@@ -279,38 +494,10 @@ flagcxResult_t bootstrapInit(struct flagcxBootstrapHandle *handle,
   FLAGCXCHECK(flagcxSocketListen(&state->listenSock));
   FLAGCXCHECK(flagcxSocketGetAddr(&state->listenSock, &info.extAddressListen));
 
-  // Create socket for root to contact me
-  FLAGCXCHECK(flagcxSocketInit(&listenSockRoot, &bootstrapNetIfAddr,
-                               state->magic, flagcxSocketTypeBootstrap,
-                               state->abortFlag));
-  FLAGCXCHECK(flagcxSocketListen(&listenSockRoot));
-  FLAGCXCHECK(flagcxSocketGetAddr(&listenSockRoot, &info.extAddressListenRoot));
-
-  // stagger connection times to avoid an overload of the root
-  if (nranks > 128) {
-    long msec = rank;
-    struct timespec tv;
-    tv.tv_sec = msec / 1000;
-    tv.tv_nsec = 1000000 * (msec % 1000);
-    TRACE(FLAGCX_INIT, "rank %d delaying connection to root by %ld msec", rank,
-          msec);
-    (void)nanosleep(&tv, NULL);
-  }
-
-  // send info on my listening socket to root
-  FLAGCXCHECK(flagcxSocketInit(&sock, &handle->addr, state->magic,
-                               flagcxSocketTypeBootstrap, state->abortFlag));
-  FLAGCXCHECK(flagcxSocketConnect(&sock));
-  FLAGCXCHECK(bootstrapNetSend(&sock, &info, sizeof(info)));
-  FLAGCXCHECK(flagcxSocketClose(&sock));
-
   // get info on my "next" rank in the bootstrap ring from root
-  FLAGCXCHECK(flagcxSocketInit(&sock));
-  FLAGCXCHECK(flagcxSocketAccept(&sock, &listenSockRoot));
-  FLAGCXCHECK(
-      bootstrapNetRecv(&sock, &nextAddr, sizeof(union flagcxSocketAddress)));
-  FLAGCXCHECK(flagcxSocketClose(&sock));
-  FLAGCXCHECK(flagcxSocketClose(&listenSockRoot));
+  uint64_t registerStart = clockNano();
+  FLAGCXCHECK(bootstrapRegister(handle, state, &info, &nextAddr));
+  state->registerNs = clockNano() - registerStart;
 
   FLAGCXCHECK(flagcxSocketInit(&state->ringSendSocket, &nextAddr, state->magic,
                                flagcxSocketTypeBootstrap, state->abortFlag));
@@ -326,7 +513,8 @@ flagcxResult_t bootstrapInit(struct flagcxBootstrapHandle *handle,
   FLAGCXCHECK(bootstrapAllGather(state, state->peerCommAddresses,
                                  sizeof(union flagcxSocketAddress)));
 
-  INFO(FLAGCX_INIT, "rank %d nranks %d - DONE", rank, nranks);
+  INFO(FLAGCX_INIT, "rank %d nranks %d - DONE, registered in %.2f ms", rank,
+       nranks, state->registerNs / 1e6);
 
   return flagcxSuccess;
 }
@@ -32,6 +32,7 @@ struct bootstrapState {
   int nranks;
   uint64_t magic;
   volatile uint32_t *abortFlag;
+  uint64_t registerNs; // time bootstrapInit took to register with the root
 };
 
 flagcxResult_t bootstrapNetInit();
@@ -46,6 +47,12 @@ flagcxResult_t bootstrapSend(void *commState, int peer, int tag, void *data,
                              int size);
 flagcxResult_t bootstrapRecv(void *commState, int peer, int tag, void *data,
                              int size);
+// Open the connection of a bootstrapSend/bootstrapRecv pair, leaving the
+// size and payload to be moved on sock by the caller
+flagcxResult_t bootstrapConnect(void *commState, int peer, int tag,
+                                struct flagcxSocket *sock);
+flagcxResult_t bootstrapAccept(void *commState, int peer, int tag,
+                               struct flagcxSocket *sock);
 flagcxResult_t bootstrapBarrier(void *commState, int rank, int nranks, int tag);
 flagcxResult_t bootstrapBroadcast(void *commState, int rank, int nranks,
                                   int root, void *bcastData, int size);
@@ -0,0 +1,133 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ ************************************************************************/
+
+#include "config.h"
+#include "debug.h"
+#include "param.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct flagcxConfig globalConfig;
+static pthread_once_t configOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t configMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *c2cAlgoNames[] = {"DEFAULT", "RING_PIPELINED",
+                                     "XML_INPUT"};
+
+static int configFlag(const char *name) {
+  const char *env = flagcxGetEnv(name);
+  return env != NULL && atoi(env) == 1;
+}
+
+static void configString(const char *name, char *out) {
+  const char *env = flagcxGetEnv(name);
+  snprintf(out, FLAGCX_CONFIG_PATH_MAX, "%s", env ? env : "");
+}
+
+static void configLoadReloadable(struct flagcxConfig *config) {
+  config->deviceFuncRelaxedOrdering =
+      configFlag("FLAGCX_DEVICE_FUNC_RELAXED_ORDERING");
+  config->c2cAlgo = flagcxConfigC2cAlgoDefault;
+  const char *algo = flagcxGetEnv("FLAGCX_C2C_ALGO");
+  if (algo != NULL) {
+    if (strcmp(algo, "RING_PIPELINED") == 0 ||
+        strcmp(algo, "Ring_pipelined") == 0) {
+      config->c2cAlgo = flagcxConfigC2cAlgoRingPipelined;
+    } else if (strcmp(algo, "XML_INPUT") == 0 ||
+               strcmp(algo, "Xml_input") == 0) {
+      config->c2cAlgo = flagcxConfigC2cAlgoXmlInput;
+    }
+  }
+  configString("FLAGCX_ALGO_IMPORT_PATH", config->algoImportPath);
+  configString("FLAGCX_ALGO_IMPORT_PREFIX", config->algoImportPrefix);
+  configString("FLAGCX_ALGO_EXPORT_PATH", config->algoExportPath);
+  configString("FLAGCX_ALGO_EXPORT_PREFIX", config->algoExportPrefix);
+}
+
+static void configInit() {
+  globalConfig.useHostComm = configFlag("FLAGCX_USE_HOST_COMM");
+  globalConfig.useHeteroComm = configFlag("FLAGCX_USE_HETERO_COMM");
+  globalConfig.useTuner = configFlag("FLAGCX_USE_TUNER");
+  const char *topo = flagcxGetEnv("FLAGCX_ENABLE_TOPO_DETECT");
+  globalConfig.topoDetect =
+      topo != NULL && (strcmp(topo, "TRUE") == 0 || strcmp(topo, "True") == 0);
+  configLoadReloadable(&globalConfig);
+}
+
+const struct flagcxConfig *flagcxConfigGet() {
+  pthread_once(&configOnce, configInit);
+  return &globalConfig;
+}
+
+void flagcxConfigReload() {
+  pthread_once(&configOnce, configInit);
+  pthread_mutex_lock(&configMutex);
+  configLoadReloadable(&globalConfig);
+  pthread_mutex_unlock(&configMutex);
+}
+
+void flagcxConfigUpdate(struct flagcxConfig *dst,
+                        const struct flagcxConfig *src) {
+  pthread_mutex_lock(&configMutex);
+  dst->deviceFuncRelaxedOrdering = src->deviceFuncRelaxedOrdering;
+  dst->c2cAlgo = src->c2cAlgo;
+  memcpy(dst->algoImportPath, src->algoImportPath, FLAGCX_CONFIG_PATH_MAX);
+  memcpy(dst->algoImportPrefix, src->algoImportPrefix, FLAGCX_CONFIG_PATH_MAX);
+  memcpy(dst->algoExportPath, src->algoExportPath, FLAGCX_CONFIG_PATH_MAX);
+  memcpy(dst->algoExportPrefix, src->algoExportPrefix, FLAGCX_CONFIG_PATH_MAX);
+  pthread_mutex_unlock(&configMutex);
+}
+
+flagcxResult_t flagcxConfigDump(const struct flagcxConfig *config, int rank) {
+  // Unset strings and the default algorithm are left out, so that loading
+  // the dump keeps them unset
+  char lines[10][FLAGCX_CONFIG_PATH_MAX + 64];
+  int n = 0;
+  snprintf(lines[n++], sizeof(lines[0]), "FLAGCX_USE_HOST_COMM=%d",
+           config->useHostComm);
+  snprintf(lines[n++], sizeof(lines[0]), "FLAGCX_USE_HETERO_COMM=%d",
+           config->useHeteroComm);
+  snprintf(lines[n++], sizeof(lines[0]), "FLAGCX_USE_TUNER=%d",
+           config->useTuner);
+  snprintf(lines[n++], sizeof(lines[0]), "FLAGCX_ENABLE_TOPO_DETECT=%s",
+           config->topoDetect ? "TRUE" : "FALSE");
+  snprintf(lines[n++], sizeof(lines[0]),
+           "FLAGCX_DEVICE_FUNC_RELAXED_ORDERING=%d",
+           config->deviceFuncRelaxedOrdering);
+  if (config->c2cAlgo != flagcxConfigC2cAlgoDefault) {
+    snprintf(lines[n++], sizeof(lines[0]), "FLAGCX_C2C_ALGO=%s",
+             c2cAlgoNames[config->c2cAlgo]);
+  }
+  const char *names[] = {"FLAGCX_ALGO_IMPORT_PATH", "FLAGCX_ALGO_IMPORT_PREFIX",
+                         "FLAGCX_ALGO_EXPORT_PATH",
+                         "FLAGCX_ALGO_EXPORT_PREFIX"};
+  const char *values[] = {config->algoImportPath, config->algoImportPrefix,
+                          config->algoExportPath, config->algoExportPrefix};
+  for (int i = 0; i < 4; i++) {
+    if (values[i][0] != '\0') {
+      snprintf(lines[n++], sizeof(lines[0]), "%s=%s", names[i], values[i]);
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    INFO(FLAGCX_ENV, "config %s", lines[i]);
+  }
+  const char *path = flagcxGetEnv("FLAGCX_CONFIG_DUMP_FILE");
+  if (rank != 0 || path == NULL || path[0] == '\0') {
+    return flagcxSuccess;
+  }
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    WARN("Cannot open config dump file %s", path);
+    return flagcxSystemError;
+  }
+  for (int i = 0; i < n; i++) {
+    fprintf(file, "%s\n", lines[i]);
+  }
+  fclose(file);
+  INFO(FLAGCX_ENV, "Config written to %s", path);
+  return flagcxSuccess;
+}
@@ -0,0 +1,54 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ *
+ * Typed snapshot of the environment settings that are consulted on every
+ * collective call. The environment is read once into a process-wide
+ * snapshot, every communicator keeps its own copy taken at init, and hot
+ * paths only read fields of that copy. Settings that decide which inner
+ * communicators exist are fixed for the lifetime of a communicator; the
+ * others can be re-read with flagcxCommReloadConfig.
+ ************************************************************************/
+
+#ifndef FLAGCX_CONFIG_H_
+#define FLAGCX_CONFIG_H_
+
+#include "flagcx.h"
+
+#define FLAGCX_CONFIG_PATH_MAX 1024
+
+typedef enum {
+  flagcxConfigC2cAlgoDefault = 0,
+  flagcxConfigC2cAlgoRingPipelined = 1, // RING_PIPELINED
+  flagcxConfigC2cAlgoXmlInput = 2       // XML_INPUT
+} flagcxConfigC2cAlgo_t;
+
+struct flagcxConfig {
+  // Fixed once a communicator is created
+  int useHostComm;   // FLAGCX_USE_HOST_COMM
+  int useHeteroComm; // FLAGCX_USE_HETERO_COMM
+  int useTuner;      // FLAGCX_USE_TUNER
+  int topoDetect;    // FLAGCX_ENABLE_TOPO_DETECT
+  // Reloadable
+  int deviceFuncRelaxedOrdering; // FLAGCX_DEVICE_FUNC_RELAXED_ORDERING
+  flagcxConfigC2cAlgo_t c2cAlgo; // FLAGCX_C2C_ALGO
+  char algoImportPath[FLAGCX_CONFIG_PATH_MAX];   // FLAGCX_ALGO_IMPORT_PATH
+  char algoImportPrefix[FLAGCX_CONFIG_PATH_MAX]; // FLAGCX_ALGO_IMPORT_PREFIX
+  char algoExportPath[FLAGCX_CONFIG_PATH_MAX];   // FLAGCX_ALGO_EXPORT_PATH
+  char algoExportPrefix[FLAGCX_CONFIG_PATH_MAX]; // FLAGCX_ALGO_EXPORT_PREFIX
+};
+
+// Process-wide snapshot, read from the environment on first use
+const struct flagcxConfig *flagcxConfigGet();
+
+// Re-read the reloadable settings of the process-wide snapshot
+void flagcxConfigReload();
+
+// Copy the reloadable settings of src into dst
+void flagcxConfigUpdate(struct flagcxConfig *dst,
+                        const struct flagcxConfig *src);
+
+// Log every setting and, on rank 0, write them to FLAGCX_CONFIG_DUMP_FILE
+// as NAME=value lines, the format of ~/.flagcx.conf
+flagcxResult_t flagcxConfigDump(const struct flagcxConfig *config, int rank);
+
+#endif
@@ -0,0 +1,341 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ ************************************************************************/
+
+#include "latency.h"
+#include "adaptor.h"
+#include "debug.h"
+#include "group.h"
+#include "param.h"
+#include "shmutils.h"
+#include "utils.h"
+#include <algorithm>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+FLAGCX_PARAM(LatencyEnable, "LATENCY_ENABLE", 0);
+FLAGCX_PARAM(LatencyShm, "LATENCY_SHM", 0);
+FLAGCX_PARAM(LatencyDumpInterval, "LATENCY_DUMP_INTERVAL", 0);
+
+static const char *latencyPhaseNames[flagcxLatencyNumPhases] = {
+    "host", "device", "queue", "net", "proxy", "total"};
+static const char *latencyOpNames[] = {
+    "Send",          "Recv",     "Broadcast", "Gather",
+    "Scatter",       "Reduce",   "AllReduce", "AllGather",
+    "ReduceScatter", "AlltoAll", "AlltoAllv"};
+
+__thread struct flagcxLatencyTag flagcxLatencyCurrent = {0, -1, 0};
+
+static struct flagcxLatencyShared *latencyState = NULL;
+static flagcxShmHandle_t latencyShmHandle = NULL;
+static char latencyDumpFile[PATH_MAX] = "";
+static pthread_once_t latencyOnce = PTHREAD_ONCE_INIT;
+
+static pthread_t latencyThread;
+static bool latencyThreadStarted = false;
+static bool latencyStop = false;
+static pthread_mutex_t latencyMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t latencyCond = PTHREAD_COND_INITIALIZER;
+
+static void *latencyDumpThread(void *) {
+  int64_t interval = flagcxParamLatencyDumpInterval();
+  pthread_mutex_lock(&latencyMutex);
+  while (!latencyStop) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += interval / 1000;
+    ts.tv_nsec += (interval % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&latencyCond, &latencyMutex, &ts);
+    if (latencyStop)
+      break;
+    pthread_mutex_unlock(&latencyMutex);
+    flagcxLatencyDump();
+    pthread_mutex_lock(&latencyMutex);
+  }
+  pthread_mutex_unlock(&latencyMutex);
+  return NULL;
+}
+
+static void latencyFini() {
+  if (latencyThreadStarted) {
+    pthread_mutex_lock(&latencyMutex);
+    latencyStop = true;
+    pthread_cond_signal(&latencyCond);
+    pthread_mutex_unlock(&latencyMutex);
+    pthread_join(latencyThread, NULL);
+  }
+  flagcxLatencyDump();
+  if (latencyShmHandle) {
+    flagcxShmUnlink(latencyShmHandle);
+    flagcxShmClose(latencyShmHandle);
+  }
+}
+
+static void latencyInit() {
+  size_t size = sizeof(struct flagcxLatencyShared);
+  void *ptr = NULL;
+  if (flagcxParamLatencyShm()) {
+    char path[SHM_PATH_MAX];
+    snprintf(path, sizeof(path), "/dev/shm/flagcx-latency-%d", getpid());
+    if (flagcxShmOpen(path, sizeof(path), size, &ptr, NULL, 1,
+                      &latencyShmHandle) != flagcxSuccess) {
+      WARN("Latency: could not export histograms in %s, keeping them "
+           "private",
+           path);
+      ptr = NULL;
+      latencyShmHandle = NULL;
+    } else {
+      INFO(FLAGCX_INIT, "Latency: histograms exported in %s", path);
+    }
+  }
+  if (ptr == NULL) {
+    ptr = calloc(1, size);
+    if (ptr == NULL) {
+      WARN("Latency: failed to allocate %zu bytes, disabling", size);
+      return;
+    }
+  }
+  struct flagcxLatencyShared *state = (struct flagcxLatencyShared *)ptr;
+  state->version = FLAGCX_LATENCY_VERSION;
+  state->nSlots = FLAGCX_LATENCY_SLOTS;
+  state->nBuckets = FLAGCX_LATENCY_BUCKETS;
+  state->nPhases = flagcxLatencyNumPhases;
+  state->ringSize = FLAGCX_LATENCY_RING;
+  state->pid = getpid();
+  // Publish the magic last so that a sidecar never sees a half-set header
+  __atomic_store_n(&state->magic, FLAGCX_LATENCY_MAGIC, __ATOMIC_RELEASE);
+
+  const char *dumpEnv = flagcxGetEnv("FLAGCX_LATENCY_DUMP_FILE");
+  if (dumpEnv != NULL && dumpEnv[0] != '\0') {
+    flagcxExpandPath(dumpEnv, latencyDumpFile, sizeof(latencyDumpFile));
+  }
+  latencyState = state;
+  if (latencyDumpFile[0] != '\0' && flagcxParamLatencyDumpInterval() > 0) {
+    if (pthread_create(&latencyThread, NULL, latencyDumpThread, NULL) == 0) {
+      flagcxSetThreadName(latencyThread, "FlagCX latency");
+      latencyThreadStarted = true;
+    }
+  }
+  atexit(latencyFini);
+}
+
+bool flagcxLatencyEnabled() {
+  if (flagcxParamLatencyEnable() == 0)
+    return false;
+  pthread_once(&latencyOnce, latencyInit);
+  return latencyState != NULL;
+}
+
+// Class 0 is empty messages, class c > 0 covers (2^(c-2), 2^(c-1)] bytes
+static inline uint32_t latencySizeClass(size_t bytes) {
+  if (bytes <= 1)
+    return bytes;
+  return 65 - __builtin_clzll(bytes - 1);
+}
+
+static struct flagcxLatencySlot *latencyGetSlot(uint64_t commHash, int op,
+                                                uint32_t sizeClass) {
+  uint64_t key = commHash * 0x9e3779b97f4a7c15ULL;
+  key ^= ((uint64_t)op << 8 | sizeClass) * 0xff51afd7ed558ccdULL;
+  key |= 1;
+  for (int i = 0; i < FLAGCX_LATENCY_SLOTS; i++) {
+    struct flagcxLatencySlot *slot =
+        latencyState->slots + ((key >> 1) + i) % FLAGCX_LATENCY_SLOTS;
+    uint64_t cur = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+    if (cur == key)
+      return slot;
+    if (cur != 0)
+      continue;
+    if (__atomic_compare_exchange_n(&slot->key, &cur, key, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      slot->commHash = commHash;
+      slot->op = op;
+      slot->sizeClass = sizeClass;
+      return slot;
+    }
+    if (cur == key)
+      return slot;
+  }
+  return NULL;
+}
+
+static inline void latencyHistAdd(struct flagcxLatencyHist *hist,
+                                  uint64_t ns) {
+  __atomic_fetch_add(&hist->buckets[flagcxLatencyBucket(ns)], 1,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(&hist->sum, ns, __ATOMIC_RELAXED);
+  uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+  while (ns > max &&
+         !__atomic_compare_exchange_n(&hist->max, &max, ns, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+  // count last, so that a reader seeing count N sees at least N samples
+  __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELEASE);
+}
+
+void flagcxLatencyRecord(uint64_t commHash, int op, size_t bytes,
+                         uint32_t phaseMask,
+                         const uint64_t ns[flagcxLatencyNumPhases]) {
+  if (!flagcxLatencyEnabled())
+    return;
+  uint32_t sizeClass = latencySizeClass(bytes);
+  struct flagcxLatencySlot *slot = latencyGetSlot(commHash, op, sizeClass);
+  if (slot == NULL) {
+    __atomic_fetch_add(&latencyState->dropped, 1, __ATOMIC_RELAXED);
+  } else {
+    for (int p = 0; p < flagcxLatencyNumPhases; p++) {
+      if (phaseMask & FLAGCX_LATENCY_PHASE(p))
+        latencyHistAdd(&slot->phases[p], ns[p]);
+    }
+  }
+
+  uint64_t idx = __atomic_fetch_add(&latencyState->head, 1, __ATOMIC_RELAXED);
+  struct flagcxLatencySample *s =
+      latencyState->ring + idx % FLAGCX_LATENCY_RING;
+  __atomic_store_n(&s->seq, 2 * idx + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  s->timestamp = clockNano();
+  s->commHash = commHash;
+  s->op = op;
+  s->phaseMask = phaseMask;
+  s->bytes = bytes;
+  for (int p = 0; p < flagcxLatencyNumPhases; p++)
+    s->ns[p] = (phaseMask & FLAGCX_LATENCY_PHASE(p)) ? ns[p] : 0;
+  __atomic_store_n(&s->seq, 2 * idx + 2, __ATOMIC_RELEASE);
+}
+
+static uint64_t latencyPercentile(const struct flagcxLatencyHist *hist,
+                                  uint64_t count, double q) {
+  uint64_t target = (uint64_t)(q * count + 0.5);
+  if (target == 0)
+    target = 1;
+  uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+  uint64_t seen = 0;
+  for (int b = 0; b < FLAGCX_LATENCY_BUCKETS; b++) {
+    seen += __atomic_load_n(&hist->buckets[b], __ATOMIC_RELAXED);
+    if (seen >= target)
+      return std::min(flagcxLatencyBucketLimit(b), max);
+  }
+  return max;
+}
+
+flagcxResult_t flagcxLatencyDump() {
+  if (latencyState == NULL || latencyDumpFile[0] == '\0')
+    return flagcxSuccess;
+  char tmp[PATH_MAX + 8];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", latencyDumpFile);
+  FILE *file = fopen(tmp, "w");
+  if (file == NULL) {
+    WARN("Latency: cannot open %s : %s", tmp, strerror(errno));
+    return flagcxSystemError;
+  }
+  fprintf(file,
+          "# pid %d samples %lu dropped %lu, times in us (percentiles are "
+          "bucket upper bounds)\n",
+          getpid(), (unsigned long)latencyState->head,
+          (unsigned long)latencyState->dropped);
+  fprintf(file, "%-18s %-14s %12s %-7s %10s %10s %10s %10s %10s %10s\n",
+          "comm", "op", "bytes<=", "phase", "count", "mean", "p50", "p90",
+          "p99", "max");
+  for (int i = 0; i < FLAGCX_LATENCY_SLOTS; i++) {
+    struct flagcxLatencySlot *slot = latencyState->slots + i;
+    if (__atomic_load_n(&slot->key, __ATOMIC_ACQUIRE) == 0)
+      continue;
+    for (int p = 0; p < flagcxLatencyNumPhases; p++) {
+      struct flagcxLatencyHist *hist = slot->phases + p;
+      uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_ACQUIRE);
+      if (count == 0)
+        continue;
+      const char *opName =
+          slot->op < sizeof(latencyOpNames) / sizeof(latencyOpNames[0])
+              ? latencyOpNames[slot->op]
+              : "Unknown";
+      unsigned long long bytes =
+          slot->sizeClass == 0 ? 0 : 1ULL << (slot->sizeClass - 1);
+      fprintf(file,
+              "%-18lx %-14s %12llu %-7s %10lu %10.2f %10.2f %10.2f %10.2f "
+              "%10.2f\n",
+              (unsigned long)slot->commHash, opName, bytes,
+              latencyPhaseNames[p], (unsigned long)count,
+              hist->sum / 1e3 / count,
+              latencyPercentile(hist, count, 0.50) / 1e3,
+              latencyPercentile(hist, count, 0.90) / 1e3,
+              latencyPercentile(hist, count, 0.99) / 1e3, hist->max / 1e3);
+    }
+  }
+  fclose(file);
+  if (rename(tmp, latencyDumpFile) != 0) {
+    WARN("Latency: cannot rename %s to %s : %s", tmp, latencyDumpFile,
+         strerror(errno));
+    return flagcxSystemError;
+  }
+  return flagcxSuccess;
+}
+
+struct flagcxLatencyCompletion {
+  uint64_t commHash;
+  int op;
+  size_t bytes;
+  uint64_t start;
+  uint64_t issued;
+};
+
+static void latencyCompletion(void *arg) {
+  struct flagcxLatencyCompletion *c = (struct flagcxLatencyCompletion *)arg;
+  uint64_t ns[flagcxLatencyNumPhases] = {0};
+  uint64_t now = clockNano();
+  ns[flagcxLatencyHost] = c->issued - c->start;
+  ns[flagcxLatencyDevice] = now - c->issued;
+  ns[flagcxLatencyTotal] = now - c->start;
+  flagcxLatencyRecord(c->commHash, c->op, c->bytes,
+                      FLAGCX_LATENCY_PHASE(flagcxLatencyHost) |
+                          FLAGCX_LATENCY_PHASE(flagcxLatencyDevice) |
+                          FLAGCX_LATENCY_PHASE(flagcxLatencyTotal),
+                      ns);
+  free(c);
+}
+
+flagcxLatencyScope::flagcxLatencyScope(uint64_t commHash, int op,
+                                       size_t bytes, flagcxStream_t stream)
+    : commHash(commHash), op(op), bytes(bytes), stream(stream), start(0),
+      outermost(false) {
+  if (!flagcxLatencyEnabled())
+    return;
+  start = clockNano();
+  if (flagcxLatencyCurrent.op < 0) {
+    flagcxLatencyCurrent = {commHash, op, bytes};
+    outermost = true;
+  }
+}
+
+flagcxLatencyScope::~flagcxLatencyScope() {
+  if (start == 0)
+    return;
+  if (outermost)
+    flagcxLatencyCurrent = {0, -1, 0};
+  uint64_t issued = clockNano();
+  if (stream != NULL && flagcxGroupDepth == 0 &&
+      deviceAdaptor->launchHostFunc != NULL) {
+    struct flagcxLatencyCompletion *c =
+        (struct flagcxLatencyCompletion *)malloc(sizeof(*c));
+    if (c != NULL) {
+      *c = {commHash, op, bytes, start, issued};
+      if (deviceAdaptor->launchHostFunc(stream, latencyCompletion, c) ==
+          flagcxSuccess)
+        return;
+      free(c);
+    }
+  }
+  uint64_t ns[flagcxLatencyNumPhases] = {0};
+  ns[flagcxLatencyHost] = issued - start;
+  flagcxLatencyRecord(commHash, op, bytes,
+                      FLAGCX_LATENCY_PHASE(flagcxLatencyHost), ns);
+}
@@ -0,0 +1,137 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ *
+ * Per-collective latency histograms. Enabled with FLAGCX_LATENCY_ENABLE=1.
+ *
+ * Every recorded operation is accounted in a log-linear histogram keyed by
+ * (communicator, op, log2 size class), split into the phases below, and
+ * appended to a fixed-size sample ring. Both live in one flat region that
+ * can be placed in /dev/shm (FLAGCX_LATENCY_SHM=1) so that a sidecar can
+ * read it without locks: histogram counters are plain atomics and every ring
+ * entry carries a sequence number that is odd while it is being written.
+ ************************************************************************/
+
+#ifndef FLAGCX_LATENCY_H_
+#define FLAGCX_LATENCY_H_
+
+#include "flagcx.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLAGCX_LATENCY_MAGIC 0x31544c5843474c46ULL // "FLGCXLT1"
+#define FLAGCX_LATENCY_VERSION 1
+#define FLAGCX_LATENCY_BUCKETS 128
+#define FLAGCX_LATENCY_SLOTS 256
+#define FLAGCX_LATENCY_RING 4096
+
+typedef enum {
+  flagcxLatencyHost = 0,   // API entry to API return
+  flagcxLatencyDevice = 1, // API return to stream completion
+  flagcxLatencyQueue = 2,  // proxy op saved to device-side start
+  flagcxLatencyNet = 3,    // device-side start to last chunk done
+  flagcxLatencyProxy = 4,  // last chunk done to op retired
+  flagcxLatencyTotal = 5,  // API entry to stream completion
+  flagcxLatencyNumPhases = 6
+} flagcxLatencyPhase_t;
+
+#define FLAGCX_LATENCY_PHASE(p) (1u << (p))
+
+// Bucket 0 holds everything below 1us; above that each power of two is split
+// into 4 linear sub-buckets, i.e. a relative error of at most 25%.
+static inline int flagcxLatencyBucket(uint64_t ns) {
+  if (ns < 1024)
+    return 0;
+  int msb = 63 - __builtin_clzll(ns);
+  int idx = 1 + (msb - 10) * 4 + (int)((ns >> (msb - 2)) & 3);
+  return idx < FLAGCX_LATENCY_BUCKETS ? idx : FLAGCX_LATENCY_BUCKETS - 1;
+}
+
+// Exclusive upper bound of a bucket in nanoseconds
+static inline uint64_t flagcxLatencyBucketLimit(int b) {
+  if (b == 0)
+    return 1024;
+  int msb = 10 + (b - 1) / 4;
+  uint64_t step = 1ULL << (msb - 2);
+  return (1ULL << msb) + ((b - 1) % 4 + 1) * step;
+}
+
+struct flagcxLatencyHist {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[FLAGCX_LATENCY_BUCKETS];
+};
+
+struct flagcxLatencySlot {
+  uint64_t key; // 0 means free, claimed once with a CAS and never released
+  uint64_t commHash;
+  uint32_t op; // flagcxCommOp_t
+  uint32_t sizeClass;
+  struct flagcxLatencyHist phases[flagcxLatencyNumPhases];
+};
+
+struct flagcxLatencySample {
+  uint64_t seq; // 2*index+1 while writing, 2*index+2 once complete
+  uint64_t timestamp;
+  uint64_t commHash;
+  uint32_t op;
+  uint32_t phaseMask;
+  uint64_t bytes;
+  uint64_t ns[flagcxLatencyNumPhases];
+};
+
+// Layout of the exported region. Readers must check magic and version and
+// use the counts below rather than the compile-time constants.
+struct flagcxLatencyShared {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t nSlots;
+  uint32_t nBuckets;
+  uint32_t nPhases;
+  uint32_t ringSize;
+  uint32_t pid;
+  uint64_t head;    // number of samples ever written to the ring
+  uint64_t dropped; // records lost because the slot table was full
+  struct flagcxLatencySlot slots[FLAGCX_LATENCY_SLOTS];
+  struct flagcxLatencySample ring[FLAGCX_LATENCY_RING];
+};
+
+bool flagcxLatencyEnabled();
+
+// Account one operation. Only phases present in phaseMask are recorded.
+void flagcxLatencyRecord(uint64_t commHash, int op, size_t bytes,
+                         uint32_t phaseMask,
+                         const uint64_t ns[flagcxLatencyNumPhases]);
+
+// Collective on whose behalf proxy ops are being issued by this thread, so
+// that their queue/net/proxy phases land in the collective's histogram. op is
+// -1 outside of a measured call; proxy ops are then accounted as Send/Recv.
+struct flagcxLatencyTag {
+  uint64_t commHash;
+  int op;
+  size_t bytes;
+};
+extern __thread struct flagcxLatencyTag flagcxLatencyCurrent;
+
+// Write the current histograms to the FLAGCX_LATENCY_DUMP_FILE, if set.
+flagcxResult_t flagcxLatencyDump();
+
+// Measures a collective API call: host time until the scope closes, then
+// device time until the stream reaches that point. Device time is skipped
+// inside group calls, where the work is only issued at group end.
+class flagcxLatencyScope {
+public:
+  flagcxLatencyScope(uint64_t commHash, int op, size_t bytes,
+                     flagcxStream_t stream);
+  ~flagcxLatencyScope();
+
+private:
+  uint64_t commHash;
+  int op;
+  size_t bytes;
+  flagcxStream_t stream;
+  uint64_t start;
+  bool outermost;
+};
+
+#endif
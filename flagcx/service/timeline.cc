@@ -0,0 +1,265 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ ************************************************************************/
+
+#include "timeline.h"
+#include "bootstrap.h"
+#include "debug.h"
+#include "param.h"
+#include "utils.h"
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+FLAGCX_PARAM(TimelineEnable, "TIMELINE_ENABLE", 0);
+FLAGCX_PARAM(TimelineEvents, "TIMELINE_EVENTS", 65536);
+
+#define TIMELINE_CLOCK_TAG 0x746c6e65 // "tlne"
+#define TIMELINE_CLOCK_ROUNDS 8
+
+void flagcxDebugInit();
+
+int flagcxTimelineState = -1;
+
+struct timelineEvent {
+  uint64_t time; // CLOCK_MONOTONIC, ns
+  const struct flagcxTimelineSite *site;
+  uint64_t id;
+  int64_t val0;
+  int64_t val1;
+  char phase;
+};
+
+// A ring is only written by its owner, as for the binary trace
+struct timelineRing {
+  uint64_t head; // number of events ever written
+  int tid;
+  int active;
+  struct timelineEvent *events;
+};
+
+static struct timelineRing timelineRings[FLAGCX_TIMELINE_MAX_THREADS];
+static int timelineNumRings = 0;
+static uint64_t timelineCapacity = 0; // power of two
+static pthread_mutex_t timelineMutex = PTHREAD_MUTEX_INITIALIZER;
+static char timelinePath[PATH_MAX] = "";
+static char timelineHost[64] = "";
+// Set by the first communicator whose ranks all have the timeline on
+static int timelineRank = -1;
+static int64_t timelineOffset = 0; // ns to add to reach the clock of rank 0
+static uint64_t timelineRtt = 0;
+
+static inline uint64_t timelineClock() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Releases the ring when its thread exits
+struct timelineOwner {
+  struct timelineRing *ring = NULL;
+  ~timelineOwner() {
+    if (ring)
+      __atomic_store_n(&ring->active, 0, __ATOMIC_RELEASE);
+  }
+};
+static thread_local struct timelineOwner timelineLocal;
+
+static void timelineInitOnce() {
+  flagcxDebugInit();
+  int64_t events = flagcxParamTimelineEvents();
+  if (flagcxParamTimelineEnable() == 0 || events <= 0) {
+    __atomic_store_n(&flagcxTimelineState, 0, __ATOMIC_RELEASE);
+    return;
+  }
+  uint64_t capacity = 1;
+  while (capacity < (uint64_t)events)
+    capacity <<= 1;
+  timelineCapacity = capacity;
+
+  const char *path = flagcxGetEnv("FLAGCX_TIMELINE_FILE");
+  flagcxExpandPath(path && path[0] ? path : "flagcx_timeline.%h.%p.json",
+                   timelinePath, sizeof(timelinePath));
+  getHostName(timelineHost, sizeof(timelineHost), '.');
+  atexit(flagcxTimelineFlush);
+  INFO(FLAGCX_INIT,
+       "Timeline: %lu events of %zu bytes per thread, written to %s",
+       (unsigned long)capacity, sizeof(struct timelineEvent), timelinePath);
+  __atomic_store_n(&flagcxTimelineState, 1, __ATOMIC_RELEASE);
+}
+
+int flagcxTimelineInit() {
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, timelineInitOnce);
+  return __atomic_load_n(&flagcxTimelineState, __ATOMIC_ACQUIRE);
+}
+
+static struct timelineRing *timelineAttach() {
+  struct timelineRing *ring = NULL;
+  pthread_mutex_lock(&timelineMutex);
+  if (timelineNumRings < FLAGCX_TIMELINE_MAX_THREADS) {
+    struct timelineEvent *events = (struct timelineEvent *)calloc(
+        timelineCapacity, sizeof(struct timelineEvent));
+    if (events != NULL) {
+      ring = &timelineRings[timelineNumRings];
+      ring->events = events;
+      __atomic_store_n(&timelineNumRings, timelineNumRings + 1,
+                       __ATOMIC_RELEASE);
+    }
+  } else {
+    for (int i = 0; i < timelineNumRings; i++) {
+      if (__atomic_load_n(&timelineRings[i].active, __ATOMIC_ACQUIRE) == 0) {
+        ring = &timelineRings[i];
+        __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+        break;
+      }
+    }
+  }
+  if (ring != NULL) {
+    ring->tid = syscall(SYS_gettid);
+    __atomic_store_n(&ring->active, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&timelineMutex);
+  return ring;
+}
+
+void flagcxTimelineRecord(const struct flagcxTimelineSite *site, char phase,
+                          uint64_t id, int64_t val0, int64_t val1) {
+  struct timelineRing *ring = timelineLocal.ring;
+  if (__builtin_expect(ring == NULL, 0)) {
+    if ((ring = timelineAttach()) == NULL)
+      return;
+    timelineLocal.ring = ring;
+  }
+  uint64_t head = ring->head;
+  struct timelineEvent *event = ring->events + (head & (timelineCapacity - 1));
+  event->time = timelineClock();
+  event->site = site;
+  event->id = id;
+  event->val0 = val0;
+  event->val1 = val1;
+  event->phase = phase;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Rank 0 answers TIMELINE_CLOCK_ROUNDS pings of every other rank with its
+// clock. Each rank keeps the round trip with the lowest latency and assumes
+// the clock was read half-way through it.
+flagcxResult_t flagcxTimelineAlignClock(void *bootstrap, int rank,
+                                        int nranks) {
+  int64_t offset = 0;
+  uint64_t bestRtt = UINT64_MAX;
+  if (rank == 0) {
+    for (int peer = 1; peer < nranks; peer++) {
+      for (int r = 0; r < TIMELINE_CLOCK_ROUNDS; r++) {
+        uint64_t ping;
+        FLAGCXCHECK(bootstrapRecv(bootstrap, peer, TIMELINE_CLOCK_TAG, &ping,
+                                  sizeof(ping)));
+        uint64_t now = timelineClock();
+        FLAGCXCHECK(bootstrapSend(bootstrap, peer, TIMELINE_CLOCK_TAG, &now,
+                                  sizeof(now)));
+      }
+    }
+    bestRtt = 0;
+  } else {
+    for (int r = 0; r < TIMELINE_CLOCK_ROUNDS; r++) {
+      uint64_t t0 = timelineClock();
+      uint64_t remote;
+      FLAGCXCHECK(bootstrapSend(bootstrap, 0, TIMELINE_CLOCK_TAG, &t0,
+                                sizeof(t0)));
+      FLAGCXCHECK(bootstrapRecv(bootstrap, 0, TIMELINE_CLOCK_TAG, &remote,
+                                sizeof(remote)));
+      uint64_t t1 = timelineClock();
+      if (t1 - t0 < bestRtt) {
+        bestRtt = t1 - t0;
+        offset = (int64_t)remote - (int64_t)(t0 + (t1 - t0) / 2);
+      }
+    }
+  }
+  pthread_mutex_lock(&timelineMutex);
+  if (timelineRank == -1) {
+    timelineRank = rank;
+    timelineOffset = offset;
+    timelineRtt = bestRtt;
+    INFO(FLAGCX_INIT,
+         "Timeline: rank %d clock offset to rank 0 %" PRId64
+         " ns, round trip %" PRIu64 " ns",
+         rank, offset, bestRtt);
+  }
+  pthread_mutex_unlock(&timelineMutex);
+  return flagcxSuccess;
+}
+
+// Microseconds with three decimals, as expected by the trace viewers
+static void timelineWriteTime(FILE *file, uint64_t time) {
+  uint64_t ns = (uint64_t)((int64_t)time + timelineOffset);
+  fprintf(file, "%" PRIu64 ".%03u", ns / 1000, (unsigned)(ns % 1000));
+}
+
+void flagcxTimelineFlush() {
+  if (__atomic_load_n(&flagcxTimelineState, __ATOMIC_ACQUIRE) != 1)
+    return;
+  pthread_mutex_lock(&timelineMutex);
+  FILE *file = fopen(timelinePath, "w");
+  if (file == NULL) {
+    WARN("Timeline: cannot open %s", timelinePath);
+    pthread_mutex_unlock(&timelineMutex);
+    return;
+  }
+  // Without alignment the pid keeps the files of different processes apart
+  int pid = timelineRank >= 0 ? timelineRank : getpid();
+  uint64_t dropped = 0;
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file,
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,"
+          "\"args\":{\"name\":\"rank %d (%s:%d)\"}}",
+          pid, timelineRank, timelineHost, getpid());
+  fprintf(file,
+          ",\n{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,"
+          "\"tid\":0,\"args\":{\"sort_index\":%d}}",
+          pid, pid);
+  for (int r = 0; r < timelineNumRings; r++) {
+    struct timelineRing *ring = &timelineRings[r];
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t count = head < timelineCapacity ? head : timelineCapacity;
+    dropped += head - count;
+    for (uint64_t i = head - count; i < head; i++) {
+      struct timelineEvent *event =
+          ring->events + (i & (timelineCapacity - 1));
+      const struct flagcxTimelineSite *site = event->site;
+      if (site == NULL)
+        continue;
+      fprintf(file,
+              ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":%d,"
+              "\"tid\":%d,\"ts\":",
+              site->name, site->cat, event->phase, pid, ring->tid);
+      timelineWriteTime(file, event->time);
+      if (event->phase == 'b' || event->phase == 'e')
+        fprintf(file, ",\"id\":\"0x%" PRIx64 "\"", event->id);
+      bool begin = event->phase == 'B' || event->phase == 'b';
+      if (begin && (site->arg0 || site->arg1)) {
+        fprintf(file, ",\"args\":{");
+        if (site->arg0)
+          fprintf(file, "\"%s\":%" PRId64, site->arg0, event->val0);
+        if (site->arg1)
+          fprintf(file, "%s\"%s\":%" PRId64, site->arg0 ? "," : "",
+                  site->arg1, event->val1);
+        fprintf(file, "}");
+      }
+      fprintf(file, "}");
+    }
+  }
+  fprintf(file,
+          "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"rank\":%d,"
+          "\"host\":\"%s\",\"pid\":%d,\"clockOffsetNs\":%" PRId64
+          ",\"clockRttNs\":%" PRIu64 ",\"droppedEvents\":%" PRIu64 "}}\n",
+          timelineRank, timelineHost, getpid(), timelineOffset, timelineRtt,
+          dropped);
+  fclose(file);
+  pthread_mutex_unlock(&timelineMutex);
+}
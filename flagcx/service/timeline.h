@@ -0,0 +1,106 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ *
+ * Event timeline. Enabled with FLAGCX_TIMELINE_ENABLE=1.
+ *
+ * Spans are recorded at the boundaries of a hetero collective: C2C planner
+ * stages, groupLaunch, proxy ops and network isend/irecv until their test
+ * completes. Every thread appends to a ring of its own, the names are string
+ * literals of the call site so an event is a timestamp, a pointer and a few
+ * integers. At exit and on flagcxCommDestroy the rings are written to
+ * FLAGCX_TIMELINE_FILE as Chrome trace JSON, which chrome://tracing and
+ * ui.perfetto.dev open directly, one process per rank.
+ *
+ * Timestamps are shifted to the clock of rank 0 of the first communicator,
+ * measured over the bootstrap at init, so the files of all ranks can be
+ * merged with flagcx/tools/timeline_merge.py and stragglers compared.
+ ************************************************************************/
+
+#ifndef FLAGCX_TIMELINE_H_
+#define FLAGCX_TIMELINE_H_
+
+#include "flagcx.h"
+#include <stdint.h>
+
+#define FLAGCX_TIMELINE_MAX_THREADS 1024
+
+// Static description of a call site, the argument names may be NULL
+struct flagcxTimelineSite {
+  const char *cat;
+  const char *name;
+  const char *arg0;
+  const char *arg1;
+};
+
+// -1 until the environment has been read, then 0 or 1
+extern int flagcxTimelineState;
+int flagcxTimelineInit();
+
+static inline bool flagcxTimelineOn() {
+  int state = __atomic_load_n(&flagcxTimelineState, __ATOMIC_RELAXED);
+  if (__builtin_expect(state == -1, 0))
+    state = flagcxTimelineInit();
+  return state == 1;
+}
+
+// phase is a Chrome trace phase: 'B'/'E' for spans of the calling thread,
+// 'b'/'e' for spans that may end on another call or thread, matched by id
+void flagcxTimelineRecord(const struct flagcxTimelineSite *site, char phase,
+                          uint64_t id, int64_t val0, int64_t val1);
+
+// Measure the offset of the local clock to the one of rank 0 over the
+// bootstrap. Collective, only call it when all ranks have the timeline on.
+flagcxResult_t flagcxTimelineAlignClock(void *bootstrap, int rank,
+                                        int nranks);
+
+// Write the rings of all threads to FLAGCX_TIMELINE_FILE
+void flagcxTimelineFlush();
+
+struct flagcxTimelineScope {
+  const struct flagcxTimelineSite *site;
+  flagcxTimelineScope(const struct flagcxTimelineSite *s, int64_t val0,
+                      int64_t val1)
+      : site(NULL) {
+    if (flagcxTimelineOn()) {
+      site = s;
+      flagcxTimelineRecord(site, 'B', 0, val0, val1);
+    }
+  }
+  ~flagcxTimelineScope() {
+    if (site)
+      flagcxTimelineRecord(site, 'E', 0, 0, 0);
+  }
+};
+
+#define FLAGCX_TIMELINE_CONCAT2(a, b) a##b
+#define FLAGCX_TIMELINE_CONCAT(a, b) FLAGCX_TIMELINE_CONCAT2(a, b)
+
+// Span from here to the end of the enclosing block
+#define TIMELINE_SCOPE(cat, name, arg0, val0, arg1, val1)                     \
+  static const struct flagcxTimelineSite FLAGCX_TIMELINE_CONCAT(              \
+      timelineSite, __LINE__) = {cat, name, arg0, arg1};                       \
+  flagcxTimelineScope FLAGCX_TIMELINE_CONCAT(timelineScope, __LINE__)(        \
+      &FLAGCX_TIMELINE_CONCAT(timelineSite, __LINE__), (int64_t)(val0),       \
+      (int64_t)(val1))
+
+// Asynchronous span, TIMELINE_END must use the same cat, name and id
+#define TIMELINE_BEGIN(cat, name, id, arg0, val0, arg1, val1)                 \
+  do {                                                                         \
+    if (flagcxTimelineOn()) {                                                  \
+      static const struct flagcxTimelineSite timelineSite = {cat, name, arg0, \
+                                                             arg1};            \
+      flagcxTimelineRecord(&timelineSite, 'b', (uint64_t)(id),                 \
+                           (int64_t)(val0), (int64_t)(val1));                  \
+    }                                                                          \
+  } while (0)
+
+#define TIMELINE_END(cat, name, id)                                            \
+  do {                                                                         \
+    if (flagcxTimelineOn()) {                                                  \
+      static const struct flagcxTimelineSite timelineSite = {cat, name, NULL, \
+                                                             NULL};            \
+      flagcxTimelineRecord(&timelineSite, 'e', (uint64_t)(id), 0, 0);          \
+    }                                                                          \
+  } while (0)
+
+#endif
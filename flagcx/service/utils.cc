@@ -63,6 +63,33 @@ flagcxResult_t getHostName(char *hostname, int maxlen, const char delim) {
   return flagcxSuccess;
 }
 
+void flagcxExpandPath(const char *in, char *out, size_t outSize) {
+  char hostname[1024];
+  getHostName(hostname, sizeof(hostname), '.');
+  size_t n = 0;
+  for (int c = 0; in[c] != '\0' && n + 1 < outSize; c++) {
+    if (in[c] != '%' || in[c + 1] == '\0') {
+      out[n++] = in[c];
+      continue;
+    }
+    switch (in[++c]) {
+      case 'h':
+        n += snprintf(out + n, outSize - n, "%s", hostname);
+        break;
+      case 'p':
+        n += snprintf(out + n, outSize - n, "%d", getpid());
+        break;
+      case '%':
+        out[n++] = '%';
+        break;
+      default:
+        n += snprintf(out + n, outSize - n, "%%%c", in[c]);
+        break;
+    }
+  }
+  out[n < outSize ? n : outSize - 1] = '\0';
+}
+
 uint64_t getHash(const char *string, int n) {
   // Based on DJB2a, result = result * 33 ^ char
   uint64_t result = 5381;
@@ -112,6 +139,33 @@ uint64_t getHostHash(void) {
   return getHash(hostHash, strlen(hostHash));
 }
 
+/* Generate a hash of the running kernel instance, shared by every process
+ * and container on this machine regardless of hostname or FLAGCX_HOSTID.
+ * Equivalent of a hash of;
+ *
+ * $(cat /proc/sys/kernel/random/boot_id)
+ */
+uint64_t getBootHash(void) {
+  char bootId[1024];
+
+  // Fall back is the hostname if the boot id cannot be read
+  (void)getHostName(bootId, sizeof(bootId), '\0');
+  FILE *file = fopen(HOSTID_FILE, "r");
+  if (file != NULL) {
+    char *p;
+    if (fscanf(file, "%ms", &p) == 1) {
+      strncpy(bootId, p, sizeof(bootId) - 1);
+      free(p);
+    }
+    fclose(file);
+  }
+  bootId[sizeof(bootId) - 1] = '\0';
+
+  TRACE(FLAGCX_INIT, "boot id '%s'", bootId);
+
+  return getHash(bootId, strlen(bootId));
+}
+
 /* Generate a hash of the unique identifying string for this process
  * that will be unique for both bare-metal and container instances
  * Equivalent of a hash of;
@@ -31,8 +31,11 @@ flagcxResult_t busIdToInt64(const char *busId, int64_t *id);
 flagcxResult_t getBusId(int cudaDev, int64_t *busId);
 
 flagcxResult_t getHostName(char *hostname, int maxlen, const char delim);
+// Replace %h and %p by the hostname and pid, as for FLAGCX_DEBUG_FILE
+void flagcxExpandPath(const char *in, char *out, size_t outSize);
 uint64_t getHash(const char *string, int n);
 uint64_t getHostHash();
+uint64_t getBootHash();
 uint64_t getPidHash();
 flagcxResult_t getRandomData(void *buffer, size_t bytes);
 
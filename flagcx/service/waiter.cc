@@ -0,0 +1,130 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ ************************************************************************/
+
+#include "waiter.h"
+#include "debug.h"
+#include "param.h"
+#include "utils.h"
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+FLAGCX_PARAM(ProxySpinNs, "PROXY_SPIN_NS", 20000);
+FLAGCX_PARAM(ProxyBackoffNs, "PROXY_BACKOFF_NS", 200000);
+FLAGCX_PARAM(ProxySleepNs, "PROXY_SLEEP_NS", 50000);
+
+static uint64_t waiterSpinNs = 0;
+static uint64_t waiterBackoffNs = 0;
+static struct timespec waiterSleep;
+static uint32_t waiterMaxPauses = 1; // pause instructions in about 1us
+
+static void waiterInitOnce() {
+  int64_t spin = flagcxParamProxySpinNs();
+  int64_t backoff = flagcxParamProxyBackoffNs();
+  int64_t sleep = flagcxParamProxySleepNs();
+  waiterSpinNs = spin > 0 ? spin : 0;
+  waiterBackoffNs = backoff > 0 ? backoff : 0;
+  sleep = sleep > 1000 ? sleep : 1000;
+  waiterSleep.tv_sec = sleep / 1000000000;
+  waiterSleep.tv_nsec = sleep % 1000000000;
+
+  // The latency of a pause ranges from a few to over a hundred cycles
+  // depending on the CPU, so the longest backoff run is calibrated in time
+  const int calibration = 4096;
+  uint64_t t0 = clockNano();
+  for (int i = 0; i < calibration; i++)
+    flagcxCpuPause();
+  uint64_t ns = clockNano() - t0;
+  uint64_t perUs = ns > 0 ? calibration * 1000ULL / ns : calibration;
+  waiterMaxPauses = perUs < 1 ? 1 : perUs > 65536 ? 65536 : perUs;
+  INFO(FLAGCX_INIT | FLAGCX_PROXY,
+       "Proxy wait: spin %lu ns, backoff %lu ns, sleep %ld ns, %u pauses/us",
+       (unsigned long)waiterSpinNs, (unsigned long)waiterBackoffNs,
+       (long)sleep, waiterMaxPauses);
+}
+
+void flagcxWaiterInit(struct flagcxWaiter *waiter) {
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, waiterInitOnce);
+  waiter->idleSince = 0;
+  waiter->backoff = 1;
+}
+
+static inline void waiterAccount(struct flagcxWaiter *waiter, uint64_t now) {
+  waiter->ns[waiter->phase] += now - waiter->last;
+  waiter->last = now;
+}
+
+void flagcxWaiterIdleEnd(struct flagcxWaiter *waiter) {
+  waiterAccount(waiter, clockNano());
+  waiter->idleSince = 0;
+}
+
+static void waiterRound(struct flagcxWaiter *waiter, uint32_t seq, bool block,
+                        bool sleep) {
+  uint64_t now = clockNano();
+  if (waiter->idleSince == 0) {
+    waiter->idleSince = now;
+    waiter->last = now;
+    waiter->phase = flagcxWaiterSpin;
+    waiter->backoff = 1;
+  }
+  // Each round is accounted to its phase when the next one starts, so that
+  // the polling done in between is included
+  waiterAccount(waiter, now);
+  uint64_t idle = now - waiter->idleSince;
+  if (idle < waiterSpinNs) {
+    waiter->phase = flagcxWaiterSpin;
+    flagcxCpuPause();
+  } else if (!sleep || idle < waiterSpinNs + waiterBackoffNs) {
+    waiter->phase = flagcxWaiterYield;
+    for (uint32_t i = 0; i < waiter->backoff; i++)
+      flagcxCpuPause();
+    if (waiter->backoff < waiterMaxPauses)
+      waiter->backoff <<= 1;
+    sched_yield();
+  } else {
+    waiter->phase = flagcxWaiterSleep;
+    // Pairs with flagcxWaiterWake: either the waker sees sleeping, or the
+    // futex sees the new seq and returns at once
+    __atomic_store_n(&waiter->sleeping, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&waiter->seq, __ATOMIC_SEQ_CST) == seq) {
+      syscall(SYS_futex, &waiter->seq, FUTEX_WAIT, seq,
+              block ? NULL : &waiterSleep, NULL, 0);
+      waiter->sleeps++;
+    }
+    __atomic_store_n(&waiter->sleeping, 0, __ATOMIC_RELAXED);
+  }
+}
+
+void flagcxWaiterIdle(struct flagcxWaiter *waiter, uint32_t seq, bool block) {
+  waiterRound(waiter, seq, block, true);
+}
+
+void flagcxWaiterPoll(struct flagcxWaiter *waiter) {
+  waiterRound(waiter, 0, false, false);
+}
+
+void flagcxWaiterWake(struct flagcxWaiter *waiter) {
+  __atomic_add_fetch(&waiter->seq, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&waiter->sleeping, __ATOMIC_SEQ_CST)) {
+    syscall(SYS_futex, &waiter->seq, FUTEX_WAKE, 1, NULL, NULL, 0);
+    __atomic_add_fetch(&waiter->wakes, 1, __ATOMIC_RELAXED);
+  }
+}
+
+void flagcxWaiterReport(struct flagcxWaiter *waiter, const char *name,
+                        int rank) {
+  flagcxWaiterProgress(waiter);
+  INFO(FLAGCX_PROXY,
+       "rank %d %s thread idle: spin %.3f ms, yield %.3f ms, sleep %.3f ms "
+       "in %lu waits, %lu wakeups",
+       rank, name, waiter->ns[flagcxWaiterSpin] / 1e6,
+       waiter->ns[flagcxWaiterYield] / 1e6,
+       waiter->ns[flagcxWaiterSleep] / 1e6, (unsigned long)waiter->sleeps,
+       (unsigned long)__atomic_load_n(&waiter->wakes, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,83 @@
+/*************************************************************************
+ * Copyright (c) 2025 BAAI. All rights reserved.
+ *
+ * Adaptive waiting for polling threads.
+ *
+ * A thread that finds nothing to do first polls with a pause instruction
+ * per round for FLAGCX_PROXY_SPIN_NS, then backs off exponentially with
+ * runs of pause instructions followed by sched_yield for
+ * FLAGCX_PROXY_BACKOFF_NS, then blocks on a futex. Producers bump the futex
+ * word with flagcxWaiterWake after publishing work, which only costs a
+ * system call when the thread is actually blocked. The time spent in every
+ * phase is accounted and reported when the thread exits.
+ ************************************************************************/
+
+#ifndef FLAGCX_WAITER_H_
+#define FLAGCX_WAITER_H_
+
+#include <stdint.h>
+
+static inline void flagcxCpuPause() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield" ::: "memory");
+#else
+  __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+typedef enum {
+  flagcxWaiterSpin = 0,
+  flagcxWaiterYield = 1,
+  flagcxWaiterSleep = 2,
+  flagcxWaiterNumPhases = 3
+} flagcxWaiterPhase_t;
+
+struct flagcxWaiter {
+  uint32_t seq;       // futex word, bumped by every wake
+  uint32_t sleeping;  // the owner is blocked or about to block on seq
+  uint64_t idleSince; // start of the current idle stretch, 0 when busy
+  uint64_t last;      // start of the previous idle round
+  int phase;          // phase of the previous idle round
+  uint32_t backoff;   // pause count of the next backoff round
+  // Counters, only written by the owner except for wakes
+  uint64_t ns[flagcxWaiterNumPhases];
+  uint64_t sleeps;
+  uint64_t wakes;
+};
+
+// Called by the owner before its first wait, reads the policy once
+void flagcxWaiterInit(struct flagcxWaiter *waiter);
+
+// Snapshot to take before looking for work and to pass to flagcxWaiterIdle,
+// so that a wake racing with the check is not lost
+static inline uint32_t flagcxWaiterPrepare(struct flagcxWaiter *waiter) {
+  return __atomic_load_n(&waiter->seq, __ATOMIC_SEQ_CST);
+}
+
+void flagcxWaiterIdleEnd(struct flagcxWaiter *waiter);
+
+// The owner made progress, the next idle stretch starts with spinning again
+static inline void flagcxWaiterProgress(struct flagcxWaiter *waiter) {
+  if (__builtin_expect(waiter->idleSince != 0, 0))
+    flagcxWaiterIdleEnd(waiter);
+}
+
+// The owner found nothing to do. When block is set nothing can happen
+// without a flagcxWaiterWake and the futex wait has no timeout, otherwise
+// it is bounded by FLAGCX_PROXY_SLEEP_NS.
+void flagcxWaiterIdle(struct flagcxWaiter *waiter, uint32_t seq, bool block);
+
+// The owner found nothing to do but expects work that does not wake it, and
+// soon: spins and backs off like flagcxWaiterIdle, without ever blocking
+void flagcxWaiterPoll(struct flagcxWaiter *waiter);
+
+// Called by producers after publishing work
+void flagcxWaiterWake(struct flagcxWaiter *waiter);
+
+// INFO line with the counters of the owner
+void flagcxWaiterReport(struct flagcxWaiter *waiter, const char *name,
+                        int rank);
+
+#endif
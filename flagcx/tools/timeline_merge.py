@@ -0,0 +1,39 @@
+"""Merge the FLAGCX_TIMELINE_FILE dumps of several ranks into one trace.
+
+usage: python timeline_merge.py OUTPUT FILE [FILE ...]
+
+Every file holds the events of one process with its rank as pid and its
+timestamps already shifted to the clock of rank 0, so merging is a
+concatenation. The result opens in chrome://tracing or ui.perfetto.dev with
+one track group per rank.
+"""
+
+import json
+import sys
+
+
+def main(output, paths):
+    events = []
+    ranks = []
+    for path in paths:
+        with open(path) as f:
+            trace = json.load(f)
+        other = trace.get("otherData", {})
+        if other.get("rank", -1) < 0:
+            sys.stderr.write("%s: clock not aligned to rank 0, was "
+                             "FLAGCX_TIMELINE_ENABLE set on all ranks?\n"
+                             % path)
+        if other.get("droppedEvents"):
+            sys.stderr.write("%s: %d oldest events were overwritten\n"
+                             % (path, other["droppedEvents"]))
+        ranks.append(other)
+        events.extend(trace["traceEvents"])
+    with open(output, "w") as f:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ns",
+                   "otherData": {"ranks": ranks}}, f)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    main(sys.argv[1], sys.argv[2:])
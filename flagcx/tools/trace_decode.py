@@ -0,0 +1,138 @@
+"""Turn FLAGCX_BINTRACE_FILE dumps back into TRACE lines.
+
+usage: python trace_decode.py FILE [FILE ...]
+
+Events of every thread of every file are merged in time order. Files of
+different processes are aligned through the realtime clock sampled when
+each process enabled the trace, and timestamps are printed in milliseconds
+since the earliest of those.
+"""
+
+import re
+import struct
+import sys
+
+MAGIC = 0x3143525442584346  # "FCXBTRC1"
+VERSION = 1
+MAX_ARGS = 6
+
+# Same conversions as printf, the length modifier tells the argument size
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t|L)?"
+                  r"([diouxXeEfgGcp%])")
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.offset = 0
+
+    def take(self, fmt):
+        values = struct.unpack_from(fmt, self.data, self.offset)
+        self.offset += struct.calcsize(fmt)
+        return values
+
+    def string(self):
+        (length,) = self.take("=I")
+        value = self.data[self.offset:self.offset + length]
+        self.offset += length
+        return value.decode(errors="replace")
+
+
+def convert(value, length, conv):
+    if conv in "eEfgG":
+        return struct.unpack("=d", struct.pack("=Q", value))[0]
+    if conv == "p":
+        return value
+    bits = {"hh": 8, "h": 16, None: 32}.get(length, 64)
+    value &= (1 << bits) - 1
+    if conv in "di" and value >> (bits - 1):
+        value -= 1 << bits
+    return value
+
+
+def render(fmt, args):
+    out = []
+    pos = 0
+    index = 0
+    for match in SPEC.finditer(fmt):
+        out.append(fmt[pos:match.start()])
+        pos = match.end()
+        flags, width, precision, length, conv = match.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if index >= len(args):
+            out.append(match.group(0))
+            continue
+        value = convert(args[index], length, conv)
+        index += 1
+        if conv == "p":
+            out.append("0x%x" % value if value else "(nil)")
+            continue
+        spec = "%" + flags + width
+        if precision is not None:
+            spec += "." + precision
+        spec += {"u": "d", "c": "c"}.get(conv, conv)
+        if conv == "c":
+            value = chr(value & 0xff)
+        out.append(spec % value)
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def load(path):
+    with open(path, "rb") as f:
+        reader = Reader(f.read())
+    magic, version, pid, start_mono, start_real = reader.take("=QIIQQ")
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("%s is not a version %d bintrace file" %
+                         (path, VERSION))
+    host = reader.take("=64s")[0].split(b"\0")[0].decode()
+    event_size, n_formats = reader.take("=II")
+    formats = []
+    for _ in range(n_formats):
+        flags, line = reader.take("=Qi")
+        func = reader.string()
+        fmt = reader.string()
+        formats.append((func, line, fmt))
+    (n_rings,) = reader.take("=I")
+    events = []
+    event_fmt = "=QII%dQ" % MAX_ARGS
+    for _ in range(n_rings):
+        tid, n_events, dropped = reader.take("=iIQ")
+        if dropped:
+            sys.stderr.write("%s: thread %d overwrote its %d oldest events\n"
+                             % (path, tid, dropped))
+        for _ in range(n_events):
+            start = reader.offset
+            fields = reader.take(event_fmt)
+            reader.offset = start + event_size
+            time, id, nargs = fields[:3]
+            if id >= len(formats):
+                continue
+            events.append((time - start_mono + start_real, host, pid, tid,
+                           formats[id], fields[3:3 + nargs]))
+    return start_real, events
+
+
+def main(paths):
+    starts = []
+    events = []
+    for path in paths:
+        start, file_events = load(path)
+        starts.append(start)
+        events.extend(file_events)
+    if not events:
+        return
+    origin = min(starts)
+    events.sort(key=lambda e: e[0])
+    for time, host, pid, tid, (func, line, fmt), args in events:
+        print("%s:%d:%d %f %s:%d FLAGCX TRACE %s" %
+              (host, pid, tid, (time - origin) / 1e6, func, line,
+               render(fmt, args)))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    main(sys.argv[1:])
@@ -0,0 +1,933 @@
+#include "flagcx.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <libgen.h>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Unified collective benchmark. Sweeps collective x datatype x op x size x
+// in-place x registration, reports algbw/busbw and p50/p99 latency as text,
+// CSV or JSON, and optionally compares busbw against a stored CSV baseline.
+// Launching needs no MPI: ranks find each other through a file or TCP
+// rendezvous, rank and size come from flags or the launcher environment.
+// The file is named after the launch (FLAGCX_BENCH_NONCE or the job id of
+// the launcher) so that a stale one is never read.
+
+#define BENCH_CHECK(cmd)                                                       \
+  do {                                                                         \
+    flagcxResult_t res = (cmd);                                                \
+    if (res != flagcxSuccess) {                                                \
+      fprintf(stderr, "[rank %d] %s:%d '%s' failed with %d\n", benchRank,      \
+              __FILE__, __LINE__, #cmd, res);                                  \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+static int benchRank = 0;
+
+static double nowSec() {
+  using clock = std::chrono::steady_clock;
+  return 1.e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     clock::now().time_since_epoch())
+                     .count();
+}
+
+/* Sweep dimensions */
+
+enum benchCollKind {
+  benchAllReduce,
+  benchAllGather,
+  benchReduceScatter,
+  benchReduce,
+  benchBroadcast,
+  benchGather,
+  benchScatter,
+  benchAlltoAll,
+  benchAlltoAllv,
+  benchSendRecv,
+};
+
+struct benchColl {
+  const char *name;
+  benchCollKind kind;
+  bool hasOp;       // takes a reduction op
+  bool perRank;     // size is split in nranks chunks
+  bool canInPlace;  // has an in-place variant
+  int busFactorNum; // busbw = algbw * num(n) / n, see busFactor()
+};
+
+static const benchColl benchColls[] = {
+    {"allreduce", benchAllReduce, true, false, true, 2},
+    {"allgather", benchAllGather, false, true, true, 1},
+    {"reducescatter", benchReduceScatter, true, true, true, 1},
+    {"reduce", benchReduce, true, false, true, 0},
+    {"broadcast", benchBroadcast, false, false, true, 0},
+    {"gather", benchGather, false, true, true, 1},
+    {"scatter", benchScatter, false, true, true, 1},
+    {"alltoall", benchAlltoAll, false, true, true, 1},
+    {"alltoallv", benchAlltoAllv, false, true, true, 1},
+    {"sendrecv", benchSendRecv, false, false, false, 0},
+};
+
+// Same conventions as nccl-tests: ring-like collectives move (n-1)/n of
+// the data per rank, allreduce twice that, rooted and p2p ones all of it
+static double busFactor(const benchColl &c, int nranks) {
+  if (c.busFactorNum == 0 || nranks == 1)
+    return 1.0;
+  return (double)c.busFactorNum * (nranks - 1) / nranks;
+}
+
+struct benchNamed {
+  const char *name;
+  int value;
+  size_t size;
+};
+
+static const benchNamed benchDtypes[] = {
+    {"int8", flagcxInt8, 1},       {"uint8", flagcxUint8, 1},
+    {"int32", flagcxInt32, 4},     {"uint32", flagcxUint32, 4},
+    {"int64", flagcxInt64, 8},     {"uint64", flagcxUint64, 8},
+    {"half", flagcxHalf, 2},       {"float", flagcxFloat, 4},
+    {"double", flagcxDouble, 8},   {"bfloat16", flagcxBfloat16, 2},
+};
+
+static const benchNamed benchOps[] = {
+    {"sum", flagcxSum, 0}, {"prod", flagcxProd, 0}, {"max", flagcxMax, 0},
+    {"min", flagcxMin, 0}, {"avg", flagcxAvg, 0},
+};
+
+template <typename T, size_t N>
+static std::vector<const T *> selectByName(const T (&table)[N],
+                                           const std::string &list,
+                                           const char *what) {
+  std::vector<const T *> out;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    bool found = false;
+    for (size_t i = 0; i < N; i++) {
+      if (item == "all" || item == table[i].name) {
+        out.push_back(&table[i]);
+        found = true;
+      }
+    }
+    if (!found) {
+      fprintf(stderr, "Unknown %s '%s'\n", what, item.c_str());
+      exit(1);
+    }
+  }
+  return out;
+}
+
+/* Options */
+
+struct benchOptions {
+  size_t minBytes = 1ULL * 1024 * 1024;
+  size_t maxBytes = 64ULL * 1024 * 1024;
+  int stepFactor = 2;
+  int warmupIters = 5;
+  int testIters = 20;
+  int root = 0;
+  std::string colls = "allreduce";
+  std::string dtypes = "float";
+  std::string ops = "sum";
+  int inPlace = 0;  // 0, 1 or 2 for both
+  int registry = 0; // 0, 1 or 2 for both
+  std::string format = "text";
+  std::string output;
+  std::string baseline;
+  double tolerance = 0.05;
+  std::string rendezvous;
+  int rank = -1;
+  int nranks = -1;
+  int device = -1;
+};
+
+static double parseSize(const char *value) {
+  double size;
+  char unit = 0;
+  int count = sscanf(value, "%lf%c", &size, &unit);
+  if (count < 1)
+    return -1.0;
+  switch (unit) {
+    case 0:
+      return size;
+    case 'G':
+    case 'g':
+      return size * 1024 * 1024 * 1024;
+    case 'M':
+    case 'm':
+      return size * 1024 * 1024;
+    case 'K':
+    case 'k':
+      return size * 1024;
+    default:
+      return -1.0;
+  }
+}
+
+static int parseBoth(const char *value, const char *what) {
+  if (strcmp(value, "both") == 0)
+    return 2;
+  int v = (int)strtol(value, NULL, 0);
+  if (v != 0 && v != 1) {
+    fprintf(stderr, "Invalid %s value '%s'\n", what, value);
+    exit(1);
+  }
+  return v;
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s\n\t"
+         "[-b <minbytes K/M/G>] [-e <maxbytes K/M/G>] [-f <stepfactor>]\n\t"
+         "[-w <warmupiters>] [-n <iters>] [-r <root>]\n\t"
+         "[-c <collectives, comma separated or all>]\n\t"
+         "[-d <datatypes, comma separated or all>]\n\t"
+         "[-o <ops, comma separated or all>]\n\t"
+         "[-i <inplace 0/1/both>] [-R <localregister 0/1/both>]\n\t"
+         "[-F <format text/csv/json>] [-O <output file>]\n\t"
+         "[-B <baseline csv>] [-t <tolerance>]\n\t"
+         "[-z <rendezvous file:PATH or tcp:HOST:PORT>, file:PATH needs\n\t"
+         "    FLAGCX_BENCH_NONCE or a launcher job id>]\n\t"
+         "[-k <rank>] [-N <nranks>] [-g <device>] [-h]\n",
+         prog);
+}
+
+static void parseOptions(int argc, char **argv, benchOptions &opt) {
+  static struct option longOpts[] = {
+      {"minbytes", required_argument, 0, 'b'},
+      {"maxbytes", required_argument, 0, 'e'},
+      {"stepfactor", required_argument, 0, 'f'},
+      {"warmup_iters", required_argument, 0, 'w'},
+      {"iters", required_argument, 0, 'n'},
+      {"root", required_argument, 0, 'r'},
+      {"collectives", required_argument, 0, 'c'},
+      {"datatype", required_argument, 0, 'd'},
+      {"op", required_argument, 0, 'o'},
+      {"inplace", required_argument, 0, 'i'},
+      {"local_register", required_argument, 0, 'R'},
+      {"format", required_argument, 0, 'F'},
+      {"output", required_argument, 0, 'O'},
+      {"baseline", required_argument, 0, 'B'},
+      {"tolerance", required_argument, 0, 't'},
+      {"rendezvous", required_argument, 0, 'z'},
+      {"rank", required_argument, 0, 'k'},
+      {"nranks", required_argument, 0, 'N'},
+      {"device", required_argument, 0, 'g'},
+      {"help", no_argument, 0, 'h'},
+      {}};
+  int c, longIndex;
+  double parsed;
+  while ((c = getopt_long(argc, argv, "b:e:f:w:n:r:c:d:o:i:R:F:O:B:t:z:k:N:g:h",
+                          longOpts, &longIndex)) != -1) {
+    switch (c) {
+      case 'b':
+      case 'e':
+        parsed = parseSize(optarg);
+        if (parsed < 0) {
+          fprintf(stderr, "Invalid size value '%s'\n", optarg);
+          exit(1);
+        }
+        (c == 'b' ? opt.minBytes : opt.maxBytes) = (size_t)parsed;
+        break;
+      case 'f':
+        opt.stepFactor = (int)strtol(optarg, NULL, 0);
+        break;
+      case 'w':
+        opt.warmupIters = (int)strtol(optarg, NULL, 0);
+        break;
+      case 'n':
+        opt.testIters = (int)strtol(optarg, NULL, 0);
+        break;
+      case 'r':
+        opt.root = (int)strtol(optarg, NULL, 0);
+        break;
+      case 'c':
+        opt.colls = optarg;
+        break;
+      case 'd':
+        opt.dtypes = optarg;
+        break;
+      case 'o':
+        opt.ops = optarg;
+        break;
+      case 'i':
+        opt.inPlace = parseBoth(optarg, "inplace");
+        break;
+      case 'R':
+        opt.registry = parseBoth(optarg, "local register");
+        break;
+      case 'F':
+        opt.format = optarg;
+        break;
+      case 'O':
+        opt.output = optarg;
+        break;
+      case 'B':
+        opt.baseline = optarg;
+        break;
+      case 't':
+        opt.tolerance = strtod(optarg, NULL);
+        break;
+      case 'z':
+        opt.rendezvous = optarg;
+        break;
+      case 'k':
+        opt.rank = (int)strtol(optarg, NULL, 0);
+        break;
+      case 'N':
+        opt.nranks = (int)strtol(optarg, NULL, 0);
+        break;
+      case 'g':
+        opt.device = (int)strtol(optarg, NULL, 0);
+        break;
+      case 'h':
+      default:
+        usage(basename(argv[0]));
+        exit(c == 'h' ? 0 : 1);
+    }
+  }
+  if (opt.stepFactor < 2 || opt.testIters < 1 || opt.warmupIters < 0 ||
+      opt.minBytes > opt.maxBytes) {
+    fprintf(stderr, "Invalid size sweep or iteration count\n");
+    exit(1);
+  }
+  if (opt.format != "text" && opt.format != "csv" && opt.format != "json") {
+    fprintf(stderr, "Invalid format '%s'\n", opt.format.c_str());
+    exit(1);
+  }
+}
+
+/* Launch: rank discovery and unique id rendezvous */
+
+static int envInt(const char *const *names, int def) {
+  for (; *names; names++) {
+    const char *v = getenv(*names);
+    if (v && *v)
+      return (int)strtol(v, NULL, 0);
+  }
+  return def;
+}
+
+static void resolveRanks(benchOptions &opt) {
+  static const char *rankVars[] = {"FLAGCX_BENCH_RANK", "OMPI_COMM_WORLD_RANK",
+                                   "PMI_RANK", "SLURM_PROCID", "RANK", NULL};
+  static const char *sizeVars[] = {"FLAGCX_BENCH_NRANKS",
+                                   "OMPI_COMM_WORLD_SIZE", "PMI_SIZE",
+                                   "SLURM_NTASKS", "WORLD_SIZE", NULL};
+  static const char *localVars[] = {"OMPI_COMM_WORLD_LOCAL_RANK",
+                                    "MPI_LOCALRANKID", "SLURM_LOCALID",
+                                    "LOCAL_RANK", NULL};
+  if (opt.rank < 0)
+    opt.rank = envInt(rankVars, 0);
+  if (opt.nranks < 0)
+    opt.nranks = envInt(sizeVars, 1);
+  if (opt.device < 0)
+    opt.device = envInt(localVars, opt.rank);
+  if (opt.rank >= opt.nranks) {
+    fprintf(stderr, "Invalid rank %d of %d\n", opt.rank, opt.nranks);
+    exit(1);
+  }
+  if (opt.nranks > 1 && opt.rendezvous.empty()) {
+    fprintf(stderr, "Running %d ranks needs -z file:PATH or tcp:HOST:PORT\n",
+            opt.nranks);
+    exit(1);
+  }
+}
+
+// Id shared by all ranks of one launch, so that a file left by an earlier
+// run is never taken for the current one. Empty when the launcher gives none.
+static std::string launchNonce() {
+  static const char *nonceVars[] = {"FLAGCX_BENCH_NONCE", "PMIX_NAMESPACE",
+                                    "OMPI_MCA_ess_base_jobid",
+                                    "TORCHELASTIC_RUN_ID", NULL};
+  for (const char *const *name = nonceVars; *name; name++) {
+    const char *v = getenv(*name);
+    if (v && *v)
+      return v;
+  }
+  const char *job = getenv("SLURM_JOB_ID");
+  if (job && *job) {
+    const char *step = getenv("SLURM_STEP_ID");
+    return std::string(job) + "." + (step && *step ? step : "0");
+  }
+  return "";
+}
+
+struct rendezvousRecord {
+  char nonce[128];
+  flagcxUniqueId id;
+};
+
+// Per-launch file of the id, PATH.<nonce>
+static std::string rendezvousFilePath(const std::string &path) {
+  std::string nonce = launchNonce();
+  if (nonce.empty() || nonce.size() >= sizeof(rendezvousRecord::nonce)) {
+    fprintf(stderr,
+            "File rendezvous needs a launch id shorter than %zu bytes, set "
+            "FLAGCX_BENCH_NONCE to the same value on every rank\n",
+            sizeof(rendezvousRecord::nonce));
+    exit(1);
+  }
+  return path + "." + nonce;
+}
+
+// Rank 0 publishes the id atomically through rename, others poll for a file
+// carrying the nonce of this launch
+static void rendezvousFile(const std::string &path, benchOptions &opt,
+                           flagcxUniqueId *id) {
+  std::string file = rendezvousFilePath(path);
+  rendezvousRecord record;
+  memset(&record, 0, sizeof(record));
+  strcpy(record.nonce, launchNonce().c_str());
+  if (opt.rank == 0) {
+    record.id = *id;
+    std::string tmp = file + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL || fwrite(&record, sizeof(record), 1, f) != 1 ||
+        fclose(f) != 0 || rename(tmp.c_str(), file.c_str()) != 0) {
+      fprintf(stderr, "Unable to publish unique id to %s\n", file.c_str());
+      exit(1);
+    }
+    return;
+  }
+  double deadline = nowSec() + 300;
+  while (true) {
+    FILE *f = fopen(file.c_str(), "rb");
+    if (f) {
+      rendezvousRecord read;
+      size_t n = fread(&read, sizeof(read), 1, f);
+      fclose(f);
+      if (n == 1 && memcmp(read.nonce, record.nonce, sizeof(read.nonce)) == 0) {
+        *id = read.id;
+        return;
+      }
+    }
+    if (nowSec() > deadline) {
+      fprintf(stderr, "Timed out waiting for rendezvous at %s\n",
+              file.c_str());
+      exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+// Rank 0 listens on PORT and hands the id to every other rank
+static void rendezvousTcp(const std::string &addr, benchOptions &opt,
+                          flagcxUniqueId *id) {
+  size_t colon = addr.rfind(':');
+  if (colon == std::string::npos) {
+    fprintf(stderr, "Invalid tcp rendezvous '%s'\n", addr.c_str());
+    exit(1);
+  }
+  std::string host = addr.substr(0, colon);
+  std::string port = addr.substr(colon + 1);
+  if (opt.rank == 0) {
+    int fd = socket(AF_INET6, SOCK_STREAM, 0);
+    int one = 1, zero = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    struct sockaddr_in6 sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin6_family = AF_INET6;
+    sa.sin6_addr = in6addr_any;
+    sa.sin6_port = htons((uint16_t)atoi(port.c_str()));
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 ||
+        listen(fd, opt.nranks) != 0) {
+      perror("rendezvous listen");
+      exit(1);
+    }
+    for (int i = 1; i < opt.nranks; i++) {
+      int peer = accept(fd, NULL, NULL);
+      if (peer < 0 || write(peer, id, sizeof(*id)) != sizeof(*id)) {
+        perror("rendezvous accept");
+        exit(1);
+      }
+      close(peer);
+    }
+    close(fd);
+    return;
+  }
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) {
+    fprintf(stderr, "Unable to resolve rendezvous host %s\n", host.c_str());
+    exit(1);
+  }
+  double deadline = nowSec() + 300;
+  while (true) {
+    int fd = socket(res->ai_family, SOCK_STREAM, 0);
+    if (connect(fd, res->ai_addr, res->ai_addrlen) == 0) {
+      size_t got = 0;
+      ssize_t n;
+      while (got < sizeof(*id) &&
+             (n = read(fd, (char *)id + got, sizeof(*id) - got)) > 0)
+        got += n;
+      close(fd);
+      if (got == sizeof(*id))
+        break;
+    } else {
+      close(fd);
+    }
+    if (nowSec() > deadline) {
+      fprintf(stderr, "Timed out waiting for rendezvous at %s\n",
+              addr.c_str());
+      exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  freeaddrinfo(res);
+}
+
+static void rendezvous(benchOptions &opt, flagcxUniqueId *id) {
+  if (opt.nranks == 1)
+    return;
+  if (opt.rendezvous.compare(0, 5, "file:") == 0) {
+    rendezvousFile(opt.rendezvous.substr(5), opt, id);
+  } else if (opt.rendezvous.compare(0, 4, "tcp:") == 0) {
+    rendezvousTcp(opt.rendezvous.substr(4), opt, id);
+  } else {
+    fprintf(stderr, "Invalid rendezvous '%s'\n", opt.rendezvous.c_str());
+    exit(1);
+  }
+}
+
+/* Measurement */
+
+struct benchResult {
+  std::string coll, dtype, op;
+  int inPlace;
+  int registered;
+  size_t bytes;
+  size_t count;
+  double avgUs, p50Us, p99Us;
+  double algBw, busBw;
+  std::string status;
+};
+
+struct benchBuffers {
+  void *send;
+  void *recv;
+  void *sendHandle;
+  void *recvHandle;
+  size_t bytes;
+  int registered;
+};
+
+struct benchContext {
+  flagcxComm_t comm;
+  flagcxStream_t stream;
+  flagcxDeviceHandle_t devHandle;
+  int rank;
+  int nranks;
+  int root;
+  std::vector<size_t> counts; // alltoallv counts and displacements
+  std::vector<size_t> displs;
+};
+
+static void allocBuffers(benchContext &ctx, benchBuffers &b, size_t bytes,
+                         int registered) {
+  b.send = b.recv = NULL; // flagcxMemAlloc refuses non-NULL pointers
+  b.bytes = bytes;
+  b.registered = registered;
+  if (registered) {
+    BENCH_CHECK(flagcxMemAlloc(&b.send, bytes, ctx.comm));
+    BENCH_CHECK(flagcxMemAlloc(&b.recv, bytes, ctx.comm));
+    BENCH_CHECK(flagcxCommRegister(ctx.comm, b.send, bytes, &b.sendHandle));
+    BENCH_CHECK(flagcxCommRegister(ctx.comm, b.recv, bytes, &b.recvHandle));
+  } else {
+    BENCH_CHECK(
+        ctx.devHandle->deviceMalloc(&b.send, bytes, flagcxMemDevice, NULL));
+    BENCH_CHECK(
+        ctx.devHandle->deviceMalloc(&b.recv, bytes, flagcxMemDevice, NULL));
+  }
+  BENCH_CHECK(
+      ctx.devHandle->deviceMemset(b.send, 0, bytes, flagcxMemDevice, NULL));
+  BENCH_CHECK(
+      ctx.devHandle->deviceMemset(b.recv, 0, bytes, flagcxMemDevice, NULL));
+}
+
+static void freeBuffers(benchContext &ctx, benchBuffers &b) {
+  if (b.registered) {
+    BENCH_CHECK(flagcxCommDeregister(ctx.comm, b.sendHandle));
+    BENCH_CHECK(flagcxCommDeregister(ctx.comm, b.recvHandle));
+    BENCH_CHECK(flagcxMemFree(b.send, ctx.comm));
+    BENCH_CHECK(flagcxMemFree(b.recv, ctx.comm));
+  } else {
+    BENCH_CHECK(ctx.devHandle->deviceFree(b.send, flagcxMemDevice, NULL));
+    BENCH_CHECK(ctx.devHandle->deviceFree(b.recv, flagcxMemDevice, NULL));
+  }
+}
+
+// Element count of one call moving `bytes`, 0 if the size is too small
+static size_t collCount(const benchColl &c, size_t bytes, size_t typeSize,
+                        int nranks) {
+  return c.perRank ? bytes / (typeSize * nranks) : bytes / typeSize;
+}
+
+static flagcxResult_t launchColl(benchContext &ctx, const benchColl &c,
+                                 benchBuffers &b, size_t count,
+                                 flagcxDataType_t dt, size_t typeSize,
+                                 flagcxRedOp_t op, int inPlace) {
+  char *sb = (char *)b.send;
+  char *rb = (char *)b.recv;
+  size_t chunk = count * typeSize * ctx.rank; // this rank's slot
+  switch (c.kind) {
+    case benchAllReduce:
+      return flagcxAllReduce(sb, inPlace ? sb : rb, count, dt, op, ctx.comm,
+                             ctx.stream);
+    case benchReduce:
+      return flagcxReduce(sb, inPlace ? sb : rb, count, dt, op, ctx.root,
+                          ctx.comm, ctx.stream);
+    case benchBroadcast:
+      return flagcxBroadcast(sb, inPlace ? sb : rb, count, dt, ctx.root,
+                             ctx.comm, ctx.stream);
+    case benchAllGather:
+      return flagcxAllGather(inPlace ? rb + chunk : sb, rb, count, dt,
+                             ctx.comm, ctx.stream);
+    case benchGather:
+      return flagcxGather(inPlace ? rb + chunk : sb, rb, count, dt, ctx.root,
+                          ctx.comm, ctx.stream);
+    case benchReduceScatter:
+      return flagcxReduceScatter(sb, inPlace ? sb + chunk : rb, count, dt, op,
+                                 ctx.comm, ctx.stream);
+    case benchScatter:
+      return flagcxScatter(sb, inPlace ? sb + chunk : rb, count, dt, ctx.root,
+                           ctx.comm, ctx.stream);
+    case benchAlltoAll:
+      return flagcxAlltoAll(sb, inPlace ? sb : rb, count, dt, ctx.comm,
+                            ctx.stream);
+    case benchAlltoAllv:
+      for (int i = 0; i < ctx.nranks; i++) {
+        ctx.counts[i] = count;
+        ctx.displs[i] = i * count;
+      }
+      return flagcxAlltoAllv(sb, ctx.counts.data(), ctx.displs.data(),
+                             inPlace ? sb : rb, ctx.counts.data(),
+                             ctx.displs.data(), dt, ctx.comm, ctx.stream);
+    case benchSendRecv: {
+      int next = (ctx.rank + 1) % ctx.nranks;
+      int prev = (ctx.rank + ctx.nranks - 1) % ctx.nranks;
+      flagcxGroupStart(ctx.comm);
+      flagcxResult_t res =
+          flagcxSend(sb, count, dt, next, ctx.comm, ctx.stream);
+      if (res == flagcxSuccess)
+        res = flagcxRecv(rb, count, dt, prev, ctx.comm, ctx.stream);
+      flagcxResult_t endRes = flagcxGroupEnd(ctx.comm);
+      return res != flagcxSuccess ? res : endRes;
+    }
+  }
+  return flagcxInvalidArgument;
+}
+
+static double percentile(std::vector<double> sorted, double p) {
+  size_t idx = (size_t)(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+// Time every iteration separately; the latency of an iteration is the
+// slowest rank's, so per-iteration times are max-reduced across ranks. A
+// failed launch does not end the loops early, which would leave the other
+// ranks waiting in the next collective: whether any rank failed is reduced
+// along with the times, and every rank reports the result the same way.
+static void measure(benchContext &ctx, const benchOptions &opt,
+                    const benchColl &c, benchBuffers &b, size_t bytes,
+                    const benchNamed &dt, const benchNamed *op, int inPlace,
+                    void *statBuff, benchResult &r) {
+  size_t count = collCount(c, bytes, dt.size, ctx.nranks);
+  flagcxDataType_t type = (flagcxDataType_t)dt.value;
+  flagcxRedOp_t redOp = op ? (flagcxRedOp_t)op->value : flagcxSum;
+  r.coll = c.name;
+  r.dtype = dt.name;
+  r.op = op ? op->name : "none";
+  r.inPlace = inPlace;
+  r.registered = b.registered;
+  r.bytes = bytes;
+  r.count = count;
+  r.status = "ok";
+
+  bool failed = false;
+  for (int i = 0; i < opt.warmupIters; i++)
+    failed |= launchColl(ctx, c, b, count, type, dt.size, redOp, inPlace) !=
+              flagcxSuccess;
+  BENCH_CHECK(ctx.devHandle->streamSynchronize(ctx.stream));
+  BENCH_CHECK(flagcxBarrier(ctx.comm, ctx.stream));
+  BENCH_CHECK(ctx.devHandle->streamSynchronize(ctx.stream));
+
+  // The last stat is the failure flag
+  std::vector<double> stats(opt.testIters + 1, 0.0);
+  for (int i = 0; i < opt.testIters; i++) {
+    double start = nowSec();
+    failed |= launchColl(ctx, c, b, count, type, dt.size, redOp, inPlace) !=
+              flagcxSuccess;
+    BENCH_CHECK(ctx.devHandle->streamSynchronize(ctx.stream));
+    stats[i] = nowSec() - start;
+  }
+  stats.back() = failed ? 1.0 : 0.0;
+
+  size_t statBytes = stats.size() * sizeof(double);
+  BENCH_CHECK(ctx.devHandle->deviceMemcpy(
+      statBuff, stats.data(), statBytes, flagcxMemcpyHostToDevice, NULL));
+  BENCH_CHECK(flagcxAllReduce(statBuff, statBuff, stats.size(), flagcxDouble,
+                              flagcxMax, ctx.comm, ctx.stream));
+  BENCH_CHECK(ctx.devHandle->streamSynchronize(ctx.stream));
+  BENCH_CHECK(ctx.devHandle->deviceMemcpy(
+      stats.data(), statBuff, statBytes, flagcxMemcpyDeviceToHost, NULL));
+  std::vector<double> times(stats.begin(), stats.end() - 1);
+  if (stats.back() > 0) {
+    r.status = "error";
+    std::fill(times.begin(), times.end(), 0.0);
+  }
+
+  double sum = 0;
+  for (double t : times)
+    sum += t;
+  double avg = sum / times.size();
+  std::sort(times.begin(), times.end());
+  r.avgUs = avg * 1e6;
+  r.p50Us = percentile(times, 0.50) * 1e6;
+  r.p99Us = percentile(times, 0.99) * 1e6;
+  r.algBw = avg > 0 ? (double)bytes / 1.0E9 / avg : 0;
+  r.busBw = r.algBw * busFactor(c, ctx.nranks);
+}
+
+/* Reporting */
+
+static const char *csvHeader = "collective,datatype,op,inplace,registered,"
+                               "bytes,count,time_us,p50_us,p99_us,algbw_gbps,"
+                               "busbw_gbps,status";
+
+static std::string benchKey(const std::string &coll, const std::string &dtype,
+                            const std::string &op, int inPlace, int registered,
+                            size_t bytes) {
+  std::stringstream ss;
+  ss << coll << ',' << dtype << ',' << op << ',' << inPlace << ','
+     << registered << ',' << bytes;
+  return ss.str();
+}
+
+static void writeTextHeader(FILE *f, int nranks, double initMs) {
+  fprintf(f, "# nranks %d, comm init %.2f ms, algbw/busbw in GB/s\n", nranks,
+          initMs);
+  fprintf(f, "#%14s %9s %5s %3s %3s %12s %11s %10s %10s %10s %9s %9s %6s\n",
+          "collective", "datatype", "op", "ip", "reg", "bytes", "count",
+          "time(us)", "p50(us)", "p99(us)", "algbw", "busbw", "status");
+}
+
+static void writeTextRow(FILE *f, const benchResult &r) {
+  fprintf(f,
+          "%15s %9s %5s %3d %3d %12zu %11zu %10.2f %10.2f %10.2f %9.3f "
+          "%9.3f %6s\n",
+          r.coll.c_str(), r.dtype.c_str(), r.op.c_str(), r.inPlace,
+          r.registered, r.bytes, r.count, r.avgUs, r.p50Us, r.p99Us, r.algBw,
+          r.busBw, r.status.c_str());
+  fflush(f);
+}
+
+static void writeCsv(FILE *f, const std::vector<benchResult> &results) {
+  fprintf(f, "%s\n", csvHeader);
+  for (const benchResult &r : results) {
+    fprintf(f, "%s,%zu,%.3f,%.3f,%.3f,%.6f,%.6f,%s\n",
+            benchKey(r.coll, r.dtype, r.op, r.inPlace, r.registered, r.bytes)
+                .c_str(),
+            r.count, r.avgUs, r.p50Us, r.p99Us, r.algBw, r.busBw,
+            r.status.c_str());
+  }
+}
+
+static void writeJson(FILE *f, const std::vector<benchResult> &results,
+                      int nranks, double initMs) {
+  fprintf(f, "{\n  \"nranks\": %d,\n  \"init_ms\": %.3f,\n  \"results\": [",
+          nranks, initMs);
+  for (size_t i = 0; i < results.size(); i++) {
+    const benchResult &r = results[i];
+    fprintf(f,
+            "%s\n    {\"collective\": \"%s\", \"datatype\": \"%s\", "
+            "\"op\": \"%s\", \"inplace\": %d, \"registered\": %d, "
+            "\"bytes\": %zu, \"count\": %zu, \"time_us\": %.3f, "
+            "\"p50_us\": %.3f, \"p99_us\": %.3f, \"algbw_gbps\": %.6f, "
+            "\"busbw_gbps\": %.6f, \"status\": \"%s\"}",
+            i ? "," : "", r.coll.c_str(), r.dtype.c_str(), r.op.c_str(),
+            r.inPlace, r.registered, r.bytes, r.count, r.avgUs, r.p50Us,
+            r.p99Us, r.algBw, r.busBw, r.status.c_str());
+  }
+  fprintf(f, "\n  ]\n}\n");
+}
+
+// Compare busbw against a CSV written by a previous run with -F csv.
+// Returns the number of entries slower than baseline by more than tolerance.
+static int compareBaseline(const std::string &path, double tolerance,
+                           const std::vector<benchResult> &results) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open baseline %s\n", path.c_str());
+    return 1;
+  }
+  std::map<std::string, double> base;
+  char line[1024];
+  while (fgets(line, sizeof(line), f)) {
+    std::vector<std::string> cols;
+    std::stringstream ss(line);
+    std::string col;
+    while (std::getline(ss, col, ','))
+      cols.push_back(col);
+    if (cols.size() < 12 || cols[0] == "collective")
+      continue;
+    std::string key = cols[0];
+    for (int i = 1; i < 6; i++)
+      key += "," + cols[i];
+    base[key] = strtod(cols[11].c_str(), NULL);
+  }
+  fclose(f);
+
+  int regressions = 0, compared = 0;
+  printf("# baseline %s, tolerance %.1f%%\n", path.c_str(), tolerance * 100);
+  for (const benchResult &r : results) {
+    auto it = base.find(
+        benchKey(r.coll, r.dtype, r.op, r.inPlace, r.registered, r.bytes));
+    if (it == base.end() || it->second <= 0)
+      continue;
+    compared++;
+    double ratio = r.busBw / it->second;
+    if (ratio < 1.0 - tolerance) {
+      regressions++;
+      printf("# REGRESSION %s %s %s ip=%d reg=%d %zu bytes: busbw %.3f vs "
+             "%.3f GB/s (%+.1f%%)\n",
+             r.coll.c_str(), r.dtype.c_str(), r.op.c_str(), r.inPlace,
+             r.registered, r.bytes, r.busBw, it->second,
+             (ratio - 1.0) * 100);
+    }
+  }
+  printf("# compared %d entries, %d regressions\n", compared, regressions);
+  return regressions;
+}
+
+int main(int argc, char *argv[]) {
+  benchOptions opt;
+  parseOptions(argc, argv, opt);
+  resolveRanks(opt);
+  benchRank = opt.rank;
+
+  std::vector<const benchColl *> colls =
+      selectByName(benchColls, opt.colls, "collective");
+  std::vector<const benchNamed *> dtypes =
+      selectByName(benchDtypes, opt.dtypes, "datatype");
+  std::vector<const benchNamed *> ops = selectByName(benchOps, opt.ops, "op");
+
+  flagcxHandlerGroup_t handler;
+  BENCH_CHECK(flagcxHandleInit(&handler));
+  flagcxUniqueId_t &uniqueId = handler->uniqueId;
+  flagcxComm_t &comm = handler->comm;
+  flagcxDeviceHandle_t &devHandle = handler->devHandle;
+
+  int nGpu;
+  BENCH_CHECK(devHandle->getDeviceCount(&nGpu));
+  BENCH_CHECK(devHandle->setDevice(opt.device % nGpu));
+
+  if (opt.rank == 0)
+    BENCH_CHECK(flagcxGetUniqueId(&uniqueId));
+  rendezvous(opt, uniqueId);
+  double initMs = nowSec();
+  BENCH_CHECK(flagcxCommInitRank(&comm, opt.nranks, uniqueId, opt.rank));
+  initMs = (nowSec() - initMs) * 1e3;
+  // Every rank has read the id once the communicator is up
+  if (opt.rank == 0 && opt.nranks > 1 &&
+      opt.rendezvous.compare(0, 5, "file:") == 0)
+    unlink(rendezvousFilePath(opt.rendezvous.substr(5)).c_str());
+
+  benchContext ctx;
+  ctx.comm = comm;
+  ctx.devHandle = devHandle;
+  ctx.rank = opt.rank;
+  ctx.nranks = opt.nranks;
+  ctx.root = opt.root % opt.nranks;
+  ctx.counts.resize(opt.nranks);
+  ctx.displs.resize(opt.nranks);
+  BENCH_CHECK(devHandle->streamCreate(&ctx.stream));
+
+  // Per-iteration times and the failure flag, see measure
+  void *statBuff;
+  BENCH_CHECK(devHandle->deviceMalloc(&statBuff,
+                                      (opt.testIters + 1) * sizeof(double),
+                                      flagcxMemDevice, NULL));
+
+  // Plain text to stdout is streamed as results come in
+  bool streamText =
+      opt.rank == 0 && opt.format == "text" && opt.output.empty();
+  if (streamText)
+    writeTextHeader(stdout, ctx.nranks, initMs);
+
+  std::vector<benchResult> results;
+  for (int reg = 0; reg <= 1; reg++) {
+    if (opt.registry != 2 && opt.registry != reg)
+      continue;
+    benchBuffers bufs;
+    allocBuffers(ctx, bufs, opt.maxBytes, reg);
+    for (const benchColl *c : colls) {
+      for (const benchNamed *dt : dtypes) {
+        std::vector<const benchNamed *> collOps(1, (const benchNamed *)NULL);
+        if (c->hasOp)
+          collOps = ops;
+        for (const benchNamed *op : collOps) {
+          for (int ip = 0; ip <= 1; ip++) {
+            if ((opt.inPlace != 2 && opt.inPlace != ip) ||
+                (ip && !c->canInPlace))
+              continue;
+            for (size_t bytes = opt.minBytes; bytes <= opt.maxBytes;
+                 bytes *= opt.stepFactor) {
+              if (collCount(*c, bytes, dt->size, ctx.nranks) == 0)
+                continue;
+              benchResult r;
+              measure(ctx, opt, *c, bufs, bytes, *dt, op, ip, statBuff, r);
+              results.push_back(r);
+              if (streamText)
+                writeTextRow(stdout, r);
+            }
+          }
+        }
+      }
+    }
+    freeBuffers(ctx, bufs);
+  }
+
+  int regressions = 0;
+  if (opt.rank == 0) {
+    FILE *out = stdout;
+    if (!opt.output.empty() && (out = fopen(opt.output.c_str(), "w")) == NULL) {
+      fprintf(stderr, "Unable to open %s\n", opt.output.c_str());
+      out = stdout;
+    }
+    if (opt.format == "csv")
+      writeCsv(out, results);
+    else if (opt.format == "json")
+      writeJson(out, results, ctx.nranks, initMs);
+    else if (out != stdout) {
+      writeTextHeader(out, ctx.nranks, initMs);
+      for (const benchResult &r : results)
+        writeTextRow(out, r);
+    }
+    if (out != stdout)
+      fclose(out);
+    if (!opt.baseline.empty())
+      regressions = compareBaseline(opt.baseline, opt.tolerance, results);
+  }
+
+  BENCH_CHECK(devHandle->deviceFree(statBuff, flagcxMemDevice, NULL));
+  BENCH_CHECK(devHandle->streamDestroy(ctx.stream));
+  BENCH_CHECK(flagcxCommDestroy(comm));
+  BENCH_CHECK(flagcxHandleFree(handler));
+  return regressions ? 2 : 0;
+}
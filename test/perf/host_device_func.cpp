@@ -0,0 +1,18 @@
+#include "flagcx.h"
+
+// Device funcs of the deprecated FLAGCX_DEVICE_FUNC_PATH path for the host
+// device adaptor, which runs them in order on the stream thread. Together
+// with FLAGCX_LATENCY_ENABLE=1 and FLAGCX_TIMELINE_ENABLE=1 this exercises
+// proxy ops that carry no group semaphore:
+// make run-latency-device-func on a USE_HOST=1 build.
+
+extern "C" void deviceAsyncStore(flagcxStream_t stream, void *args) {
+  bool *volatile value = (bool *)args;
+  __atomic_store_n(value, 1, __ATOMIC_RELAXED);
+}
+
+extern "C" void deviceAsyncLoad(flagcxStream_t stream, void *args) {
+  bool *volatile value = (bool *)args;
+  while (!__atomic_load_n(value, __ATOMIC_RELAXED)) {
+  }
+}
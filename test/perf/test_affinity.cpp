@@ -0,0 +1,218 @@
+#include "affinity.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <getopt.h>
+#include <limits.h>
+#include <set>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Placement of the communication threads and staging buffers. First prints
+// the cores FLAGCX_THREAD_AFFINITY (or the automatic choice) gives to the
+// threads of the communicators the ranks open on a NIC. Ranks are spread
+// over -N hosts and, as with a CUDA_VISIBLE_DEVICES per rank, every one of
+// them sees a single device of index 0, so they can only be told apart by
+// their rank on the host, which is derived from host hashes as at init.
+// Cores pinned twice on a host fail the test. Then, for every pair of NUMA
+// nodes, a thread placed on the first node copies out of a staging buffer
+// allocated on the second one, which shows what pinning next to the NIC
+// buys on a multi-NUMA host: the diagonal should be the fastest.
+// usage: test_affinity [-i net interface] [-r ranks] [-N hosts]
+//                      [-c comms per rank] [-s MB] [-n iters]
+
+static uint64_t nowNs() {
+  using clock = std::chrono::steady_clock;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             clock::now().time_since_epoch())
+      .count();
+}
+
+static std::string cpusToList(const cpu_set_t *cpus) {
+  std::string list;
+  for (int c = 0; c < CPU_SETSIZE; c++) {
+    if (!CPU_ISSET(c, cpus))
+      continue;
+    int last = c;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpus))
+      last++;
+    if (!list.empty())
+      list += ",";
+    list += std::to_string(c);
+    if (last > c)
+      list += "-" + std::to_string(last);
+    c = last;
+  }
+  return list.empty() ? "-" : list;
+}
+
+static std::vector<int> numaNodes() {
+  std::vector<int> nodes;
+  DIR *dir = opendir("/sys/devices/system/node");
+  if (dir == NULL)
+    return nodes;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    int node;
+    if (sscanf(entry->d_name, "node%d", &node) == 1)
+      nodes.push_back(node);
+  }
+  closedir(dir);
+  std::sort(nodes.begin(), nodes.end());
+  return nodes;
+}
+
+// Node holding the first page of ptr, -1 when unknown
+static int pageNode(void *ptr) {
+  int status = -1;
+  if (syscall(SYS_move_pages, 0, 1UL, &ptr, NULL, &status, 0) != 0)
+    return -1;
+  return status;
+}
+
+int main(int argc, char *argv[]) {
+  const char *ifname = getenv("FLAGCX_SOCKET_IFNAME");
+  int nRanks = 2, nHosts = 1, nComms = 2, iters = 10;
+  size_t size = 64 << 20;
+  int opt;
+  while ((opt = getopt(argc, argv, "i:r:N:c:s:n:")) != -1) {
+    switch (opt) {
+      case 'i':
+        ifname = optarg;
+        break;
+      case 'r':
+        nRanks = atoi(optarg);
+        break;
+      case 'N':
+        nHosts = atoi(optarg);
+        break;
+      case 'c':
+        nComms = atoi(optarg);
+        break;
+      case 's':
+        size = (size_t)atoi(optarg) << 20;
+        break;
+      case 'n':
+        iters = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr,
+                "usage: %s [-i net interface] [-r ranks] [-N hosts] [-c "
+                "comms per rank] [-s MB] [-n iters]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  char *pciPath = NULL;
+  if (ifname != NULL && ifname[0] != '\0') {
+    char devicePath[PATH_MAX];
+    snprintf(devicePath, PATH_MAX, "/sys/class/net/%s/device", ifname);
+    pciPath = realpath(devicePath, NULL);
+  }
+  const char *spec = getenv("FLAGCX_THREAD_AFFINITY");
+  printf("# NIC %s at %s, FLAGCX_THREAD_AFFINITY=%s\n",
+         ifname ? ifname : "-", pciPath ? pciPath : "-", spec ? spec : "");
+  if (nHosts < 1 || nHosts > nRanks)
+    nHosts = 1;
+  // Consecutive ranks share a host
+  std::vector<uint64_t> hostHashes(nRanks);
+  for (int rank = 0; rank < nRanks; rank++)
+    hostHashes[rank] = 0x1000 + (uint64_t)rank * nHosts / nRanks;
+  std::vector<std::set<int>> pinned(nHosts);
+  int shared = 0;
+  printf("%6s %6s %6s %6s %6s %12s %12s %12s %12s\n", "rank", "host",
+         "local", "comm", "node", "progress", "service", "kernel", "socket");
+  // Every rank lives in its own process, whose slots start over
+  for (int rank = 0; rank < nRanks; rank++) {
+    int host = hostHashes[rank] - 0x1000, localRank, localRanks;
+    flagcxAffinityLocalRank(hostHashes.data(), nRanks, rank, &localRank,
+                            &localRanks);
+    std::vector<struct flagcxAffinity> comms(nComms);
+    for (int c = 0; c < nComms; c++) {
+      struct flagcxAffinity &affinity = comms[c];
+      if (flagcxAffinityInit(&affinity, pciPath, localRank, localRanks) !=
+          flagcxSuccess) {
+        fprintf(stderr, "invalid FLAGCX_THREAD_AFFINITY, run with "
+                        "FLAGCX_DEBUG=WARN\n");
+        return 1;
+      }
+      printf("%6d %6d %6d %6d %6d", rank, host, localRank, c,
+             affinity.numaNode);
+      for (int r = 0; r < flagcxThreadNumRoles; r++) {
+        printf(" %12s", cpusToList(&affinity.cpus[r]).c_str());
+        // Threads confined to a set of cores may share them
+        if (r == flagcxThreadSocketHelper || CPU_COUNT(&affinity.cpus[r]) != 1)
+          continue;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+          if (CPU_ISSET(cpu, &affinity.cpus[r]) &&
+              !pinned[host].insert(cpu).second)
+            shared++;
+        }
+      }
+      printf("\n");
+    }
+    for (struct flagcxAffinity &affinity : comms)
+      flagcxAffinityRelease(&affinity);
+  }
+  free(pciPath);
+  printf("# cores pinned more than once on a host: %d\n", shared);
+  if (shared > 0)
+    return 1;
+
+  std::vector<int> nodes = numaNodes();
+  printf("\n# copy bandwidth (GB/s) of %zu MB, thread node x buffer node\n",
+         size >> 20);
+  printf("%10s", "cpu\\mem");
+  for (int mem : nodes)
+    printf(" %8d", mem);
+  printf("\n");
+  for (int cpu : nodes) {
+    // Place the copying thread like a socket helper of a NIC on node cpu
+    std::string nodeSpec = "numa=" + std::to_string(cpu);
+    setenv("FLAGCX_THREAD_AFFINITY", nodeSpec.c_str(), 1);
+    struct flagcxAffinity affinity;
+    if (flagcxAffinityInit(&affinity, NULL, 0, 0) != flagcxSuccess)
+      return 1;
+    printf("%10d", cpu);
+    for (int mem : nodes) {
+      char *staging = (char *)flagcxNumaAlloc(size, mem);
+      char *local = (char *)flagcxNumaAlloc(size, cpu);
+      if (staging == NULL || local == NULL) {
+        fprintf(stderr, "cannot allocate %zu bytes\n", size);
+        return 1;
+      }
+      memset(staging, 1, size);
+      int placed = pageNode(staging);
+      double gbs = 0;
+      std::atomic<bool> pinned(false);
+      std::thread copier([&]() {
+        while (!pinned.load())
+          std::this_thread::yield();
+        memset(local, 0, size);
+        uint64_t t0 = nowNs();
+        for (int i = 0; i < iters; i++)
+          memcpy(local, staging, size);
+        gbs = (double)size * iters / (nowNs() - t0);
+      });
+      flagcxAffinityBind(&affinity, flagcxThreadSocketHelper,
+                         copier.native_handle());
+      pinned.store(true);
+      copier.join();
+      printf(" %8.2f", gbs);
+      if (placed != mem)
+        printf("(on %d)", placed);
+      free(staging);
+      free(local);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "bintrace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <thread>
+#include <vector>
+
+// Cost of hot-path tracing. Every thread logs the same event with TRACE,
+// formatted under the debug lock into FLAGCX_DEBUG_FILE (/dev/null here),
+// then with TRACE_BIN into its own ring. The rings are written to the
+// given file, which flagcx/tools/trace_decode.py turns back into text.
+// usage: test_bintrace [-t max threads] [-n events per thread] [-o file]
+
+static double nowSec() {
+  using clock = std::chrono::steady_clock;
+  return 1.e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     clock::now().time_since_epoch())
+                     .count();
+}
+
+// Returns the average cost of one event in ns
+static double runThreads(bool binary, int nThreads, int nEvents) {
+  std::vector<std::thread> threads;
+  double start = nowSec();
+  for (int t = 0; t < nThreads; t++) {
+    threads.emplace_back([=]() {
+      for (int i = 0; i < nEvents; i++) {
+        if (binary) {
+          TRACE_BIN(FLAGCX_P2P, "thread %d event %d size %zu ptr %p", t, i,
+                    (size_t)i * 4096, (void *)&i);
+        } else {
+          TRACE(FLAGCX_P2P, "thread %d event %d size %zu ptr %p", t, i,
+                (size_t)i * 4096, (void *)&i);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return (nowSec() - start) * 1e9 / ((double)nThreads * nEvents);
+}
+
+int main(int argc, char *argv[]) {
+  int maxThreads = 4, nEvents = 1 << 18;
+  const char *file = "test_bintrace.bin";
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:o:")) != -1) {
+    switch (opt) {
+      case 't':
+        maxThreads = atoi(optarg);
+        break;
+      case 'n':
+        nEvents = atoi(optarg);
+        break;
+      case 'o':
+        file = optarg;
+        break;
+      default:
+        fprintf(stderr,
+                "usage: %s [-t max threads] [-n events per thread] "
+                "[-o file]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  // Both loggers are configured before their first use, the rings keep the
+  // last 4096 events of every thread
+  setenv("FLAGCX_DEBUG", "TRACE", 1);
+  setenv("FLAGCX_DEBUG_SUBSYS", "P2P", 1);
+  setenv("FLAGCX_DEBUG_FILE", "/dev/null", 1);
+  setenv("FLAGCX_BINTRACE_EVENTS", "4096", 1);
+  setenv("FLAGCX_BINTRACE_FILE", file, 1);
+  if (!flagcxBintraceOn(FLAGCX_P2P)) {
+    fprintf(stderr, "binary trace could not be enabled\n");
+    return 1;
+  }
+
+  printf("# %d events per thread\n", nEvents);
+  printf("%8s %14s %14s\n", "threads", "TRACE(ns)", "TRACE_BIN(ns)");
+  for (int t = 1; t <= maxThreads; t *= 2) {
+    double text = runThreads(false, t, nEvents);
+    double binary = runThreads(true, t, nEvents);
+    printf("%8d %14.1f %14.1f\n", t, text, binary);
+  }
+  flagcxBintraceFlush();
+  printf("# rings written to %s\n", file);
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include "bootstrap.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Bootstrap scaling benchmark. Forks nranks processes on this host that all
+// rendezvous through one bootstrap root, then do an AllGather and a Barrier.
+// Reports, as the maximum over the ranks, the time spent registering with
+// the root alone, in the whole bootstrapInit (registration, ring setup and
+// the address AllGather), and in the AllGather and Barrier that follow; the
+// average registration time is given too. The wall time also covers forking
+// the ranks and loading the library in each of them, which dominates on
+// small hosts. No MPI and no device are needed, so it can run hundreds of
+// ranks on a single machine. With -g, every group of that many ranks gets
+// its own FLAGCX_HOSTID so that it elects its own leader, as ranks on
+// separate hosts would; FLAGCX_BOOTSTRAP_HIERARCHY=0 compares with every
+// rank registering on its own.
+// usage: test_bootstrap [-n nranks] [-g ranks per host] [-i iters]
+
+#define BOOT_CHECK(cmd)                                                        \
+  do {                                                                         \
+    flagcxResult_t res = (cmd);                                                \
+    if (res != flagcxSuccess) {                                                \
+      fprintf(stderr, "%s:%d '%s' failed with %d\n", __FILE__, __LINE__,       \
+              #cmd, res);                                                      \
+      _exit(1);                                                                \
+    }                                                                          \
+  } while (0)
+
+static double nowSec() {
+  using clock = std::chrono::steady_clock;
+  return 1.e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     clock::now().time_since_epoch())
+                     .count();
+}
+
+struct rankTimes {
+  double reg;       // registration with the root
+  double init;      // all of bootstrapInit
+  double allGather; // one int per rank
+  double barrier;
+};
+
+// Times the bootstrap phases of this rank; returns false on error
+static bool runRank(struct flagcxBootstrapHandle *handle, int rank,
+                    int nranks, struct rankTimes *times) {
+  // bootstrapClose frees the state
+  struct bootstrapState *state =
+      (struct bootstrapState *)calloc(1, sizeof(struct bootstrapState));
+  state->rank = rank;
+  state->nranks = nranks;
+  state->magic = handle->magic;
+
+  double start = nowSec();
+  BOOT_CHECK(bootstrapInit(handle, state));
+  double inited = nowSec();
+  std::vector<int> ranks(nranks, -1);
+  ranks[rank] = rank;
+  BOOT_CHECK(bootstrapAllGather(state, ranks.data(), sizeof(int)));
+  double gathered = nowSec();
+  BOOT_CHECK(bootstrapBarrier(state, rank, nranks, 0));
+  times->reg = 1.e-9 * state->registerNs;
+  times->init = inited - start;
+  times->allGather = gathered - inited;
+  times->barrier = nowSec() - gathered;
+
+  for (int r = 0; r < nranks; r++) {
+    if (ranks[r] != r) {
+      fprintf(stderr, "rank %d: wrong AllGather entry %d = %d\n", rank, r,
+              ranks[r]);
+      return false;
+    }
+  }
+  BOOT_CHECK(bootstrapClose(state));
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  int nranks = 64, perHost = 0, iters = 3;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:g:i:")) != -1) {
+    switch (opt) {
+      case 'n':
+        nranks = atoi(optarg);
+        break;
+      case 'g':
+        perHost = atoi(optarg);
+        break;
+      case 'i':
+        iters = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr,
+                "usage: %s [-n nranks] [-g ranks per host] [-i iters]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  BOOT_CHECK(bootstrapNetInit());
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  printf("# bootstrap of %d ranks, %d per host\n", nranks,
+         perHost > 0 ? perHost : nranks);
+  printf("%6s %10s %10s %10s %10s %10s %10s\n", "iter", "wall(ms)",
+         "reg(ms)", "avgreg(ms)", "init(ms)", "gather(ms)", "barrier(ms)");
+
+  int failed = 0;
+  for (int it = 0; it < iters && !failed; it++) {
+    // The root runs as a thread of this process
+    struct flagcxBootstrapHandle handle;
+    BOOT_CHECK(bootstrapGetUniqueId(&handle));
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      return 1;
+    }
+    double start = nowSec();
+    for (int r = 0; r < nranks; r++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        perror("fork");
+        return 1;
+      }
+      if (pid == 0) {
+        close(fds[0]);
+        if (perHost > 0) {
+          char hostId[64];
+          snprintf(hostId, sizeof(hostId), "bootstrap-host%d", r / perHost);
+          setenv("FLAGCX_HOSTID", hostId, 1);
+        }
+        struct rankTimes times;
+        if (!runRank(&handle, r, nranks, &times))
+          _exit(1);
+        ssize_t n = write(fds[1], &times, sizeof(times));
+        _exit(n == sizeof(times) ? 0 : 1);
+      }
+    }
+    close(fds[1]);
+
+    struct rankTimes max = {}, times;
+    double sumReg = 0;
+    for (int r = 0; r < nranks; r++) {
+      int status;
+      if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+        failed = 1;
+    }
+    double wall = nowSec() - start;
+    int received = 0;
+    while (read(fds[0], &times, sizeof(times)) == sizeof(times)) {
+      max.reg = std::max(max.reg, times.reg);
+      max.init = std::max(max.init, times.init);
+      max.allGather = std::max(max.allGather, times.allGather);
+      max.barrier = std::max(max.barrier, times.barrier);
+      sumReg += times.reg;
+      received++;
+    }
+    close(fds[0]);
+    if (failed || received != nranks) {
+      fprintf(stderr, "iteration %d: %d of %d ranks completed\n", it,
+              received, nranks);
+      failed = 1;
+      break;
+    }
+    printf("%6d %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", it, wall * 1e3,
+           max.reg * 1e3, sumReg / nranks * 1e3, max.init * 1e3,
+           max.allGather * 1e3, max.barrier * 1e3);
+  }
+  return failed;
+}
@@ -0,0 +1,207 @@
+#include "cluster.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+// Cluster layout derived from the vendor names the ranks exchange at init.
+// flagcxCollectClusterInfos computes the layout of all ranks in one pass;
+// every rank used to compute only its own, which is kept below as the
+// reference. Random layouts of contiguous vendor blocks, half of them with
+// a random FLAGCX_CLUSTER_SPLIT_LIST, must give every rank the same result
+// both ways.
+// usage: test_cluster [-n trials] [-s seed]
+
+// The per-rank computation flagcxCommInitRank ran before the init record
+// exchange, unchanged but for its warnings and env lookup
+static flagcxResult_t referenceClusterInfo(const flagcxVendor *allData,
+                                           flagcxCommunicatorType_t *type,
+                                           int *homo_rank, int *homo_root_rank,
+                                           int *homo_ranks, int *cluster_id,
+                                           int *cluster_inter_rank,
+                                           int *ncluster, int rank,
+                                           int nranks) {
+  *homo_rank = rank;
+  *homo_root_rank = 0;
+  *homo_ranks = 1;
+  *cluster_id = 0;
+  *cluster_inter_rank = -1; // deprecated, to be removed
+  *ncluster = 1;
+  *type = flagcxCommunicatorHomo;
+
+  if (nranks <= 1)
+    return flagcxSuccess;
+
+  std::map<std::string, int> clusterMap;
+  clusterMap[allData[0].internal] = 1;
+  int numClusters = 1;
+  int currCluster = 0;
+  int aggRanks = 1;
+  int homoRootRank = 0;
+  std::string myCls = allData[rank].internal;
+  for (int i = 1; i < nranks; ++i) {
+    std::string cls = allData[i].internal;
+    auto it = clusterMap.find(cls);
+    if (it != clusterMap.end()) {
+      it->second = it->second + 1;
+    } else {
+      clusterMap[cls] = 1;
+      numClusters += 1;
+      if (myCls == cls) {
+        *homo_rank = *homo_rank - aggRanks;
+        currCluster = numClusters - 1;
+        homoRootRank = i;
+      }
+    }
+    aggRanks += 1;
+
+    if (i == rank) {
+      *homo_root_rank = homoRootRank;
+    }
+  }
+
+  *homo_ranks = clusterMap[myCls];
+
+  if (clusterMap.size() > 1) {
+    *type = flagcxCommunicatorHybrid;
+  } else {
+    *type = flagcxCommunicatorHomo;
+  }
+
+  if (*type == flagcxCommunicatorHybrid) {
+    *cluster_id = currCluster;
+    *ncluster = numClusters;
+  }
+
+  // split and obtain sub-clusters
+  const char *clusterSplitInfo = getenv("FLAGCX_CLUSTER_SPLIT_LIST");
+  if (clusterSplitInfo != NULL) {
+    std::vector<int> clusterSplitList;
+    FLAGCXCHECK(parseClusterSplitList(clusterSplitInfo, clusterSplitList));
+    if (*ncluster != int(clusterSplitList.size())) {
+      return flagcxSystemError;
+    }
+
+    int subClusterId = 0;
+    for (int i = 0; i < currCluster; ++i) {
+      subClusterId += clusterSplitList[i];
+    }
+    int subHomoRanks = (*homo_ranks) / clusterSplitList[currCluster];
+    int hasRes =
+        (((*homo_rank) / subHomoRanks) >= clusterSplitList[currCluster]) ? 1
+                                                                         : 0;
+    subClusterId += (hasRes == 1) ? ((*homo_rank) / subHomoRanks) - 1
+                                  : ((*homo_rank) / subHomoRanks);
+    int subHomoRank = (hasRes == 1)
+                          ? subHomoRanks + ((*homo_rank) % subHomoRanks)
+                          : ((*homo_rank) % subHomoRanks);
+    int subHomoRootRank = rank - subHomoRank;
+    if (hasRes == 1 ||
+        ((*homo_rank) / subHomoRanks) == clusterSplitList[currCluster] - 1) {
+      subHomoRanks += (*homo_ranks) % clusterSplitList[currCluster];
+    }
+    int subNClusters = 0;
+    for (int i = 0; i < (*ncluster); ++i) {
+      subNClusters += clusterSplitList[i];
+    }
+    *homo_rank = subHomoRank;
+    *homo_root_rank = subHomoRootRank;
+    *homo_ranks = subHomoRanks;
+    *cluster_id = subClusterId;
+    *ncluster = subNClusters;
+    *type =
+        (subNClusters > 1) ? flagcxCommunicatorHybrid : flagcxCommunicatorHomo;
+  }
+
+  return flagcxSuccess;
+}
+
+int main(int argc, char *argv[]) {
+  int trials = 10000;
+  unsigned seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+    switch (opt) {
+      case 'n':
+        trials = atoi(optarg);
+        break;
+      case 's':
+        seed = (unsigned)atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n trials] [-s seed]\n", argv[0]);
+        return 1;
+    }
+  }
+  srand(seed);
+  int mismatches = 0, split = 0;
+  for (int t = 0; t < trials; t++) {
+    // Up to 4 vendors of 1 to 12 ranks each
+    int nVendors = 1 + rand() % 4;
+    std::vector<flagcxVendor> vendors;
+    std::vector<int> sizes;
+    for (int v = 0; v < nVendors; v++) {
+      int size = 1 + rand() % 12;
+      sizes.push_back(size);
+      for (int i = 0; i < size; i++) {
+        flagcxVendor vendor = {};
+        snprintf(vendor.internal, sizeof(vendor.internal), "VENDOR%d", v);
+        vendors.push_back(vendor);
+      }
+    }
+    int nranks = vendors.size();
+    // Splits of at most as many parts as ranks, and only when the layout
+    // has more than one rank
+    std::string splitList;
+    if (rand() % 2 && nranks > 1) {
+      for (int v = 0; v < nVendors; v++) {
+        int parts = 1 + rand() % std::min(sizes[v], 3);
+        splitList += (v ? "," : "") + std::to_string(parts);
+      }
+      setenv("FLAGCX_CLUSTER_SPLIT_LIST", splitList.c_str(), 1);
+      split++;
+    } else {
+      unsetenv("FLAGCX_CLUSTER_SPLIT_LIST");
+    }
+
+    flagcxCommunicatorType_t type;
+    int nclusters;
+    std::vector<int> homoRank(nranks), homoRootRank(nranks),
+        homoRanks(nranks), clusterId(nranks), clusterInterRank(nranks);
+    if (flagcxCollectClusterInfos(
+            vendors.data(), &type, homoRank.data(), homoRootRank.data(),
+            homoRanks.data(), clusterId.data(), clusterInterRank.data(),
+            &nclusters, nranks) != flagcxSuccess) {
+      printf("# trial %d: %d ranks, split '%s' failed\n", t, nranks,
+             splitList.c_str());
+      mismatches++;
+      continue;
+    }
+    for (int r = 0; r < nranks; r++) {
+      flagcxCommunicatorType_t refType;
+      int ref[6];
+      if (referenceClusterInfo(vendors.data(), &refType, ref, ref + 1,
+                               ref + 2, ref + 3, ref + 4, ref + 5, r,
+                               nranks) != flagcxSuccess)
+        continue;
+      int got[6] = {homoRank[r],  homoRootRank[r],     homoRanks[r],
+                    clusterId[r], clusterInterRank[r], nclusters};
+      if (refType == type && memcmp(ref, got, sizeof(ref)) == 0)
+        continue;
+      if (mismatches++ < 10) {
+        printf("# trial %d: %d ranks, split '%s', rank %d: homo rank %d/%d "
+               "root %d ranks %d cluster %d/%d inter %d type %d, expected "
+               "%d/%d root %d ranks %d cluster %d/%d inter %d type %d\n",
+               t, nranks, splitList.c_str(), r, got[0], got[2], got[1],
+               got[2], got[3], got[5], got[4], type, ref[0], ref[2], ref[1],
+               ref[2], ref[3], ref[5], ref[4], refType);
+      }
+    }
+  }
+  printf("# %d layouts, %d of them split: %d mismatches\n", trials, split,
+         mismatches);
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+#include "flagcx_kernel.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+// Device trigger FIFO benchmark. Host threads stand in for the device
+// producers and write the flagcxFifo layout exactly as the kernel side does,
+// while the calling thread consumes like flagcxProxyKernelService. The
+// legacy single-producer protocol is measured for reference, then the
+// multi-producer protocol with one trigger per dequeue and with batches.
+// usage: test_fifo [-p max producers] [-n triggers per run] [-i iters]
+
+static const uint64_t readyBit = 1ull << flagcxDeviceTriggerOffFifoReserved;
+static const int slotWords = sizeof(flagcxDeviceTrigger) / sizeof(uint64_t);
+
+static double nowSec() {
+  using clock = std::chrono::steady_clock;
+  return 1.e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     clock::now().time_since_epoch())
+                     .count();
+}
+
+// Producer of the original FIFO: a plain increment of produced, so only one
+// producer may run at a time
+static void legacyEnqueue(uint64_t *buffer, uint64_t fst, uint64_t snd) {
+  uint64_t capacity = buffer[0];
+  uint64_t prod = __atomic_load_n(&buffer[2], __ATOMIC_RELAXED);
+  while (prod - __atomic_load_n(&buffer[1], __ATOMIC_ACQUIRE) >= capacity) {
+    sched_yield();
+  }
+  uint64_t *trigger = buffer + 3 + slotWords * (prod % capacity);
+  trigger[0] = fst;
+  trigger[1] = snd;
+  __atomic_store_n(&buffer[2], prod + 1, __ATOMIC_RELEASE);
+}
+
+// Consumer of the original FIFO, one trigger per call
+static int legacyDequeue(uint64_t *buffer, flagcxDeviceTrigger_t trigger) {
+  uint64_t capacity = buffer[0];
+  uint64_t cons = buffer[1];
+  if (__atomic_load_n(&buffer[2], __ATOMIC_ACQUIRE) == cons) {
+    return 0;
+  }
+  memcpy(trigger, buffer + 3 + slotWords * (cons % capacity),
+         sizeof(flagcxDeviceTrigger));
+  __atomic_store_n(&buffer[1], cons + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+// Host stand-in for the device enqueue: reserve, write, publish
+static void mpscEnqueue(uint64_t *buffer, uint64_t fst, uint64_t snd) {
+  uint64_t capacity = buffer[0];
+  uint64_t slot = __atomic_fetch_add(&buffer[2], 1, __ATOMIC_RELAXED);
+  while (slot - __atomic_load_n(&buffer[1], __ATOMIC_ACQUIRE) >= capacity) {
+    sched_yield(); // the device side backs off instead
+  }
+  uint64_t *trigger = buffer + 3 + slotWords * (slot % capacity);
+  __atomic_store_n(&trigger[0], fst, __ATOMIC_RELAXED);
+  __atomic_store_n(&trigger[1], snd | readyBit, __ATOMIC_RELEASE);
+}
+
+enum fifoMode { modeLegacy, modeSingle, modeBatch };
+
+// Returns the consumed triggers per second, or a negative value if a
+// trigger was lost, duplicated or reordered within its producer
+static double runFifo(fifoMode mode, int nProducers, uint64_t nTriggers) {
+  std::vector<uint64_t> buffer(3 + slotWords * FLAGCX_KERNEL_FIFO_CAPACITY, 0);
+  buffer[0] = FLAGCX_KERNEL_FIFO_CAPACITY;
+  uint64_t perProducer = nTriggers / nProducers;
+  std::vector<uint64_t> next(nProducers, 0);
+
+  double start = nowSec();
+  std::vector<std::thread> producers;
+  for (int p = 0; p < nProducers; p++) {
+    producers.emplace_back([&, p]() {
+      for (uint64_t i = 0; i < perProducer; i++) {
+        // fst carries the producer and its sequence number, snd the count
+        uint64_t fst = (uint64_t)p << 40 | i;
+        uint64_t snd = i & 0xffff;
+        if (mode == modeLegacy) {
+          legacyEnqueue(buffer.data(), fst, snd);
+        } else {
+          mpscEnqueue(buffer.data(), fst, snd);
+        }
+      }
+    });
+  }
+
+  flagcxDeviceTrigger triggers[FLAGCX_KERNEL_FIFO_CAPACITY];
+  uint64_t consumed = 0, total = perProducer * nProducers;
+  bool valid = true;
+  while (consumed < total) {
+    int n = 0;
+    if (mode == modeLegacy) {
+      n = legacyDequeue(buffer.data(), triggers);
+    } else {
+      dequeueBatch(buffer.data(), triggers,
+                   mode == modeBatch ? FLAGCX_KERNEL_FIFO_CAPACITY : 1, &n);
+    }
+    if (n == 0) {
+      sched_yield();
+      continue;
+    }
+    for (int i = 0; i < n; i++) {
+      uint64_t p = triggers[i].fst >> 40;
+      uint64_t seq = triggers[i].fst & ((1ull << 40) - 1);
+      if (p >= (uint64_t)nProducers || seq != next[p] ||
+          triggers[i].getCount() != (seq & 0xffff)) {
+        valid = false;
+      } else {
+        next[p]++;
+      }
+    }
+    consumed += n;
+  }
+  double elapsed = nowSec() - start;
+  for (auto &t : producers) {
+    t.join();
+  }
+  return valid ? total / elapsed : -1;
+}
+
+int main(int argc, char *argv[]) {
+  int maxProducers = 4, iters = 3;
+  uint64_t nTriggers = 1 << 20;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:n:i:")) != -1) {
+    switch (opt) {
+      case 'p':
+        maxProducers = atoi(optarg);
+        break;
+      case 'n':
+        nTriggers = strtoull(optarg, NULL, 0);
+        break;
+      case 'i':
+        iters = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr,
+                "usage: %s [-p max producers] [-n triggers per run] "
+                "[-i iters]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  printf("# %lu triggers per run, FIFO capacity %d, best of %d\n",
+         (unsigned long)nTriggers, FLAGCX_KERNEL_FIFO_CAPACITY, iters);
+  printf("%-10s %10s %16s\n", "mode", "producers", "Mtriggers/s");
+  const char *names[] = {"legacy", "single", "batch"};
+  for (int mode = modeLegacy; mode <= modeBatch; mode++) {
+    for (int p = 1; p <= maxProducers; p *= 2) {
+      if (mode == modeLegacy && p > 1) {
+        break; // the legacy producer index is not safe to share
+      }
+      double best = 0;
+      for (int it = 0; it < iters; it++) {
+        double rate = runFifo((fifoMode)mode, p, nTriggers);
+        if (rate < 0) {
+          fprintf(stderr, "%s with %d producers lost or reordered triggers\n",
+                  names[mode], p);
+          return 1;
+        }
+        best = rate > best ? rate : best;
+      }
+      printf("%-10s %10d %16.2f\n", names[mode], p, best * 1e-6);
+    }
+  }
+  return 0;
+}
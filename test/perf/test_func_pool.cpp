@@ -0,0 +1,224 @@
+#include "launch_kernel.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <getopt.h>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Device func flags and events pool, driven the way groupLaunch and the
+// proxy thread use it on the host build. Every op takes a slot and an event,
+// a stream function stands in for the device funcs that raise the flags of
+// the slot, and a proxy thread only gives the slot and event back once the
+// event recorded after it has completed. The stream is held until a burst of
+// -n ops is queued, so the first burst must grow the pool to enough slabs
+// for all of them; later bursts, and -i rounds of ops that are put back
+// while new ones are taken, must reuse them without a single device
+// allocation or event creation, counted on the device adaptor itself.
+// usage: test_func_pool [-n ops per burst] [-b bursts] [-i rounds]
+
+#define POOLCHECK(cmd)                                                         \
+  do {                                                                         \
+    flagcxResult_t res = cmd;                                                  \
+    if (res != flagcxSuccess) {                                                \
+      fprintf(stderr, "%s:%d %s failed : %d\n", __FILE__, __LINE__, #cmd,      \
+              res);                                                            \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+static struct flagcxDeviceAdaptor countingAdaptor;
+static struct flagcxDeviceAdaptor *realAdaptor;
+static std::atomic<int> deviceAllocs(0);
+static std::atomic<int> eventCreates(0);
+
+static flagcxResult_t countingMalloc(void **ptr, size_t size,
+                                     flagcxMemType_t type,
+                                     flagcxStream_t stream) {
+  deviceAllocs++;
+  return realAdaptor->deviceMalloc(ptr, size, type, stream);
+}
+
+static flagcxResult_t countingEventCreate(flagcxEvent_t *event,
+                                          flagcxEventType_t eventType) {
+  eventCreates++;
+  return realAdaptor->eventCreate(event, eventType);
+}
+
+struct funcOp {
+  int slot;
+  bool *flags;
+  flagcxEvent_t event;
+};
+
+static std::atomic<bool> gateOpen(false);
+static std::atomic<int> dirtySlots(0);
+static std::atomic<int> unraisedSlots(0);
+
+static void holdStream(void *args) {
+  while (!gateOpen.load(std::memory_order_acquire))
+    std::this_thread::yield();
+}
+
+// What the device funcs of an op do to its flags, which must have been
+// reset when the slot was handed out
+static void raiseFlags(void *args) {
+  bool *flags = (bool *)args;
+  if (flags[0] || flags[1])
+    dirtySlots++;
+  flags[0] = flags[1] = true;
+}
+
+// The proxy side: ops are put back in order, each once its event completed
+struct proxyQueue {
+  std::mutex mutex;
+  std::deque<funcOp> ops;
+  std::atomic<int> inFlight{0};
+  std::atomic<bool> stop{false};
+};
+
+static void proxyThread(struct flagcxFuncPool *pool, proxyQueue *queue) {
+  while (true) {
+    funcOp op;
+    {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      if (queue->ops.empty()) {
+        if (queue->stop.load())
+          return;
+        op.event = NULL;
+      } else {
+        op = queue->ops.front();
+      }
+    }
+    if (op.event == NULL ||
+        realAdaptor->eventQuery(op.event) != flagcxSuccess) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (!op.flags[0] || !op.flags[1])
+      unraisedSlots++;
+    {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      queue->ops.pop_front();
+    }
+    POOLCHECK(flagcxFuncPoolPut(pool, op.slot, op.event));
+    queue->inFlight--;
+  }
+}
+
+// Take an op from the pool, launch it and hand it to the proxy
+static void launchOp(struct flagcxFuncPool *pool, flagcxStream_t stream,
+                     proxyQueue *queue, std::set<int> *taken) {
+  funcOp op;
+  POOLCHECK(flagcxFuncPoolGet(pool, stream, &op.slot, &op.flags, &op.event));
+  if (taken != NULL && !taken->insert(op.slot).second) {
+    printf("# slot %d handed out twice\n", op.slot);
+    exit(1);
+  }
+  POOLCHECK(deviceAdaptor->launchHostFunc(stream, raiseFlags, op.flags));
+  POOLCHECK(deviceAdaptor->eventRecord(op.event, stream));
+  queue->inFlight++;
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->ops.push_back(op);
+}
+
+static void waitDrained(proxyQueue *queue) {
+  while (queue->inFlight.load() > 0)
+    std::this_thread::yield();
+}
+
+int main(int argc, char *argv[]) {
+  int burst = 3 * FLAGCX_FUNC_POOL_SLAB + 1;
+  int bursts = 4;
+  int rounds = 20000;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:b:i:")) != -1) {
+    switch (opt) {
+      case 'n':
+        burst = atoi(optarg);
+        break;
+      case 'b':
+        bursts = atoi(optarg);
+        break;
+      case 'i':
+        rounds = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr,
+                "usage: %s [-n ops per burst] [-b bursts] [-i rounds]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+  if (burst < 1 || bursts < 1 || rounds < 0) {
+    fprintf(stderr, "ops per burst and bursts must be positive\n");
+    return 1;
+  }
+
+  realAdaptor = deviceAdaptor;
+  countingAdaptor = *deviceAdaptor;
+  countingAdaptor.deviceMalloc = countingMalloc;
+  countingAdaptor.eventCreate = countingEventCreate;
+  deviceAdaptor = &countingAdaptor;
+
+  flagcxStream_t stream;
+  POOLCHECK(deviceAdaptor->streamCreate(&stream));
+  struct flagcxFuncPool *pool;
+  POOLCHECK(flagcxFuncPoolCreate(&pool));
+  proxyQueue queue;
+  std::thread proxy(proxyThread, pool, &queue);
+
+  int failures = 0;
+  int slabs = (burst + FLAGCX_FUNC_POOL_SLAB - 1) / FLAGCX_FUNC_POOL_SLAB;
+  int allocs = 0, events = 0;
+  for (int b = 0; b < bursts; b++) {
+    gateOpen = false;
+    POOLCHECK(deviceAdaptor->launchHostFunc(stream, holdStream, NULL));
+    std::set<int> taken;
+    for (int i = 0; i < burst; i++)
+      launchOp(pool, stream, &queue, &taken);
+    gateOpen = true;
+    waitDrained(&queue);
+    printf("# burst %d: %d ops, %d device allocations, %d events created\n",
+           b, burst, deviceAllocs.load(), eventCreates.load());
+    if (b == 0) {
+      allocs = deviceAllocs.load();
+      events = eventCreates.load();
+      if (allocs != slabs || events != burst) {
+        printf("# expected %d slabs and %d events\n", slabs, burst);
+        failures++;
+      }
+    } else if (deviceAllocs.load() != allocs ||
+               eventCreates.load() != events) {
+      failures++;
+    }
+  }
+
+  // Ops are put back by the proxy while new ones are taken, never more in
+  // flight than the first burst took
+  for (int i = 0; i < rounds; i++) {
+    while (queue.inFlight.load() >= burst)
+      std::this_thread::yield();
+    launchOp(pool, stream, &queue, NULL);
+  }
+  waitDrained(&queue);
+  printf("# %d rounds: %d device allocations, %d events created\n", rounds,
+         deviceAllocs.load(), eventCreates.load());
+  if (deviceAllocs.load() != allocs || eventCreates.load() != events)
+    failures++;
+
+  printf("# %d slots not reset, %d slots not raised\n", dirtySlots.load(),
+         unraisedSlots.load());
+  failures += dirtySlots.load() + unraisedSlots.load();
+  queue.stop = true;
+  proxy.join();
+  POOLCHECK(deviceAdaptor->streamSynchronize(stream));
+  POOLCHECK(flagcxFuncPoolDestroy(pool));
+  POOLCHECK(deviceAdaptor->streamDestroy(stream));
+  printf("# %s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
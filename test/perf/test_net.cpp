@@ -0,0 +1,373 @@
+#include "adaptor.h"
+#include "flagcx_net.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <getopt.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Two processes over one net adaptor, without MPI or a communicator: the
+// parent listens and receives, a forked child connects and sends. Message
+// sizes double up to -e, past the 8 MB ring of the SHM adaptor by default,
+// and the receiver checks the pattern every message carries. With -a shm a
+// listener is also killed before any peer connects, and the next init must
+// remove the segment it left in /dev/shm. Adaptors with one-sided functions
+// are also driven through write, signal and read of the largest size, and
+// must reject operations on windows that were never registered.
+// usage: test_net [-a shm|socket|ucx] [-e max MB] [-n iters]
+
+extern struct flagcxNetAdaptor flagcxNetShm;
+extern struct flagcxNetAdaptor flagcxNetSocket;
+
+#define NETCHECK(cmd)                                                          \
+  do {                                                                         \
+    flagcxResult_t res = cmd;                                                  \
+    if (res != flagcxSuccess) {                                                \
+      fprintf(stderr, "%s:%d %s failed : %d\n", __FILE__, __LINE__, #cmd,      \
+              res);                                                            \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+static double nowSec() {
+  using clock = std::chrono::steady_clock;
+  return 1.e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     clock::now().time_since_epoch())
+                     .count();
+}
+
+static void pipeWrite(int fd, const void *data, size_t size) {
+  if (write(fd, data, size) != (ssize_t)size) {
+    perror("pipe write");
+    exit(1);
+  }
+}
+
+static void pipeRead(int fd, void *data, size_t size) {
+  size_t got = 0;
+  while (got < size) {
+    ssize_t n = read(fd, (char *)data + got, size - got);
+    if (n <= 0) {
+      perror("pipe read");
+      exit(1);
+    }
+    got += n;
+  }
+}
+
+static void fill(char *buf, size_t size, int seed) {
+  for (size_t i = 0; i < size; i++)
+    buf[i] = (char)(i * 131 + seed);
+}
+
+static size_t mismatches(const char *buf, size_t size, int seed) {
+  size_t bad = 0;
+  for (size_t i = 0; i < size; i++)
+    bad += buf[i] != (char)(i * 131 + seed);
+  return bad;
+}
+
+static void waitRequest(struct flagcxNetAdaptor *net, void *request,
+                        int *size) {
+  int done = 0;
+  while (!done)
+    NETCHECK(net->test(request, &done, size));
+}
+
+// The sender side, run in the child
+static void runSender(struct flagcxNetAdaptor *net, int in, size_t maxBytes,
+                      int iters) {
+  char handle[FLAGCX_NET_HANDLE_MAXSIZE];
+  void *sendComm = NULL, *mhandle = NULL;
+  NETCHECK(net->init());
+  pipeRead(in, handle, sizeof(handle));
+  while (sendComm == NULL)
+    NETCHECK(net->connect(0, handle, &sendComm));
+  std::vector<char> buf(maxBytes);
+  NETCHECK(net->regMr(sendComm, buf.data(), maxBytes, FLAGCX_PTR_HOST,
+                      &mhandle));
+  for (size_t size = 1024; size <= maxBytes; size *= 2) {
+    for (int i = 0; i < iters; i++) {
+      void *request = NULL;
+      fill(buf.data(), size, i + (int)size);
+      while (request == NULL)
+        NETCHECK(net->isend(sendComm, buf.data(), size, 0, mhandle, NULL,
+                            &request));
+      waitRequest(net, request, NULL);
+    }
+  }
+  NETCHECK(net->deregMr(sendComm, mhandle));
+  NETCHECK(net->closeSend(sendComm));
+}
+
+// The receiver side, run in the parent; returns the number of failures
+static int runReceiver(struct flagcxNetAdaptor *net, int out, size_t maxBytes,
+                       int iters) {
+  char handle[FLAGCX_NET_HANDLE_MAXSIZE] = {};
+  void *listenComm = NULL, *recvComm = NULL, *mhandle = NULL;
+  NETCHECK(net->init());
+  NETCHECK(net->listen(0, handle, &listenComm));
+  pipeWrite(out, handle, sizeof(handle));
+  while (recvComm == NULL)
+    NETCHECK(net->accept(listenComm, &recvComm));
+  std::vector<char> buf(maxBytes);
+  NETCHECK(net->regMr(recvComm, buf.data(), maxBytes, FLAGCX_PTR_HOST,
+                      &mhandle));
+  int failures = 0;
+  printf("%12s %10s %8s\n", "bytes", "GB/s", "status");
+  for (size_t size = 1024; size <= maxBytes; size *= 2) {
+    size_t bad = 0;
+    double time = 0;
+    for (int i = 0; i < iters; i++) {
+      void *request = NULL, *data = buf.data();
+      size_t sizes[1] = {size};
+      int tags[1] = {0}, got = 0;
+      memset(buf.data(), 0, size);
+      double t0 = nowSec();
+      while (request == NULL)
+        NETCHECK(net->irecv(recvComm, 1, &data, sizes, tags, &mhandle, NULL,
+                            &request));
+      waitRequest(net, request, &got);
+      time += nowSec() - t0;
+      bad += (size_t)got != size ? size : mismatches(buf.data(), size,
+                                                     i + (int)size);
+    }
+    failures += bad != 0;
+    printf("%12zu %10.2f %8s\n", size, 1.e-9 * size * iters / time,
+           bad ? "wrong" : "ok");
+  }
+  NETCHECK(net->deregMr(recvComm, mhandle));
+  NETCHECK(net->closeRecv(recvComm));
+  NETCHECK(net->closeListen(listenComm));
+  return failures;
+}
+
+static flagcxResult_t rmaWait(struct flagcxNetAdaptor *net, void *request) {
+  int done = 0;
+  while (!done) {
+    flagcxResult_t res = net->test(request, &done, NULL);
+    if (res != flagcxSuccess)
+      return res;
+  }
+  return flagcxSuccess;
+}
+
+typedef flagcxResult_t (*rmaFunc_t)(void *comm, void *data, size_t size,
+                                    int tag, void *mhandle, void *phandle,
+                                    void **request);
+
+// Post a one-sided operation and wait for it; rejections are returned
+static flagcxResult_t rmaRun(struct flagcxNetAdaptor *net, rmaFunc_t func,
+                             void *comm, void *data, size_t size,
+                             void *mhandle, flagcxNetRmaDesc_t *desc) {
+  void *request = NULL;
+  while (request == NULL) {
+    flagcxResult_t res =
+        func(comm, data, size, 0, mhandle, desc, &request);
+    if (res != flagcxSuccess)
+      return res;
+  }
+  return rmaWait(net, request);
+}
+
+// The initiator of writes and signals, run in a child: puts the pattern in
+// the window of the parent, then adds 1 to the word behind it. The parent
+// reads the same pattern back from the window registered here.
+static int runRmaInitiator(struct flagcxNetAdaptor *net, int in, int out,
+                           size_t size) {
+  char handle[FLAGCX_NET_HANDLE_MAXSIZE];
+  flagcxNetRmaDesc_t window;
+  void *sendComm = NULL, *mhandle = NULL;
+  int failures = 0;
+  NETCHECK(net->init());
+  pipeRead(in, handle, sizeof(handle));
+  while (sendComm == NULL)
+    NETCHECK(net->connect(0, handle, &sendComm));
+  std::vector<char> buf(size);
+  uint64_t one = 1;
+  fill(buf.data(), size, 7);
+  NETCHECK(net->regMr(sendComm, buf.data(), size,
+                      FLAGCX_PTR_HOST | FLAGCX_PTR_RMA, &mhandle));
+  pipeRead(in, &window, sizeof(window));
+  pipeWrite(out, mhandle, sizeof(flagcxNetRmaDesc_t));
+
+  // A window without key is refused before anything is sent
+  flagcxNetRmaDesc_t bad = window;
+  bad.keyLen = 0;
+  failures += rmaRun(net, net->write, sendComm, buf.data(), size, mhandle,
+                     &bad) == flagcxSuccess;
+  // The socket adaptor checks keys at the target, which must drain the
+  // payload and keep the connection usable. Forged UCX rkeys are not safe
+  // to unpack, so they are not tried.
+  if (strcmp(net->name, "Socket") == 0) {
+    bad = window;
+    bad.key[0] ^= 1;
+    failures += rmaRun(net, net->write, sendComm, buf.data(), size, mhandle,
+                       &bad) == flagcxSuccess;
+  }
+  failures += rmaRun(net, net->write, sendComm, buf.data(), size, mhandle,
+                     &window) != flagcxSuccess;
+  flagcxNetRmaDesc_t word = window;
+  word.addr += size;
+  word.size = sizeof(uint64_t);
+  failures += rmaRun(net, net->signal, sendComm, &one, sizeof(one), NULL,
+                     &word) != flagcxSuccess;
+  pipeWrite(out, &failures, sizeof(failures));
+  // Keep the window until the parent read it
+  pipeRead(in, &failures, sizeof(failures));
+  NETCHECK(net->deregMr(sendComm, mhandle));
+  NETCHECK(net->closeSend(sendComm));
+  return failures;
+}
+
+// The target of writes and signals and the initiator of reads, run in the
+// parent; returns the number of failures
+static int runRmaTarget(struct flagcxNetAdaptor *net, int in, int out,
+                        size_t size) {
+  char handle[FLAGCX_NET_HANDLE_MAXSIZE] = {};
+  flagcxNetRmaDesc_t remote;
+  void *listenComm = NULL, *recvComm = NULL, *mhandle = NULL;
+  int failures = 0, peerFailures = 0;
+  NETCHECK(net->listen(0, handle, &listenComm));
+  pipeWrite(out, handle, sizeof(handle));
+  while (recvComm == NULL)
+    NETCHECK(net->accept(listenComm, &recvComm));
+  // The pattern followed by the word signals add to
+  std::vector<char> buf(size + sizeof(uint64_t), 0);
+  NETCHECK(net->regMr(recvComm, buf.data(), buf.size(),
+                      FLAGCX_PTR_HOST | FLAGCX_PTR_RMA, &mhandle));
+  flagcxNetRmaDesc_t *window = (flagcxNetRmaDesc_t *)mhandle;
+  if (window->keyLen == 0) {
+    printf("# one-sided: region not exposed by %s\n", net->name);
+    failures++;
+  }
+  pipeWrite(out, window, sizeof(*window));
+  pipeRead(in, &remote, sizeof(remote));
+  pipeRead(in, &peerFailures, sizeof(peerFailures));
+  uint64_t word;
+  memcpy(&word, buf.data() + size, sizeof(word));
+  bool wrote = mismatches(buf.data(), size, 7) == 0;
+  printf("# one-sided write %s, signal %s, rejected keys %s\n",
+         wrote ? "ok" : "wrong", word == 1 ? "ok" : "wrong",
+         peerFailures ? "wrong" : "ok");
+  failures += !wrote + (word != 1) + peerFailures;
+
+  memset(buf.data(), 0, size);
+  flagcxResult_t res =
+      rmaRun(net, net->read, recvComm, buf.data(), size, NULL, &remote);
+  bool read = res == flagcxSuccess && mismatches(buf.data(), size, 7) == 0;
+  printf("# one-sided read %s\n", read ? "ok" : "wrong");
+  failures += !read;
+  pipeWrite(out, &failures, sizeof(failures));
+  NETCHECK(net->deregMr(recvComm, mhandle));
+  NETCHECK(net->closeRecv(recvComm));
+  NETCHECK(net->closeListen(listenComm));
+  return failures;
+}
+
+// A listener that dies before its peer attaches must not leak its segment
+static int checkShmSweep(struct flagcxNetAdaptor *net) {
+  int fds[2];
+  char handle[FLAGCX_NET_HANDLE_MAXSIZE] = {};
+  if (pipe(fds) != 0)
+    return 1;
+  pid_t pid = fork();
+  if (pid == 0) {
+    void *listenComm = NULL;
+    NETCHECK(net->init());
+    NETCHECK(net->listen(0, handle, &listenComm));
+    pipeWrite(fds[1], handle, sizeof(handle));
+    _exit(0);
+  }
+  pipeRead(fds[0], handle, sizeof(handle));
+  waitpid(pid, NULL, 0);
+  close(fds[0]);
+  close(fds[1]);
+  // The SHM handle starts with the path of the segment
+  std::string path(handle, strnlen(handle, sizeof(handle)));
+  struct stat st;
+  bool left = stat(path.c_str(), &st) == 0;
+  NETCHECK(net->init());
+  bool removed = stat(path.c_str(), &st) != 0;
+  printf("# segment %s of a dead listener: %s\n", path.c_str(),
+         !left ? "not found" : removed ? "removed" : "leaked");
+  return left && removed ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+  std::string name = "shm";
+  size_t maxBytes = 32 << 20;
+  int iters = 5;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:e:n:")) != -1) {
+    switch (opt) {
+      case 'a':
+        name = optarg;
+        break;
+      case 'e':
+        maxBytes = (size_t)atoi(optarg) << 20;
+        break;
+      case 'n':
+        iters = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr,
+                "usage: %s [-a shm|socket|ucx] [-e max MB] [-n iters]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+  struct flagcxNetAdaptor *net = NULL;
+  if (name == "shm") {
+    net = &flagcxNetShm;
+  } else if (name == "socket") {
+    net = &flagcxNetSocket;
+  } else if (name == "ucx") {
+    // Only there when the library is built with USE_UCX=1
+    net = (struct flagcxNetAdaptor *)dlsym(RTLD_DEFAULT, "flagcxNetUcx");
+    if (net == NULL) {
+      printf("# adaptor ucx is not built in, skipping\n");
+      return 0;
+    }
+  } else {
+    fprintf(stderr, "unknown adaptor %s\n", name.c_str());
+    return 1;
+  }
+
+  printf("# adaptor %s, %d iters per size\n", net->name, iters);
+  bool rma = net->write != NULL;
+  int toChild[2], toRma[2], fromRma[2];
+  if (pipe(toChild) != 0 || pipe(toRma) != 0 || pipe(fromRma) != 0) {
+    perror("pipe");
+    return 1;
+  }
+  // Both children are forked before the parent initializes the adaptor
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    runSender(net, toChild[0], maxBytes, iters);
+    _exit(0);
+  }
+  pid_t rmaPid = rma ? fork() : -1;
+  if (rmaPid == 0)
+    _exit(runRmaInitiator(net, toRma[0], fromRma[1], maxBytes) ? 1 : 0);
+  int failures = runReceiver(net, toChild[1], maxBytes, iters);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  if (rma) {
+    failures += runRmaTarget(net, fromRma[0], toRma[1], maxBytes);
+    waitpid(rmaPid, &status, 0);
+    failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  }
+  if (name == "shm")
+    failures += checkShmSweep(net);
+  printf("# %s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+#include "global_comm.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Tuner communicator pool over forked ranks of the host build, without MPI.
+// Every rank runs AllReduce on sizes of different tuner buckets in turns,
+// one more bucket each round, so the searches of the buckets walk the host
+// candidates out of step. Every other round runs inside one group.
+// After every call the pool is compared with a model of it: past -p
+// communicators it may only hold best ones and the one in use, a new one
+// must evict the least recently used communicator that is not a best one,
+// and the retired ones must be destroyed by the next creation once their
+// ops are done, but never while their group is open. The results are
+// checked as well.
+// usage: test_tuner_pool [-n ranks] [-p pool size] [-i rounds]
+
+#define POOLCHECK(cmd)                                                         \
+  do {                                                                         \
+    flagcxResult_t res = cmd;                                                  \
+    if (res != flagcxSuccess) {                                                \
+      fprintf(stderr, "%s:%d %s failed : %d\n", __FILE__, __LINE__, #cmd,      \
+              res);                                                            \
+      _exit(1);                                                                \
+    }                                                                          \
+  } while (0)
+
+struct poolModel {
+  size_t poolSize;
+  std::list<uint32_t> lru; // config index, most recently used first
+  int created;
+  int evicted;
+  int failures;
+};
+
+static uint32_t poolKey(flagcxComm_t comm, flagcxInnerComm_t innerComm) {
+  for (const auto &item : comm->homoCommPool) {
+    if (item.second == innerComm)
+      return item.first;
+  }
+  return UINT32_MAX;
+}
+
+static bool isBest(flagcxComm_t comm, uint32_t idx) {
+  auto it = comm->homoCommPool.find(idx);
+  for (const auto &item : comm->homoBestCommMap) {
+    if (it != comm->homoCommPool.end() && item.second == it->second)
+      return true;
+  }
+  return false;
+}
+
+static std::string joinConfigs(const std::vector<uint32_t> &configs) {
+  std::string out;
+  for (uint32_t idx : configs)
+    out += (out.empty() ? "" : ",") + std::to_string(idx);
+  return out;
+}
+
+#define POOLFAIL(model, ...)                                                   \
+  do {                                                                         \
+    if ((model).failures++ < 10)                                               \
+      printf(__VA_ARGS__);                                                     \
+  } while (0)
+
+// Compare the pool after a call with the model of it before the call.
+// retiredBefore is the number of retired communicators before the call.
+static void checkPool(flagcxComm_t comm, poolModel &model, int rank,
+                      size_t retiredBefore, bool inGroup) {
+  std::set<uint32_t> before(model.lru.begin(), model.lru.end());
+  std::vector<uint32_t> added, removed;
+  for (const auto &item : comm->homoCommPool) {
+    if (!before.count(item.first))
+      added.push_back(item.first);
+  }
+  for (uint32_t idx : model.lru) {
+    if (!comm->homoCommPool.count(idx))
+      removed.push_back(idx);
+  }
+  if (added.size() > 1)
+    POOLFAIL(model, "# rank %d: %zu communicators created by one call\n",
+             rank, added.size());
+
+  // The victims are the least recently used ones that are not best, as many
+  // as it takes to make room for the new one
+  std::vector<uint32_t> expected;
+  if (!added.empty()) {
+    size_t size = before.size();
+    for (auto it = model.lru.rbegin();
+         it != model.lru.rend() && size >= model.poolSize; ++it) {
+      if (!isBest(comm, *it)) {
+        expected.push_back(*it);
+        size--;
+      }
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+  std::sort(removed.begin(), removed.end());
+  if (removed != expected) {
+    POOLFAIL(model, "# rank %d: evicted configs {%s}, expected {%s}\n", rank,
+             joinConfigs(removed).c_str(), joinConfigs(expected).c_str());
+  }
+
+  // Only best ones are kept past the pool size, beside the one just created
+  size_t best = 0;
+  for (const auto &item : comm->homoCommPool)
+    best += isBest(comm, item.first);
+  if (comm->homoCommPool.size() > std::max(model.poolSize, best + 1))
+    POOLFAIL(model, "# rank %d: %zu communicators pooled, %zu are best\n",
+             rank, comm->homoCommPool.size(), best);
+
+  // A creation first destroys the retired communicators whose ops are done,
+  // which all are here since the stream was synchronized, but not in a group
+  size_t retired = comm->homoCommRetired.size();
+  if (!added.empty()) {
+    size_t left = inGroup ? retiredBefore + removed.size() : removed.size();
+    if (retired != left)
+      POOLFAIL(model, "# rank %d: %zu communicators retired, expected %zu\n",
+               rank, retired, left);
+  } else if (retired != retiredBefore) {
+    POOLFAIL(model, "# rank %d: retired communicators went %zu -> %zu\n", rank,
+             retiredBefore, retired);
+  }
+  // The ones retired by this call are last
+  if (inGroup) {
+    for (size_t i = retired - std::min(retired, removed.size()); i < retired;
+         i++) {
+      if (!comm->homoCommRetired[i].events.empty())
+        POOLFAIL(model, "# rank %d: event recorded inside a group\n", rank);
+    }
+  }
+
+  for (uint32_t idx : removed)
+    model.lru.remove(idx);
+  for (uint32_t idx : added)
+    model.lru.push_front(idx);
+  uint32_t used = poolKey(comm, comm->homo_comm);
+  if (used == UINT32_MAX) {
+    POOLFAIL(model, "# rank %d: communicator in use is not pooled\n", rank);
+  } else {
+    model.lru.remove(used);
+    model.lru.push_front(used);
+  }
+  model.created += added.size();
+  model.evicted += removed.size();
+}
+
+static int checkResult(flagcxDeviceHandle_t devHandle, void *buff,
+                       size_t count, int nranks) {
+  std::vector<float> host(count);
+  POOLCHECK(devHandle->deviceMemcpy(host.data(), buff, count * sizeof(float),
+                                    flagcxMemcpyDeviceToHost, NULL));
+  float expected = nranks * (nranks + 1) / 2.0f;
+  for (size_t i = 0; i < count; i++) {
+    if (host[i] != expected)
+      return 1;
+  }
+  return 0;
+}
+
+static int runRank(flagcxHandlerGroup_t handler, int rank, int nranks,
+                   size_t poolSize, int rounds) {
+  flagcxDeviceHandle_t devHandle = handler->devHandle;
+  flagcxComm_t comm = NULL;
+  POOLCHECK(flagcxCommInitRank(&comm, nranks, handler->uniqueId, rank));
+  if (comm->tuner == NULL) {
+    printf("# rank %d: no tuner on the communicator\n", rank);
+    return 1;
+  }
+  flagcxStream_t stream;
+  POOLCHECK(devHandle->streamCreate(&stream));
+
+  // One size per power of two, each its own tuner bucket
+  const size_t counts[] = {256, 4096, 65536};
+  const int nSizes = sizeof(counts) / sizeof(counts[0]);
+  std::vector<void *> buffs(nSizes);
+  std::vector<float> init(counts[nSizes - 1], (float)(rank + 1));
+  for (int s = 0; s < nSizes; s++) {
+    POOLCHECK(devHandle->deviceMalloc(&buffs[s], counts[s] * sizeof(float),
+                                      flagcxMemDevice, NULL));
+  }
+
+  poolModel model = {poolSize, {}, 0, 0, 0};
+  int wrong = 0;
+  for (int round = 0; round < rounds; round++) {
+    // Every other round runs in one group: retired communicators must wait
+    // for the group end before their ops are tracked
+    bool group = round % 2;
+    if (group)
+      POOLCHECK(flagcxGroupStart(comm));
+    for (int s = 0; s < std::min(round + 1, nSizes); s++) {
+      POOLCHECK(devHandle->deviceMemcpy(
+          buffs[s], init.data(), counts[s] * sizeof(float),
+          flagcxMemcpyHostToDevice, NULL));
+      size_t retired = comm->homoCommRetired.size();
+      POOLCHECK(flagcxAllReduce(buffs[s], buffs[s], counts[s], flagcxFloat,
+                                flagcxSum, comm, stream));
+      if (!group)
+        POOLCHECK(devHandle->streamSynchronize(stream));
+      checkPool(comm, model, rank, retired, group);
+    }
+    if (group) {
+      POOLCHECK(flagcxGroupEnd(comm));
+      POOLCHECK(devHandle->streamSynchronize(stream));
+    }
+    for (int s = 0; s < std::min(round + 1, nSizes); s++)
+      wrong += checkResult(devHandle, buffs[s], counts[s], nranks);
+  }
+  if (wrong)
+    POOLFAIL(model, "# rank %d: %d wrong results\n", rank, wrong);
+
+  printf("# rank %d: %d created, %d evicted, %zu pooled, %zu retired\n", rank,
+         model.created, model.evicted, comm->homoCommPool.size(),
+         comm->homoCommRetired.size());
+  if (model.evicted == 0 && model.created > (int)poolSize)
+    POOLFAIL(model, "# rank %d: the pool never evicted\n", rank);
+
+  for (int s = 0; s < nSizes; s++)
+    POOLCHECK(devHandle->deviceFree(buffs[s], flagcxMemDevice, NULL));
+  POOLCHECK(devHandle->streamDestroy(stream));
+  POOLCHECK(flagcxCommDestroy(comm));
+  return model.failures;
+}
+
+int main(int argc, char *argv[]) {
+  int nranks = 2;
+  int poolSize = 2;
+  int rounds = 16;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:p:i:")) != -1) {
+    switch (opt) {
+      case 'n':
+        nranks = atoi(optarg);
+        break;
+      case 'p':
+        poolSize = atoi(optarg);
+        break;
+      case 'i':
+        rounds = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n ranks] [-p pool size] [-i rounds]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+  if (nranks < 1 || poolSize < 1 || rounds < 1) {
+    fprintf(stderr, "ranks, pool size and rounds must be positive\n");
+    return 1;
+  }
+  // The ranks read these at init, one search loop per config keeps the
+  // search short
+  std::string pool = std::to_string(poolSize);
+  setenv("FLAGCX_USE_TUNER", "1", 1);
+  setenv("FLAGCX_TUNER_COMM_POOL_SIZE", pool.c_str(), 1);
+  setenv("FLAGCX_TUNER_SEARCH_NLOOPS", "1", 0);
+
+  flagcxHandlerGroup_t handler;
+  POOLCHECK(flagcxHandleInit(&handler));
+  POOLCHECK(flagcxGetUniqueId(&handler->uniqueId));
+  printf("# %d ranks, pool of %d communicators, %d rounds\n", nranks,
+         poolSize, rounds);
+  fflush(stdout);
+  std::vector<pid_t> pids;
+  for (int r = 0; r < nranks; r++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      int failures = runRank(handler, r, nranks, poolSize, rounds);
+      fflush(stdout);
+      _exit(failures ? 1 : 0);
+    }
+    pids.push_back(pid);
+  }
+  int failures = 0;
+  for (pid_t pid : pids) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  }
+  POOLCHECK(flagcxHandleFree(handler));
+  printf("# %s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
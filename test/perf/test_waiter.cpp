@@ -0,0 +1,110 @@
+#include "waiter.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <thread>
+
+// Idle cost and wake-up latency of the proxy wait policy. A producer posts
+// items with a fixed gap, the consumer polls for them like the proxy
+// progress thread, either with sched_yield only (the former loop) or with
+// flagcxWaiter, woken by the producer. Reported are the average latency
+// from post to consumption and the CPU time the consumer burnt per second.
+// usage: test_waiter [-n items per run] [-g max gap us]
+
+static uint64_t nowNs() {
+  using clock = std::chrono::steady_clock;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             clock::now().time_since_epoch())
+      .count();
+}
+
+static double threadCpuSec() {
+  struct rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+struct result {
+  double latencyUs;
+  double cpuPerSec;
+};
+
+static result runWaiter(bool adaptive, int nItems, int gapUs) {
+  uint64_t posted = 0; // timestamp of the pending item, 0 when none
+  struct flagcxWaiter waiter = {};
+  double latency = 0, cpu = 0;
+  uint64_t start = nowNs();
+
+  std::thread consumer([&]() {
+    double cpu0 = threadCpuSec();
+    flagcxWaiterInit(&waiter);
+    for (int i = 0; i < nItems;) {
+      uint32_t seq = flagcxWaiterPrepare(&waiter);
+      uint64_t t = __atomic_load_n(&posted, __ATOMIC_ACQUIRE);
+      if (t != 0) {
+        latency += nowNs() - t;
+        __atomic_store_n(&posted, 0, __ATOMIC_RELEASE);
+        i++;
+        if (adaptive)
+          flagcxWaiterProgress(&waiter);
+        continue;
+      }
+      if (adaptive) {
+        flagcxWaiterIdle(&waiter, seq, true);
+      } else {
+        sched_yield();
+      }
+    }
+    cpu = threadCpuSec() - cpu0;
+  });
+
+  for (int i = 0; i < nItems; i++) {
+    uint64_t next = nowNs() + gapUs * 1000ULL;
+    while (__atomic_load_n(&posted, __ATOMIC_ACQUIRE) != 0 || nowNs() < next)
+      std::this_thread::sleep_for(std::chrono::microseconds(gapUs / 4 + 1));
+    __atomic_store_n(&posted, nowNs(), __ATOMIC_RELEASE);
+    if (adaptive)
+      flagcxWaiterWake(&waiter);
+  }
+  consumer.join();
+  double elapsed = (nowNs() - start) * 1e-9;
+  if (adaptive)
+    flagcxWaiterReport(&waiter, "test consumer", 0);
+  return {latency / nItems * 1e-3, cpu / elapsed};
+}
+
+int main(int argc, char *argv[]) {
+  int nItems = 2000, maxGapUs = 1000;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:g:")) != -1) {
+    switch (opt) {
+      case 'n':
+        nItems = atoi(optarg);
+        break;
+      case 'g':
+        maxGapUs = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n items per run] [-g max gap us]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  printf("# %d items per run\n", nItems);
+  printf("%10s %10s %14s %14s\n", "policy", "gap(us)", "latency(us)",
+         "cpu(s/s)");
+  const char *names[] = {"yield", "adaptive"};
+  for (int gap = 10; gap <= maxGapUs; gap *= 10) {
+    for (int adaptive = 0; adaptive <= 1; adaptive++) {
+      result r = runWaiter(adaptive, nItems, gap);
+      printf("%10s %10d %14.2f %14.3f\n", names[adaptive], gap, r.latencyUs,
+             r.cpuPerSec);
+    }
+  }
+  return 0;
+}